@@ -211,7 +211,7 @@ typedef enum OPTION_choice {
     OPT_COMMON,
     OPT_ELAPSED, OPT_EVP, OPT_HMAC, OPT_DECRYPT, OPT_ENGINE, OPT_MULTI,
     OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS, OPT_R_ENUM, OPT_PROV_ENUM,
-    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC
+    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC, OPT_BATCH
 } OPTION_CHOICE;
 
 const OPTIONS speed_options[] = {
@@ -233,6 +233,8 @@ const OPTIONS speed_options[] = {
     {"engine", OPT_ENGINE, 's', "Use engine, possibly a hardware device"},
 #endif
     {"primes", OPT_PRIMES, 'p', "Specify number of primes (for RSA only)"},
+    {"batch", OPT_BATCH, 'p',
+     "Derive ECDH shared secrets in batches of the specified size"},
 
     OPT_SECTION("Selection"),
     {"evp", OPT_EVP, 's', "Use EVP-named cipher or digest"},
@@ -472,6 +474,10 @@ typedef struct loopargs_st {
     EVP_PKEY_CTX *ecdsa_sign_ctx[ECDSA_NUM];
     EVP_PKEY_CTX *ecdsa_verify_ctx[ECDSA_NUM];
     EVP_PKEY_CTX *ecdh_ctx[EC_NUM];
+    EVP_PKEY_CTX **ecdh_batch_ctx[EC_NUM];
+    unsigned char *ecdh_batch_buf;
+    unsigned char **ecdh_batch_secret;
+    size_t *ecdh_batch_outlen;
     EVP_MD_CTX *eddsa_ctx[EdDSA_NUM];
     EVP_MD_CTX *eddsa_ctx2[EdDSA_NUM];
 #ifndef OPENSSL_NO_SM2
@@ -975,6 +981,7 @@ static int ECDSA_verify_loop(void *args)
 
 /* ******************************************************************** */
 static long ecdh_c[EC_NUM][1];
+static int ecdh_batch = 1;
 
 static int ECDH_EVP_derive_key_loop(void *args)
 {
@@ -990,6 +997,22 @@ static int ECDH_EVP_derive_key_loop(void *args)
     return count;
 }
 
+static int ECDH_EVP_derive_key_batch_loop(void *args)
+{
+    loopargs_t *tempargs = *(loopargs_t **) args;
+    EVP_PKEY_CTX **ctx = tempargs->ecdh_batch_ctx[testnum];
+    int count, j;
+
+    for (count = 0; COND(ecdh_c[testnum][0]); count += ecdh_batch) {
+        for (j = 0; j < ecdh_batch; j++)
+            tempargs->ecdh_batch_outlen[j] = MAX_ECDH_SIZE;
+        EVP_PKEY_derive_batch(ctx, ecdh_batch, tempargs->ecdh_batch_secret,
+                              tempargs->ecdh_batch_outlen);
+    }
+
+    return count;
+}
+
 static long eddsa_c[EdDSA_NUM][2];
 static int EdDSA_sign_loop(void *args)
 {
@@ -1597,6 +1620,14 @@ int speed_main(int argc, char **argv)
         case OPT_PRIMES:
             primes = opt_int_arg();
             break;
+        case OPT_BATCH:
+            ecdh_batch = opt_int_arg();
+            if (ecdh_batch < 1) {
+                BIO_printf(bio_err, "%s: batch size must be positive\n",
+                           prog);
+                goto opterr;
+            }
+            break;
         case OPT_SECONDS:
             seconds.sym = seconds.rsa = seconds.dsa = seconds.ecdsa
                         = seconds.ecdh = seconds.eddsa
@@ -1792,6 +1823,18 @@ int speed_main(int argc, char **argv)
         loopargs[i].sigsize = buflen - misalign;
         loopargs[i].secret_a = app_malloc(MAX_ECDH_SIZE, "ECDH secret a");
         loopargs[i].secret_b = app_malloc(MAX_ECDH_SIZE, "ECDH secret b");
+        if (ecdh_batch > 1) {
+            loopargs[i].ecdh_batch_buf =
+                app_malloc(ecdh_batch * MAX_ECDH_SIZE, "ECDH batch secrets");
+            loopargs[i].ecdh_batch_secret =
+                app_malloc(ecdh_batch * sizeof(unsigned char *),
+                           "ECDH batch secret pointers");
+            loopargs[i].ecdh_batch_outlen =
+                app_malloc(ecdh_batch * sizeof(size_t), "ECDH batch lengths");
+            for (k = 0; k < (unsigned int)ecdh_batch; k++)
+                loopargs[i].ecdh_batch_secret[k] =
+                    loopargs[i].ecdh_batch_buf + k * MAX_ECDH_SIZE;
+        }
 #ifndef OPENSSL_NO_DH
         loopargs[i].secret_ff_a = app_malloc(MAX_FFDH_SIZE, "FFDH secret a");
         loopargs[i].secret_ff_b = app_malloc(MAX_FFDH_SIZE, "FFDH secret b");
@@ -2646,6 +2689,28 @@ int speed_main(int argc, char **argv)
             loopargs[i].ecdh_ctx[testnum] = ctx;
             loopargs[i].outlen[testnum] = outlen;
 
+            /* The contexts of a batch all derive the same secret */
+            if (ecdh_batch > 1) {
+                loopargs[i].ecdh_batch_ctx[testnum] =
+                    app_malloc(ecdh_batch * sizeof(EVP_PKEY_CTX *),
+                               "ECDH batch contexts");
+                for (k = 0; k < (unsigned int)ecdh_batch; k++)
+                    if ((loopargs[i].ecdh_batch_ctx[testnum][k] =
+                             EVP_PKEY_CTX_dup(ctx)) == NULL)
+                        break;
+                if (k < (unsigned int)ecdh_batch) {
+                    while (k-- > 0)
+                        EVP_PKEY_CTX_free(loopargs[i].ecdh_batch_ctx[testnum][k]);
+                    OPENSSL_free(loopargs[i].ecdh_batch_ctx[testnum]);
+                    loopargs[i].ecdh_batch_ctx[testnum] = NULL;
+                    ecdh_checks = 0;
+                    BIO_printf(bio_err, "ECDH context duplication failure.\n");
+                    ERR_print_errors(bio_err);
+                    op_count = 1;
+                    break;
+                }
+            }
+
             EVP_PKEY_free(key_A);
             EVP_PKEY_free(key_B);
             EVP_PKEY_CTX_free(test_ctx);
@@ -2657,7 +2722,10 @@ int speed_main(int argc, char **argv)
                                ec_curves[testnum].bits, seconds.ecdh);
             Time_F(START);
             count =
-                run_benchmark(async_jobs, ECDH_EVP_derive_key_loop, loopargs);
+                run_benchmark(async_jobs, ecdh_batch > 1
+                                          ? ECDH_EVP_derive_key_batch_loop
+                                          : ECDH_EVP_derive_key_loop,
+                              loopargs);
             d = Time_F(STOP);
             BIO_printf(bio_err,
                        mr ? "+R7:%ld:%d:%.2f\n" :
@@ -3304,8 +3372,16 @@ int speed_main(int argc, char **argv)
             EVP_PKEY_CTX_free(loopargs[i].ecdsa_sign_ctx[k]);
             EVP_PKEY_CTX_free(loopargs[i].ecdsa_verify_ctx[k]);
         }
-        for (k = 0; k < EC_NUM; k++)
+        for (k = 0; k < EC_NUM; k++) {
             EVP_PKEY_CTX_free(loopargs[i].ecdh_ctx[k]);
+            if (loopargs[i].ecdh_batch_ctx[k] != NULL) {
+                int j;
+
+                for (j = 0; j < ecdh_batch; j++)
+                    EVP_PKEY_CTX_free(loopargs[i].ecdh_batch_ctx[k][j]);
+                OPENSSL_free(loopargs[i].ecdh_batch_ctx[k]);
+            }
+        }
         for (k = 0; k < EdDSA_NUM; k++) {
             EVP_MD_CTX_free(loopargs[i].eddsa_ctx[k]);
             EVP_MD_CTX_free(loopargs[i].eddsa_ctx2[k]);
@@ -3330,6 +3406,9 @@ int speed_main(int argc, char **argv)
 #endif
         OPENSSL_free(loopargs[i].secret_a);
         OPENSSL_free(loopargs[i].secret_b);
+        OPENSSL_free(loopargs[i].ecdh_batch_buf);
+        OPENSSL_free(loopargs[i].ecdh_batch_secret);
+        OPENSSL_free(loopargs[i].ecdh_batch_outlen);
     }
     OPENSSL_free(evp_hmac_name);
     OPENSSL_free(evp_cmac_name);
@@ -16,6 +16,7 @@
 #include "internal/provider.h"
 #include "crypto/ctype.h"
 #include "crypto/rand.h"
+#include "internal/tsan_assist.h"
 
 struct ossl_lib_ctx_onfree_list_st {
     ossl_lib_ctx_onfree_fn *fn;
@@ -43,6 +44,24 @@ struct ossl_lib_ctx_st {
     int run_once_ret[OSSL_LIB_CTX_MAX_RUN_ONCE];
     struct ossl_lib_ctx_onfree_list_st *onfreelist;
     unsigned int ischild:1;
+
+    /* Read on every EVP fetch, so kept here where no lock is needed */
+    TSAN_QUALIFIER int thread_fetch_cache;
+    /*
+     * Changed whenever a method store of this context changes in a way
+     * that could change the result of a fetch, which makes the entries of
+     * the per-thread fetch caches for this context stale.  The values come
+     * from |fetch_generations|, see new_fetch_generation().
+     */
+    TSAN_QUALIFIER size_t fetch_generation;
+
+    /*
+     * Set by OSSL_LIB_CTX_freeze(), along with a snapshot of the data that
+     * existed at the time, which ossl_lib_ctx_get_data() can then return
+     * without taking any lock.
+     */
+    TSAN_QUALIFIER int frozen;
+    void *frozen_data[OSSL_LIB_CTX_MAX_INDEXES];
 };
 
 int ossl_lib_ctx_write_lock(OSSL_LIB_CTX *ctx)
@@ -69,6 +88,88 @@ int ossl_lib_ctx_is_child(OSSL_LIB_CTX *ctx)
     return ctx->ischild;
 }
 
+static int lib_ctx_frozen(OSSL_LIB_CTX *ctx)
+{
+#ifdef tsan_ld_acq
+    return tsan_ld_acq(&ctx->frozen);
+#else
+    int frozen;
+
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return 0;
+    frozen = ctx->frozen;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return frozen;
+#endif
+}
+
+int ossl_lib_ctx_is_frozen(OSSL_LIB_CTX *ctx)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx == NULL)
+        return 0;
+    return lib_ctx_frozen(ctx);
+}
+
+/* For callers that hold the lock of |ctx|, which freezing it needs */
+int ossl_lib_ctx_is_frozen_locked(OSSL_LIB_CTX *ctx)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx == NULL)
+        return 0;
+    return ctx->frozen;
+}
+
+void ossl_lib_ctx_set_thread_fetch_cache(OSSL_LIB_CTX *ctx, int enable)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx != NULL)
+        tsan_store(&ctx->thread_fetch_cache, enable != 0);
+}
+
+int ossl_lib_ctx_thread_fetch_cache(OSSL_LIB_CTX *ctx)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx == NULL)
+        return 0;
+    return tsan_load(&ctx->thread_fetch_cache);
+}
+
+/*
+ * Fetch generations are unique in the process, not just in their library
+ * context.  The per-thread fetch caches identify a library context by its
+ * address, and those of other threads may still hold entries for a library
+ * context that was freed when a new one is allocated at the same address.
+ * Their generations can never match those of the new one.
+ */
+static TSAN_QUALIFIER size_t fetch_generations;
+
+static size_t new_fetch_generation(void)
+{
+    return tsan_counter(&fetch_generations) + 1;
+}
+
+size_t ossl_lib_ctx_fetch_generation(OSSL_LIB_CTX *ctx)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx == NULL)
+        return 0;
+    return tsan_load(&ctx->fetch_generation);
+}
+
+void ossl_lib_ctx_new_fetch_generation(OSSL_LIB_CTX *ctx)
+{
+    ctx = ossl_lib_ctx_get_concrete(ctx);
+
+    if (ctx != NULL)
+        tsan_store(&ctx->fetch_generation, new_fetch_generation());
+}
+
 static int context_init(OSSL_LIB_CTX *ctx)
 {
     size_t i;
@@ -82,6 +183,8 @@ static int context_init(OSSL_LIB_CTX *ctx)
     if (ctx->oncelock == NULL)
         goto err;
 
+    ctx->fetch_generation = new_fetch_generation();
+
     for (i = 0; i < OSSL_LIB_CTX_MAX_INDEXES; i++) {
         ctx->index_locks[i] = CRYPTO_THREAD_lock_new();
         ctx->dyn_indexes[i] = -1;
@@ -122,6 +225,10 @@ static int context_deinit(OSSL_LIB_CTX *ctx)
     if (ctx == NULL)
         return 1;
 
+    /* Everything is torn down the usual way */
+    ctx->frozen = 0;
+    memset(ctx->frozen_data, 0, sizeof(ctx->frozen_data));
+
     ossl_ctx_thread_stop(ctx);
 
     onfree = ctx->onfreelist;
@@ -273,6 +380,93 @@ OSSL_LIB_CTX *OSSL_LIB_CTX_set0_default(OSSL_LIB_CTX *libctx)
     return NULL;
 }
 
+int OSSL_LIB_CTX_set_method_cache_size(OSSL_LIB_CTX *ctx, size_t size)
+{
+    if (ossl_lib_ctx_is_frozen(ctx)) {
+        ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+        return 0;
+    }
+    return ossl_method_cache_set_size(ctx, size);
+}
+
+size_t OSSL_LIB_CTX_get_method_cache_size(OSSL_LIB_CTX *ctx)
+{
+    return ossl_method_cache_get_size(ctx);
+}
+
+int OSSL_LIB_CTX_get_method_cache_stats(OSSL_LIB_CTX *ctx, uint64_t *hits,
+                                        uint64_t *misses, uint64_t *evictions)
+{
+    return ossl_method_cache_get_stats(ctx, hits, misses, evictions);
+}
+
+/* The indexes of the method stores, see OSSL_LIB_CTX_freeze() */
+static const int method_store_indexes[] = {
+    OSSL_LIB_CTX_EVP_METHOD_STORE_INDEX,
+    OSSL_LIB_CTX_ENCODER_STORE_INDEX,
+    OSSL_LIB_CTX_DECODER_STORE_INDEX,
+    OSSL_LIB_CTX_STORE_LOADER_STORE_INDEX
+};
+
+int OSSL_LIB_CTX_freeze(OSSL_LIB_CTX *ctx, const char *propq)
+{
+    OSSL_LIB_CTX *concrete = ossl_lib_ctx_get_concrete(ctx);
+    OSSL_METHOD_STORE *stores[OSSL_NELEM(method_store_indexes)];
+    size_t j;
+    int i, dynidx;
+
+    if (concrete == NULL)
+        return 0;
+    if (concrete->ischild) {
+        /* The providers of a child follow those of its parent */
+        ERR_raise_data(ERR_LIB_CRYPTO, ERR_R_PASSED_INVALID_ARGUMENT,
+                       "child library contexts can't be frozen");
+        return 0;
+    }
+    if (lib_ctx_frozen(concrete))
+        return 1;
+
+    /* Methods can't be constructed any more once frozen, so do it now */
+    if (!OSSL_LIB_CTX_prefetch(ctx, "all", propq))
+        return 0;
+
+    /*
+     * Only the method stores that exist now are searched without a lock
+     * later on.  They are frozen without holding the lock of the context,
+     * because writers may need it while they hold the lock of a shard.
+     */
+    if (!CRYPTO_THREAD_read_lock(concrete->lock))
+        return 0;
+    for (j = 0; j < OSSL_NELEM(method_store_indexes); j++) {
+        dynidx = concrete->dyn_indexes[method_store_indexes[j]];
+        stores[j] = dynidx != -1 ? CRYPTO_get_ex_data(&concrete->data, dynidx)
+                                 : NULL;
+    }
+    CRYPTO_THREAD_unlock(concrete->lock);
+    for (j = 0; j < OSSL_NELEM(method_store_indexes); j++)
+        if (stores[j] != NULL && !ossl_method_store_freeze(stores[j]))
+            return 0;
+
+    if (!CRYPTO_THREAD_write_lock(concrete->lock))
+        return 0;
+    for (i = 0; i < OSSL_LIB_CTX_MAX_INDEXES; i++)
+        if ((dynidx = concrete->dyn_indexes[i]) != -1)
+            concrete->frozen_data[i] = CRYPTO_get_ex_data(&concrete->data,
+                                                          dynidx);
+#ifdef tsan_st_rel
+    tsan_st_rel(&concrete->frozen, 1);
+#else
+    concrete->frozen = 1;
+#endif
+    CRYPTO_THREAD_unlock(concrete->lock);
+    return 1;
+}
+
+int OSSL_LIB_CTX_is_frozen(OSSL_LIB_CTX *ctx)
+{
+    return ossl_lib_ctx_is_frozen(ctx);
+}
+
 void ossl_release_default_drbg_ctx(void)
 {
     int dynidx = default_context_int.dyn_indexes[OSSL_LIB_CTX_DRBG_INDEX];
@@ -284,6 +478,7 @@ void ossl_release_default_drbg_ctx(void)
         data = CRYPTO_get_ex_data(&default_context_int.data, dynidx);
         ossl_rand_ctx_free(data);
         CRYPTO_set_ex_data(&default_context_int.data, dynidx, NULL);
+        default_context_int.frozen_data[OSSL_LIB_CTX_DRBG_INDEX] = NULL;
     }
 }
 #endif
@@ -374,6 +569,10 @@ void *ossl_lib_ctx_get_data(OSSL_LIB_CTX *ctx, int index,
     if (ctx == NULL)
         return NULL;
 
+    /* What existed when the context was frozen stays as it is */
+    if (lib_ctx_frozen(ctx) && (data = ctx->frozen_data[index]) != NULL)
+        return data;
+
     if (!CRYPTO_THREAD_read_lock(ctx->lock))
         return NULL;
     dynidx = ctx->dyn_indexes[index];
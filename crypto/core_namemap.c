@@ -9,9 +9,18 @@
 
 #include "internal/namemap.h"
 #include <openssl/lhash.h>
-#include "crypto/lhash.h"      /* ossl_lh_strcasehash */
+#include "crypto/ctype.h"      /* ossl_tolower */
 #include "internal/tsan_assist.h"
 #include "internal/sizes.h"
+#include "internal/core.h"
+
+/*
+ * Lookups can go through a lock-free index when the compiler gives us
+ * acquire/release semantics, see namemap_index_lookup() below.
+ */
+#ifdef tsan_ld_acq
+# define NAMEMAP_INDEX_LOCKLESS
+#endif
 
 /*-
  * The namenum entry
@@ -19,11 +28,40 @@
  */
 typedef struct {
     char *name;
+    size_t name_len;
+    unsigned long hash;                /* Precomputed namenum_hash_n() */
     int number;
 } NAMENUM_ENTRY;
 
 DEFINE_LHASH_OF(NAMENUM_ENTRY);
 
+#ifdef NAMEMAP_INDEX_LOCKLESS
+/*-
+ * The lookup index
+ * ================
+ *
+ * An open addressing table with linear probing that mirrors the hash table
+ * of entries.  Slots are only ever filled in, under the namemap write lock,
+ * and always with a fully initialised entry that lives as long as the
+ * namemap, so readers can probe it without any lock.  When the table needs
+ * to grow, a new one is built and published, and the old one is kept on
+ * the retired list until the namemap is freed, since readers may still be
+ * looking at it.  Tables double in size, so the retired tables never take
+ * more space than the current one.
+ */
+# define NAMEMAP_INDEX_MIN_SLOTS 64
+
+typedef NAMENUM_ENTRY *TSAN_QUALIFIER NAMENUM_SLOT;
+
+typedef struct namemap_index_st NAMEMAP_INDEX;
+struct namemap_index_st {
+    size_t mask;                       /* Number of slots - 1 */
+    size_t used;                       /* Number of filled slots */
+    NAMENUM_SLOT *slots;
+    NAMEMAP_INDEX *retired;            /* Next older index, if retired */
+};
+#endif
+
 /*-
  * The namemap itself
  * ==================
@@ -32,23 +70,58 @@ DEFINE_LHASH_OF(NAMENUM_ENTRY);
 struct ossl_namemap_st {
     /* Flags */
     unsigned int stored:1; /* If 1, it's stored in a library context */
+    unsigned int noindex:1; /* If 1, the lookup index couldn't be grown */
 
+    OSSL_LIB_CTX *libctx;              /* If stored, the owning context */
     CRYPTO_RWLOCK *lock;
     LHASH_OF(NAMENUM_ENTRY) *namenum;  /* Name->number mapping */
 
+#ifdef NAMEMAP_INDEX_LOCKLESS
+    /*
+     * Lock-free copy of the name->number mapping.  NULL means that lookups
+     * must go through |namenum| under lock.
+     */
+    NAMEMAP_INDEX *TSAN_QUALIFIER index;
+    NAMEMAP_INDEX *retired;            /* Indexes that have been replaced */
+#endif
+
     TSAN_QUALIFIER int max_number;     /* Current max number */
 };
 
+/*
+ * Case insensitive FNV-1a over a name that isn't necessarily NUL terminated,
+ * so lookups don't have to copy it first.
+ */
+static unsigned long namenum_hash_n(const char *name, size_t name_len)
+{
+    unsigned long h = 2166136261UL;
+    size_t i;
+
+    for (i = 0; i < name_len; i++) {
+        h ^= (unsigned char)ossl_tolower(name[i]);
+        h = (h * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
+
+static int namenum_match(const NAMENUM_ENTRY *n, const char *name,
+                         size_t name_len, unsigned long hash)
+{
+    return n->hash == hash
+        && n->name_len == name_len
+        && OPENSSL_strncasecmp(n->name, name, name_len) == 0;
+}
+
 /* LHASH callbacks */
 
 static unsigned long namenum_hash(const NAMENUM_ENTRY *n)
 {
-    return ossl_lh_strcasehash(n->name);
+    return n->hash;
 }
 
 static int namenum_cmp(const NAMENUM_ENTRY *a, const NAMENUM_ENTRY *b)
 {
-    return OPENSSL_strcasecmp(a->name, b->name);
+    return !namenum_match(a, b->name, b->name_len, b->hash);
 }
 
 static void namenum_free(NAMENUM_ENTRY *n)
@@ -58,14 +131,128 @@ static void namenum_free(NAMENUM_ENTRY *n)
     OPENSSL_free(n);
 }
 
+#ifdef NAMEMAP_INDEX_LOCKLESS
+/* Index functions */
+
+static NAMEMAP_INDEX *namemap_index_new(size_t num_slots)
+{
+    NAMEMAP_INDEX *idx;
+
+    idx = OPENSSL_zalloc(sizeof(*idx) + num_slots * sizeof(NAMENUM_SLOT));
+    if (idx == NULL)
+        return NULL;
+    idx->mask = num_slots - 1;
+    idx->slots = (NAMENUM_SLOT *)(idx + 1);
+    return idx;
+}
+
+static void namemap_index_free(NAMEMAP_INDEX *idx)
+{
+    NAMEMAP_INDEX *next;
+
+    for (; idx != NULL; idx = next) {
+        next = idx->retired;
+        OPENSSL_free(idx);
+    }
+}
+
+/* Must be called with the namemap write lock held */
+static void namemap_index_fill(NAMEMAP_INDEX *idx, NAMENUM_ENTRY *n)
+{
+    size_t i;
+
+    for (i = n->hash & idx->mask;
+         tsan_load(&idx->slots[i]) != NULL;
+         i = (i + 1) & idx->mask)
+        continue;
+    /* Publish the entry only once it's entirely set up */
+    tsan_st_rel(&idx->slots[i], n);
+    idx->used++;
+}
+
+static void namemap_index_retire(OSSL_NAMEMAP *namemap, NAMEMAP_INDEX *idx)
+{
+    if (idx != NULL) {
+        idx->retired = namemap->retired;
+        namemap->retired = idx;
+    }
+}
+
+/*
+ * Add an entry to the index, growing it if needed.  Must be called with the
+ * namemap write lock held.  If the index can't be grown, it's dropped, and
+ * lookups go back to using the hash table under lock.
+ */
+static void namemap_index_add(OSSL_NAMEMAP *namemap, NAMENUM_ENTRY *n)
+{
+    NAMEMAP_INDEX *idx = tsan_load(&namemap->index);
+    NAMEMAP_INDEX *newidx;
+    size_t num_slots, i;
+
+    if (namemap->noindex)
+        return;
+
+    /* Keep the load factor at or below 1/2, to keep probe sequences short */
+    if (idx != NULL && (idx->used + 1) * 2 <= idx->mask + 1) {
+        namemap_index_fill(idx, n);
+        return;
+    }
+
+    num_slots = idx == NULL ? NAMEMAP_INDEX_MIN_SLOTS : (idx->mask + 1) * 2;
+    if ((newidx = namemap_index_new(num_slots)) != NULL) {
+        if (idx != NULL)
+            for (i = 0; i <= idx->mask; i++) {
+                NAMENUM_ENTRY *old = tsan_load(&idx->slots[i]);
+
+                if (old != NULL)
+                    namemap_index_fill(newidx, old);
+            }
+        namemap_index_fill(newidx, n);
+    } else {
+        namemap->noindex = 1;
+    }
+    tsan_st_rel(&namemap->index, newidx);
+    namemap_index_retire(namemap, idx);
+}
+
+/*
+ * Returns 1 and sets |*entry| if the index could be searched, or 0 if the
+ * caller has to fall back to a locked search.
+ */
+static int namemap_index_lookup(const OSSL_NAMEMAP *namemap,
+                                const char *name, size_t name_len,
+                                unsigned long hash,
+                                const NAMENUM_ENTRY **entry)
+{
+    NAMEMAP_INDEX *idx = tsan_ld_acq(&((OSSL_NAMEMAP *)namemap)->index);
+    const NAMENUM_ENTRY *n;
+    size_t i;
+
+    if (idx == NULL)
+        return 0;
+
+    *entry = NULL;
+    for (i = hash & idx->mask;
+         (n = tsan_ld_acq(&idx->slots[i])) != NULL;
+         i = (i + 1) & idx->mask)
+        if (namenum_match(n, name, name_len, hash)) {
+            *entry = n;
+            break;
+        }
+    return 1;
+}
+#endif
+
 /* OSSL_LIB_CTX_METHOD functions for a namemap stored in a library context */
 
 static void *stored_namemap_new(OSSL_LIB_CTX *libctx)
 {
     OSSL_NAMEMAP *namemap = ossl_namemap_new();
 
-    if (namemap != NULL)
+    if (namemap != NULL) {
         namemap->stored = 1;
+        namemap->libctx = libctx;
+    }
 
     return namemap;
 }
@@ -171,24 +358,53 @@ int ossl_namemap_doall_names(const OSSL_NAMEMAP *namemap, int number,
     return 1;
 }
 
+static NAMENUM_ENTRY *namemap_retrieve(const OSSL_NAMEMAP *namemap,
+                                       const char *name, size_t name_len,
+                                       unsigned long hash)
+{
+    NAMENUM_ENTRY namenum_tmpl;
+
+    namenum_tmpl.name = (char *)name;
+    namenum_tmpl.name_len = name_len;
+    namenum_tmpl.hash = hash;
+    namenum_tmpl.number = 0;
+    return lh_NAMENUM_ENTRY_retrieve(namemap->namenum, &namenum_tmpl);
+}
+
 static int namemap_name2num_n(const OSSL_NAMEMAP *namemap,
                               const char *name, size_t name_len)
 {
-    NAMENUM_ENTRY *namenum_entry, namenum_tmpl;
+    NAMENUM_ENTRY *namenum_entry =
+        namemap_retrieve(namemap, name, name_len,
+                         namenum_hash_n(name, name_len));
 
-    if ((namenum_tmpl.name = OPENSSL_strndup(name, name_len)) == NULL)
-        return 0;
-    namenum_tmpl.number = 0;
-    namenum_entry =
-        lh_NAMENUM_ENTRY_retrieve(namemap->namenum, &namenum_tmpl);
-    OPENSSL_free(namenum_tmpl.name);
     return namenum_entry != NULL ? namenum_entry->number : 0;
 }
 
+/* Looks up a name, without holding the lock if at all possible */
+static const NAMENUM_ENTRY *namemap_lookup(const OSSL_NAMEMAP *namemap,
+                                           const char *name, size_t name_len)
+{
+    const NAMENUM_ENTRY *namenum_entry;
+    unsigned long hash = namenum_hash_n(name, name_len);
+
+#ifdef NAMEMAP_INDEX_LOCKLESS
+    if (namemap_index_lookup(namemap, name, name_len, hash, &namenum_entry))
+        return namenum_entry;
+#endif
+
+    if (!CRYPTO_THREAD_read_lock(namemap->lock))
+        return NULL;
+    namenum_entry = namemap_retrieve(namemap, name, name_len, hash);
+    CRYPTO_THREAD_unlock(namemap->lock);
+
+    return namenum_entry;
+}
+
 int ossl_namemap_name2num_n(const OSSL_NAMEMAP *namemap,
                             const char *name, size_t name_len)
 {
-    int number;
+    const NAMENUM_ENTRY *namenum_entry;
 
 #ifndef FIPS_MODULE
     if (namemap == NULL)
@@ -198,12 +414,8 @@ int ossl_namemap_name2num_n(const OSSL_NAMEMAP *namemap,
     if (namemap == NULL)
         return 0;
 
-    if (!CRYPTO_THREAD_read_lock(namemap->lock))
-        return 0;
-    number = namemap_name2num_n(namemap, name, name_len);
-    CRYPTO_THREAD_unlock(namemap->lock);
-
-    return number;
+    namenum_entry = namemap_lookup(namemap, name, name_len);
+    return namenum_entry != NULL ? namenum_entry->number : 0;
 }
 
 int ossl_namemap_name2num(const OSSL_NAMEMAP *namemap, const char *name)
@@ -251,9 +463,17 @@ static int namemap_add_name_n(OSSL_NAMEMAP *namemap, int number,
     if ((tmp_number = namemap_name2num_n(namemap, name, name_len)) != 0)
         return tmp_number;
 
+    /* No new names are accepted by a frozen library context */
+    if (namemap->stored && ossl_lib_ctx_is_frozen(namemap->libctx)) {
+        ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+        return 0;
+    }
+
     if ((namenum = OPENSSL_zalloc(sizeof(*namenum))) == NULL
         || (namenum->name = OPENSSL_strndup(name, name_len)) == NULL)
         goto err;
+    namenum->name_len = name_len;
+    namenum->hash = namenum_hash_n(name, name_len);
 
     /* The tsan_counter use here is safe since we're under lock */
     namenum->number =
@@ -262,6 +482,9 @@ static int namemap_add_name_n(OSSL_NAMEMAP *namemap, int number,
 
     if (lh_NAMENUM_ENTRY_error(namemap->namenum))
         goto err;
+#ifdef NAMEMAP_INDEX_LOCKLESS
+    namemap_index_add(namemap, namenum);
+#endif
     return namenum->number;
 
  err:
@@ -525,6 +748,10 @@ void ossl_namemap_free(OSSL_NAMEMAP *namemap)
 
     lh_NAMENUM_ENTRY_doall(namemap->namenum, namenum_free);
     lh_NAMENUM_ENTRY_free(namemap->namenum);
+#ifdef NAMEMAP_INDEX_LOCKLESS
+    namemap_index_free(namemap->index);
+    namemap_index_free(namemap->retired);
+#endif
 
     CRYPTO_THREAD_lock_free(namemap->lock);
     OPENSSL_free(namemap);
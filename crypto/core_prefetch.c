@@ -0,0 +1,197 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/encoder.h>
+#include <openssl/decoder.h>
+#include <openssl/trace.h>
+#include "internal/nelem.h"
+#include "crypto/ctype.h"
+
+/*
+ * Prefetching of algorithm implementations
+ * ========================================
+ *
+ * Constructing a method is by far the most expensive part of a fetch: the
+ * provider is queried for the operation, the names are added to the namemap
+ * and the method is built and added to the method store.  Prefetching does
+ * all of that up front, and then fetches each algorithm once by name so
+ * that the query cache is populated as well.  The methods stay in the method
+ * store for as long as their provider remains loaded, so nothing else needs
+ * to be held on to.
+ */
+
+typedef struct {
+    OSSL_LIB_CTX *libctx;
+    const char *propq;
+} PREFETCH_DATA;
+
+/*
+ * For the operations that are fetched by algorithm name.  The |do_all|
+ * callback fetches each method by name again, to populate the query cache.
+ */
+#define IMPLEMENT_PREFETCH(TYPE, type)                                      \
+    static void prefetch_##type##_one(TYPE *method, void *arg)              \
+    {                                                                       \
+        PREFETCH_DATA *data = arg;                                          \
+                                                                            \
+        TYPE##_free(TYPE##_fetch(data->libctx, TYPE##_get0_name(method),    \
+                                 data->propq));                             \
+    }                                                                       \
+    static void prefetch_##type##_all(PREFETCH_DATA *data)                  \
+    {                                                                       \
+        TYPE##_do_all_provided(data->libctx, prefetch_##type##_one, data);  \
+    }                                                                       \
+    static int prefetch_##type##_name(PREFETCH_DATA *data, const char *name)\
+    {                                                                       \
+        TYPE *method = TYPE##_fetch(data->libctx, name, data->propq);       \
+                                                                            \
+        TYPE##_free(method);                                                \
+        return method != NULL;                                              \
+    }
+
+/*
+ * For the operations that are looked up by other means than a name, such as
+ * encoders and decoders, which are collected with |do_all|.  Constructing
+ * them is all that can be done up front.
+ */
+#define IMPLEMENT_PREFETCH_ALL_ONLY(TYPE, type)                             \
+    static void prefetch_##type##_one(TYPE *method, void *arg)              \
+    {                                                                       \
+    }                                                                       \
+    static void prefetch_##type##_all(PREFETCH_DATA *data)                  \
+    {                                                                       \
+        TYPE##_do_all_provided(data->libctx, prefetch_##type##_one, data);  \
+    }
+
+IMPLEMENT_PREFETCH(EVP_MD, md)
+IMPLEMENT_PREFETCH(EVP_CIPHER, cipher)
+IMPLEMENT_PREFETCH(EVP_MAC, mac)
+IMPLEMENT_PREFETCH(EVP_KDF, kdf)
+IMPLEMENT_PREFETCH(EVP_RAND, rand)
+IMPLEMENT_PREFETCH(EVP_KEYMGMT, keymgmt)
+IMPLEMENT_PREFETCH(EVP_KEYEXCH, keyexch)
+IMPLEMENT_PREFETCH(EVP_SIGNATURE, signature)
+IMPLEMENT_PREFETCH(EVP_ASYM_CIPHER, asym_cipher)
+IMPLEMENT_PREFETCH(EVP_KEM, kem)
+IMPLEMENT_PREFETCH_ALL_ONLY(OSSL_ENCODER, encoder)
+IMPLEMENT_PREFETCH_ALL_ONLY(OSSL_DECODER, decoder)
+
+static const struct prefetch_operation_st {
+    const char *name;
+    void (*all)(PREFETCH_DATA *data);
+    int (*by_name)(PREFETCH_DATA *data, const char *name);
+} prefetch_operations[] = {
+    { "digest", prefetch_md_all, prefetch_md_name },
+    { "cipher", prefetch_cipher_all, prefetch_cipher_name },
+    { "mac", prefetch_mac_all, prefetch_mac_name },
+    { "kdf", prefetch_kdf_all, prefetch_kdf_name },
+    { "rand", prefetch_rand_all, prefetch_rand_name },
+    { "keymgmt", prefetch_keymgmt_all, prefetch_keymgmt_name },
+    { "keyexch", prefetch_keyexch_all, prefetch_keyexch_name },
+    { "signature", prefetch_signature_all, prefetch_signature_name },
+    { "asym-cipher", prefetch_asym_cipher_all, prefetch_asym_cipher_name },
+    { "kem", prefetch_kem_all, prefetch_kem_name },
+    { "encoder", prefetch_encoder_all, NULL },
+    { "decoder", prefetch_decoder_all, NULL },
+};
+
+static const struct prefetch_operation_st *
+prefetch_operation(const char *name, size_t name_len)
+{
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(prefetch_operations); i++)
+        if (strlen(prefetch_operations[i].name) == name_len
+            && OPENSSL_strncasecmp(prefetch_operations[i].name, name,
+                                   name_len) == 0)
+            return &prefetch_operations[i];
+    return NULL;
+}
+
+static void prefetch_all(PREFETCH_DATA *data,
+                         const struct prefetch_operation_st *op)
+{
+    OSSL_TRACE1(INIT, "Prefetching all %s implementations\n", op->name);
+
+    /* Individual algorithms not matching the property query aren't errors */
+    ERR_set_mark();
+    op->all(data);
+    ERR_pop_to_mark();
+}
+
+int OSSL_LIB_CTX_prefetch(OSSL_LIB_CTX *ctx, const char *algorithms,
+                          const char *propq)
+{
+    PREFETCH_DATA data;
+    const struct prefetch_operation_st *op;
+    const char *p, *q, *name;
+    char namebuf[256];
+    size_t i, l, op_len;
+
+    if (algorithms == NULL) {
+        ERR_raise(ERR_LIB_CRYPTO, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    data.libctx = ctx;
+    data.propq = propq;
+
+    for (p = algorithms; *p != '\0'; p += l) {
+        /* Items are separated by commas and/or white space */
+        while (*p == ',' || ossl_isspace(*p))
+            p++;
+        for (l = 0; p[l] != '\0' && p[l] != ',' && !ossl_isspace(p[l]); l++)
+            continue;
+        if (l == 0)
+            break;
+
+        /* Each item is "operation" or "operation:name" */
+        if ((q = memchr(p, ':', l)) != NULL)
+            op_len = q - p;
+        else
+            op_len = l;
+
+        if (op_len == 3 && OPENSSL_strncasecmp(p, "all", 3) == 0
+            && q == NULL) {
+            for (i = 0; i < OSSL_NELEM(prefetch_operations); i++)
+                prefetch_all(&data, &prefetch_operations[i]);
+            continue;
+        }
+
+        if ((op = prefetch_operation(p, op_len)) == NULL) {
+            ERR_raise_data(ERR_LIB_CRYPTO, ERR_R_PASSED_INVALID_ARGUMENT,
+                           "unknown operation: %.*s", (int)op_len, p);
+            return 0;
+        }
+        if (q == NULL) {
+            prefetch_all(&data, op);
+            continue;
+        }
+
+        name = q + 1;
+        if (op->by_name == NULL
+            || (size_t)(p + l - name) >= sizeof(namebuf)
+            || p + l == name) {
+            ERR_raise_data(ERR_LIB_CRYPTO, ERR_R_PASSED_INVALID_ARGUMENT,
+                           "%.*s", (int)l, p);
+            return 0;
+        }
+        memcpy(namebuf, name, p + l - name);
+        namebuf[p + l - name] = '\0';
+        OSSL_TRACE2(INIT, "Prefetching %s %s\n", op->name, namebuf);
+        if (!op->by_name(&data, namebuf))
+            return 0;
+    }
+    return 1;
+}
@@ -205,13 +205,13 @@ static void fe64_invert(fe64 out, const fe64 z)
 }
 
 /*
- * Duplicate of original x25519_scalar_mult_generic, but using
+ * Duplicate of original x25519_ladder_generic, but using
  * fe64_* subroutines.
  */
-static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
+static void x25519_ladder_mulx(fe64 x2, fe64 z2, const uint8_t scalar[32],
                                const uint8_t point[32])
 {
-    fe64 x1, x2, z2, x3, z3, tmp0, tmp1;
+    fe64 x1, x3, z3, tmp0, tmp1;
     uint8_t e[32];
     unsigned swap = 0;
     int pos;
@@ -253,11 +253,18 @@ static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
         fe64_mul(z2, tmp1, tmp0);
     }
 
+    OPENSSL_cleanse(e, sizeof(e));
+}
+
+static void x25519_scalar_mulx(uint8_t out[32], const uint8_t scalar[32],
+                               const uint8_t point[32])
+{
+    fe64 x2, z2;
+
+    x25519_ladder_mulx(x2, z2, scalar, point);
     fe64_invert(z2, z2);
     fe64_mul(x2, x2, z2);
     fe64_tobytes(out, x2);
-
-    OPENSSL_cleanse(e, sizeof(e));
 }
 #endif
 
@@ -690,24 +697,17 @@ static void fe51_invert(fe51 out, const fe51 z)
 }
 
 /*
- * Duplicate of original x25519_scalar_mult_generic, but using
+ * Duplicate of original x25519_ladder_generic, but using
  * fe51_* subroutines.
  */
-static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
-                               const uint8_t point[32])
+static void x25519_ladder51(fe51 x2, fe51 z2, const uint8_t scalar[32],
+                            const uint8_t point[32])
 {
-    fe51 x1, x2, z2, x3, z3, tmp0, tmp1;
+    fe51 x1, x3, z3, tmp0, tmp1;
     uint8_t e[32];
     unsigned swap = 0;
     int pos;
 
-# ifdef BASE_2_64_IMPLEMENTED
-    if (x25519_fe64_eligible()) {
-        x25519_scalar_mulx(out, scalar, point);
-        return;
-    }
-# endif
-
     memcpy(e, scalar, 32);
     e[0]  &= 0xf8;
     e[31] &= 0x7f;
@@ -745,11 +745,52 @@ static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
         fe51_mul(z2, tmp1, tmp0);
     }
 
+    OPENSSL_cleanse(e, sizeof(e));
+}
+
+static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
+                               const uint8_t point[32])
+{
+    fe51 x2, z2;
+
+# ifdef BASE_2_64_IMPLEMENTED
+    if (x25519_fe64_eligible()) {
+        x25519_scalar_mulx(out, scalar, point);
+        return;
+    }
+# endif
+
+    x25519_ladder51(x2, z2, scalar, point);
     fe51_invert(z2, z2);
     fe51_mul(x2, x2, z2);
     fe51_tobytes(out, x2);
+}
 
-    OPENSSL_cleanse(e, sizeof(e));
+/*
+ * Montgomery ladder without the final inversion, returning the fully
+ * reduced encodings of the projective X and Z coordinates of the result.
+ */
+static void x25519_scalar_mult_proj(uint8_t x[32], uint8_t z[32],
+                                    const uint8_t scalar[32],
+                                    const uint8_t point[32])
+{
+# ifdef BASE_2_64_IMPLEMENTED
+    if (x25519_fe64_eligible()) {
+        fe64 x2, z2;
+
+        x25519_ladder_mulx(x2, z2, scalar, point);
+        fe64_tobytes(x, x2);
+        fe64_tobytes(z, z2);
+        return;
+    } else
+# endif
+    {
+        fe51 x2, z2;
+
+        x25519_ladder51(x2, z2, scalar, point);
+        fe51_tobytes(x, x2);
+        fe51_tobytes(z, z2);
+    }
 }
 #endif
 
@@ -4374,10 +4415,9 @@ static void fe_mul121666(fe h, fe f)
     h[9] = (int32_t)h9;
 }
 
-static void x25519_scalar_mult_generic(uint8_t out[32],
-                                       const uint8_t scalar[32],
-                                       const uint8_t point[32]) {
-    fe x1, x2, z2, x3, z3, tmp0, tmp1;
+static void x25519_ladder_generic(fe x2, fe z2, const uint8_t scalar[32],
+                                  const uint8_t point[32]) {
+    fe x1, x3, z3, tmp0, tmp1;
     uint8_t e[32];
     unsigned swap = 0;
     int pos;
@@ -4418,16 +4458,27 @@ static void x25519_scalar_mult_generic(uint8_t out[32],
         fe_mul(z2, tmp1, tmp0);
     }
 
-    fe_invert(z2, z2);
-    fe_mul(x2, x2, z2);
-    fe_tobytes(out, x2);
-
     OPENSSL_cleanse(e, sizeof(e));
 }
 
 static void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
                                const uint8_t point[32]) {
-    x25519_scalar_mult_generic(out, scalar, point);
+    fe x2, z2;
+
+    x25519_ladder_generic(x2, z2, scalar, point);
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_tobytes(out, x2);
+}
+
+static void x25519_scalar_mult_proj(uint8_t x[32], uint8_t z[32],
+                                    const uint8_t scalar[32],
+                                    const uint8_t point[32]) {
+    fe x2, z2;
+
+    x25519_ladder_generic(x2, z2, scalar, point);
+    fe_tobytes(x, x2);
+    fe_tobytes(z, z2);
 }
 #endif
 
@@ -5650,3 +5701,105 @@ ossl_x25519_public_from_private(uint8_t out_public_value[32],
 
     OPENSSL_cleanse(e, sizeof(e));
 }
+
+/*
+ * Set |out[i]| to the encoding of x[i] / z[i] for the |num| elements, with
+ * a single field inversion for all of them (Montgomery's trick).  As with
+ * fe_invert(), an element with z[i] == 0 comes out as zero, and it does not
+ * disturb the results for the others.
+ */
+static void fe_batch_div(uint8_t *const out[], fe x[], fe z[], size_t num)
+{
+    fe acc[ECX_BATCH_MAX], zero, one, inv, t;
+    unsigned int iszero;
+    size_t i;
+
+    fe_0(zero);
+    fe_1(one);
+    for (i = 0; i < num; i++) {
+        iszero = fe_isnonzero(z[i]) ^ 1;
+        fe_cmov(z[i], one, iszero);
+        fe_cmov(x[i], zero, iszero);
+        if (i == 0)
+            fe_copy(acc[0], z[0]);
+        else
+            fe_mul(acc[i], acc[i - 1], z[i]);
+    }
+
+    /* inv = 1 / (z[0] * ... * z[i]) on each iteration */
+    fe_invert(inv, acc[num - 1]);
+    for (i = num - 1; i > 0; i--) {
+        fe_mul(t, inv, acc[i - 1]);
+        fe_mul(inv, inv, z[i]);
+        fe_mul(t, t, x[i]);
+        fe_tobytes(out[i], t);
+    }
+    fe_mul(t, inv, x[0]);
+    fe_tobytes(out[0], t);
+
+    OPENSSL_cleanse(acc, sizeof(acc));
+    OPENSSL_cleanse(inv, sizeof(inv));
+    OPENSSL_cleanse(t, sizeof(t));
+}
+
+int
+ossl_x25519_batch(size_t num, uint8_t *const out_shared_key[],
+                  const uint8_t *const private_key[],
+                  const uint8_t *const peer_public_value[])
+{
+    static const uint8_t kZeros[32] = {0};
+    uint8_t x[32], z[32];
+    fe fx[ECX_BATCH_MAX], fz[ECX_BATCH_MAX];
+    size_t i, j, n;
+    int ret = 1;
+
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            x25519_scalar_mult_proj(x, z, private_key[i + j],
+                                    peer_public_value[i + j]);
+            fe_frombytes(fx[j], x);
+            fe_frombytes(fz[j], z);
+        }
+        fe_batch_div(out_shared_key + i, fx, fz, n);
+        for (j = 0; j < n; j++)
+            ret &= CRYPTO_memcmp(kZeros, out_shared_key[i + j], 32) != 0;
+    }
+
+    OPENSSL_cleanse(x, sizeof(x));
+    OPENSSL_cleanse(z, sizeof(z));
+    OPENSSL_cleanse(fx, sizeof(fx));
+    OPENSSL_cleanse(fz, sizeof(fz));
+    return ret;
+}
+
+void
+ossl_x25519_public_from_private_batch(size_t num,
+                                      uint8_t *const out_public_value[],
+                                      const uint8_t *const private_key[])
+{
+    uint8_t e[32];
+    ge_p3 A;
+    fe zplusy[ECX_BATCH_MAX], zminusy[ECX_BATCH_MAX];
+    size_t i, j, n;
+
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            memcpy(e, private_key[i + j], 32);
+            e[0] &= 248;
+            e[31] &= 127;
+            e[31] |= 64;
+
+            ge_scalarmult_base(&A, e);
+            fe_add(zplusy[j], A.Z, A.Y);
+            fe_sub(zminusy[j], A.Z, A.Y);
+        }
+        fe_batch_div(out_public_value + i, zplusy, zminusy, n);
+    }
+
+    OPENSSL_cleanse(e, sizeof(e));
+    OPENSSL_cleanse(&A, sizeof(A));
+    OPENSSL_cleanse(zplusy, sizeof(zplusy));
+    OPENSSL_cleanse(zminusy, sizeof(zminusy));
+}
@@ -382,15 +382,16 @@ ossl_curve448_point_decode_like_eddsa_and_mul_by_ratio(
     return c448_succeed_if(mask_to_bool(succ));
 }
 
-c448_error_t
-ossl_x448_int(uint8_t out[X_PUBLIC_BYTES],
-              const uint8_t base[X_PUBLIC_BYTES],
-              const uint8_t scalar[X_PRIVATE_BYTES])
+/*
+ * Montgomery ladder without the final inversion, leaving the projective
+ * X and Z coordinates of the result in |x2| and |z2|.
+ */
+static void x448_ladder(gf x2, gf z2, const uint8_t base[X_PUBLIC_BYTES],
+                        const uint8_t scalar[X_PRIVATE_BYTES])
 {
-    gf x1, x2, z2, x3, z3, t1, t2;
+    gf x1, x3, z3, t1, t2;
     int t;
     mask_t swap = 0;
-    mask_t nz;
 
     (void)gf_deserialize(x1, base, 1, 0);
     gf_copy(x2, ONE);
@@ -446,6 +447,23 @@ ossl_x448_int(uint8_t out[X_PUBLIC_BYTES],
     /* Finish */
     gf_cond_swap(x2, x3, swap);
     gf_cond_swap(z2, z3, swap);
+
+    OPENSSL_cleanse(x1, sizeof(x1));
+    OPENSSL_cleanse(x3, sizeof(x3));
+    OPENSSL_cleanse(z3, sizeof(z3));
+    OPENSSL_cleanse(t1, sizeof(t1));
+    OPENSSL_cleanse(t2, sizeof(t2));
+}
+
+c448_error_t
+ossl_x448_int(uint8_t out[X_PUBLIC_BYTES],
+              const uint8_t base[X_PUBLIC_BYTES],
+              const uint8_t scalar[X_PRIVATE_BYTES])
+{
+    gf x1, x2, z2;
+    mask_t nz;
+
+    x448_ladder(x2, z2, base, scalar);
     gf_invert(z2, z2, 0);
     gf_mul(x1, x2, z2);
     gf_serialize(out, x1, 1);
@@ -454,10 +472,6 @@ ossl_x448_int(uint8_t out[X_PUBLIC_BYTES],
     OPENSSL_cleanse(x1, sizeof(x1));
     OPENSSL_cleanse(x2, sizeof(x2));
     OPENSSL_cleanse(z2, sizeof(z2));
-    OPENSSL_cleanse(x3, sizeof(x3));
-    OPENSSL_cleanse(z3, sizeof(z3));
-    OPENSSL_cleanse(t1, sizeof(t1));
-    OPENSSL_cleanse(t2, sizeof(t2));
 
     return c448_succeed_if(mask_to_bool(nz));
 }
@@ -477,13 +491,12 @@ ossl_curve448_point_mul_by_ratio_and_encode_like_x448(uint8_t
     ossl_curve448_point_destroy(q);
 }
 
-void ossl_x448_derive_public_key(uint8_t out[X_PUBLIC_BYTES],
-                                 const uint8_t scalar[X_PRIVATE_BYTES])
+static void x448_derive_public_point(curve448_point_t p,
+                                     const uint8_t scalar[X_PRIVATE_BYTES])
 {
     /* Scalar conditioning */
     uint8_t scalar2[X_PRIVATE_BYTES];
     curve448_scalar_t the_scalar;
-    curve448_point_t p;
     unsigned int i;
 
     memcpy(scalar2, scalar, sizeof(scalar2));
@@ -500,6 +513,16 @@ void ossl_x448_derive_public_key(uint8_t out[X_PUBLIC_BYTES],
 
     ossl_curve448_precomputed_scalarmul(p, ossl_curve448_precomputed_base,
                                         the_scalar);
+    OPENSSL_cleanse(scalar2, sizeof(scalar2));
+    ossl_curve448_scalar_destroy(the_scalar);
+}
+
+void ossl_x448_derive_public_key(uint8_t out[X_PUBLIC_BYTES],
+                                 const uint8_t scalar[X_PRIVATE_BYTES])
+{
+    curve448_point_t p;
+
+    x448_derive_public_point(p, scalar);
     ossl_curve448_point_mul_by_ratio_and_encode_like_x448(out, p);
     ossl_curve448_point_destroy(p);
 }
@@ -736,3 +759,92 @@ void ossl_x448_public_from_private(uint8_t out_public_value[56],
 {
     ossl_x448_derive_public_key(out_public_value, private_key);
 }
+
+/*
+ * Set |out[i]| to the encoding of x[i] / z[i] for the |num| elements, with
+ * a single field inversion for all of them (Montgomery's trick).  As with
+ * gf_invert(), an element with z[i] == 0 comes out as zero, and it does not
+ * disturb the results for the others.
+ */
+static void gf_batch_div(uint8_t *const out[], gf x[], gf z[], size_t num)
+{
+    gf acc[ECX_BATCH_MAX], inv, t, u;
+    mask_t iszero;
+    size_t i;
+
+    for (i = 0; i < num; i++) {
+        iszero = gf_eq(z[i], ZERO);
+        gf_cond_sel(z[i], z[i], ONE, iszero);
+        gf_cond_sel(x[i], x[i], ZERO, iszero);
+        if (i == 0)
+            gf_copy(acc[0], z[0]);
+        else
+            gf_mul(acc[i], acc[i - 1], z[i]);
+    }
+
+    /* inv = 1 / (z[0] * ... * z[i]) on each iteration */
+    gf_invert(inv, acc[num - 1], 0);
+    for (i = num - 1; i > 0; i--) {
+        gf_mul(t, inv, acc[i - 1]);
+        gf_mul(u, inv, z[i]);
+        gf_copy(inv, u);
+        gf_mul(u, t, x[i]);
+        gf_serialize(out[i], u, 1);
+    }
+    gf_mul(u, inv, x[0]);
+    gf_serialize(out[0], u, 1);
+
+    OPENSSL_cleanse(acc, sizeof(acc));
+    OPENSSL_cleanse(inv, sizeof(inv));
+    OPENSSL_cleanse(t, sizeof(t));
+    OPENSSL_cleanse(u, sizeof(u));
+}
+
+int ossl_x448_batch(size_t num, uint8_t *const out_shared_key[],
+                    const uint8_t *const private_key[],
+                    const uint8_t *const peer_public_value[])
+{
+    static const uint8_t zeros[X_PUBLIC_BYTES] = {0};
+    gf x[ECX_BATCH_MAX], z[ECX_BATCH_MAX];
+    size_t i, j, n;
+    int ret = 1;
+
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++)
+            x448_ladder(x[j], z[j], peer_public_value[i + j],
+                        private_key[i + j]);
+        gf_batch_div(out_shared_key + i, x, z, n);
+        for (j = 0; j < n; j++)
+            ret &= CRYPTO_memcmp(zeros, out_shared_key[i + j],
+                                 X_PUBLIC_BYTES) != 0;
+    }
+
+    OPENSSL_cleanse(x, sizeof(x));
+    OPENSSL_cleanse(z, sizeof(z));
+    return ret;
+}
+
+void ossl_x448_public_from_private_batch(size_t num,
+                                         uint8_t *const out_public_value[],
+                                         const uint8_t *const private_key[])
+{
+    curve448_point_t p;
+    gf y2[ECX_BATCH_MAX], x2[ECX_BATCH_MAX];
+    size_t i, j, n;
+
+    /* As ossl_curve448_point_mul_by_ratio_and_encode_like_x448(): (y/x)^2 */
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            x448_derive_public_point(p, private_key[i + j]);
+            gf_sqr(y2[j], p->y);
+            gf_sqr(x2[j], p->x);
+        }
+        gf_batch_div(out_public_value + i, y2, x2, n);
+    }
+
+    ossl_curve448_point_destroy(p);
+    OPENSSL_cleanse(y2, sizeof(y2));
+    OPENSSL_cleanse(x2, sizeof(x2));
+}
@@ -353,10 +353,33 @@ int ossl_ecdsa_verify(int type, const unsigned char *dgst, int dgst_len,
     return ret;
 }
 
+/* Convert |dgst| to an integer, truncated to the bit length of |order| */
+static int ecdsa_digest_to_bn(BIGNUM *m, const BIGNUM *order,
+                              const unsigned char *dgst, int dgst_len)
+{
+    int i = BN_num_bits(order);
+
+    /*
+     * Need to truncate digest if it is too long: first truncate whole bytes.
+     */
+    if (8 * dgst_len > i)
+        dgst_len = (i + 7) / 8;
+    if (!BN_bin2bn(dgst, dgst_len, m)) {
+        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+        return 0;
+    }
+    /* If still too long truncate remaining bits with a shift */
+    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7))) {
+        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+        return 0;
+    }
+    return 1;
+}
+
 int ossl_ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
                                  const ECDSA_SIG *sig, EC_KEY *eckey)
 {
-    int ret = -1, i;
+    int ret = -1;
     BN_CTX *ctx;
     const BIGNUM *order;
     BIGNUM *u1, *u2, *m, *X;
@@ -410,21 +433,8 @@ int ossl_ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         goto err;
     }
     /* digest -> m */
-    i = BN_num_bits(order);
-    /*
-     * Need to truncate digest if it is too long: first truncate whole bytes.
-     */
-    if (8 * dgst_len > i)
-        dgst_len = (i + 7) / 8;
-    if (!BN_bin2bn(dgst, dgst_len, m)) {
-        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+    if (!ecdsa_digest_to_bn(m, order, dgst, dgst_len))
         goto err;
-    }
-    /* If still too long truncate remaining bits with a shift */
-    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7))) {
-        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
-        goto err;
-    }
     /* u1 = m * tmp mod order */
     if (!BN_mod_mul(u1, m, u2, order, ctx)) {
         ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
@@ -462,3 +472,232 @@ int ossl_ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
     EC_POINT_free(point);
     return ret;
 }
+
+/*
+ * Verify the signatures in |sig| together.  All of the keys use the built-in
+ * implementation and the same named curve as eckey[0].  The inverses of the
+ * s values are computed with a single inversion modulo the order, and the
+ * points u1 * G + u2 * pub_key are converted to affine coordinates with a
+ * single field inversion.
+ */
+static void ecdsa_simple_verify_sig_batch(size_t num,
+                                          const unsigned char *const dgst[],
+                                          const int dgst_len[],
+                                          ECDSA_SIG *const sig[],
+                                          EC_KEY *const eckey[],
+                                          int results[])
+{
+    const EC_GROUP *group = eckey[0]->group;
+    const BIGNUM *order = EC_GROUP_get0_order(group);
+    BN_CTX *ctx;
+    BIGNUM *acc[ECDSA_BATCH_MAX], *inv, *u1, *u2, *m, *X;
+    EC_POINT *points[ECDSA_BATCH_MAX];
+    size_t idx[ECDSA_BATCH_MAX];
+    size_t i, j, n = 0;
+
+    for (i = 0; i < num; i++)
+        results[i] = -1;
+    memset(points, 0, sizeof(points));
+
+    ctx = BN_CTX_new_ex(eckey[0]->libctx);
+    if (ctx == NULL) {
+        ERR_raise(ERR_LIB_EC, ERR_R_MALLOC_FAILURE);
+        return;
+    }
+    BN_CTX_start(ctx);
+    for (i = 0; i < num; i++)
+        acc[i] = BN_CTX_get(ctx);
+    inv = BN_CTX_get(ctx);
+    u1 = BN_CTX_get(ctx);
+    u2 = BN_CTX_get(ctx);
+    m = BN_CTX_get(ctx);
+    X = BN_CTX_get(ctx);
+    if (X == NULL) {
+        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+        goto err;
+    }
+
+    /* acc[j] is the product of the s values of the first j + 1 signatures */
+    for (i = 0; i < num; i++) {
+        if (BN_is_zero(sig[i]->r) || BN_is_negative(sig[i]->r)
+                || BN_ucmp(sig[i]->r, order) >= 0 || BN_is_zero(sig[i]->s)
+                || BN_is_negative(sig[i]->s)
+                || BN_ucmp(sig[i]->s, order) >= 0) {
+            results[i] = 0;     /* signature is invalid */
+            continue;
+        }
+        if (n == 0 ? BN_copy(acc[n], sig[i]->s) == NULL
+                   : !BN_mod_mul(acc[n], acc[n - 1], sig[i]->s, order, ctx)) {
+            ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+            goto err;
+        }
+        idx[n++] = i;
+    }
+    if (n == 0)
+        goto err;
+    if (!ossl_ec_group_do_inverse_ord(group, inv, acc[n - 1], ctx)) {
+        ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+        goto err;
+    }
+
+    /* Walk back, acc[j] becomes the inverse of s of the j-th signature */
+    for (j = n; j-- > 0;) {
+        i = idx[j];
+        if (j > 0) {
+            if (!BN_mod_mul(acc[j], inv, acc[j - 1], order, ctx)
+                    || !BN_mod_mul(inv, inv, sig[i]->s, order, ctx)) {
+                ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+                goto err;
+            }
+        } else if (BN_copy(acc[j], inv) == NULL) {
+            ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+            goto err;
+        }
+    }
+
+    for (j = 0; j < n; j++) {
+        i = idx[j];
+        if (!ecdsa_digest_to_bn(m, order, dgst[i], dgst_len[i]))
+            goto err;
+        /* u1 = m * w mod order, u2 = r * w mod order */
+        if (!BN_mod_mul(u1, m, acc[j], order, ctx)
+                || !BN_mod_mul(u2, sig[i]->r, acc[j], order, ctx)) {
+            ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
+            goto err;
+        }
+        if ((points[j] = EC_POINT_new(group)) == NULL) {
+            ERR_raise(ERR_LIB_EC, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        if (!EC_POINT_mul(group, points[j], u1, eckey[i]->pub_key, u2, ctx)) {
+            ERR_raise(ERR_LIB_EC, ERR_R_EC_LIB);
+            goto err;
+        }
+    }
+
+    /* Points at infinity are left as they are */
+    if (!EC_POINTs_make_affine(group, n, points, ctx)) {
+        ERR_raise(ERR_LIB_EC, ERR_R_EC_LIB);
+        goto err;
+    }
+
+    for (j = 0; j < n; j++) {
+        i = idx[j];
+        if (EC_POINT_is_at_infinity(group, points[j])) {
+            ERR_raise(ERR_LIB_EC, EC_R_POINT_AT_INFINITY);
+            continue;
+        }
+        if (group->meth->field_decode != NULL) {
+            if (!group->meth->field_decode(group, X, points[j]->X, ctx))
+                continue;
+        } else if (BN_copy(X, points[j]->X) == NULL) {
+            continue;
+        }
+        if (!BN_nnmod(u1, X, order, ctx))
+            continue;
+        /*  if the signature is correct u1 is equal to sig->r */
+        results[i] = (BN_ucmp(u1, sig[i]->r) == 0);
+    }
+
+ err:
+    for (j = 0; j < n; j++)
+        EC_POINT_free(points[j]);
+    BN_CTX_end(ctx);
+    BN_CTX_free(ctx);
+}
+
+static int ecdsa_can_verify_batch(const EC_KEY *eckey)
+{
+    return eckey != NULL && eckey->group != NULL && eckey->pub_key != NULL
+           && eckey->meth->verify == ossl_ecdsa_verify
+           && eckey->meth->verify_sig == ossl_ecdsa_verify_sig
+           && eckey->group->meth->ecdsa_verify_sig
+              == ossl_ecdsa_simple_verify_sig
+           && EC_GROUP_get_curve_name(eckey->group) != NID_undef
+           && EC_KEY_can_sign(eckey);
+}
+
+/* Decode the DER encoded |sigbuf| as strictly as ossl_ecdsa_verify() */
+static ECDSA_SIG *ecdsa_sig_decode(const unsigned char *sigbuf, int sig_len)
+{
+    ECDSA_SIG *s;
+    const unsigned char *p = sigbuf;
+    unsigned char *der = NULL;
+    int derlen = -1;
+
+    if ((s = d2i_ECDSA_SIG(NULL, &p, sig_len)) == NULL)
+        return NULL;
+    derlen = i2d_ECDSA_SIG(s, &der);
+    if (derlen != sig_len || memcmp(sigbuf, der, derlen) != 0) {
+        ECDSA_SIG_free(s);
+        s = NULL;
+    }
+    OPENSSL_free(der);
+    return s;
+}
+
+/*
+ * Verify |num| DER encoded signatures, like ECDSA_verify() does for each of
+ * them, and set results[i] to what ECDSA_verify() would return for the i-th
+ * one.  Signatures of keys on the same named curve are verified together,
+ * in groups of up to ECDSA_BATCH_MAX.  Returns 1 if all signatures were
+ * verified successfully and 0 otherwise.
+ */
+int ossl_ecdsa_verify_batch(size_t num, const unsigned char *const dgst[],
+                            const size_t dgst_len[],
+                            const unsigned char *const sigbuf[],
+                            const size_t sig_len[], EC_KEY *const eckey[],
+                            int results[])
+{
+    const unsigned char *bdgst[ECDSA_BATCH_MAX];
+    int bdgst_len[ECDSA_BATCH_MAX], bresults[ECDSA_BATCH_MAX];
+    ECDSA_SIG *bsig[ECDSA_BATCH_MAX];
+    EC_KEY *bkey[ECDSA_BATCH_MAX];
+    size_t bidx[ECDSA_BATCH_MAX];
+    size_t i, j, n = 0;
+    int ret = 1;
+
+    for (i = 0; i <= num; i++) {
+        if (i < num) {
+            results[i] = -1;
+            if (eckey[i] == NULL || dgst_len[i] > INT_MAX
+                    || sig_len[i] > INT_MAX)
+                continue;
+            if (!ecdsa_can_verify_batch(eckey[i])) {
+                results[i] = ECDSA_verify(0, dgst[i], (int)dgst_len[i],
+                                          sigbuf[i], (int)sig_len[i],
+                                          eckey[i]);
+                continue;
+            }
+        }
+
+        /* Verify what was collected once the batch is full or ends */
+        if (n > 0
+                && (i == num || n == ECDSA_BATCH_MAX
+                    || EC_GROUP_get_curve_name(eckey[i]->group)
+                       != EC_GROUP_get_curve_name(bkey[0]->group)
+                    || eckey[i]->group->meth != bkey[0]->group->meth)) {
+            ecdsa_simple_verify_sig_batch(n, bdgst, bdgst_len, bsig, bkey,
+                                          bresults);
+            for (j = 0; j < n; j++) {
+                results[bidx[j]] = bresults[j];
+                ECDSA_SIG_free(bsig[j]);
+            }
+            n = 0;
+        }
+        if (i == num)
+            break;
+
+        if ((bsig[n] = ecdsa_sig_decode(sigbuf[i], (int)sig_len[i])) == NULL)
+            continue;
+        bdgst[n] = dgst[i];
+        bdgst_len[n] = (int)dgst_len[i];
+        bkey[n] = eckey[i];
+        bidx[n++] = i;
+    }
+
+    for (i = 0; i < num; i++)
+        if (results[i] != 1)
+            ret = 0;
+    return ret;
+}
@@ -17,6 +17,7 @@
 #include <openssl/trace.h>
 #include "crypto/evp.h"
 #include "crypto/decoder.h"
+#include "internal/namemap.h"
 #include "encoder_local.h"
 
 int OSSL_DECODER_CTX_set_passphrase(OSSL_DECODER_CTX *ctx,
@@ -216,6 +217,8 @@ static void collect_keymgmt(EVP_KEYMGMT *keymgmt, void *arg)
 
 struct collect_decoder_data_st {
     STACK_OF(OPENSSL_CSTRING) *names;
+    /* The namemap numbers for |names|, so we only look them up once */
+    int *ids;
     OSSL_DECODER_CTX *ctx;
 
     int total;
@@ -232,7 +235,7 @@ static void collect_decoder(OSSL_DECODER *decoder, void *arg)
     if (data->error_occurred)
         return;
 
-    if (data->names == NULL) {
+    if (data->names == NULL || data->ids == NULL) {
         data->error_occurred = 1;
         return;
     }
@@ -258,9 +261,7 @@ static void collect_decoder(OSSL_DECODER *decoder, void *arg)
 
     end_i = sk_OPENSSL_CSTRING_num(data->names);
     for (i = 0; i < end_i; i++) {
-        const char *name = sk_OPENSSL_CSTRING_value(data->names, i);
-
-        if (OSSL_DECODER_is_a(decoder, name)) {
+        if (decoder->base.id == data->ids[i]) {
             void *decoderctx = NULL;
             OSSL_DECODER_INSTANCE *di = NULL;
 
@@ -386,11 +387,29 @@ int ossl_decoder_ctx_setup_for_pkey(OSSL_DECODER_CTX *ctx,
      */
     {
         struct collect_decoder_data_st collect_decoder_data = { NULL, };
+        OSSL_NAMEMAP *namemap = ossl_namemap_stored(libctx);
+
+        end = sk_OPENSSL_CSTRING_num(names);
+        if (namemap == NULL) {
+            ERR_raise(ERR_LIB_OSSL_DECODER, ERR_R_INTERNAL_ERROR);
+            goto err;
+        }
+        collect_decoder_data.ids =
+            OPENSSL_malloc(sizeof(int) * (end > 0 ? end : 1));
+        if (collect_decoder_data.ids == NULL) {
+            ERR_raise(ERR_LIB_OSSL_DECODER, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        for (i = 0; i < end; i++)
+            collect_decoder_data.ids[i] =
+                ossl_namemap_name2num(namemap,
+                                      sk_OPENSSL_CSTRING_value(names, i));
 
         collect_decoder_data.names = names;
         collect_decoder_data.ctx = ctx;
         OSSL_DECODER_do_all_provided(libctx,
                                      collect_decoder, &collect_decoder_data);
+        OPENSSL_free(collect_decoder_data.ids);
         sk_OPENSSL_CSTRING_free(names);
         names = NULL;
 
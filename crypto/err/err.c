@@ -659,7 +659,7 @@ ERR_STATE *ossl_err_get_state_int(void)
         if (!CRYPTO_THREAD_set_local(&err_thread_local, (ERR_STATE*)-1))
             return NULL;
 
-        if ((state = OPENSSL_zalloc(sizeof(*state))) == NULL) {
+        if ((state = OPENSSL_zalloc(sizeof(ERR_STATE_BUFFERS))) == NULL) {
             CRYPTO_THREAD_set_local(&err_thread_local, NULL);
             return NULL;
         }
@@ -791,7 +791,7 @@ void ERR_add_error_vdata(int num, va_list args)
 {
     int i, len, size;
     int flags = ERR_TXT_MALLOCED | ERR_TXT_STRING;
-    char *str, *arg;
+    char *str, *arg, *inline_str;
     ERR_STATE *es;
 
     /* Get the current error data; if an allocated string get it. */
@@ -799,14 +799,18 @@ void ERR_add_error_vdata(int num, va_list args)
     if (es == NULL)
         return;
     i = es->top;
+    inline_str = err_inline_data(es, i);
 
     /*
-     * If err_data is allocated already, re-use the space.
-     * Otherwise, allocate a small new buffer.
+     * If err_data is allocated already, re-use the space, keeping the string
+     * that it may hold.  Otherwise, use the slot's own buffer.
      */
-    if ((es->err_data_flags[i] & flags) == flags) {
+    if ((es->err_data_flags[i] & ERR_TXT_MALLOCED) != 0
+        && es->err_data[i] != NULL) {
         str = es->err_data[i];
-        size = es->err_data_size[i];
+        size = (int)es->err_data_size[i];
+        if ((es->err_data_flags[i] & ERR_TXT_STRING) == 0)
+            str[0] = '\0';
 
         /*
          * To protect the string we just grabbed from tampering by other
@@ -817,9 +821,9 @@ void ERR_add_error_vdata(int num, va_list args)
          */
         es->err_data[i] = NULL;
         es->err_data_flags[i] = 0;
-    } else if ((str = OPENSSL_malloc(size = 81)) == NULL) {
-        return;
     } else {
+        str = inline_str;
+        size = ERR_INLINE_DATA_SIZE;
         str[0] = '\0';
     }
     len = strlen(str);
@@ -833,16 +837,22 @@ void ERR_add_error_vdata(int num, va_list args)
             char *p;
 
             size = len + 20;
-            p = OPENSSL_realloc(str, size);
+            if (str == inline_str) {
+                if ((p = OPENSSL_malloc(size)) != NULL)
+                    OPENSSL_strlcpy(p, str, (size_t)size);
+            } else {
+                p = OPENSSL_realloc(str, size);
+            }
             if (p == NULL) {
-                OPENSSL_free(str);
+                if (str != inline_str)
+                    OPENSSL_free(str);
                 return;
             }
             str = p;
         }
         OPENSSL_strlcat(str, arg, (size_t)size);
     }
-    if (!err_set_error_data_int(str, size, flags, 0))
+    if (!err_set_error_data_int(str, size, flags, 0) && str != inline_str)
         OPENSSL_free(str);
 }
 
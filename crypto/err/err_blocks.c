@@ -60,14 +60,30 @@ void ERR_vset_error(int lib, int reason, const char *fmt, va_list args)
     i = es->top;
 
     if (fmt != NULL) {
-        int printed_len = 0;
-        char *rbuf = NULL;
+        char tmp[ERR_MAX_DATA_SIZE];
+        int printed_len = BIO_vsnprintf(tmp, sizeof(tmp), fmt, args);
+        size_t len;
 
-        buf = es->err_data[i];
-        buf_size = es->err_data_size[i];
+        if (printed_len < 0)
+            printed_len = 0;
+        tmp[printed_len] = '\0';
+        len = printed_len + 1;
 
         /*
-         * To protect the string we just grabbed from tampering by other
+         * Use the buffer that the slot has, which is its own buffer unless
+         * larger data was set before.  Only allocate if it's too small.
+         */
+        if ((es->err_data_flags[i] & ERR_TXT_MALLOCED) != 0
+            && es->err_data[i] != NULL) {
+            buf = es->err_data[i];
+            buf_size = es->err_data_size[i];
+        } else {
+            buf = err_inline_data(es, i);
+            buf_size = ERR_INLINE_DATA_SIZE;
+        }
+
+        /*
+         * To protect the buffer we just grabbed from tampering by other
          * functions we may call, or to protect them from freeing a pointer
          * that may no longer be valid at that point, we clear away the
          * data pointer and the flags.  We will set them again at the end
@@ -76,38 +92,24 @@ void ERR_vset_error(int lib, int reason, const char *fmt, va_list args)
         es->err_data[i] = NULL;
         es->err_data_flags[i] = 0;
 
-        /*
-         * Try to maximize the space available.  If that fails, we use what
-         * we have.
-         */
-        if (buf_size < ERR_MAX_DATA_SIZE
-            && (rbuf = OPENSSL_realloc(buf, ERR_MAX_DATA_SIZE)) != NULL) {
-            buf = rbuf;
-            buf_size = ERR_MAX_DATA_SIZE;
+        if (buf_size < len) {
+            char *rbuf;
+
+            /* If that fails, we truncate to what we have */
+            if (buf == err_inline_data(es, i))
+                rbuf = OPENSSL_malloc(len);
+            else
+                rbuf = OPENSSL_realloc(buf, len);
+            if (rbuf != NULL) {
+                buf = rbuf;
+                buf_size = len;
+            } else {
+                len = buf_size;
+            }
         }
-
-        if (buf != NULL) {
-            printed_len = BIO_vsnprintf(buf, buf_size, fmt, args);
-        }
-        if (printed_len < 0)
-            printed_len = 0;
-        if (buf != NULL)
-            buf[printed_len] = '\0';
-
-        /*
-         * Try to reduce the size, but only if we maximized above.  If that
-         * fails, we keep what we have.
-         * (According to documentation, realloc leaves the old buffer untouched
-         * if it fails)
-         */
-        if ((rbuf = OPENSSL_realloc(buf, printed_len + 1)) != NULL) {
-            buf = rbuf;
-            buf_size = printed_len + 1;
-            buf[printed_len] = '\0';
-        }
-
-        if (buf != NULL)
-            flags = ERR_TXT_MALLOCED | ERR_TXT_STRING;
+        memcpy(buf, tmp, len);
+        buf[len - 1] = '\0';
+        flags = ERR_TXT_MALLOCED | ERR_TXT_STRING;
     }
 
     err_clear_data(es, es->top, 0);
@@ -7,9 +7,47 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <string.h>
 #include <openssl/err.h>
 #include <openssl/e_os2.h>
 
+/*
+ * Sizes of the buffers that each error slot has for the file and function
+ * names and for the error data.  Most of them fit, and then raising and
+ * clearing an error doesn't allocate any memory.  Longer strings are
+ * allocated as usual.  The data buffer of a slot is treated like an
+ * allocated one (ERR_TXT_MALLOCED) that is never freed or reallocated.
+ */
+# define ERR_INLINE_FILE_SIZE    96
+# define ERR_INLINE_FUNC_SIZE    64
+# define ERR_INLINE_DATA_SIZE    128
+
+/*
+ * The error state that is actually allocated for each thread.  It starts
+ * with the public ERR_STATE, so a pointer to either is a pointer to both.
+ */
+typedef struct err_state_buffers_st {
+    ERR_STATE es;
+    char file[ERR_NUM_ERRORS][ERR_INLINE_FILE_SIZE];
+    char func[ERR_NUM_ERRORS][ERR_INLINE_FUNC_SIZE];
+    char data[ERR_NUM_ERRORS][ERR_INLINE_DATA_SIZE];
+} ERR_STATE_BUFFERS;
+
+static ossl_inline char *err_inline_file(ERR_STATE *es, size_t i)
+{
+    return ((ERR_STATE_BUFFERS *)es)->file[i];
+}
+
+static ossl_inline char *err_inline_func(ERR_STATE *es, size_t i)
+{
+    return ((ERR_STATE_BUFFERS *)es)->func[i];
+}
+
+static ossl_inline char *err_inline_data(ERR_STATE *es, size_t i)
+{
+    return ((ERR_STATE_BUFFERS *)es)->data[i];
+}
+
 static ossl_inline void err_get_slot(ERR_STATE *es)
 {
     es->top = (es->top + 1) % ERR_NUM_ERRORS;
@@ -17,11 +55,17 @@ static ossl_inline void err_get_slot(ERR_STATE *es)
         es->bottom = (es->bottom + 1) % ERR_NUM_ERRORS;
 }
 
+static ossl_inline void err_free_data(ERR_STATE *es, size_t i)
+{
+    if (es->err_data[i] != err_inline_data(es, i))
+        OPENSSL_free(es->err_data[i]);
+}
+
 static ossl_inline void err_clear_data(ERR_STATE *es, size_t i, int deall)
 {
     if (es->err_data_flags[i] & ERR_TXT_MALLOCED) {
         if (deall) {
-            OPENSSL_free(es->err_data[i]);
+            err_free_data(es, i);
             es->err_data[i] = NULL;
             es->err_data_size[i] = 0;
             es->err_data_flags[i] = 0;
@@ -45,32 +89,51 @@ static ossl_inline void err_set_error(ERR_STATE *es, size_t i,
         : ERR_PACK(lib, 0, reason);
 }
 
+static ossl_inline void err_free_name(char *name, char *inline_buf)
+{
+    if (name != inline_buf)
+        OPENSSL_free(name);
+}
+
+static ossl_inline char *err_copy_name(char *old, char *inline_buf,
+                                       size_t inline_size, const char *name)
+{
+    char *copy = NULL;
+    size_t len;
+
+    if (name != NULL && name[0] != '\0') {
+        if ((len = strlen(name) + 1) <= inline_size) {
+            memmove(inline_buf, name, len);
+            copy = inline_buf;
+        } else {
+            copy = OPENSSL_strdup(name);
+        }
+    }
+    if (old != copy)
+        err_free_name(old, inline_buf);
+    return copy;
+}
+
 static ossl_inline void err_set_debug(ERR_STATE *es, size_t i,
                                       const char *file, int line,
                                       const char *fn)
 {
     /*
-     * We dup the file and fn strings because they may be provider owned. If the
-     * provider gets unloaded, they may not be valid anymore.
+     * We copy the file and fn strings because they may be provider owned. If
+     * the provider gets unloaded, they may not be valid anymore.
      */
-    OPENSSL_free(es->err_file[i]);
-    if (file == NULL || file[0] == '\0')
-        es->err_file[i] = NULL;
-    else
-        es->err_file[i] = OPENSSL_strdup(file);
+    es->err_file[i] = err_copy_name(es->err_file[i], err_inline_file(es, i),
+                                    ERR_INLINE_FILE_SIZE, file);
     es->err_line[i] = line;
-    OPENSSL_free(es->err_func[i]);
-    if (fn == NULL || fn[0] == '\0')
-        es->err_func[i] = NULL;
-    else
-        es->err_func[i] = OPENSSL_strdup(fn);
+    es->err_func[i] = err_copy_name(es->err_func[i], err_inline_func(es, i),
+                                    ERR_INLINE_FUNC_SIZE, fn);
 }
 
 static ossl_inline void err_set_data(ERR_STATE *es, size_t i,
                                      void *data, size_t datasz, int flags)
 {
     if ((es->err_data_flags[i] & ERR_TXT_MALLOCED) != 0)
-        OPENSSL_free(es->err_data[i]);
+        err_free_data(es, i);
     es->err_data[i] = data;
     es->err_data_size[i] = datasz;
     es->err_data_flags[i] = flags;
@@ -83,9 +146,9 @@ static ossl_inline void err_clear(ERR_STATE *es, size_t i, int deall)
     es->err_flags[i] = 0;
     es->err_buffer[i] = 0;
     es->err_line[i] = -1;
-    OPENSSL_free(es->err_file[i]);
+    err_free_name(es->err_file[i], err_inline_file(es, i));
     es->err_file[i] = NULL;
-    OPENSSL_free(es->err_func[i]);
+    err_free_name(es->err_func[i], err_inline_func(es, i));
     es->err_func[i] = NULL;
 }
 
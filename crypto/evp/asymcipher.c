@@ -298,6 +298,48 @@ int EVP_PKEY_decrypt(EVP_PKEY_CTX *ctx,
         return ctx->pmeth->decrypt(ctx, out, outlen, in, inlen);
 }
 
+int EVP_PKEY_decrypt_batch(EVP_PKEY_CTX *ctx, size_t num,
+                           unsigned char *const out[], size_t outlen[],
+                           const unsigned char *const in[],
+                           const size_t inlen[])
+{
+    size_t i;
+    int ret;
+
+    if (ctx == NULL) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_SUPPORTED_FOR_THIS_KEYTYPE);
+        return -2;
+    }
+
+    if (ctx->operation != EVP_PKEY_OP_DECRYPT) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_INITIALIZED);
+        return -1;
+    }
+
+    if (num == 0)
+        return 1;
+    if (out == NULL || outlen == NULL || in == NULL || inlen == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    if (ctx->op.ciph.algctx != NULL
+            && ctx->op.ciph.cipher->decrypt_batch != NULL)
+        return ctx->op.ciph.cipher->decrypt_batch(ctx->op.ciph.algctx, num,
+                                                  out, outlen, in, inlen);
+
+    for (i = 0; i < num; i++) {
+        if (out[i] == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+            return 0;
+        }
+        ret = EVP_PKEY_decrypt(ctx, out[i], &outlen[i], in[i], inlen[i]);
+        if (ret <= 0)
+            return ret;
+    }
+    return 1;
+}
+
 
 static EVP_ASYM_CIPHER *evp_asym_cipher_new(OSSL_PROVIDER *prov)
 {
@@ -372,6 +414,11 @@ static void *evp_asym_cipher_from_algorithm(int name_id,
             cipher->decrypt = OSSL_FUNC_asym_cipher_decrypt(fns);
             decfncnt++;
             break;
+        case OSSL_FUNC_ASYM_CIPHER_DECRYPT_BATCH:
+            if (cipher->decrypt_batch != NULL)
+                break;
+            cipher->decrypt_batch = OSSL_FUNC_asym_cipher_decrypt_batch(fns);
+            break;
         case OSSL_FUNC_ASYM_CIPHER_FREECTX:
             if (cipher->freectx != NULL)
                 break;
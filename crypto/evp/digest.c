@@ -1076,6 +1076,16 @@ EVP_MD *EVP_MD_fetch(OSSL_LIB_CTX *ctx, const char *algorithm,
     return md;
 }
 
+#ifndef FIPS_MODULE
+EVP_MD *EVP_MD_fetch_with_query(OSSL_LIB_CTX *ctx, const char *algorithm,
+                                const OSSL_PROPERTY_QUERY *query)
+{
+    return evp_generic_fetch_with_query(ctx, OSSL_OP_DIGEST, algorithm, query,
+                                        evp_md_from_algorithm, evp_md_up_ref,
+                                        evp_md_free);
+}
+#endif
+
 int EVP_MD_up_ref(EVP_MD *md)
 {
     int ref = 0;
@@ -1656,6 +1656,17 @@ EVP_CIPHER *EVP_CIPHER_fetch(OSSL_LIB_CTX *ctx, const char *algorithm,
     return cipher;
 }
 
+#ifndef FIPS_MODULE
+EVP_CIPHER *EVP_CIPHER_fetch_with_query(OSSL_LIB_CTX *ctx,
+                                        const char *algorithm,
+                                        const OSSL_PROPERTY_QUERY *query)
+{
+    return evp_generic_fetch_with_query(ctx, OSSL_OP_CIPHER, algorithm, query,
+                                        evp_cipher_from_algorithm,
+                                        evp_cipher_up_ref, evp_cipher_free);
+}
+#endif
+
 int EVP_CIPHER_up_ref(EVP_CIPHER *cipher)
 {
     int ref = 0;
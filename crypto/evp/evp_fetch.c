@@ -17,7 +17,7 @@
 #include "internal/core.h"
 #include "internal/provider.h"
 #include "internal/namemap.h"
-#include "internal/property.h"
+#include "crypto/cryptlib.h"
 #include "crypto/evp.h"    /* evp_local.h needs it */
 #include "evp_local.h"
 
@@ -48,6 +48,7 @@ struct evp_method_data_st {
     int name_id;                 /* For get_evp_method_from_store() */
     const char *names;           /* For get_evp_method_from_store() */
     const char *propquery;       /* For get_evp_method_from_store() */
+    const OSSL_PROPERTY_LIST *parsed_propquery; /* For get_evp_method_from_store() */
 
     OSSL_METHOD_STORE *tmp_store; /* For get_tmp_evp_method_store() */
 
@@ -147,9 +148,15 @@ static void *get_evp_method_from_store(void *store, const OSSL_PROVIDER **prov,
         && (store = get_evp_method_store(methdata->libctx)) == NULL)
         return NULL;
 
-    if (!ossl_method_store_fetch(store, meth_id, methdata->propquery, prov,
-                                 &method))
+    if (methdata->parsed_propquery != NULL) {
+        if (!ossl_method_store_fetch_parsed(store, meth_id,
+                                            methdata->parsed_propquery, prov,
+                                            &method))
+            return NULL;
+    } else if (!ossl_method_store_fetch(store, meth_id, methdata->propquery,
+                                        prov, &method)) {
         return NULL;
+    }
     return method;
 }
 
@@ -356,26 +363,274 @@ inner_evp_generic_fetch(struct evp_method_data_st *methdata,
     return method;
 }
 
-void *evp_generic_fetch(OSSL_LIB_CTX *libctx, int operation_id,
-                        const char *name, const char *properties,
-                        void *(*new_method)(int name_id,
-                                            const OSSL_ALGORITHM *algodef,
-                                            OSSL_PROVIDER *prov),
-                        int (*up_ref_method)(void *),
-                        void (*free_method)(void *))
+/*-
+ * Per-thread fetch cache
+ * ======================
+ *
+ * When enabled for a library context with EVP_thread_fetch_cache_enable(),
+ * evp_generic_fetch() first looks in a small direct mapped cache that is
+ * private to the calling thread.  A hit hands out another reference to a
+ * method fetched earlier by the same thread, without going through the
+ * namemap, the method store and their locks.
+ *
+ * Entries are tagged with the fetch generation of their library context at
+ * the time they were fetched.  The generation changes whenever the result of
+ * a fetch from that context could change (providers being activated or
+ * unloaded, default properties being set, ...), which makes all older entries
+ * for the context stale, while entries for other contexts stay valid.
+ * Generations are unique in the process, so the entries left behind by a
+ * freed library context never match a new one at the same address.
+ *
+ * The cached references are released by thread stop handlers, so the same
+ * rules as for other thread local data apply: threads must call
+ * OPENSSL_thread_stop_ex() before a library context they used is freed.
+ */
+#ifndef FIPS_MODULE
+# define FETCH_CACHE_SIZE        64      /* Must be a power of two */
+# define FETCH_CACHE_MAX_LIBCTX  8
+
+typedef struct {
+    OSSL_LIB_CTX *libctx;
+    int operation_id;
+    size_t generation;
+    char *name;
+    char *propq;
+    void *method;
+    void (*free_method)(void *);
+} FETCH_CACHE_ENTRY;
+
+typedef struct {
+    FETCH_CACHE_ENTRY entries[FETCH_CACHE_SIZE];
+    /* The library contexts a thread stop handler is registered for */
+    OSSL_LIB_CTX *libctxs[FETCH_CACHE_MAX_LIBCTX];
+} FETCH_CACHE;
+
+static CRYPTO_ONCE fetch_cache_once = CRYPTO_ONCE_STATIC_INIT;
+static CRYPTO_THREAD_LOCAL fetch_cache_key;
+static int fetch_cache_key_inited = 0;
+
+DEFINE_RUN_ONCE_STATIC(do_fetch_cache_init)
+{
+    fetch_cache_key_inited = CRYPTO_THREAD_init_local(&fetch_cache_key, NULL);
+    return fetch_cache_key_inited;
+}
+
+void evp_fetch_cache_cleanup_int(void)
+{
+    if (fetch_cache_key_inited) {
+        CRYPTO_THREAD_cleanup_local(&fetch_cache_key);
+        fetch_cache_key_inited = 0;
+    }
+}
+
+static void fetch_cache_entry_clear(FETCH_CACHE_ENTRY *entry)
+{
+    if (entry->method != NULL)
+        entry->free_method(entry->method);
+    OPENSSL_free(entry->name);
+    OPENSSL_free(entry->propq);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void fetch_cache_thread_stop(void *arg)
+{
+    OSSL_LIB_CTX *libctx = arg;
+    FETCH_CACHE *cache;
+    size_t i;
+    int in_use = 0;
+
+    if (!fetch_cache_key_inited
+            || (cache = CRYPTO_THREAD_get_local(&fetch_cache_key)) == NULL)
+        return;
+
+    for (i = 0; i < FETCH_CACHE_SIZE; i++)
+        if (cache->entries[i].libctx == libctx)
+            fetch_cache_entry_clear(&cache->entries[i]);
+    for (i = 0; i < FETCH_CACHE_MAX_LIBCTX; i++) {
+        if (cache->libctxs[i] == libctx)
+            cache->libctxs[i] = NULL;
+        else if (cache->libctxs[i] != NULL)
+            in_use = 1;
+    }
+    if (!in_use) {
+        CRYPTO_THREAD_set_local(&fetch_cache_key, NULL);
+        OPENSSL_free(cache);
+    }
+}
+
+/*
+ * Make sure the thread stop handler will clean up after |libctx| in this
+ * thread.  Returns 0 if this can't be arranged, in which case nothing must
+ * be cached for |libctx|.
+ */
+static int fetch_cache_register_libctx(FETCH_CACHE *cache,
+                                       OSSL_LIB_CTX *libctx)
+{
+    size_t i, free_slot = FETCH_CACHE_MAX_LIBCTX;
+
+    for (i = 0; i < FETCH_CACHE_MAX_LIBCTX; i++) {
+        if (cache->libctxs[i] == libctx)
+            return 1;
+        if (cache->libctxs[i] == NULL && free_slot == FETCH_CACHE_MAX_LIBCTX)
+            free_slot = i;
+    }
+    if (free_slot == FETCH_CACHE_MAX_LIBCTX
+            || !ossl_init_thread_start(NULL, libctx, fetch_cache_thread_stop))
+        return 0;
+    cache->libctxs[free_slot] = libctx;
+    return 1;
+}
+
+/*
+ * Find the cache slot for the given fetch parameters, creating this thread's
+ * cache if needed.  Returns NULL if the cache isn't enabled or available.
+ */
+static FETCH_CACHE_ENTRY *fetch_cache_slot(OSSL_LIB_CTX *libctx,
+                                           int operation_id, const char *name,
+                                           const char *propq)
+{
+    FETCH_CACHE *cache;
+    unsigned long h;
+
+    if (!RUN_ONCE(&fetch_cache_once, do_fetch_cache_init))
+        return NULL;
+    if ((cache = CRYPTO_THREAD_get_local(&fetch_cache_key)) == NULL) {
+        if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL)
+            return NULL;
+        if (!CRYPTO_THREAD_set_local(&fetch_cache_key, cache)) {
+            OPENSSL_free(cache);
+            return NULL;
+        }
+    }
+
+    h = OPENSSL_LH_strhash(name) + (unsigned long)operation_id;
+    if (propq != NULL)
+        h ^= OPENSSL_LH_strhash(propq) * 31;
+    return &cache->entries[h & (FETCH_CACHE_SIZE - 1)];
+}
+
+static int fetch_cache_entry_matches(const FETCH_CACHE_ENTRY *entry,
+                                     OSSL_LIB_CTX *libctx, int operation_id,
+                                     const char *name, const char *propq,
+                                     size_t generation)
+{
+    if (entry->method == NULL
+            || entry->libctx != libctx
+            || entry->operation_id != operation_id
+            || entry->generation != generation
+            || strcmp(entry->name, name) != 0)
+        return 0;
+    if (entry->propq == NULL || propq == NULL)
+        return entry->propq == propq;
+    return strcmp(entry->propq, propq) == 0;
+}
+
+static void fetch_cache_entry_set(FETCH_CACHE_ENTRY *entry,
+                                  OSSL_LIB_CTX *libctx, int operation_id,
+                                  const char *name, const char *propq,
+                                  size_t generation, void *method,
+                                  int (*up_ref_method)(void *),
+                                  void (*free_method)(void *))
+{
+    FETCH_CACHE *cache = CRYPTO_THREAD_get_local(&fetch_cache_key);
+
+    fetch_cache_entry_clear(entry);
+    if (cache == NULL || !fetch_cache_register_libctx(cache, libctx))
+        return;
+    if ((entry->name = OPENSSL_strdup(name)) == NULL
+            || (propq != NULL
+                && (entry->propq = OPENSSL_strdup(propq)) == NULL)
+            || !up_ref_method(method)) {
+        fetch_cache_entry_clear(entry);
+        return;
+    }
+    entry->libctx = libctx;
+    entry->operation_id = operation_id;
+    entry->generation = generation;
+    entry->method = method;
+    entry->free_method = free_method;
+}
+#endif /* FIPS_MODULE */
+
+static void *generic_fetch(OSSL_LIB_CTX *libctx, int operation_id,
+                           const char *name, const char *properties,
+                           const OSSL_PROPERTY_LIST *parsed_properties,
+                           void *(*new_method)(int name_id,
+                                               const OSSL_ALGORITHM *algodef,
+                                               OSSL_PROVIDER *prov),
+                           int (*up_ref_method)(void *),
+                           void (*free_method)(void *))
 {
     struct evp_method_data_st methdata;
     void *method;
+#ifndef FIPS_MODULE
+    FETCH_CACHE_ENTRY *entry = NULL;
+    OSSL_LIB_CTX *concrete = NULL;
+    size_t generation = 0;
+
+    if (name != NULL && ossl_lib_ctx_thread_fetch_cache(libctx)) {
+        concrete = ossl_lib_ctx_get_concrete(libctx);
+        /* Read before the fetch, so that concurrent changes make it stale */
+        generation = ossl_lib_ctx_fetch_generation(concrete);
+        entry = fetch_cache_slot(concrete, operation_id, name, properties);
+        if (entry != NULL
+                && fetch_cache_entry_matches(entry, concrete, operation_id,
+                                             name, properties, generation)
+                && up_ref_method(entry->method))
+            return entry->method;
+    }
+#endif
 
     methdata.libctx = libctx;
     methdata.tmp_store = NULL;
+    methdata.parsed_propquery = parsed_properties;
     method = inner_evp_generic_fetch(&methdata, NULL, operation_id,
                                      0, name, properties,
                                      new_method, up_ref_method, free_method);
     dealloc_tmp_evp_method_store(methdata.tmp_store);
+
+#ifndef FIPS_MODULE
+    if (entry != NULL && method != NULL)
+        fetch_cache_entry_set(entry, concrete, operation_id, name, properties,
+                              generation, method, up_ref_method, free_method);
+#endif
     return method;
 }
 
+void *evp_generic_fetch(OSSL_LIB_CTX *libctx, int operation_id,
+                        const char *name, const char *properties,
+                        void *(*new_method)(int name_id,
+                                            const OSSL_ALGORITHM *algodef,
+                                            OSSL_PROVIDER *prov),
+                        int (*up_ref_method)(void *),
+                        void (*free_method)(void *))
+{
+    return generic_fetch(libctx, operation_id, name, properties, NULL,
+                         new_method, up_ref_method, free_method);
+}
+
+#ifndef FIPS_MODULE
+/*
+ * evp_generic_fetch_with_query() is like evp_generic_fetch(), but takes an
+ * interned query, whose parsed form is passed down to the method store, so
+ * that the fetch doesn't have to look it up again.
+ */
+void *evp_generic_fetch_with_query(OSSL_LIB_CTX *libctx, int operation_id,
+                                   const char *name,
+                                   const OSSL_PROPERTY_QUERY *query,
+                                   void *(*new_method)(int name_id,
+                                                       const OSSL_ALGORITHM *algodef,
+                                                       OSSL_PROVIDER *prov),
+                                   int (*up_ref_method)(void *),
+                                   void (*free_method)(void *))
+{
+    return generic_fetch(libctx, operation_id, name,
+                         OSSL_PROPERTY_QUERY_get0_string(query),
+                         ossl_prop_query_get0_list(query),
+                         new_method, up_ref_method, free_method);
+}
+#endif
+
 /*
  * evp_generic_fetch_by_number() is special, and only returns methods for
  * already known names, i.e. it refuses to work if no name_id can be found
@@ -396,6 +651,7 @@ void *evp_generic_fetch_by_number(OSSL_LIB_CTX *libctx, int operation_id,
 
     methdata.libctx = libctx;
     methdata.tmp_store = NULL;
+    methdata.parsed_propquery = NULL;
     method = inner_evp_generic_fetch(&methdata, NULL, operation_id,
                                      name_id, NULL, properties,
                                      new_method, up_ref_method, free_method);
@@ -422,6 +678,7 @@ void *evp_generic_fetch_from_prov(OSSL_PROVIDER *prov, int operation_id,
 
     methdata.libctx = ossl_provider_libctx(prov);
     methdata.tmp_store = NULL;
+    methdata.parsed_propquery = NULL;
     method = inner_evp_generic_fetch(&methdata, prov, operation_id,
                                      0, name, properties,
                                      new_method, up_ref_method, free_method);
@@ -456,6 +713,11 @@ static int evp_set_parsed_default_properties(OSSL_LIB_CTX *libctx,
     OSSL_METHOD_STORE *store = get_evp_method_store(libctx);
     OSSL_PROPERTY_LIST **plp = ossl_ctx_global_properties(libctx, loadconfig);
 
+    if (ossl_lib_ctx_is_frozen(libctx)) {
+        ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+        return 0;
+    }
+
     if (plp != NULL && store != NULL) {
 #ifndef FIPS_MODULE
         char *propstr = NULL;
@@ -571,6 +833,21 @@ int EVP_default_properties_enable_fips(OSSL_LIB_CTX *libctx, int enable)
     return evp_default_properties_enable_fips_int(libctx, enable, 1);
 }
 
+int EVP_thread_fetch_cache_enable(OSSL_LIB_CTX *libctx, int enable)
+{
+    if (ossl_lib_ctx_get_concrete(libctx) == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+    ossl_lib_ctx_set_thread_fetch_cache(libctx, enable);
+    return 1;
+}
+
+int EVP_thread_fetch_cache_is_enabled(OSSL_LIB_CTX *libctx)
+{
+    return ossl_lib_ctx_thread_fetch_cache(libctx);
+}
+
 char *evp_get_global_properties_str(OSSL_LIB_CTX *libctx, int loadconfig)
 {
     OSSL_PROPERTY_LIST **plp = ossl_ctx_global_properties(libctx, loadconfig);
@@ -627,6 +904,7 @@ void evp_generic_do_all(OSSL_LIB_CTX *libctx, int operation_id,
 
     methdata.libctx = libctx;
     methdata.tmp_store = NULL;
+    methdata.parsed_propquery = NULL;
     (void)inner_evp_generic_fetch(&methdata, NULL, operation_id, 0, NULL, NULL,
                                   new_method, up_ref_method, free_method);
 
@@ -115,6 +115,7 @@ struct evp_keymgmt_st {
     OSSL_FUNC_keymgmt_gen_settable_params_fn *gen_settable_params;
     OSSL_FUNC_keymgmt_gen_fn *gen;
     OSSL_FUNC_keymgmt_gen_cleanup_fn *gen_cleanup;
+    OSSL_FUNC_keymgmt_gen_batch_fn *gen_batch;
 
     OSSL_FUNC_keymgmt_load_fn *load;
 
@@ -144,6 +145,7 @@ struct evp_keyexch_st {
     OSSL_FUNC_keyexch_init_fn *init;
     OSSL_FUNC_keyexch_set_peer_fn *set_peer;
     OSSL_FUNC_keyexch_derive_fn *derive;
+    OSSL_FUNC_keyexch_derive_batch_fn *derive_batch;
     OSSL_FUNC_keyexch_freectx_fn *freectx;
     OSSL_FUNC_keyexch_dupctx_fn *dupctx;
     OSSL_FUNC_keyexch_set_ctx_params_fn *set_ctx_params;
@@ -163,8 +165,10 @@ struct evp_signature_st {
     OSSL_FUNC_signature_newctx_fn *newctx;
     OSSL_FUNC_signature_sign_init_fn *sign_init;
     OSSL_FUNC_signature_sign_fn *sign;
+    OSSL_FUNC_signature_sign_batch_fn *sign_batch;
     OSSL_FUNC_signature_verify_init_fn *verify_init;
     OSSL_FUNC_signature_verify_fn *verify;
+    OSSL_FUNC_signature_verify_batch_fn *verify_batch;
     OSSL_FUNC_signature_verify_recover_init_fn *verify_recover_init;
     OSSL_FUNC_signature_verify_recover_fn *verify_recover;
     OSSL_FUNC_signature_digest_sign_init_fn *digest_sign_init;
@@ -200,6 +204,7 @@ struct evp_asym_cipher_st {
     OSSL_FUNC_asym_cipher_encrypt_fn *encrypt;
     OSSL_FUNC_asym_cipher_decrypt_init_fn *decrypt_init;
     OSSL_FUNC_asym_cipher_decrypt_fn *decrypt;
+    OSSL_FUNC_asym_cipher_decrypt_batch_fn *decrypt_batch;
     OSSL_FUNC_asym_cipher_freectx_fn *freectx;
     OSSL_FUNC_asym_cipher_dupctx_fn *dupctx;
     OSSL_FUNC_asym_cipher_get_ctx_params_fn *get_ctx_params;
@@ -269,6 +274,14 @@ void *evp_generic_fetch(OSSL_LIB_CTX *ctx, int operation_id,
                                             OSSL_PROVIDER *prov),
                         int (*up_ref_method)(void *),
                         void (*free_method)(void *));
+void *evp_generic_fetch_with_query(OSSL_LIB_CTX *libctx, int operation_id,
+                                   const char *name,
+                                   const OSSL_PROPERTY_QUERY *query,
+                                   void *(*new_method)(int name_id,
+                                                       const OSSL_ALGORITHM *algodef,
+                                                       OSSL_PROVIDER *prov),
+                                   int (*up_ref_method)(void *),
+                                   void (*free_method)(void *));
 void *evp_generic_fetch_by_number(OSSL_LIB_CTX *ctx, int operation_id,
                                   int name_id, const char *properties,
                                   void *(*new_method)(int name_id,
@@ -83,6 +83,11 @@ static void *evp_keyexch_from_algorithm(int name_id,
             exchange->derive = OSSL_FUNC_keyexch_derive(fns);
             fncnt++;
             break;
+        case OSSL_FUNC_KEYEXCH_DERIVE_BATCH:
+            if (exchange->derive_batch != NULL)
+                break;
+            exchange->derive_batch = OSSL_FUNC_keyexch_derive_batch(fns);
+            break;
         case OSSL_FUNC_KEYEXCH_FREECTX:
             if (exchange->freectx != NULL)
                 break;
@@ -533,6 +538,62 @@ int EVP_PKEY_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *pkeylen)
         return ctx->pmeth->derive(ctx, key, pkeylen);
 }
 
+int EVP_PKEY_derive_batch(EVP_PKEY_CTX *const ctx[], size_t num,
+                          unsigned char *const key[], size_t keylen[])
+{
+    EVP_KEYEXCH *exchange;
+    void **algctx;
+    size_t i;
+    int ret;
+
+    if (num == 0)
+        return 1;
+    if (ctx == NULL || key == NULL || keylen == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (ctx[i] == NULL || key[i] == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+            return -1;
+        }
+        if (!EVP_PKEY_CTX_IS_DERIVE_OP(ctx[i])) {
+            ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_INITIALIZED);
+            return -1;
+        }
+    }
+
+    /*
+     * The contexts can only be handed to the provider together if they all
+     * belong to the same implementation.
+     */
+    exchange = ctx[0]->op.kex.exchange;
+    for (i = 0; i < num; i++)
+        if (ctx[i]->op.kex.algctx == NULL
+                || ctx[i]->op.kex.exchange != exchange)
+            break;
+
+    if (i == num && exchange->derive_batch != NULL) {
+        if ((algctx = OPENSSL_malloc(num * sizeof(*algctx))) == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        for (i = 0; i < num; i++)
+            algctx[i] = ctx[i]->op.kex.algctx;
+        ret = exchange->derive_batch(algctx, num, key, keylen);
+        OPENSSL_free(algctx);
+        return ret;
+    }
+
+    for (i = 0; i < num; i++) {
+        ret = EVP_PKEY_derive(ctx[i], key[i], &keylen[i]);
+        if (ret <= 0)
+            return ret;
+    }
+    return 1;
+}
+
 int evp_keyexch_get_number(const EVP_KEYEXCH *keyexch)
 {
     return keyexch->name_id;
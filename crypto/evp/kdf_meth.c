@@ -165,6 +165,16 @@ EVP_KDF *EVP_KDF_fetch(OSSL_LIB_CTX *libctx, const char *algorithm,
                              evp_kdf_free);
 }
 
+#ifndef FIPS_MODULE
+EVP_KDF *EVP_KDF_fetch_with_query(OSSL_LIB_CTX *libctx, const char *algorithm,
+                                  const OSSL_PROPERTY_QUERY *query)
+{
+    return evp_generic_fetch_with_query(libctx, OSSL_OP_KDF, algorithm, query,
+                                        evp_kdf_from_algorithm, evp_kdf_up_ref,
+                                        evp_kdf_free);
+}
+#endif
+
 int EVP_KDF_up_ref(EVP_KDF *kdf)
 {
     return evp_kdf_up_ref(kdf);
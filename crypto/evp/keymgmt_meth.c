@@ -90,6 +90,10 @@ static void *keymgmt_from_algorithm(int name_id,
             if (keymgmt->gen_cleanup == NULL)
                 keymgmt->gen_cleanup = OSSL_FUNC_keymgmt_gen_cleanup(fns);
             break;
+        case OSSL_FUNC_KEYMGMT_GEN_BATCH:
+            if (keymgmt->gen_batch == NULL)
+                keymgmt->gen_batch = OSSL_FUNC_keymgmt_gen_batch(fns);
+            break;
         case OSSL_FUNC_KEYMGMT_FREE:
             if (keymgmt->free == NULL)
                 keymgmt->free = OSSL_FUNC_keymgmt_free(fns);
@@ -375,6 +379,20 @@ void *evp_keymgmt_gen(const EVP_KEYMGMT *keymgmt, void *genctx,
     return keymgmt->gen(genctx, cb, cbarg);
 }
 
+int evp_keymgmt_has_gen_batch(const EVP_KEYMGMT *keymgmt)
+{
+    return keymgmt != NULL && keymgmt->gen_batch != NULL;
+}
+
+int evp_keymgmt_gen_batch(const EVP_KEYMGMT *keymgmt, void *genctx,
+                          size_t num, void *keydata[],
+                          OSSL_CALLBACK *cb, void *cbarg)
+{
+    if (keymgmt->gen_batch == NULL)
+        return 0;
+    return keymgmt->gen_batch(genctx, num, keydata, cb, cbarg);
+}
+
 void evp_keymgmt_gen_cleanup(const EVP_KEYMGMT *keymgmt, void *genctx)
 {
     if (keymgmt->gen != NULL)
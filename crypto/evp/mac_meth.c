@@ -174,6 +174,16 @@ EVP_MAC *EVP_MAC_fetch(OSSL_LIB_CTX *libctx, const char *algorithm,
                              evp_mac_free);
 }
 
+#ifndef FIPS_MODULE
+EVP_MAC *EVP_MAC_fetch_with_query(OSSL_LIB_CTX *libctx, const char *algorithm,
+                                  const OSSL_PROPERTY_QUERY *query)
+{
+    return evp_generic_fetch_with_query(libctx, OSSL_OP_MAC, algorithm, query,
+                                        evp_mac_from_algorithm, evp_mac_up_ref,
+                                        evp_mac_free);
+}
+#endif
+
 int EVP_MAC_up_ref(EVP_MAC *mac)
 {
     return evp_mac_up_ref(mac);
@@ -166,6 +166,7 @@ void evp_cleanup_int(void)
     OBJ_sigid_free();
 
     evp_app_cleanup_int();
+    evp_fetch_cache_cleanup_int();
 }
 
 struct doall_cipher {
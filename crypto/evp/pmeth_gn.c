@@ -274,6 +274,79 @@ int EVP_PKEY_keygen(EVP_PKEY_CTX *ctx, EVP_PKEY **ppkey)
     return EVP_PKEY_generate(ctx, ppkey);
 }
 
+int EVP_PKEY_generate_batch(EVP_PKEY_CTX *ctx, size_t num, EVP_PKEY *ppkey[])
+{
+    void **keydata;
+    /* Legacy compatible keygen callback info, see EVP_PKEY_generate() */
+    int gentmp[2];
+    size_t i;
+    int ret = 1;
+
+    if (ppkey == NULL)
+        return -1;
+    for (i = 0; i < num; i++)
+        ppkey[i] = NULL;
+
+    if (ctx == NULL) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_SUPPORTED_FOR_THIS_KEYTYPE);
+        return -2;
+    }
+    if (ctx->operation != EVP_PKEY_OP_KEYGEN) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_INITIALIZED);
+        return -1;
+    }
+    if (num == 0)
+        return 1;
+
+    /*
+     * Only a provider implementation without a template key can generate
+     * the whole batch in one call, anything else is done key by key.
+     */
+    if (ctx->op.keymgmt.genctx == NULL || ctx->pkey != NULL
+            || !evp_keymgmt_has_gen_batch(ctx->keymgmt)) {
+        for (i = 0; i < num && ret > 0; i++)
+            ret = EVP_PKEY_generate(ctx, &ppkey[i]);
+        goto end;
+    }
+
+    if ((keydata = OPENSSL_zalloc(num * sizeof(*keydata))) == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    ctx->keygen_info = gentmp;
+    ctx->keygen_info_count = 2;
+    ret = evp_keymgmt_gen_batch(ctx->keymgmt, ctx->op.keymgmt.genctx, num,
+                                keydata, ossl_callback_to_pkey_gencb, ctx);
+    ctx->keygen_info = NULL;
+
+    for (i = 0; i < num; i++) {
+        if (keydata[i] == NULL) {
+            ret = 0;
+            continue;
+        }
+        if (ret <= 0
+                || (ppkey[i] = evp_keymgmt_util_make_pkey(ctx->keymgmt,
+                                                          keydata[i])) == NULL) {
+            evp_keymgmt_freedata(ctx->keymgmt, keydata[i]);
+            ret = 0;
+            continue;
+        }
+        /* Because we still have legacy keys */
+        ppkey[i]->type = ctx->legacy_keytype;
+    }
+    OPENSSL_free(keydata);
+
+ end:
+    if (ret <= 0) {
+        for (i = 0; i < num; i++) {
+            EVP_PKEY_free(ppkey[i]);
+            ppkey[i] = NULL;
+        }
+    }
+    return ret;
+}
+
 void EVP_PKEY_CTX_set_cb(EVP_PKEY_CTX *ctx, EVP_PKEY_gen_cb *cb)
 {
     ctx->pkey_gencb = cb;
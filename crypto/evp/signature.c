@@ -80,6 +80,11 @@ static void *evp_signature_from_algorithm(int name_id,
             signature->sign = OSSL_FUNC_signature_sign(fns);
             signfncnt++;
             break;
+        case OSSL_FUNC_SIGNATURE_SIGN_BATCH:
+            if (signature->sign_batch != NULL)
+                break;
+            signature->sign_batch = OSSL_FUNC_signature_sign_batch(fns);
+            break;
         case OSSL_FUNC_SIGNATURE_VERIFY_INIT:
             if (signature->verify_init != NULL)
                 break;
@@ -92,6 +97,11 @@ static void *evp_signature_from_algorithm(int name_id,
             signature->verify = OSSL_FUNC_signature_verify(fns);
             verifyfncnt++;
             break;
+        case OSSL_FUNC_SIGNATURE_VERIFY_BATCH:
+            if (signature->verify_batch != NULL)
+                break;
+            signature->verify_batch = OSSL_FUNC_signature_verify_batch(fns);
+            break;
         case OSSL_FUNC_SIGNATURE_VERIFY_RECOVER_INIT:
             if (signature->verify_recover_init != NULL)
                 break;
@@ -660,6 +670,48 @@ int EVP_PKEY_sign(EVP_PKEY_CTX *ctx,
         return ctx->pmeth->sign(ctx, sig, siglen, tbs, tbslen);
 }
 
+int EVP_PKEY_sign_batch(EVP_PKEY_CTX *ctx, size_t num,
+                        unsigned char *const sig[], size_t siglen[],
+                        const unsigned char *const tbs[],
+                        const size_t tbslen[])
+{
+    size_t i;
+    int ret;
+
+    if (ctx == NULL) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_SUPPORTED_FOR_THIS_KEYTYPE);
+        return -2;
+    }
+
+    if (ctx->operation != EVP_PKEY_OP_SIGN) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_INITIALIZED);
+        return -1;
+    }
+
+    if (num == 0)
+        return 1;
+    if (sig == NULL || siglen == NULL || tbs == NULL || tbslen == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    if (ctx->op.sig.algctx != NULL
+            && ctx->op.sig.signature->sign_batch != NULL)
+        return ctx->op.sig.signature->sign_batch(ctx->op.sig.algctx, num,
+                                                 sig, siglen, tbs, tbslen);
+
+    for (i = 0; i < num; i++) {
+        if (sig[i] == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+            return 0;
+        }
+        ret = EVP_PKEY_sign(ctx, sig[i], &siglen[i], tbs[i], tbslen[i]);
+        if (ret <= 0)
+            return ret;
+    }
+    return 1;
+}
+
 int EVP_PKEY_verify_init(EVP_PKEY_CTX *ctx)
 {
     return evp_pkey_signature_init(ctx, EVP_PKEY_OP_VERIFY, NULL);
@@ -702,6 +754,69 @@ int EVP_PKEY_verify(EVP_PKEY_CTX *ctx,
     return ctx->pmeth->verify(ctx, sig, siglen, tbs, tbslen);
 }
 
+int EVP_PKEY_verify_batch(EVP_PKEY_CTX *const ctx[], size_t num,
+                          const unsigned char *const sig[],
+                          const size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[], int results[])
+{
+    EVP_SIGNATURE *signature;
+    void **algctx;
+    size_t i;
+    int ret;
+
+    if (num == 0)
+        return 1;
+    if (ctx == NULL || sig == NULL || siglen == NULL || tbs == NULL
+            || tbslen == NULL || results == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (ctx[i] == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+            return -1;
+        }
+        if (ctx[i]->operation != EVP_PKEY_OP_VERIFY) {
+            ERR_raise(ERR_LIB_EVP, EVP_R_OPERATION_NOT_INITIALIZED);
+            return -1;
+        }
+    }
+
+    /*
+     * The contexts can only be handed to the provider together if they all
+     * belong to the same implementation.
+     */
+    signature = ctx[0]->op.sig.signature;
+    for (i = 0; i < num; i++)
+        if (ctx[i]->op.sig.algctx == NULL
+                || ctx[i]->op.sig.signature != signature)
+            break;
+
+    if (i == num && signature->verify_batch != NULL) {
+        if ((algctx = OPENSSL_malloc(num * sizeof(*algctx))) == NULL) {
+            ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
+            return -1;
+        }
+        for (i = 0; i < num; i++)
+            algctx[i] = ctx[i]->op.sig.algctx;
+        ret = signature->verify_batch(algctx, num, sig, siglen, tbs, tbslen,
+                                      results);
+        OPENSSL_free(algctx);
+        return ret == 1;
+    }
+
+    ret = 1;
+    for (i = 0; i < num; i++) {
+        results[i] = EVP_PKEY_verify(ctx[i], sig[i], siglen[i],
+                                     tbs[i], tbslen[i]);
+        if (results[i] != 1)
+            ret = 0;
+    }
+    return ret;
+}
+
 int EVP_PKEY_verify_recover_init(EVP_PKEY_CTX *ctx)
 {
     return evp_pkey_signature_init(ctx, EVP_PKEY_OP_VERIFYRECOVER, NULL);
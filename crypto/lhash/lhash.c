@@ -207,6 +207,27 @@ void *OPENSSL_LH_retrieve(OPENSSL_LHASH *lh, const void *data)
     return *rn == NULL ? NULL : (*rn)->data;
 }
 
+/*
+ * Same as OPENSSL_LH_retrieve(), but without touching the error indicator
+ * or the statistics, so concurrent lookups in a table that isn't modified
+ * any more don't write anything at all.
+ */
+void *ossl_lh_retrieve_ro(const OPENSSL_LHASH *lh, const void *data)
+{
+    unsigned long hash, nn;
+    OPENSSL_LH_NODE *n;
+
+    hash = (*(lh->hash)) (data);
+    nn = hash % lh->pmax;
+    if (nn < lh->p)
+        nn = hash % lh->num_alloc_nodes;
+
+    for (n = lh->b[(int)nn]; n != NULL; n = n->next)
+        if (n->hash == hash && lh->comp(n->data, data) == 0)
+            return n->data;
+    return NULL;
+}
+
 static void doall_util_fn(OPENSSL_LHASH *lh, int use_arg,
                           OPENSSL_LH_DOALL_FUNC func,
                           OPENSSL_LH_DOALL_FUNCARG func_arg, void *arg)
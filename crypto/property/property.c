@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <openssl/crypto.h>
+#include <openssl/err.h>
 #include "internal/core.h"
 #include "internal/property.h"
 #include "internal/provider.h"
@@ -19,16 +20,25 @@
 #include <openssl/lhash.h>
 #include <openssl/rand.h>
 #include "internal/thread_once.h"
+#include "internal/tsan_assist.h"
 #include "crypto/lhash.h"
 #include "crypto/sparse_array.h"
 #include "property_local.h"
 
 /*
- * The number of elements in the query cache before we initiate a flush.
- * If reducing this, also ensure the stochastic test in test/property_test.c
- * isn't likely to fail.
+ * The default number of entries the query cache of a method store can hold
+ * before old entries start being replaced.  Can be changed per library
+ * context with OSSL_LIB_CTX_set_method_cache_size().
  */
-#define IMPL_CACHE_FLUSH_THRESHOLD  500
+#define IMPL_CACHE_DEFAULT_SIZE     2000
+
+/*
+ * The method store is split into a number of independently locked shards,
+ * each holding the algorithms whose identifiers hash to it.  Fetches of
+ * different algorithms thereby take different locks, which keeps the lock
+ * cache lines from bouncing between cores.  Must be a power of two.
+ */
+#define NUM_SHARDS                  4
 
 typedef struct {
     void *method;
@@ -48,6 +58,11 @@ typedef struct {
     const OSSL_PROVIDER *provider;
     const char *query;
     METHOD method;
+    int nid;
+    /* Position on the clock of the shard, see impl_cache_clock_slot() */
+    size_t clock_slot;
+    /* Reference bit, set on every cache hit and cleared by the clock hand */
+    TSAN_QUALIFIER int used;
     char body[1];
 } QUERY;
 
@@ -59,25 +74,44 @@ typedef struct {
     LHASH_OF(QUERY) *cache;
 } ALGORITHM;
 
-struct ossl_method_store_st {
-    OSSL_LIB_CTX *ctx;
+/*
+ * Query cache statistics.  These are kept per library context, with one set
+ * per shard so that concurrent cache hits on different shards don't all
+ * update the same cache line.  They are only statistics, exactness isn't
+ * critical, so tsan_counter() is good enough to update them.
+ */
+typedef union {
+    struct {
+        TSAN_QUALIFIER size_t hits;
+        TSAN_QUALIFIER size_t misses;
+        TSAN_QUALIFIER size_t evictions;
+    } c;
+    unsigned char pad[64];
+} METHOD_CACHE_STATS;
+
+typedef struct {
     SPARSE_ARRAY_OF(ALGORITHM) *algs;
     CRYPTO_RWLOCK *lock;
 
     /* query cache specific values */
 
-    /* Count of the query cache entries for all algs */
-    size_t cache_nelem;
+    /*
+     * The query cache entries of all algs in this shard, arranged on a clock
+     * for the CLOCK replacement policy.  Empty slots are NULL.
+     */
+    QUERY **clock;
+    size_t clock_size;
+    size_t clock_hand;
 
-    /* Flag: 1 if query cache entries for all algs need flushing */
-    int cache_need_flush;
-};
+    METHOD_CACHE_STATS *stats;
+} STORED_ALGORITHMS;
 
-typedef struct {
-    LHASH_OF(QUERY) *cache;
-    size_t nelem;
-    uint32_t seed;
-} IMPL_CACHE_FLUSH;
+struct ossl_method_store_st {
+    OSSL_LIB_CTX *ctx;
+    STORED_ALGORITHMS shards[NUM_SHARDS];
+    /* Set by ossl_method_store_freeze(), the shards aren't locked after */
+    TSAN_QUALIFIER int frozen;
+};
 
 DEFINE_SPARSE_ARRAY_OF(ALGORITHM);
 
@@ -86,11 +120,14 @@ typedef struct ossl_global_properties_st {
 #ifndef FIPS_MODULE
     unsigned int no_mirrored : 1;
 #endif
+    /* Query cache size for the method stores in this library context */
+    TSAN_QUALIFIER size_t cache_size;
+    METHOD_CACHE_STATS cache_stats[NUM_SHARDS];
 } OSSL_GLOBAL_PROPERTIES;
 
-static void ossl_method_cache_flush_alg(OSSL_METHOD_STORE *store,
+static void ossl_method_cache_flush_alg(STORED_ALGORITHMS *sa,
                                         ALGORITHM *alg);
-static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid);
+static void ossl_method_cache_flush(STORED_ALGORITHMS *sa, int nid);
 
 /* Global properties are stored per library context */
 static void ossl_ctx_global_properties_free(void *vglobp)
@@ -105,7 +142,11 @@ static void ossl_ctx_global_properties_free(void *vglobp)
 
 static void *ossl_ctx_global_properties_new(OSSL_LIB_CTX *ctx)
 {
-    return OPENSSL_zalloc(sizeof(OSSL_GLOBAL_PROPERTIES));
+    OSSL_GLOBAL_PROPERTIES *globp = OPENSSL_zalloc(sizeof(*globp));
+
+    if (globp != NULL)
+        globp->cache_size = IMPL_CACHE_DEFAULT_SIZE;
+    return globp;
 }
 
 static const OSSL_LIB_CTX_METHOD ossl_ctx_global_properties_method = {
@@ -129,6 +170,52 @@ OSSL_PROPERTY_LIST **ossl_ctx_global_properties(OSSL_LIB_CTX *libctx,
     return globp != NULL ? &globp->list : NULL;
 }
 
+static OSSL_GLOBAL_PROPERTIES *ossl_ctx_global_properties_get(OSSL_LIB_CTX *libctx)
+{
+    return ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_GLOBAL_PROPERTIES,
+                                 &ossl_ctx_global_properties_method);
+}
+
+int ossl_method_cache_set_size(OSSL_LIB_CTX *libctx, size_t size)
+{
+    OSSL_GLOBAL_PROPERTIES *globp = ossl_ctx_global_properties_get(libctx);
+
+    if (globp == NULL)
+        return 0;
+    tsan_store(&globp->cache_size, size);
+    return 1;
+}
+
+size_t ossl_method_cache_get_size(OSSL_LIB_CTX *libctx)
+{
+    OSSL_GLOBAL_PROPERTIES *globp = ossl_ctx_global_properties_get(libctx);
+
+    return globp != NULL ? tsan_load(&globp->cache_size) : 0;
+}
+
+int ossl_method_cache_get_stats(OSSL_LIB_CTX *libctx, uint64_t *hits,
+                                uint64_t *misses, uint64_t *evictions)
+{
+    OSSL_GLOBAL_PROPERTIES *globp = ossl_ctx_global_properties_get(libctx);
+    uint64_t h = 0, m = 0, e = 0;
+    size_t i;
+
+    if (globp == NULL)
+        return 0;
+    for (i = 0; i < NUM_SHARDS; i++) {
+        h += tsan_load(&globp->cache_stats[i].c.hits);
+        m += tsan_load(&globp->cache_stats[i].c.misses);
+        e += tsan_load(&globp->cache_stats[i].c.evictions);
+    }
+    if (hits != NULL)
+        *hits = h;
+    if (misses != NULL)
+        *misses = m;
+    if (evictions != NULL)
+        *evictions = e;
+    return 1;
+}
+
 #ifndef FIPS_MODULE
 int ossl_global_properties_no_mirrored(OSSL_LIB_CTX *libctx)
 {
@@ -160,17 +247,65 @@ static void ossl_method_free(METHOD *method)
     (*method->free)(method->method);
 }
 
-static __owur int ossl_property_read_lock(OSSL_METHOD_STORE *p)
+/*
+ * The shards take turns holding ranges of 1 << SHARD_ID_BITS consecutive
+ * identifiers, which is the size of a leaf of the sparse arrays in the
+ * default layout.  A walk over all shards, as ossl_method_store_do_all()
+ * does, then scans no more leaves than it would in a single sparse array.
+ * Spreading individual identifiers over the shards instead made each shard
+ * allocate nearly every leaf, and every walk NUM_SHARDS times as long.
+ *
+ * Method identifiers built by evp_method_id() carry the name above the
+ * operation in their low 8 bits, so the EVP methods are spread by groups of
+ * 16 names, while the few decoder, encoder and store loader names all share a
+ * shard.
+ */
+#define SHARD_ID_BITS               12
+
+static ossl_inline STORED_ALGORITHMS *stored_algs_shard(OSSL_METHOD_STORE *store,
+                                                        int nid)
+{
+    return &store->shards[((unsigned int)nid >> SHARD_ID_BITS)
+                          & (NUM_SHARDS - 1)];
+}
+
+/*
+ * Nothing in the method stores of a frozen library context changes any
+ * more, see OSSL_LIB_CTX_freeze(), so the stores that were frozen along
+ * with it can be searched without any lock.  Attempts to change them fail.
+ * Writers check this again once they hold the lock of the shard, so that
+ * none of them is still busy when ossl_method_store_freeze() returns.
+ */
+static int ossl_method_store_is_frozen(OSSL_METHOD_STORE *store)
+{
+#ifdef tsan_ld_acq
+    return tsan_ld_acq(&store->frozen);
+#else
+    /* Without atomics, the shards are always locked */
+    return 0;
+#endif
+}
+
+static int ossl_method_store_frozen(OSSL_METHOD_STORE *store)
+{
+    if (!ossl_method_store_is_frozen(store)
+            && !ossl_lib_ctx_is_frozen(store->ctx))
+        return 0;
+    ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+    return 1;
+}
+
+static __owur int ossl_property_read_lock(STORED_ALGORITHMS *p)
 {
     return p != NULL ? CRYPTO_THREAD_read_lock(p->lock) : 0;
 }
 
-static __owur int ossl_property_write_lock(OSSL_METHOD_STORE *p)
+static __owur int ossl_property_write_lock(STORED_ALGORITHMS *p)
 {
     return p != NULL ? CRYPTO_THREAD_write_lock(p->lock) : 0;
 }
 
-static int ossl_property_unlock(OSSL_METHOD_STORE *p)
+static int ossl_property_unlock(STORED_ALGORITHMS *p)
 {
     return p != 0 ? CRYPTO_THREAD_unlock(p->lock) : 0;
 }
@@ -213,9 +348,18 @@ static void impl_cache_flush_alg(ossl_uintmax_t idx, ALGORITHM *alg)
     lh_QUERY_flush(alg->cache);
 }
 
+IMPLEMENT_LHASH_DOALL_ARG(QUERY, STORED_ALGORITHMS);
+
+/* Free a query cache entry that has already been taken out of its cache */
+static void impl_cache_remove(QUERY *elem, STORED_ALGORITHMS *sa)
+{
+    sa->clock[elem->clock_slot] = NULL;
+    impl_cache_free(elem);
+}
+
 static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a, void *arg)
 {
-    OSSL_METHOD_STORE *store = arg;
+    STORED_ALGORITHMS *sa = arg;
 
     if (a != NULL) {
         sk_IMPLEMENTATION_pop_free(a->impls, &impl_free);
@@ -223,8 +367,22 @@ static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a, void *arg)
         lh_QUERY_free(a->cache);
         OPENSSL_free(a);
     }
-    if (store != NULL)
-        ossl_sa_ALGORITHM_set(store->algs, idx, NULL);
+    if (sa != NULL)
+        ossl_sa_ALGORITHM_set(sa->algs, idx, NULL);
+}
+
+static void stored_algs_free(STORED_ALGORITHMS *sa)
+{
+    size_t i;
+
+    for (i = 0; i < NUM_SHARDS; i++) {
+        if (sa[i].algs != NULL) {
+            ossl_sa_ALGORITHM_doall_arg(sa[i].algs, &alg_cleanup, &sa[i]);
+            ossl_sa_ALGORITHM_free(sa[i].algs);
+        }
+        CRYPTO_THREAD_lock_free(sa[i].lock);
+        OPENSSL_free(sa[i].clock);
+    }
 }
 
 /*
@@ -234,41 +392,70 @@ static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a, void *arg)
 OSSL_METHOD_STORE *ossl_method_store_new(OSSL_LIB_CTX *ctx)
 {
     OSSL_METHOD_STORE *res;
+    OSSL_GLOBAL_PROPERTIES *globp;
+    size_t i;
 
+    if ((globp = ossl_ctx_global_properties_get(ctx)) == NULL)
+        return NULL;
     res = OPENSSL_zalloc(sizeof(*res));
     if (res != NULL) {
         res->ctx = ctx;
-        if ((res->algs = ossl_sa_ALGORITHM_new()) == NULL) {
-            OPENSSL_free(res);
-            return NULL;
-        }
-        if ((res->lock = CRYPTO_THREAD_lock_new()) == NULL) {
-            ossl_sa_ALGORITHM_free(res->algs);
-            OPENSSL_free(res);
-            return NULL;
+        for (i = 0; i < NUM_SHARDS; i++) {
+            /*
+             * The global properties are cleaned up after all method stores,
+             * so holding on to the statistics is safe.
+             */
+            res->shards[i].stats = &globp->cache_stats[i];
+            if ((res->shards[i].algs = ossl_sa_ALGORITHM_new()) == NULL
+                    || (res->shards[i].lock = CRYPTO_THREAD_lock_new()) == NULL) {
+                stored_algs_free(res->shards);
+                OPENSSL_free(res);
+                return NULL;
+            }
         }
     }
     return res;
 }
 
+/*
+ * Stop the changes to |store| and let it be searched without taking any
+ * lock from now on.  Taking the lock of every shard waits for the writers
+ * that are still busy with it.
+ */
+int ossl_method_store_freeze(OSSL_METHOD_STORE *store)
+{
+    size_t i, j;
+
+    for (i = 0; i < NUM_SHARDS; i++)
+        if (!ossl_property_write_lock(&store->shards[i])) {
+            for (j = 0; j < i; j++)
+                ossl_property_unlock(&store->shards[j]);
+            return 0;
+        }
+#ifdef tsan_st_rel
+    tsan_st_rel(&store->frozen, 1);
+#endif
+    for (i = 0; i < NUM_SHARDS; i++)
+        ossl_property_unlock(&store->shards[i]);
+    return 1;
+}
+
 void ossl_method_store_free(OSSL_METHOD_STORE *store)
 {
     if (store != NULL) {
-        ossl_sa_ALGORITHM_doall_arg(store->algs, &alg_cleanup, store);
-        ossl_sa_ALGORITHM_free(store->algs);
-        CRYPTO_THREAD_lock_free(store->lock);
+        stored_algs_free(store->shards);
         OPENSSL_free(store);
     }
 }
 
-static ALGORITHM *ossl_method_store_retrieve(OSSL_METHOD_STORE *store, int nid)
+static ALGORITHM *ossl_method_store_retrieve(STORED_ALGORITHMS *sa, int nid)
 {
-    return ossl_sa_ALGORITHM_get(store->algs, nid);
+    return ossl_sa_ALGORITHM_get(sa->algs, nid);
 }
 
-static int ossl_method_store_insert(OSSL_METHOD_STORE *store, ALGORITHM *alg)
+static int ossl_method_store_insert(STORED_ALGORITHMS *sa, ALGORITHM *alg)
 {
-        return ossl_sa_ALGORITHM_set(store->algs, alg->nid, alg);
+    return ossl_sa_ALGORITHM_set(sa->algs, alg->nid, alg);
 }
 
 int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
@@ -276,6 +463,7 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
                           int (*method_up_ref)(void *),
                           void (*method_destruct)(void *))
 {
+    STORED_ALGORITHMS *sa;
     ALGORITHM *alg = NULL;
     IMPLEMENTATION *impl;
     int ret = 0;
@@ -283,6 +471,9 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
 
     if (nid <= 0 || method == NULL || store == NULL)
         return 0;
+    if (ossl_method_store_frozen(store))
+        return 0;
+    sa = stored_algs_shard(store, nid);
     if (properties == NULL)
         properties = "";
 
@@ -303,11 +494,13 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
     impl->provider = prov;
 
     /* Insert into the hash table if required */
-    if (!ossl_property_write_lock(store)) {
+    if (!ossl_property_write_lock(sa)) {
         OPENSSL_free(impl);
         return 0;
     }
-    ossl_method_cache_flush(store, nid);
+    if (ossl_method_store_frozen(store))
+        goto err;
+    ossl_method_cache_flush(sa, nid);
     if ((impl->properties = ossl_prop_defn_get(store->ctx, properties)) == NULL) {
         impl->properties = ossl_parse_property(store->ctx, properties);
         if (impl->properties == NULL)
@@ -315,14 +508,14 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
         ossl_prop_defn_set(store->ctx, properties, impl->properties);
     }
 
-    alg = ossl_method_store_retrieve(store, nid);
+    alg = ossl_method_store_retrieve(sa, nid);
     if (alg == NULL) {
         if ((alg = OPENSSL_zalloc(sizeof(*alg))) == NULL
                 || (alg->impls = sk_IMPLEMENTATION_new_null()) == NULL
                 || (alg->cache = lh_QUERY_new(&query_hash, &query_cmp)) == NULL)
             goto err;
         alg->nid = nid;
-        if (!ossl_method_store_insert(store, alg))
+        if (!ossl_method_store_insert(sa, alg))
             goto err;
     }
 
@@ -335,15 +528,17 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
             break;
     }
     if (i == sk_IMPLEMENTATION_num(alg->impls)
-        && sk_IMPLEMENTATION_push(alg->impls, impl))
+        && sk_IMPLEMENTATION_push(alg->impls, impl)) {
+        ossl_lib_ctx_new_fetch_generation(store->ctx);
         ret = 1;
-    ossl_property_unlock(store);
+    }
+    ossl_property_unlock(sa);
     if (ret == 0)
         impl_free(impl);
     return ret;
 
 err:
-    ossl_property_unlock(store);
+    ossl_property_unlock(sa);
     alg_cleanup(0, alg, NULL);
     impl_free(impl);
     return 0;
@@ -352,18 +547,26 @@ err:
 int ossl_method_store_remove(OSSL_METHOD_STORE *store, int nid,
                              const void *method)
 {
+    STORED_ALGORITHMS *sa;
     ALGORITHM *alg = NULL;
     int i;
 
     if (nid <= 0 || method == NULL || store == NULL)
         return 0;
+    if (ossl_method_store_frozen(store))
+        return 0;
 
-    if (!ossl_property_write_lock(store))
+    sa = stored_algs_shard(store, nid);
+    if (!ossl_property_write_lock(sa))
+        return 0;
+    if (ossl_method_store_frozen(store)) {
+        ossl_property_unlock(sa);
         return 0;
-    ossl_method_cache_flush(store, nid);
-    alg = ossl_method_store_retrieve(store, nid);
+    }
+    ossl_method_cache_flush(sa, nid);
+    alg = ossl_method_store_retrieve(sa, nid);
     if (alg == NULL) {
-        ossl_property_unlock(store);
+        ossl_property_unlock(sa);
         return 0;
     }
 
@@ -378,16 +581,17 @@ int ossl_method_store_remove(OSSL_METHOD_STORE *store, int nid,
         if (impl->method.method == method) {
             impl_free(impl);
             (void)sk_IMPLEMENTATION_delete(alg->impls, i);
-            ossl_property_unlock(store);
+            ossl_lib_ctx_new_fetch_generation(store->ctx);
+            ossl_property_unlock(sa);
             return 1;
         }
     }
-    ossl_property_unlock(store);
+    ossl_property_unlock(sa);
     return 0;
 }
 
 struct alg_cleanup_by_provider_data_st {
-    OSSL_METHOD_STORE *store;
+    STORED_ALGORITHMS *sa;
     const OSSL_PROVIDER *prov;
 };
 
@@ -418,20 +622,31 @@ alg_cleanup_by_provider(ossl_uintmax_t idx, ALGORITHM *alg, void *arg)
      * any implementation, though.
      */
     if (count > 0)
-        ossl_method_cache_flush_alg(data->store, alg);
+        ossl_method_cache_flush_alg(data->sa, alg);
 }
 
 int ossl_method_store_remove_all_provided(OSSL_METHOD_STORE *store,
                                           const OSSL_PROVIDER *prov)
 {
     struct alg_cleanup_by_provider_data_st data;
+    size_t i;
 
-    if (!ossl_property_write_lock(store))
+    if (store == NULL || ossl_method_store_frozen(store))
         return 0;
     data.prov = prov;
-    data.store = store;
-    ossl_sa_ALGORITHM_doall_arg(store->algs, &alg_cleanup_by_provider, &data);
-    ossl_property_unlock(store);
+    for (i = 0; i < NUM_SHARDS; i++) {
+        data.sa = &store->shards[i];
+        if (!ossl_property_write_lock(data.sa))
+            return 0;
+        if (ossl_method_store_frozen(store)) {
+            ossl_property_unlock(data.sa);
+            return 0;
+        }
+        ossl_sa_ALGORITHM_doall_arg(data.sa->algs, &alg_cleanup_by_provider,
+                                    &data);
+        ossl_property_unlock(data.sa);
+    }
+    ossl_lib_ctx_new_fetch_generation(store->ctx);
     return 1;
 }
 
@@ -464,57 +679,62 @@ void ossl_method_store_do_all(OSSL_METHOD_STORE *store,
                               void *fnarg)
 {
     struct alg_do_each_data_st data;
+    size_t i;
 
     data.fn = fn;
     data.fnarg = fnarg;
     if (store != NULL)
-        ossl_sa_ALGORITHM_doall_arg(store->algs, alg_do_each, &data);
+        for (i = 0; i < NUM_SHARDS; i++)
+            ossl_sa_ALGORITHM_doall_arg(store->shards[i].algs, alg_do_each,
+                                        &data);
 }
 
-int ossl_method_store_fetch(OSSL_METHOD_STORE *store,
-                            int nid, const char *prop_query,
-                            const OSSL_PROVIDER **prov_rw, void **method)
+/*
+ * Finds the best implementation of |nid| for the parsed query |pq|, which
+ * may be NULL to match any implementation.
+ */
+static int method_store_fetch(OSSL_METHOD_STORE *store, int nid,
+                              const OSSL_PROPERTY_LIST *pq,
+                              const OSSL_PROVIDER **prov_rw, void **method)
 {
     OSSL_PROPERTY_LIST **plp;
+    STORED_ALGORITHMS *sa;
     ALGORITHM *alg;
     IMPLEMENTATION *impl, *best_impl = NULL;
-    OSSL_PROPERTY_LIST *pq = NULL, *p2 = NULL;
+    OSSL_PROPERTY_LIST *p2 = NULL;
     const OSSL_PROVIDER *prov = prov_rw != NULL ? *prov_rw : NULL;
     int ret = 0;
-    int j, best = -1, score, optional;
+    int j, best = -1, score, optional, frozen;
 
-#ifndef FIPS_MODULE
-    if (!OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL))
-        return 0;
-#endif
-
-    if (nid <= 0 || method == NULL || store == NULL)
-        return 0;
-
-    /* This only needs to be a read lock, because the query won't create anything */
-    if (!ossl_property_read_lock(store))
-        return 0;
-    alg = ossl_method_store_retrieve(store, nid);
-    if (alg == NULL) {
-        ossl_property_unlock(store);
-        return 0;
-    }
-
-    if (prop_query != NULL)
-        p2 = pq = ossl_parse_query(store->ctx, prop_query, 0);
+    /*
+     * Merge the query before taking the lock, so that the time spent
+     * holding it is limited to the walk of the implementations.
+     */
+    frozen = ossl_method_store_is_frozen(store);
     plp = ossl_ctx_global_properties(store->ctx, 0);
     if (plp != NULL && *plp != NULL) {
         if (pq == NULL) {
             pq = *plp;
         } else {
             p2 = ossl_property_merge(pq, *plp);
-            ossl_property_free(pq);
             if (p2 == NULL)
-                goto fin;
+                return 0;
             pq = p2;
         }
     }
 
+    /* This only needs to be a read lock, because the query won't create anything */
+    sa = stored_algs_shard(store, nid);
+    if (!frozen && !ossl_property_read_lock(sa)) {
+        ossl_property_free(p2);
+        return 0;
+    }
+    alg = ossl_method_store_retrieve(sa, nid);
+    if (alg == NULL) {
+        ret = 0;
+        goto end;
+    }
+
     if (pq == NULL) {
         for (j = 0; j < sk_IMPLEMENTATION_num(alg->impls); j++) {
             if ((impl = sk_IMPLEMENTATION_value(alg->impls, j)) != NULL
@@ -548,102 +768,183 @@ fin:
     } else {
         ret = 0;
     }
-    ossl_property_unlock(store);
+end:
+    if (!frozen)
+        ossl_property_unlock(sa);
     ossl_property_free(p2);
     return ret;
 }
 
-static void ossl_method_cache_flush_alg(OSSL_METHOD_STORE *store,
+int ossl_method_store_fetch(OSSL_METHOD_STORE *store,
+                            int nid, const char *prop_query,
+                            const OSSL_PROVIDER **prov_rw, void **method)
+{
+    const OSSL_PROPERTY_LIST *pq = NULL;
+    OSSL_PROPERTY_LIST *p1 = NULL;
+    int ret;
+
+#ifndef FIPS_MODULE
+    if (!OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL))
+        return 0;
+#endif
+
+    if (nid <= 0 || method == NULL || store == NULL)
+        return 0;
+
+    /*
+     * Parsed queries are mostly interned, so a given query string is usually
+     * only parsed once per library context.
+     */
+    if (prop_query != NULL)
+        pq = ossl_prop_query_get(store->ctx, prop_query, &p1);
+    ret = method_store_fetch(store, nid, pq, prov_rw, method);
+    ossl_property_free(p1);
+    return ret;
+}
+
+/*
+ * Like ossl_method_store_fetch(), but with a query that the caller has
+ * already parsed, see ossl_prop_query_get0_list().
+ */
+int ossl_method_store_fetch_parsed(OSSL_METHOD_STORE *store, int nid,
+                                   const OSSL_PROPERTY_LIST *prop_query,
+                                   const OSSL_PROVIDER **prov_rw,
+                                   void **method)
+{
+#ifndef FIPS_MODULE
+    if (!OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL))
+        return 0;
+#endif
+
+    if (nid <= 0 || method == NULL || store == NULL)
+        return 0;
+    return method_store_fetch(store, nid, prop_query, prov_rw, method);
+}
+
+static void ossl_method_cache_flush_alg(STORED_ALGORITHMS *sa,
                                         ALGORITHM *alg)
 {
-    store->cache_nelem -= lh_QUERY_num_items(alg->cache);
-    impl_cache_flush_alg(0, alg);
+    lh_QUERY_doall_STORED_ALGORITHMS(alg->cache, &impl_cache_remove, sa);
+    lh_QUERY_flush(alg->cache);
 }
 
-static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
+static void ossl_method_cache_flush(STORED_ALGORITHMS *sa, int nid)
 {
-    ALGORITHM *alg = ossl_method_store_retrieve(store, nid);
+    ALGORITHM *alg = ossl_method_store_retrieve(sa, nid);
 
     if (alg != NULL)
-        ossl_method_cache_flush_alg(store, alg);
+        ossl_method_cache_flush_alg(sa, alg);
 }
 
 int ossl_method_store_cache_flush_all(OSSL_METHOD_STORE *store)
 {
-    if (!ossl_property_write_lock(store))
+    STORED_ALGORITHMS *sa;
+    size_t i;
+
+    if (store == NULL || ossl_method_store_frozen(store))
         return 0;
-    ossl_sa_ALGORITHM_doall(store->algs, &impl_cache_flush_alg);
-    store->cache_nelem = 0;
-    ossl_property_unlock(store);
+    for (i = 0; i < NUM_SHARDS; i++) {
+        sa = &store->shards[i];
+        if (!ossl_property_write_lock(sa))
+            return 0;
+        if (ossl_method_store_frozen(store)) {
+            ossl_property_unlock(sa);
+            return 0;
+        }
+        ossl_sa_ALGORITHM_doall(sa->algs, &impl_cache_flush_alg);
+        if (sa->clock != NULL)
+            memset(sa->clock, 0, sa->clock_size * sizeof(*sa->clock));
+        ossl_property_unlock(sa);
+    }
+    ossl_lib_ctx_new_fetch_generation(store->ctx);
     return 1;
 }
 
-IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
-
 /*
- * Flush an element from the query cache (perhaps).
- *
- * In order to avoid taking a write lock or using atomic operations
- * to keep accurate least recently used (LRU) or least frequently used
- * (LFU) information, the procedure used here is to stochastically
- * flush approximately half the cache.
- *
- * This procedure isn't ideal, LRU or LFU would be better.  However,
- * in normal operation, reaching a full cache would be unexpected.
- * It means that no steady state of algorithm queries has been reached.
- * That is, it is most likely an attack of some form.  A suboptimal clearance
- * strategy that doesn't degrade performance of the normal case is
- * preferable to a more refined approach that imposes a performance
- * impact.
+ * Resize the clock of a shard to match the configured cache size.  The
+ * cache is emptied in the process, which is fine since resizing is rare.
  */
-static void impl_cache_flush_cache(QUERY *c, IMPL_CACHE_FLUSH *state)
+static int impl_cache_clock_resize(STORED_ALGORITHMS *sa, size_t size)
 {
-    uint32_t n;
+    QUERY **clock = NULL;
 
-    /*
-     * Implement the 32 bit xorshift as suggested by George Marsaglia in:
-     *      https://doi.org/10.18637/jss.v008.i14
-     *
-     * This is a very fast PRNG so there is no need to extract bits one at a
-     * time and use the entire value each time.
-     */
-    n = state->seed;
-    n ^= n << 13;
-    n ^= n >> 17;
-    n ^= n << 5;
-    state->seed = n;
-
-    if ((n & 1) != 0)
-        impl_cache_free(lh_QUERY_delete(state->cache, c));
-    else
-        state->nelem++;
+    if (size > 0
+            && (clock = OPENSSL_zalloc(size * sizeof(*clock))) == NULL)
+        return 0;
+    ossl_sa_ALGORITHM_doall(sa->algs, &impl_cache_flush_alg);
+    OPENSSL_free(sa->clock);
+    sa->clock = clock;
+    sa->clock_size = size;
+    sa->clock_hand = 0;
+    return 1;
 }
 
-static void impl_cache_flush_one_alg(ossl_uintmax_t idx, ALGORITHM *alg,
-                                     void *v)
+/*
+ * Find a free slot on the clock of a shard for a new query cache entry,
+ * evicting an old entry if needed.
+ *
+ * This implements the CLOCK approximation of least recently used (LRU)
+ * replacement: cache hits merely set the reference bit of an entry, which
+ * can be done without taking the write lock.  The hand sweeps around the
+ * clock clearing reference bits, and the first entry found without one is
+ * evicted.  Recently used entries thus get a second chance while the cost
+ * of an eviction stays bounded by two rotations of the clock.
+ */
+static size_t impl_cache_clock_slot(STORED_ALGORITHMS *sa)
 {
-    IMPL_CACHE_FLUSH *state = (IMPL_CACHE_FLUSH *)v;
-
-    state->cache = alg->cache;
-    lh_QUERY_doall_IMPL_CACHE_FLUSH(state->cache, &impl_cache_flush_cache,
-                                    state);
+    ALGORITHM *alg;
+    QUERY *victim;
+    size_t slot;
+
+    for (;;) {
+        slot = sa->clock_hand;
+        if (++sa->clock_hand == sa->clock_size)
+            sa->clock_hand = 0;
+        if ((victim = sa->clock[slot]) == NULL)
+            return slot;
+        if (tsan_load(&victim->used)) {
+            tsan_store(&victim->used, 0);
+            continue;
+        }
+        alg = ossl_method_store_retrieve(sa, victim->nid);
+        if (alg != NULL)
+            (void)lh_QUERY_delete(alg->cache, victim);
+        impl_cache_remove(victim, sa);
+        tsan_counter(&sa->stats->c.evictions);
+        return slot;
+    }
 }
 
-static void ossl_method_cache_flush_some(OSSL_METHOD_STORE *store)
+/*
+ * Query cache lookup in a frozen library context.  Nothing is added to or
+ * evicted from the cache any more, so the lock isn't needed, and neither is
+ * the reference bit.  The statistics aren't updated either, which leaves
+ * this path without any write to shared memory, apart from the reference
+ * count of the method.
+ */
+static int impl_cache_get_frozen(STORED_ALGORITHMS *sa, OSSL_PROVIDER *prov,
+                                 int nid, const char *prop_query,
+                                 void **method)
 {
-    IMPL_CACHE_FLUSH state;
+    ALGORITHM *alg = ossl_method_store_retrieve(sa, nid);
+    QUERY elem, *r;
 
-    state.nelem = 0;
-    if ((state.seed = OPENSSL_rdtsc()) == 0)
-        state.seed = 1;
-    store->cache_need_flush = 0;
-    ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_one_alg, &state);
-    store->cache_nelem = state.nelem;
+    if (alg == NULL)
+        return 0;
+
+    elem.query = prop_query;
+    elem.provider = prov;
+    r = ossl_lh_retrieve_ro((const OPENSSL_LHASH *)alg->cache, &elem);
+    if (r == NULL || !ossl_method_up_ref(&r->method))
+        return 0;
+    *method = r->method.method;
+    return 1;
 }
 
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
                                 int nid, const char *prop_query, void **method)
 {
+    STORED_ALGORITHMS *sa;
     ALGORITHM *alg;
     QUERY elem, *r;
     int res = 0;
@@ -651,9 +952,12 @@ int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
     if (nid <= 0 || store == NULL || prop_query == NULL)
         return 0;
 
-    if (!ossl_property_read_lock(store))
+    sa = stored_algs_shard(store, nid);
+    if (ossl_method_store_is_frozen(store))
+        return impl_cache_get_frozen(sa, prov, nid, prop_query, method);
+    if (!ossl_property_read_lock(sa))
         return 0;
-    alg = ossl_method_store_retrieve(store, nid);
+    alg = ossl_method_store_retrieve(sa, nid);
     if (alg == NULL)
         goto err;
 
@@ -664,10 +968,17 @@ int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
         goto err;
     if (ossl_method_up_ref(&r->method)) {
         *method = r->method.method;
+        /* Avoid dirtying the cache line when the bit is already set */
+        if (!tsan_load(&r->used))
+            tsan_store(&r->used, 1);
         res = 1;
     }
 err:
-    ossl_property_unlock(store);
+    if (res)
+        tsan_counter(&sa->stats->c.hits);
+    else
+        tsan_counter(&sa->stats->c.misses);
+    ossl_property_unlock(sa);
     return res;
 }
 
@@ -676,9 +987,10 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
                                 int (*method_up_ref)(void *),
                                 void (*method_destruct)(void *))
 {
+    STORED_ALGORITHMS *sa;
     QUERY elem, *old, *p = NULL;
     ALGORITHM *alg;
-    size_t len;
+    size_t len, size;
     int res = 1;
 
     if (nid <= 0 || store == NULL || prop_query == NULL)
@@ -687,23 +999,37 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
     if (!ossl_assert(prov != NULL))
         return 0;
 
-    if (!ossl_property_write_lock(store))
+    /* The cache of a frozen library context stays as it is */
+    if (ossl_method_store_is_frozen(store)
+            || ossl_lib_ctx_is_frozen(store->ctx))
+        return 1;
+
+    /* Spread the configured cache size evenly over the shards */
+    size = ossl_method_cache_get_size(store->ctx);
+    size = (size + NUM_SHARDS - 1) / NUM_SHARDS;
+
+    sa = stored_algs_shard(store, nid);
+    if (!ossl_property_write_lock(sa))
         return 0;
-    if (store->cache_need_flush)
-        ossl_method_cache_flush_some(store);
-    alg = ossl_method_store_retrieve(store, nid);
+    if (ossl_method_store_is_frozen(store)
+            || ossl_lib_ctx_is_frozen(store->ctx))
+        goto end;
+    if (size != sa->clock_size && !impl_cache_clock_resize(sa, size))
+        goto err;
+    alg = ossl_method_store_retrieve(sa, nid);
     if (alg == NULL)
         goto err;
 
     if (method == NULL) {
         elem.query = prop_query;
         elem.provider = prov;
-        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL) {
-            impl_cache_free(old);
-            store->cache_nelem--;
-        }
+        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL)
+            impl_cache_remove(old, sa);
         goto end;
     }
+    /* A zero sized cache means that caching is disabled */
+    if (sa->clock_size == 0)
+        goto end;
     p = OPENSSL_malloc(sizeof(*p) + (len = strlen(prop_query)));
     if (p != NULL) {
         p->query = p->body;
@@ -711,16 +1037,19 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
         p->method.method = method;
         p->method.up_ref = method_up_ref;
         p->method.free = method_destruct;
+        p->nid = nid;
+        p->used = 0;
         if (!ossl_method_up_ref(&p->method))
             goto err;
         memcpy((char *)p->query, prop_query, len + 1);
-        if ((old = lh_QUERY_insert(alg->cache, p)) != NULL) {
-            impl_cache_free(old);
-            goto end;
-        }
+        elem.query = prop_query;
+        elem.provider = prov;
+        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL)
+            impl_cache_remove(old, sa);
+        p->clock_slot = impl_cache_clock_slot(sa);
+        (void)lh_QUERY_insert(alg->cache, p);
         if (!lh_QUERY_error(alg->cache)) {
-            if (++store->cache_nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
-                store->cache_need_flush = 1;
+            sa->clock[p->clock_slot] = p;
             goto end;
         }
         ossl_method_free(&p->method);
@@ -729,6 +1058,6 @@ err:
     res = 0;
     OPENSSL_free(p);
 end:
-    ossl_property_unlock(store);
+    ossl_property_unlock(sa);
     return res;
 }
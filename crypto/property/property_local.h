@@ -53,3 +53,8 @@ int ossl_property_has_optional(const OSSL_PROPERTY_LIST *query);
 OSSL_PROPERTY_LIST *ossl_prop_defn_get(OSSL_LIB_CTX *ctx, const char *prop);
 int ossl_prop_defn_set(OSSL_LIB_CTX *ctx, const char *prop,
                        OSSL_PROPERTY_LIST *pl);
+
+/* Parsed property query cache functions */
+const OSSL_PROPERTY_LIST *ossl_prop_query_get(OSSL_LIB_CTX *ctx,
+                                              const char *query,
+                                              OSSL_PROPERTY_LIST **parsed);
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <openssl/err.h>
+#include <openssl/lhash.h>
+#include "internal/propertyerr.h"
+#include "internal/property.h"
+#include "internal/core.h"
+#include "crypto/lhash.h"
+#include "property_local.h"
+
+/*
+ * Implement a parsed property query cache.
+ * Queries are interned: once parsed, a query string maps to the same
+ * immutable property list for the lifetime of the library context, so
+ * callers never have to free what they get back.
+ * No attempt is made to clean out the cache, except when it is shut down.
+ * Instead, fetches stop adding queries to it once it holds
+ * PROP_QUERY_MAX_INTERNED of them, and parse any further query per use.
+ * Queries are parsed without creating property names or values, as in
+ * ossl_method_store_fetch(), because an unknown name or value can't match
+ * any definition.  Queries with unknown names or values aren't interned by
+ * fetches, and are parsed per use even if they were interned explicitly, as
+ * a provider that is loaded later may define them.
+ * Once the library context is frozen, the cache is searched without a lock
+ * and nothing is added to it any more.
+ */
+
+#define PROP_QUERY_MAX_INTERNED     512
+
+struct ossl_property_query_st {
+    const char *query;
+    OSSL_PROPERTY_LIST *list;
+    /* Set if |list| has names or values that weren't known when parsed */
+    int unknown;
+    char body[1];
+};
+
+DEFINE_LHASH_OF(OSSL_PROPERTY_QUERY);
+
+static unsigned long property_query_hash(const OSSL_PROPERTY_QUERY *a)
+{
+    return OPENSSL_LH_strhash(a->query);
+}
+
+static int property_query_cmp(const OSSL_PROPERTY_QUERY *a,
+                              const OSSL_PROPERTY_QUERY *b)
+{
+    return strcmp(a->query, b->query);
+}
+
+static void property_query_free(OSSL_PROPERTY_QUERY *elem)
+{
+    ossl_property_free(elem->list);
+    OPENSSL_free(elem);
+}
+
+static void property_queries_free(void *vproperty_queries)
+{
+    LHASH_OF(OSSL_PROPERTY_QUERY) *property_queries = vproperty_queries;
+
+    if (property_queries != NULL) {
+        lh_OSSL_PROPERTY_QUERY_doall(property_queries, &property_query_free);
+        lh_OSSL_PROPERTY_QUERY_free(property_queries);
+    }
+}
+
+static void *property_queries_new(OSSL_LIB_CTX *ctx) {
+    return lh_OSSL_PROPERTY_QUERY_new(&property_query_hash,
+                                      &property_query_cmp);
+}
+
+static const OSSL_LIB_CTX_METHOD property_queries_method = {
+    OSSL_LIB_CTX_METHOD_DEFAULT_PRIORITY,
+    property_queries_new,
+    property_queries_free,
+};
+
+static LHASH_OF(OSSL_PROPERTY_QUERY) *prop_queries(OSSL_LIB_CTX *ctx)
+{
+    return ossl_lib_ctx_get_data(ctx, OSSL_LIB_CTX_PROPERTY_QUERY_INDEX,
+                                 &property_queries_method);
+}
+
+static int prop_query_has_unknown(const OSSL_PROPERTY_LIST *list)
+{
+    const OSSL_PROPERTY_DEFINITION *prop;
+    int i;
+
+    for (i = 0; i < list->num_properties; i++) {
+        prop = &list->properties[i];
+        if (prop->name_idx == 0
+                || (prop->type == OSSL_PROPERTY_TYPE_STRING
+                    && prop->v.str_val == 0))
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns the interned form of |query|, or NULL if it isn't interned */
+static const OSSL_PROPERTY_QUERY *prop_query_lookup(OSSL_LIB_CTX *ctx,
+                                                    const char *query)
+{
+    LHASH_OF(OSSL_PROPERTY_QUERY) *property_queries = prop_queries(ctx);
+    OSSL_PROPERTY_QUERY elem, *r;
+
+    if (property_queries == NULL || query == NULL)
+        return NULL;
+
+    elem.query = query;
+    if (ossl_lib_ctx_is_frozen(ctx))
+        return ossl_lh_retrieve_ro((const OPENSSL_LHASH *)property_queries,
+                                   &elem);
+
+    if (!ossl_lib_ctx_read_lock(ctx))
+        return NULL;
+    r = lh_OSSL_PROPERTY_QUERY_retrieve(property_queries, &elem);
+    ossl_lib_ctx_unlock(ctx);
+    return r;
+}
+
+/*
+ * Intern |query| with its parsed form |list|.  Unless |force| is set,
+ * nothing is added once the cache is full.  On success, |list| belongs to
+ * the cache, even if another thread interned the query first.  On failure,
+ * NULL is returned and |list| still belongs to the caller.
+ */
+static const OSSL_PROPERTY_QUERY *prop_query_add(OSSL_LIB_CTX *ctx,
+                                                 const char *query,
+                                                 OSSL_PROPERTY_LIST *list,
+                                                 int force)
+{
+    LHASH_OF(OSSL_PROPERTY_QUERY) *property_queries = prop_queries(ctx);
+    OSSL_PROPERTY_QUERY *r, *p;
+    size_t len;
+
+    if (property_queries == NULL || ossl_lib_ctx_is_frozen(ctx))
+        return NULL;
+
+    len = strlen(query);
+    if ((p = OPENSSL_malloc(sizeof(*p) + len)) == NULL) {
+        ERR_raise(ERR_LIB_PROP, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    p->list = list;
+    p->unknown = prop_query_has_unknown(list);
+    p->query = p->body;
+    memcpy(p->body, query, len + 1);
+
+    if (!ossl_lib_ctx_write_lock(ctx)) {
+        OPENSSL_free(p);
+        return NULL;
+    }
+    /* The context may have been frozen in the meantime */
+    if (ossl_lib_ctx_is_frozen_locked(ctx)) {
+        r = NULL;
+    } else if ((r = lh_OSSL_PROPERTY_QUERY_retrieve(property_queries, p))
+               != NULL) {
+        /* Someone else may have beaten us to it */
+        property_query_free(p);
+    } else if (force
+               || lh_OSSL_PROPERTY_QUERY_num_items(property_queries)
+                  < PROP_QUERY_MAX_INTERNED) {
+        (void)lh_OSSL_PROPERTY_QUERY_insert(property_queries, p);
+        if (!lh_OSSL_PROPERTY_QUERY_error(property_queries))
+            r = p;
+    }
+    ossl_lib_ctx_unlock(ctx);
+    if (r == NULL)
+        OPENSSL_free(p);
+    return r;
+}
+
+/*
+ * Returns the parsed form of |query|.  If it isn't interned, it is also
+ * stored in |*parsed|, which the caller must then free.
+ */
+const OSSL_PROPERTY_LIST *ossl_prop_query_get(OSSL_LIB_CTX *ctx,
+                                              const char *query,
+                                              OSSL_PROPERTY_LIST **parsed)
+{
+    const OSSL_PROPERTY_QUERY *r = prop_query_lookup(ctx, query);
+    OSSL_PROPERTY_LIST *list;
+
+    *parsed = NULL;
+    if (r != NULL && !r->unknown)
+        return r->list;
+
+    if ((list = ossl_parse_query(ctx, query, 0)) == NULL)
+        return NULL;
+    if (r == NULL
+            && !prop_query_has_unknown(list)
+            && (r = prop_query_add(ctx, query, list, 0)) != NULL)
+        return r->list;
+    *parsed = list;
+    return list;
+}
+
+#ifndef FIPS_MODULE
+const OSSL_PROPERTY_QUERY *OSSL_PROPERTY_QUERY_intern(OSSL_LIB_CTX *libctx,
+                                                      const char *propq)
+{
+    const OSSL_PROPERTY_QUERY *r;
+    OSSL_PROPERTY_LIST *list;
+
+    if (propq == NULL) {
+        ERR_raise(ERR_LIB_PROP, ERR_R_PASSED_NULL_PARAMETER);
+        return NULL;
+    }
+    if ((r = prop_query_lookup(libctx, propq)) != NULL)
+        return r;
+    if (ossl_lib_ctx_is_frozen(libctx)) {
+        ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+        return NULL;
+    }
+    if ((list = ossl_parse_query(libctx, propq, 0)) == NULL)
+        return NULL;
+    if ((r = prop_query_add(libctx, propq, list, 1)) == NULL)
+        ossl_property_free(list);
+    return r;
+}
+
+const char *OSSL_PROPERTY_QUERY_get0_string(const OSSL_PROPERTY_QUERY *query)
+{
+    return query != NULL ? query->query : NULL;
+}
+
+/*
+ * Returns the parsed form of |query| for ossl_method_store_fetch_parsed(),
+ * or NULL if it has to be parsed again, from its string, for each use.
+ */
+const OSSL_PROPERTY_LIST *ossl_prop_query_get0_list(const OSSL_PROPERTY_QUERY *query)
+{
+    return query != NULL && !query->unknown ? query->list : NULL;
+}
+#endif
@@ -13,6 +13,7 @@
 #include <openssl/provider.h>
 #include <openssl/core_names.h>
 #include "internal/provider.h"
+#include "internal/core.h"
 #include "provider_local.h"
 
 OSSL_PROVIDER *OSSL_PROVIDER_try_load(OSSL_LIB_CTX *libctx, const char *name,
@@ -59,6 +60,15 @@ OSSL_PROVIDER *OSSL_PROVIDER_load(OSSL_LIB_CTX *libctx, const char *name)
 
 int OSSL_PROVIDER_unload(OSSL_PROVIDER *prov)
 {
+    /*
+     * Providers stay loaded in a frozen library context until it's freed,
+     * so the unloading is deferred until then.  The reference held by the
+     * caller is released as usual.
+     */
+    if (prov != NULL && ossl_lib_ctx_is_frozen(ossl_provider_libctx(prov))) {
+        ossl_provider_free(prov);
+        return 1;
+    }
     if (!ossl_provider_deactivate(prov, 1))
         return 0;
     ossl_provider_free(prov);
@@ -144,6 +144,7 @@ static int provider_conf_load(OSSL_LIB_CTX *libctx, const char *name,
     int soft = 0;
     OSSL_PROVIDER *prov = NULL, *actual = NULL;
     const char *path = NULL;
+    const char *prefetch = NULL;
     long activate = 0;
     int ok = 0;
 
@@ -179,6 +180,9 @@ static int provider_conf_load(OSSL_LIB_CTX *libctx, const char *name,
             path = confvalue;
         else if (strcmp(confname, "activate") == 0)
             activate = 1;
+        /* Algorithms to prefetch once the provider is activated */
+        else if (strcmp(confname, "prefetch") == 0)
+            prefetch = confvalue;
     }
 
     if (activate) {
@@ -246,6 +250,18 @@ static int provider_conf_load(OSSL_LIB_CTX *libctx, const char *name,
                 ossl_provider_free(prov);
         }
         CRYPTO_THREAD_unlock(pcgbl->lock);
+
+        /*
+         * Failure to prefetch isn't fatal either, the algorithms will simply
+         * be fetched when they're first used.
+         */
+        if (ok && prefetch != NULL) {
+            ERR_set_mark();
+            if (!OSSL_LIB_CTX_prefetch(libctx, prefetch, NULL))
+                OSSL_TRACE2(CONF, "Prefetching \"%s\" for provider %s failed\n",
+                            prefetch, name);
+            ERR_pop_to_mark();
+        }
     } else {
         OSSL_PROVIDER_INFO entry;
 
@@ -373,6 +373,11 @@ int ossl_provider_info_add_to_store(OSSL_LIB_CTX *libctx,
         return 0;
     }
 
+    if (ossl_lib_ctx_is_frozen(libctx)) {
+        ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+        return 0;
+    }
+
     if (!CRYPTO_THREAD_write_lock(store->lock))
         return 0;
     if (store->provinfosz == 0) {
@@ -1221,11 +1226,20 @@ static int provider_remove_store_methods(OSSL_PROVIDER *prov)
     return 1;
 }
 
+/* The set of active providers of a frozen library context is fixed */
+static int provider_frozen(const OSSL_PROVIDER *prov)
+{
+    if (!ossl_lib_ctx_is_frozen(prov->libctx))
+        return 0;
+    ERR_raise(ERR_LIB_CRYPTO, CRYPTO_R_LIBRARY_CONTEXT_FROZEN);
+    return 1;
+}
+
 int ossl_provider_activate(OSSL_PROVIDER *prov, int upcalls, int aschild)
 {
     int count;
 
-    if (prov == NULL)
+    if (prov == NULL || provider_frozen(prov))
         return 0;
 #ifndef FIPS_MODULE
     /*
@@ -1246,6 +1260,7 @@ int ossl_provider_deactivate(OSSL_PROVIDER *prov, int removechildren)
     int count;
 
     if (prov == NULL
+            || provider_frozen(prov)
             || (count = provider_deactivate(prov, 1, removechildren)) < 0)
         return 0;
     return count == 0 ? provider_remove_store_methods(prov) : 1;
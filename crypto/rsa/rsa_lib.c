@@ -173,7 +173,9 @@ void RSA_free(RSA *r)
     sk_RSA_PRIME_INFO_pop_free(r->prime_infos, ossl_rsa_multip_info_free);
 #endif
     BN_BLINDING_free(r->blinding);
-    BN_BLINDING_free(r->mt_blinding);
+    while (r->blinding_pool_num > 0)
+        BN_BLINDING_free(r->blinding_pool[--r->blinding_pool_num]);
+    OPENSSL_free(r->blinding_pool);
     OPENSSL_free(r);
 }
 
@@ -94,7 +94,13 @@ struct rsa_st {
     BN_MONT_CTX *_method_mod_p;
     BN_MONT_CTX *_method_mod_q;
     BN_BLINDING *blinding;
-    BN_BLINDING *mt_blinding;
+    /*
+     * Idle blindings for threads other than the one |blinding| belongs to,
+     * see rsa_get_blinding()
+     */
+    BN_BLINDING **blinding_pool;
+    size_t blinding_pool_num;
+    size_t blinding_pool_size;
     CRYPTO_RWLOCK *lock;
 
     int dirty_cnt;
@@ -162,10 +162,23 @@ static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
     return r;
 }
 
-static BN_BLINDING *rsa_get_blinding(RSA *rsa, int *local, BN_CTX *ctx)
+/*
+ * Returns a BN_BLINDING that the calling thread has to itself until it is
+ * handed back with rsa_put_blinding(), so the unblinding factor can always be
+ * kept in the BN_BLINDING and no lock is held while it is used.
+ *
+ * The thread that created rsa->blinding uses that one. Every other thread
+ * takes a blinding out of rsa->blinding_pool, or makes a new one if they are
+ * all in use, in which case *pooled is set and the blinding is added to the
+ * pool when it is handed back. The pool thus grows to the number of threads
+ * that use the key at the same time, and each blinding in it keeps its own
+ * update schedule.
+ */
+static BN_BLINDING *rsa_get_blinding(RSA *rsa, int *pooled, BN_CTX *ctx)
 {
     BN_BLINDING *ret;
 
+    *pooled = 0;
     if (!CRYPTO_THREAD_write_lock(rsa->lock))
         return NULL;
 
@@ -180,92 +193,109 @@ static BN_BLINDING *rsa_get_blinding(RSA *rsa, int *local, BN_CTX *ctx)
     if (BN_BLINDING_is_current_thread(ret)) {
         /* rsa->blinding is ours! */
 
-        *local = 1;
+        *pooled = 0;
     } else {
-        /* resort to rsa->mt_blinding instead */
-
-        /*
-         * instructs rsa_blinding_convert(), rsa_blinding_invert() that the
-         * BN_BLINDING is shared, meaning that accesses require locks, and
-         * that the blinding factor must be stored outside the BN_BLINDING
-         */
-        *local = 0;
-
-        if (rsa->mt_blinding == NULL) {
-            rsa->mt_blinding = RSA_setup_blinding(rsa, ctx);
-        }
-        ret = rsa->mt_blinding;
+        *pooled = 1;
+        ret = NULL;
+        if (rsa->blinding_pool_num > 0)
+            ret = rsa->blinding_pool[--rsa->blinding_pool_num];
     }
 
  err:
     CRYPTO_THREAD_unlock(rsa->lock);
+    if (ret == NULL && *pooled)
+        ret = RSA_setup_blinding(rsa, ctx);
     return ret;
 }
 
-static int rsa_blinding_convert(BN_BLINDING *b, BIGNUM *f, BIGNUM *unblind,
-                                BN_CTX *ctx)
+/*
+ * Hands back a blinding obtained from rsa_get_blinding(). |failed| is set if
+ * blinding or unblinding failed, in which case the blinding may have been left
+ * half updated and is not reused. Operations that fail for any other reason,
+ * such as bad input, leave the blinding fit for reuse.
+ */
+static void rsa_put_blinding(RSA *rsa, BN_BLINDING *b, int pooled, int failed)
 {
-    if (unblind == NULL) {
-        /*
-         * Local blinding: store the unblinding factor in BN_BLINDING.
-         */
-        return BN_BLINDING_convert_ex(f, NULL, b, ctx);
-    } else {
-        /*
-         * Shared blinding: store the unblinding factor outside BN_BLINDING.
-         */
-        int ret;
-
-        if (!BN_BLINDING_lock(b))
-            return 0;
-
-        ret = BN_BLINDING_convert_ex(f, unblind, b, ctx);
-        BN_BLINDING_unlock(b);
-
-        return ret;
+    BN_BLINDING **pool;
+    size_t size;
+
+    if (b == NULL || !pooled)
+        return;
+
+    if (!failed && CRYPTO_THREAD_write_lock(rsa->lock)) {
+        if (rsa->blinding_pool_num == rsa->blinding_pool_size) {
+            size = rsa->blinding_pool_size == 0 ? 4
+                                                : rsa->blinding_pool_size * 2;
+            pool = OPENSSL_realloc(rsa->blinding_pool, size * sizeof(*pool));
+            if (pool != NULL) {
+                rsa->blinding_pool = pool;
+                rsa->blinding_pool_size = size;
+            }
+        }
+        if (rsa->blinding_pool_num < rsa->blinding_pool_size) {
+            rsa->blinding_pool[rsa->blinding_pool_num++] = b;
+            b = NULL;
+        }
+        CRYPTO_THREAD_unlock(rsa->lock);
     }
+    BN_BLINDING_free(b);
 }
 
-static int rsa_blinding_invert(BN_BLINDING *b, BIGNUM *f, BIGNUM *unblind,
-                               BN_CTX *ctx)
+static int rsa_blinding_convert(BN_BLINDING *b, BIGNUM *f, BN_CTX *ctx)
+{
+    /* The unblinding factor is stored in BN_BLINDING */
+    return BN_BLINDING_convert_ex(f, NULL, b, ctx);
+}
+
+static int rsa_blinding_invert(BN_BLINDING *b, BIGNUM *f, BN_CTX *ctx)
 {
-    /*
-     * For local blinding, unblind is set to NULL, and BN_BLINDING_invert_ex
-     * will use the unblinding factor stored in BN_BLINDING. If BN_BLINDING
-     * is shared between threads, unblind must be non-null:
-     * BN_BLINDING_invert_ex will then use the local unblinding factor, and
-     * will only read the modulus from BN_BLINDING. In both cases it's safe
-     * to access the blinding without a lock.
-     */
     BN_set_flags(f, BN_FLG_CONSTTIME);
-    return BN_BLINDING_invert_ex(f, unblind, b, ctx);
+    return BN_BLINDING_invert_ex(f, NULL, b, ctx);
 }
 
-/* signing */
-static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
-                                   unsigned char *to, RSA *rsa, int padding)
+/*
+ * Takes what a private key operation needs from |rsa| that can be shared
+ * between several operations: the Montgomery context for the modulus and a
+ * blinding, which is to be handed back with rsa_put_blinding().
+ */
+static int rsa_private_setup(RSA *rsa, BN_CTX *ctx, BN_BLINDING **blinding,
+                             int *pooled)
+{
+    *blinding = NULL;
+    *pooled = 0;
+
+    if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
+        if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock,
+                                    rsa->n, ctx))
+            return 0;
+
+    if (!(rsa->flags & RSA_FLAG_NO_BLINDING)) {
+        *blinding = rsa_get_blinding(rsa, pooled, ctx);
+        if (*blinding == NULL) {
+            ERR_raise(ERR_LIB_RSA, ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Signs one input after rsa_private_setup(). |buf| is scratch space of
+ * RSA_size(rsa) bytes. |*blinding_failed| is set if blinding or unblinding
+ * failed.
+ */
+static int rsa_private_encrypt_int(int flen, const unsigned char *from,
+                                   unsigned char *to, RSA *rsa, int padding,
+                                   BN_BLINDING *blinding, unsigned char *buf,
+                                   BN_CTX *ctx, int *blinding_failed)
 {
     BIGNUM *f, *ret, *res;
-    int i, num = 0, r = -1;
-    unsigned char *buf = NULL;
-    BN_CTX *ctx = NULL;
-    int local_blinding = 0;
-    /*
-     * Used only if the blinding structure is shared. A non-NULL unblind
-     * instructs rsa_blinding_convert() and rsa_blinding_invert() to store
-     * the unblinding factor outside the blinding structure.
-     */
-    BIGNUM *unblind = NULL;
-    BN_BLINDING *blinding = NULL;
+    int i, num = BN_num_bytes(rsa->n), r = -1;
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
-        goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
     ret = BN_CTX_get(ctx);
-    num = BN_num_bytes(rsa->n);
-    buf = OPENSSL_malloc(num);
-    if (ret == NULL || buf == NULL) {
+    if (ret == NULL) {
         ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
         goto err;
     }
@@ -296,26 +326,9 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
         goto err;
     }
 
-    if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-        if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock,
-                                    rsa->n, ctx))
-            goto err;
-
-    if (!(rsa->flags & RSA_FLAG_NO_BLINDING)) {
-        blinding = rsa_get_blinding(rsa, &local_blinding, ctx);
-        if (blinding == NULL) {
-            ERR_raise(ERR_LIB_RSA, ERR_R_INTERNAL_ERROR);
-            goto err;
-        }
-    }
-
-    if (blinding != NULL) {
-        if (!local_blinding && ((unblind = BN_CTX_get(ctx)) == NULL)) {
-            ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
-            goto err;
-        }
-        if (!rsa_blinding_convert(blinding, f, unblind, ctx))
-            goto err;
+    if (blinding != NULL && !rsa_blinding_convert(blinding, f, ctx)) {
+        *blinding_failed = 1;
+        goto err;
     }
 
     if ((rsa->flags & RSA_FLAG_EXT_PKEY) ||
@@ -347,9 +360,10 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
         BN_free(d);
     }
 
-    if (blinding)
-        if (!rsa_blinding_invert(blinding, ret, unblind, ctx))
-            goto err;
+    if (blinding != NULL && !rsa_blinding_invert(blinding, ret, ctx)) {
+        *blinding_failed = 1;
+        goto err;
+    }
 
     if (padding == RSA_X931_PADDING) {
         if (!BN_sub(f, rsa->n, ret))
@@ -369,31 +383,117 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
     r = BN_bn2binpad(res, to, num);
  err:
     BN_CTX_end(ctx);
+    return r;
+}
+
+/* signing */
+static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
+                                   unsigned char *to, RSA *rsa, int padding)
+{
+    int num = 0, r = -1;
+    unsigned char *buf = NULL;
+    BN_CTX *ctx = NULL;
+    int pooled_blinding = 0, blinding_failed = 0;
+    BN_BLINDING *blinding = NULL;
+
+    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+        goto err;
+    num = BN_num_bytes(rsa->n);
+    buf = OPENSSL_malloc(num);
+    if (buf == NULL) {
+        ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!rsa_private_setup(rsa, ctx, &blinding, &pooled_blinding))
+        goto err;
+
+    r = rsa_private_encrypt_int(flen, from, to, rsa, padding, blinding, buf,
+                                ctx, &blinding_failed);
+ err:
+    rsa_put_blinding(rsa, blinding, pooled_blinding, blinding_failed);
     BN_CTX_free(ctx);
     OPENSSL_clear_free(buf, num);
     return r;
 }
 
-static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
-                                   unsigned char *to, RSA *rsa, int padding)
+/*
+ * Signs |num| inputs with the same key and padding, as RSA_private_encrypt()
+ * would. Every to[i] must have room for RSA_size(rsa) bytes, which is the
+ * length of every signature.
+ *
+ * The BN_CTX, the Montgomery contexts and the blinding are set up once for
+ * all of the operations rather than once for each. With an RSA_METHOD other
+ * than the built-in one, the operations are simply done one at a time.
+ */
+int ossl_rsa_private_encrypt_batch(RSA *rsa, size_t num,
+                                   const unsigned char *const from[],
+                                   const size_t flen[],
+                                   unsigned char *const to[], int padding)
 {
-    BIGNUM *f, *ret;
-    int j, num = 0, r = -1;
+    int rsasize = RSA_size(rsa), ok = 0;
     unsigned char *buf = NULL;
+    BN_CTX *ctx = NULL;
+    int pooled_blinding = 0, blinding_failed = 0;
+    BN_BLINDING *blinding = NULL;
+    size_t i;
+
+    for (i = 0; i < num; i++) {
+        if (flen[i] > (size_t)rsasize) {
+            ERR_raise(ERR_LIB_RSA, RSA_R_DATA_TOO_LARGE_FOR_KEY_SIZE);
+            return 0;
+        }
+    }
+
+    if (rsa->meth->rsa_priv_enc != rsa_ossl_private_encrypt) {
+        for (i = 0; i < num; i++)
+            if (RSA_private_encrypt((int)flen[i], from[i], to[i], rsa,
+                                    padding) <= 0)
+                return 0;
+        return 1;
+    }
+
+    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+        goto err;
+    buf = OPENSSL_malloc(rsasize);
+    if (buf == NULL) {
+        ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!rsa_private_setup(rsa, ctx, &blinding, &pooled_blinding))
+        goto err;
+
+    for (i = 0; i < num; i++)
+        if (rsa_private_encrypt_int((int)flen[i], from[i], to[i], rsa,
+                                    padding, blinding, buf, ctx,
+                                    &blinding_failed) <= 0)
+            goto err;
+    ok = 1;
+ err:
+    rsa_put_blinding(rsa, blinding, pooled_blinding, blinding_failed);
+    BN_CTX_free(ctx);
+    OPENSSL_clear_free(buf, rsasize);
+    return ok;
+}
+
+/*
+ * Decrypts one input after rsa_private_setup(). |buf| is scratch space of
+ * RSA_size(rsa) bytes. |*blinding_failed| is set if blinding or unblinding
+ * failed.
+ */
+static int rsa_private_decrypt_int(int flen, const unsigned char *from,
+                                   unsigned char *to, RSA *rsa, int padding,
+                                   BN_BLINDING *blinding, unsigned char *buf,
+                                   BN_CTX *ctx, int *blinding_failed)
+{
+    BIGNUM *f, *ret;
+    int j, num = BN_num_bytes(rsa->n), r = -1;
     unsigned char d_hash[SHA256_DIGEST_LENGTH] = {0};
     HMAC_CTX *hmac = NULL;
     unsigned int md_len = SHA256_DIGEST_LENGTH;
     unsigned char kdk[SHA256_DIGEST_LENGTH] = {0};
-    BN_CTX *ctx = NULL;
-    int local_blinding = 0;
     EVP_MD *md = NULL;
-    /*
-     * Used only if the blinding structure is shared. A non-NULL unblind
-     * instructs rsa_blinding_convert() and rsa_blinding_invert() to store
-     * the unblinding factor outside the blinding structure.
-     */
-    BIGNUM *unblind = NULL;
-    BN_BLINDING *blinding = NULL;
 
     /*
      * we need the value of the private exponent to perform implicit rejection
@@ -401,14 +501,10 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
     if ((rsa->flags & RSA_FLAG_EXT_PKEY) && (padding == RSA_PKCS1_PADDING))
         padding = RSA_PKCS1_NO_IMPLICIT_REJECT_PADDING;
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
-        goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
     ret = BN_CTX_get(ctx);
-    num = BN_num_bytes(rsa->n);
-    buf = OPENSSL_malloc(num);
-    if (ret == NULL || buf == NULL) {
+    if (ret == NULL) {
         ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
         goto err;
     }
@@ -436,26 +532,9 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
         goto err;
     }
 
-    if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-        if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock,
-                                    rsa->n, ctx))
-            goto err;
-
-    if (!(rsa->flags & RSA_FLAG_NO_BLINDING)) {
-        blinding = rsa_get_blinding(rsa, &local_blinding, ctx);
-        if (blinding == NULL) {
-            ERR_raise(ERR_LIB_RSA, ERR_R_INTERNAL_ERROR);
-            goto err;
-        }
-    }
-
-    if (blinding != NULL) {
-        if (!local_blinding && ((unblind = BN_CTX_get(ctx)) == NULL)) {
-            ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
-            goto err;
-        }
-        if (!rsa_blinding_convert(blinding, f, unblind, ctx))
-            goto err;
+    if (blinding != NULL && !rsa_blinding_convert(blinding, f, ctx)) {
+        *blinding_failed = 1;
+        goto err;
     }
 
     /* do the decrypt */
@@ -562,9 +641,10 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
         }
     }
 
-    if (blinding)
-        if (!rsa_blinding_invert(blinding, ret, unblind, ctx))
-            goto err;
+    if (blinding != NULL && !rsa_blinding_invert(blinding, ret, ctx)) {
+        *blinding_failed = 1;
+        goto err;
+    }
 
     j = BN_bn2binpad(ret, buf, num);
     if (j < 0)
@@ -601,11 +681,106 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
     HMAC_CTX_free(hmac);
     EVP_MD_free(md);
     BN_CTX_end(ctx);
+    return r;
+}
+
+static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
+                                   unsigned char *to, RSA *rsa, int padding)
+{
+    int num = 0, r = -1;
+    unsigned char *buf = NULL;
+    BN_CTX *ctx = NULL;
+    int pooled_blinding = 0, blinding_failed = 0;
+    BN_BLINDING *blinding = NULL;
+
+    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+        goto err;
+    num = BN_num_bytes(rsa->n);
+    buf = OPENSSL_malloc(num);
+    if (buf == NULL) {
+        ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!rsa_private_setup(rsa, ctx, &blinding, &pooled_blinding))
+        goto err;
+
+    r = rsa_private_decrypt_int(flen, from, to, rsa, padding, blinding, buf,
+                                ctx, &blinding_failed);
+ err:
+    rsa_put_blinding(rsa, blinding, pooled_blinding, blinding_failed);
     BN_CTX_free(ctx);
     OPENSSL_clear_free(buf, num);
     return r;
 }
 
+/*
+ * Decrypts |num| inputs with the same key and padding, as
+ * RSA_private_decrypt() would, setting tolen[i] to the length of each
+ * plaintext. Every to[i] must have room for RSA_size(rsa) bytes. Fails as a
+ * whole if any of the operations fails.
+ *
+ * As with ossl_rsa_private_encrypt_batch(), the BN_CTX, the Montgomery
+ * contexts and the blinding are set up once for all of the operations.
+ */
+int ossl_rsa_private_decrypt_batch(RSA *rsa, size_t num,
+                                   const unsigned char *const from[],
+                                   const size_t flen[],
+                                   unsigned char *const to[], size_t tolen[],
+                                   int padding)
+{
+    int rsasize = RSA_size(rsa), r, ok = 0;
+    unsigned char *buf = NULL;
+    BN_CTX *ctx = NULL;
+    int pooled_blinding = 0, blinding_failed = 0;
+    BN_BLINDING *blinding = NULL;
+    size_t i;
+
+    for (i = 0; i < num; i++) {
+        if (flen[i] > (size_t)rsasize) {
+            ERR_raise(ERR_LIB_RSA, RSA_R_DATA_GREATER_THAN_MOD_LEN);
+            return 0;
+        }
+    }
+
+    if (rsa->meth->rsa_priv_dec != rsa_ossl_private_decrypt) {
+        for (i = 0; i < num; i++) {
+            r = RSA_private_decrypt((int)flen[i], from[i], to[i], rsa,
+                                    padding);
+            if (r < 0)
+                return 0;
+            tolen[i] = r;
+        }
+        return 1;
+    }
+
+    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+        goto err;
+    buf = OPENSSL_malloc(rsasize);
+    if (buf == NULL) {
+        ERR_raise(ERR_LIB_RSA, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!rsa_private_setup(rsa, ctx, &blinding, &pooled_blinding))
+        goto err;
+
+    for (i = 0; i < num; i++) {
+        r = rsa_private_decrypt_int((int)flen[i], from[i], to[i], rsa,
+                                    padding, blinding, buf, ctx,
+                                    &blinding_failed);
+        if (r < 0)
+            goto err;
+        tolen[i] = r;
+    }
+    ok = 1;
+ err:
+    rsa_put_blinding(rsa, blinding, pooled_blinding, blinding_failed);
+    BN_CTX_free(ctx);
+    OPENSSL_clear_free(buf, rsasize);
+    return ok;
+}
+
 /* signature verification */
 static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
                                   unsigned char *to, RSA *rsa, int padding)
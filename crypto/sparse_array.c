@@ -78,9 +78,16 @@ static void sa_doall(const OPENSSL_SA *sa, void (*node)(void **),
     i[0] = 0;
     nodes[0] = sa->nodes;
     while (l >= 0) {
-        const int n = i[l];
+        int n = i[l];
         void ** const p = nodes[l];
 
+        /* Most slots are empty, skip over them in one go */
+        if (p == NULL)
+            n = SA_BLOCK_MAX;
+        else
+            while (n < SA_BLOCK_MAX && p[n] == NULL)
+                n++;
+
         if (n >= SA_BLOCK_MAX) {
             if (p != NULL && node != NULL)
                 (*node)(p);
@@ -88,15 +95,13 @@ static void sa_doall(const OPENSSL_SA *sa, void (*node)(void **),
             idx >>= OPENSSL_SA_BLOCK_BITS;
         } else {
             i[l] = n + 1;
-            if (p != NULL && p[n] != NULL) {
-                idx = (idx & ~SA_BLOCK_MASK) | n;
-                if (l < sa->levels - 1) {
-                    i[++l] = 0;
-                    nodes[l] = p[n];
-                    idx <<= OPENSSL_SA_BLOCK_BITS;
-                } else if (leaf != NULL) {
-                    (*leaf)(idx, p[n], arg);
-                }
+            idx = (idx & ~SA_BLOCK_MASK) | n;
+            if (l < sa->levels - 1) {
+                i[++l] = 0;
+                nodes[l] = p[n];
+                idx <<= OPENSSL_SA_BLOCK_BITS;
+            } else if (leaf != NULL) {
+                (*leaf)(idx, p[n], arg);
             }
         }
     }
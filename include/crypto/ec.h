@@ -50,6 +50,15 @@ int evp_pkey_ctx_set_ec_param_enc_prov(EVP_PKEY_CTX *ctx, int param_enc);
 __owur int ossl_ec_group_do_inverse_ord(const EC_GROUP *group, BIGNUM *res,
                                         const BIGNUM *x, BN_CTX *ctx);
 
+/* Number of ECDSA signatures verified together */
+#  define ECDSA_BATCH_MAX 32
+
+int ossl_ecdsa_verify_batch(size_t num, const unsigned char *const dgst[],
+                            const size_t dgst_len[],
+                            const unsigned char *const sigbuf[],
+                            const size_t sig_len[], EC_KEY *const eckey[],
+                            int results[]);
+
 /*-
  * ECDH Key Derivation Function as defined in ANSI X9.63
  */
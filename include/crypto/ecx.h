@@ -30,6 +30,9 @@
 
 #  define MAX_KEYLEN  ED448_KEYLEN
 
+/* Number of X25519/X448 operations sharing one field inversion */
+#  define ECX_BATCH_MAX 16
+
 #  define X25519_BITS           253
 #  define X25519_SECURITY_BITS  128
 
@@ -88,6 +91,12 @@ int ossl_x25519(uint8_t out_shared_key[32], const uint8_t private_key[32],
                 const uint8_t peer_public_value[32]);
 void ossl_x25519_public_from_private(uint8_t out_public_value[32],
                                      const uint8_t private_key[32]);
+int ossl_x25519_batch(size_t num, uint8_t *const out_shared_key[],
+                      const uint8_t *const private_key[],
+                      const uint8_t *const peer_public_value[]);
+void ossl_x25519_public_from_private_batch(size_t num,
+                                           uint8_t *const out_public_value[],
+                                           const uint8_t *const private_key[]);
 
 int
 ossl_ed25519_public_from_private(OSSL_LIB_CTX *ctx, uint8_t out_public_key[32],
@@ -122,6 +131,14 @@ ossl_x448(uint8_t out_shared_key[56], const uint8_t private_key[56],
 void
 ossl_x448_public_from_private(uint8_t out_public_value[56],
                               const uint8_t private_key[56]);
+int
+ossl_x448_batch(size_t num, uint8_t *const out_shared_key[],
+                const uint8_t *const private_key[],
+                const uint8_t *const peer_public_value[]);
+void
+ossl_x448_public_from_private_batch(size_t num,
+                                    uint8_t *const out_public_value[],
+                                    const uint8_t *const private_key[]);
 
 
 /* Backend support */
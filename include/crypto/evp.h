@@ -746,6 +746,7 @@ struct evp_pkey_st {
 void openssl_add_all_ciphers_int(void);
 void openssl_add_all_digests_int(void);
 void evp_cleanup_int(void);
+void evp_fetch_cache_cleanup_int(void);
 void evp_app_cleanup_int(void);
 void *evp_pkey_export_to_provider(EVP_PKEY *pk, OSSL_LIB_CTX *libctx,
                                   EVP_KEYMGMT **keymgmt,
@@ -815,6 +816,10 @@ int evp_keymgmt_gen_set_params(const EVP_KEYMGMT *keymgmt, void *genctx,
                                const OSSL_PARAM params[]);
 void *evp_keymgmt_gen(const EVP_KEYMGMT *keymgmt, void *genctx,
                       OSSL_CALLBACK *cb, void *cbarg);
+int evp_keymgmt_has_gen_batch(const EVP_KEYMGMT *keymgmt);
+int evp_keymgmt_gen_batch(const EVP_KEYMGMT *keymgmt, void *genctx,
+                          size_t num, void *keydata[],
+                          OSSL_CALLBACK *cb, void *cbarg);
 void evp_keymgmt_gen_cleanup(const EVP_KEYMGMT *keymgmt, void *genctx);
 
 int evp_keymgmt_has_load(const EVP_KEYMGMT *keymgmt);
@@ -11,6 +11,9 @@
 # define OSSL_CRYPTO_LHASH_H
 # pragma once
 
+# include <openssl/lhash.h>
+
 unsigned long ossl_lh_strcasehash(const char *);
+void *ossl_lh_retrieve_ro(const OPENSSL_LHASH *lh, const void *data);
 
 #endif  /* OSSL_CRYPTO_LHASH_H */
@@ -62,4 +62,10 @@ __owur int ossl_lib_ctx_write_lock(OSSL_LIB_CTX *ctx);
 __owur int ossl_lib_ctx_read_lock(OSSL_LIB_CTX *ctx);
 int ossl_lib_ctx_unlock(OSSL_LIB_CTX *ctx);
 int ossl_lib_ctx_is_child(OSSL_LIB_CTX *ctx);
+int ossl_lib_ctx_is_frozen(OSSL_LIB_CTX *ctx);
+int ossl_lib_ctx_is_frozen_locked(OSSL_LIB_CTX *ctx);
+void ossl_lib_ctx_set_thread_fetch_cache(OSSL_LIB_CTX *ctx, int enable);
+int ossl_lib_ctx_thread_fetch_cache(OSSL_LIB_CTX *ctx);
+size_t ossl_lib_ctx_fetch_generation(OSSL_LIB_CTX *ctx);
+void ossl_lib_ctx_new_fetch_generation(OSSL_LIB_CTX *ctx);
 #endif
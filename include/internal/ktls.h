@@ -197,6 +197,14 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
     return sbytes;
 }
 
+/* There is no splice() system call on FreeBSD */
+static ossl_inline ossl_ssize_t ktls_splice(int in, int out, size_t size,
+                                            int flags)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
 #  endif                         /* __FreeBSD__ */
 
 #  if defined(OPENSSL_SYS_LINUX)
@@ -213,6 +221,8 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
 #   if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
 #    define OPENSSL_KTLS_AES_GCM_256
 #    define OPENSSL_KTLS_TLS13
+/* Only used with SSL_OP_ENABLE_KTLS_TLS13_RX */
+#    define OPENSSL_KTLS_TLS13_RX
 #    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
 #     define OPENSSL_KTLS_AES_CCM_128
 #     if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
@@ -224,6 +234,8 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
 #   endif
 
 #   include <sys/sendfile.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
 #   include <netinet/tcp.h>
 #   include <linux/socket.h>
 #   include <openssl/ssl3.h>
@@ -334,6 +346,20 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
     return sendfile(s, fd, &off, size);
 }
 
+/*
+ * Move up to |size| bytes from |in| to |out| inside the kernel. One of the two
+ * must be a pipe. From a socket with KTLS receive only decrypted application
+ * data is moved, and the call fails with EINVAL while the next record is of
+ * any other type. splice() is called directly as its declaration needs
+ * _GNU_SOURCE.
+ */
+static ossl_inline ossl_ssize_t ktls_splice(int in, int out, size_t size,
+                                            int flags)
+{
+    return syscall(__NR_splice, in, NULL, out, NULL, size,
+                   (unsigned int)flags);
+}
+
 #   ifdef OPENSSL_NO_KTLS_RX
 
 
@@ -400,5 +426,22 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
 #   endif /* OPENSSL_NO_KTLS_RX */
 
 #  endif /* OPENSSL_SYS_LINUX */
+
+/*
+ * Send application data from |iovcnt| buffers with a single system call. The
+ * kernel splits the data into records.  This is the same on FreeBSD and
+ * Linux.
+ */
+static ossl_inline ossl_ssize_t ktls_sendv(int fd, const struct iovec *iov,
+                                           int iovcnt)
+{
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    return sendmsg(fd, &msg, 0);
+}
 # endif /* OPENSSL_NO_KTLS */
 #endif /* HEADER_INTERNAL_KTLS */
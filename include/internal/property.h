@@ -52,6 +52,7 @@ int64_t ossl_property_get_number_value(const OSSL_PROPERTY_DEFINITION *prop);
 /* Implementation store functions */
 OSSL_METHOD_STORE *ossl_method_store_new(OSSL_LIB_CTX *ctx);
 void ossl_method_store_free(OSSL_METHOD_STORE *store);
+int ossl_method_store_freeze(OSSL_METHOD_STORE *store);
 int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
                           int nid, const char *properties, void *method,
                           int (*method_up_ref)(void *),
@@ -64,6 +65,9 @@ void ossl_method_store_do_all(OSSL_METHOD_STORE *store,
 int ossl_method_store_fetch(OSSL_METHOD_STORE *store,
                             int nid, const char *prop_query,
                             const OSSL_PROVIDER **prov, void **method);
+int ossl_method_store_fetch_parsed(OSSL_METHOD_STORE *store, int nid,
+                                   const OSSL_PROPERTY_LIST *prop_query,
+                                   const OSSL_PROVIDER **prov, void **method);
 int ossl_method_store_remove_all_provided(OSSL_METHOD_STORE *store,
                                           const OSSL_PROVIDER *prov);
 
@@ -81,6 +85,15 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, OSSL_PROVIDER *prov,
 
 __owur int ossl_method_store_cache_flush_all(OSSL_METHOD_STORE *store);
 
+/* property query cache configuration and statistics, per library context */
+int ossl_method_cache_set_size(OSSL_LIB_CTX *libctx, size_t size);
+size_t ossl_method_cache_get_size(OSSL_LIB_CTX *libctx);
+int ossl_method_cache_get_stats(OSSL_LIB_CTX *libctx, uint64_t *hits,
+                                uint64_t *misses, uint64_t *evictions);
+
+/* Interned property queries, see OSSL_PROPERTY_QUERY_intern(3) */
+const OSSL_PROPERTY_LIST *ossl_prop_query_get0_list(const OSSL_PROPERTY_QUERY *query);
+
 /* Merge two property queries together */
 OSSL_PROPERTY_LIST *ossl_property_merge(const OSSL_PROPERTY_LIST *a,
                                         const OSSL_PROPERTY_LIST *b);
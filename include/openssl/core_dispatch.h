@@ -579,6 +579,10 @@ OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *,
 OSSL_CORE_MAKE_FUNC(void *, keymgmt_gen,
                     (void *genctx, OSSL_CALLBACK *cb, void *cbarg))
 OSSL_CORE_MAKE_FUNC(void, keymgmt_gen_cleanup, (void *genctx))
+# define OSSL_FUNC_KEYMGMT_GEN_BATCH                   9
+OSSL_CORE_MAKE_FUNC(int, keymgmt_gen_batch,
+                    (void *genctx, size_t num, void *keydata[],
+                     OSSL_CALLBACK *cb, void *cbarg))
 
 /* Key loading by object reference */
 # define OSSL_FUNC_KEYMGMT_LOAD                        8
@@ -656,12 +660,16 @@ OSSL_CORE_MAKE_FUNC(void *, keymgmt_dup,
 # define OSSL_FUNC_KEYEXCH_SETTABLE_CTX_PARAMS         8
 # define OSSL_FUNC_KEYEXCH_GET_CTX_PARAMS              9
 # define OSSL_FUNC_KEYEXCH_GETTABLE_CTX_PARAMS        10
+# define OSSL_FUNC_KEYEXCH_DERIVE_BATCH               11
 
 OSSL_CORE_MAKE_FUNC(void *, keyexch_newctx, (void *provctx))
 OSSL_CORE_MAKE_FUNC(int, keyexch_init, (void *ctx, void *provkey,
                                         const OSSL_PARAM params[]))
 OSSL_CORE_MAKE_FUNC(int, keyexch_derive, (void *ctx,  unsigned char *secret,
                                              size_t *secretlen, size_t outlen))
+OSSL_CORE_MAKE_FUNC(int, keyexch_derive_batch,
+                    (void *const ctx[], size_t num,
+                     unsigned char *const secret[], size_t secretlen[]))
 OSSL_CORE_MAKE_FUNC(int, keyexch_set_peer, (void *ctx, void *provkey))
 OSSL_CORE_MAKE_FUNC(void, keyexch_freectx, (void *ctx))
 OSSL_CORE_MAKE_FUNC(void *, keyexch_dupctx, (void *ctx))
@@ -701,6 +709,8 @@ OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *, keyexch_gettable_ctx_params,
 # define OSSL_FUNC_SIGNATURE_GETTABLE_CTX_MD_PARAMS 23
 # define OSSL_FUNC_SIGNATURE_SET_CTX_MD_PARAMS      24
 # define OSSL_FUNC_SIGNATURE_SETTABLE_CTX_MD_PARAMS 25
+# define OSSL_FUNC_SIGNATURE_SIGN_BATCH             26
+# define OSSL_FUNC_SIGNATURE_VERIFY_BATCH           27
 
 OSSL_CORE_MAKE_FUNC(void *, signature_newctx, (void *provctx,
                                                   const char *propq))
@@ -710,6 +720,10 @@ OSSL_CORE_MAKE_FUNC(int, signature_sign, (void *ctx,  unsigned char *sig,
                                              size_t *siglen, size_t sigsize,
                                              const unsigned char *tbs,
                                              size_t tbslen))
+OSSL_CORE_MAKE_FUNC(int, signature_sign_batch,
+                    (void *ctx, size_t num, unsigned char *const sig[],
+                     size_t siglen[], const unsigned char *const tbs[],
+                     const size_t tbslen[]))
 OSSL_CORE_MAKE_FUNC(int, signature_verify_init, (void *ctx, void *provkey,
                                                  const OSSL_PARAM params[]))
 OSSL_CORE_MAKE_FUNC(int, signature_verify, (void *ctx,
@@ -717,6 +731,11 @@ OSSL_CORE_MAKE_FUNC(int, signature_verify, (void *ctx,
                                                size_t siglen,
                                                const unsigned char *tbs,
                                                size_t tbslen))
+OSSL_CORE_MAKE_FUNC(int, signature_verify_batch,
+                    (void *const ctx[], size_t num,
+                     const unsigned char *const sig[], const size_t siglen[],
+                     const unsigned char *const tbs[], const size_t tbslen[],
+                     int results[]))
 OSSL_CORE_MAKE_FUNC(int, signature_verify_recover_init,
                     (void *ctx, void *provkey, const OSSL_PARAM params[]))
 OSSL_CORE_MAKE_FUNC(int, signature_verify_recover,
@@ -776,6 +795,7 @@ OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *, signature_settable_ctx_md_params,
 # define OSSL_FUNC_ASYM_CIPHER_GETTABLE_CTX_PARAMS     9
 # define OSSL_FUNC_ASYM_CIPHER_SET_CTX_PARAMS         10
 # define OSSL_FUNC_ASYM_CIPHER_SETTABLE_CTX_PARAMS    11
+# define OSSL_FUNC_ASYM_CIPHER_DECRYPT_BATCH          12
 
 OSSL_CORE_MAKE_FUNC(void *, asym_cipher_newctx, (void *provctx))
 OSSL_CORE_MAKE_FUNC(int, asym_cipher_encrypt_init, (void *ctx, void *provkey,
@@ -792,6 +812,10 @@ OSSL_CORE_MAKE_FUNC(int, asym_cipher_decrypt, (void *ctx, unsigned char *out,
                                                   size_t outsize,
                                                   const unsigned char *in,
                                                   size_t inlen))
+OSSL_CORE_MAKE_FUNC(int, asym_cipher_decrypt_batch,
+                    (void *ctx, size_t num, unsigned char *const out[],
+                     size_t outlen[], const unsigned char *const in[],
+                     const size_t inlen[]))
 OSSL_CORE_MAKE_FUNC(void, asym_cipher_freectx, (void *ctx))
 OSSL_CORE_MAKE_FUNC(void *, asym_cipher_dupctx, (void *ctx))
 OSSL_CORE_MAKE_FUNC(int, asym_cipher_get_ctx_params,
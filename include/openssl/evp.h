@@ -97,6 +97,8 @@ extern "C" {
 int EVP_set_default_properties(OSSL_LIB_CTX *libctx, const char *propq);
 int EVP_default_properties_is_fips_enabled(OSSL_LIB_CTX *libctx);
 int EVP_default_properties_enable_fips(OSSL_LIB_CTX *libctx, int enable);
+int EVP_thread_fetch_cache_enable(OSSL_LIB_CTX *libctx, int enable);
+int EVP_thread_fetch_cache_is_enabled(OSSL_LIB_CTX *libctx);
 
 # define EVP_PKEY_MO_SIGN        0x0001
 # define EVP_PKEY_MO_VERIFY      0x0002
@@ -602,6 +604,9 @@ int EVP_CIPHER_get_type(const EVP_CIPHER *cipher);
 # define EVP_CIPHER_type EVP_CIPHER_get_type
 EVP_CIPHER *EVP_CIPHER_fetch(OSSL_LIB_CTX *ctx, const char *algorithm,
                              const char *properties);
+EVP_CIPHER *EVP_CIPHER_fetch_with_query(OSSL_LIB_CTX *ctx,
+                                        const char *algorithm,
+                                        const OSSL_PROPERTY_QUERY *query);
 int EVP_CIPHER_up_ref(EVP_CIPHER *cipher);
 void EVP_CIPHER_free(EVP_CIPHER *cipher);
 
@@ -727,6 +732,8 @@ __owur int EVP_DigestFinalXOF(EVP_MD_CTX *ctx, unsigned char *md,
 
 __owur EVP_MD *EVP_MD_fetch(OSSL_LIB_CTX *ctx, const char *algorithm,
                             const char *properties);
+__owur EVP_MD *EVP_MD_fetch_with_query(OSSL_LIB_CTX *ctx, const char *algorithm,
+                                       const OSSL_PROPERTY_QUERY *query);
 
 int EVP_MD_up_ref(EVP_MD *md);
 void EVP_MD_free(EVP_MD *md);
@@ -1195,6 +1202,8 @@ void EVP_MD_do_all_provided(OSSL_LIB_CTX *libctx,
 
 EVP_MAC *EVP_MAC_fetch(OSSL_LIB_CTX *libctx, const char *algorithm,
                        const char *properties);
+EVP_MAC *EVP_MAC_fetch_with_query(OSSL_LIB_CTX *libctx, const char *algorithm,
+                                  const OSSL_PROPERTY_QUERY *query);
 int EVP_MAC_up_ref(EVP_MAC *mac);
 void EVP_MAC_free(EVP_MAC *mac);
 const char *EVP_MAC_get0_name(const EVP_MAC *mac);
@@ -1892,11 +1901,20 @@ int EVP_PKEY_sign_init_ex(EVP_PKEY_CTX *ctx, const OSSL_PARAM params[]);
 int EVP_PKEY_sign(EVP_PKEY_CTX *ctx,
                   unsigned char *sig, size_t *siglen,
                   const unsigned char *tbs, size_t tbslen);
+int EVP_PKEY_sign_batch(EVP_PKEY_CTX *ctx, size_t num,
+                        unsigned char *const sig[], size_t siglen[],
+                        const unsigned char *const tbs[],
+                        const size_t tbslen[]);
 int EVP_PKEY_verify_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_verify_init_ex(EVP_PKEY_CTX *ctx, const OSSL_PARAM params[]);
 int EVP_PKEY_verify(EVP_PKEY_CTX *ctx,
                     const unsigned char *sig, size_t siglen,
                     const unsigned char *tbs, size_t tbslen);
+int EVP_PKEY_verify_batch(EVP_PKEY_CTX *const ctx[], size_t num,
+                          const unsigned char *const sig[],
+                          const size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[], int results[]);
 int EVP_PKEY_verify_recover_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_verify_recover_init_ex(EVP_PKEY_CTX *ctx,
                                     const OSSL_PARAM params[]);
@@ -1913,6 +1931,10 @@ int EVP_PKEY_decrypt_init_ex(EVP_PKEY_CTX *ctx, const OSSL_PARAM params[]);
 int EVP_PKEY_decrypt(EVP_PKEY_CTX *ctx,
                      unsigned char *out, size_t *outlen,
                      const unsigned char *in, size_t inlen);
+int EVP_PKEY_decrypt_batch(EVP_PKEY_CTX *ctx, size_t num,
+                           unsigned char *const out[], size_t outlen[],
+                           const unsigned char *const in[],
+                           const size_t inlen[]);
 
 int EVP_PKEY_derive_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_derive_init_ex(EVP_PKEY_CTX *ctx, const OSSL_PARAM params[]);
@@ -1920,6 +1942,8 @@ int EVP_PKEY_derive_set_peer_ex(EVP_PKEY_CTX *ctx, EVP_PKEY *peer,
                                 int validate_peer);
 int EVP_PKEY_derive_set_peer(EVP_PKEY_CTX *ctx, EVP_PKEY *peer);
 int EVP_PKEY_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *keylen);
+int EVP_PKEY_derive_batch(EVP_PKEY_CTX *const ctx[], size_t num,
+                          unsigned char *const key[], size_t keylen[]);
 
 int EVP_PKEY_encapsulate_init(EVP_PKEY_CTX *ctx, const OSSL_PARAM params[]);
 int EVP_PKEY_encapsulate(EVP_PKEY_CTX *ctx,
@@ -1976,6 +2000,7 @@ int EVP_PKEY_paramgen(EVP_PKEY_CTX *ctx, EVP_PKEY **ppkey);
 int EVP_PKEY_keygen_init(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_keygen(EVP_PKEY_CTX *ctx, EVP_PKEY **ppkey);
 int EVP_PKEY_generate(EVP_PKEY_CTX *ctx, EVP_PKEY **ppkey);
+int EVP_PKEY_generate_batch(EVP_PKEY_CTX *ctx, size_t num, EVP_PKEY *ppkey[]);
 int EVP_PKEY_check(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_public_check(EVP_PKEY_CTX *ctx);
 int EVP_PKEY_public_check_quick(EVP_PKEY_CTX *ctx);
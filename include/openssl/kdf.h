@@ -29,6 +29,8 @@ int EVP_KDF_up_ref(EVP_KDF *kdf);
 void EVP_KDF_free(EVP_KDF *kdf);
 EVP_KDF *EVP_KDF_fetch(OSSL_LIB_CTX *libctx, const char *algorithm,
                        const char *properties);
+EVP_KDF *EVP_KDF_fetch_with_query(OSSL_LIB_CTX *libctx, const char *algorithm,
+                                  const OSSL_PROPERTY_QUERY *query);
 
 EVP_KDF_CTX *EVP_KDF_CTX_new(EVP_KDF *kdf);
 void EVP_KDF_CTX_free(EVP_KDF_CTX *ctx);
@@ -213,6 +213,7 @@ typedef struct ossl_store_info_st OSSL_STORE_INFO;
 typedef struct ossl_store_search_st OSSL_STORE_SEARCH;
 
 typedef struct ossl_lib_ctx_st OSSL_LIB_CTX;
+typedef struct ossl_property_query_st OSSL_PROPERTY_QUERY;
 
 typedef struct ossl_dispatch_st OSSL_DISPATCH;
 typedef struct ossl_item_st OSSL_ITEM;
@@ -38,6 +38,7 @@ static OSSL_FUNC_asym_cipher_encrypt_init_fn rsa_encrypt_init;
 static OSSL_FUNC_asym_cipher_encrypt_fn rsa_encrypt;
 static OSSL_FUNC_asym_cipher_decrypt_init_fn rsa_decrypt_init;
 static OSSL_FUNC_asym_cipher_decrypt_fn rsa_decrypt;
+static OSSL_FUNC_asym_cipher_decrypt_batch_fn rsa_decrypt_batch;
 static OSSL_FUNC_asym_cipher_freectx_fn rsa_freectx;
 static OSSL_FUNC_asym_cipher_dupctx_fn rsa_dupctx;
 static OSSL_FUNC_asym_cipher_get_ctx_params_fn rsa_get_ctx_params;
@@ -290,6 +291,108 @@ static int rsa_decrypt(void *vprsactx, unsigned char *out, size_t *outlen,
     return ret;
 }
 
+/*
+ * Decrypts |num| inputs with the same key and settings, doing all of the
+ * private key operations together with ossl_rsa_private_decrypt_batch().
+ * OAEP padding is checked afterwards for each input on its own. The TLS
+ * premaster secret padding goes through rsa_decrypt() one input at a time.
+ */
+static int rsa_decrypt_batch(void *vprsactx, size_t num,
+                             unsigned char *const out[], size_t outlen[],
+                             const unsigned char *const in[],
+                             const size_t inlen[])
+{
+    PROV_RSA_CTX *prsactx = (PROV_RSA_CTX *)vprsactx;
+    size_t len = RSA_size(prsactx->rsa);
+    unsigned char *tbuf = NULL, **tout = NULL;
+    size_t *toutlen = NULL;
+    size_t i;
+    int pad_mode, r, ret = 0;
+
+    if (!ossl_prov_is_running())
+        return 0;
+
+    if (prsactx->pad_mode == RSA_PKCS1_WITH_TLS_PADDING) {
+        for (i = 0; i < num; i++)
+            if (!rsa_decrypt(prsactx, out[i], &outlen[i], outlen[i], in[i],
+                             inlen[i]))
+                return 0;
+        return 1;
+    }
+
+    if (len == 0) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEY);
+        return 0;
+    }
+    for (i = 0; i < num; i++) {
+        if (out[i] == NULL) {
+            ERR_raise(ERR_LIB_PROV, ERR_R_PASSED_NULL_PARAMETER);
+            return 0;
+        }
+        if (outlen[i] < len) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_BAD_LENGTH);
+            return 0;
+        }
+    }
+
+    if (prsactx->pad_mode != RSA_PKCS1_OAEP_PADDING) {
+        if ((prsactx->implicit_rejection == 0) &&
+                (prsactx->pad_mode == RSA_PKCS1_PADDING))
+            pad_mode = RSA_PKCS1_NO_IMPLICIT_REJECT_PADDING;
+        else
+            pad_mode = prsactx->pad_mode;
+        if (!ossl_rsa_private_decrypt_batch(prsactx->rsa, num, in, inlen, out,
+                                            outlen, pad_mode)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_DECRYPT);
+            return 0;
+        }
+        return 1;
+    }
+
+    if (prsactx->oaep_md == NULL) {
+        prsactx->oaep_md = EVP_MD_fetch(prsactx->libctx, "SHA-1", NULL);
+        if (prsactx->oaep_md == NULL) {
+            ERR_raise(ERR_LIB_PROV, ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+    }
+    tbuf = OPENSSL_malloc(num * len);
+    tout = OPENSSL_malloc(num * sizeof(*tout));
+    toutlen = OPENSSL_malloc(num * sizeof(*toutlen));
+    if (tbuf == NULL || tout == NULL || toutlen == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (i = 0; i < num; i++)
+        tout[i] = tbuf + i * len;
+    if (!ossl_rsa_private_decrypt_batch(prsactx->rsa, num, in, inlen, tout,
+                                        toutlen, RSA_NO_PADDING)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_DECRYPT);
+        goto err;
+    }
+    for (i = 0; i < num; i++) {
+        /* With no padding every output is len bytes (non-constant time) */
+        if (toutlen[i] != len) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_DECRYPT);
+            goto err;
+        }
+        r = RSA_padding_check_PKCS1_OAEP_mgf1(out[i], outlen[i], tout[i],
+                                              len, len, prsactx->oaep_label,
+                                              prsactx->oaep_labellen,
+                                              prsactx->oaep_md,
+                                              prsactx->mgf1_md);
+        if (r < 0)
+            goto err;
+        outlen[i] = r;
+    }
+    ret = 1;
+ err:
+    OPENSSL_clear_free(tbuf, num * len);
+    OPENSSL_free(tout);
+    OPENSSL_free(toutlen);
+    return ret;
+}
+
 static void rsa_freectx(void *vprsactx)
 {
     PROV_RSA_CTX *prsactx = (PROV_RSA_CTX *)vprsactx;
@@ -594,6 +697,8 @@ const OSSL_DISPATCH ossl_rsa_asym_cipher_functions[] = {
     { OSSL_FUNC_ASYM_CIPHER_ENCRYPT, (void (*)(void))rsa_encrypt },
     { OSSL_FUNC_ASYM_CIPHER_DECRYPT_INIT, (void (*)(void))rsa_decrypt_init },
     { OSSL_FUNC_ASYM_CIPHER_DECRYPT, (void (*)(void))rsa_decrypt },
+    { OSSL_FUNC_ASYM_CIPHER_DECRYPT_BATCH,
+      (void (*)(void))rsa_decrypt_batch },
     { OSSL_FUNC_ASYM_CIPHER_FREECTX, (void (*)(void))rsa_freectx },
     { OSSL_FUNC_ASYM_CIPHER_DUPCTX, (void (*)(void))rsa_dupctx },
     { OSSL_FUNC_ASYM_CIPHER_GET_CTX_PARAMS,
@@ -26,6 +26,7 @@ static OSSL_FUNC_keyexch_newctx_fn x448_newctx;
 static OSSL_FUNC_keyexch_init_fn ecx_init;
 static OSSL_FUNC_keyexch_set_peer_fn ecx_set_peer;
 static OSSL_FUNC_keyexch_derive_fn ecx_derive;
+static OSSL_FUNC_keyexch_derive_batch_fn ecx_derive_batch;
 static OSSL_FUNC_keyexch_freectx_fn ecx_freectx;
 static OSSL_FUNC_keyexch_dupctx_fn ecx_dupctx;
 
@@ -181,6 +182,82 @@ static int ecx_derive(void *vecxctx, unsigned char *secret, size_t *secretlen,
     return 1;
 }
 
+static int ecx_derive_batch(void *const vecxctx[], size_t num,
+                            unsigned char *const secret[], size_t secretlen[])
+{
+    PROV_ECX_CTX *ecxctx;
+    const unsigned char *privkey[ECX_BATCH_MAX], *pubkey[ECX_BATCH_MAX];
+    size_t keylen, i, j, n;
+    int ok;
+
+    if (!ossl_prov_is_running())
+        return 0;
+
+    keylen = ((PROV_ECX_CTX *)vecxctx[0])->keylen;
+    if (!ossl_assert(keylen == X25519_KEYLEN || keylen == X448_KEYLEN)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEY_LENGTH);
+        return 0;
+    }
+
+    for (i = 0; i < num; i++) {
+        ecxctx = (PROV_ECX_CTX *)vecxctx[i];
+        if (ecxctx->key == NULL
+                || ecxctx->key->privkey == NULL
+                || ecxctx->peerkey == NULL) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_MISSING_KEY);
+            return 0;
+        }
+        if (!ossl_assert(ecxctx->keylen == keylen)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        if (secretlen[i] < keylen) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+            return 0;
+        }
+    }
+
+#ifdef S390X_EC_ASM
+    if ((keylen == X25519_KEYLEN
+         && (OPENSSL_s390xcap_P.pcc[1]
+             & S390X_CAPBIT(S390X_SCALAR_MULTIPLY_X25519)))
+        || (keylen == X448_KEYLEN
+            && (OPENSSL_s390xcap_P.pcc[1]
+                & S390X_CAPBIT(S390X_SCALAR_MULTIPLY_X448)))) {
+        for (i = 0; i < num; i++)
+            if (!ecx_derive(vecxctx[i], secret[i], &secretlen[i],
+                            secretlen[i]))
+                return 0;
+        return 1;
+    }
+#endif
+
+    /*
+     * Each chunk of derivations shares one field inversion, see
+     * ossl_x25519_batch() and ossl_x448_batch().
+     */
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            ecxctx = (PROV_ECX_CTX *)vecxctx[i + j];
+            privkey[j] = ecxctx->key->privkey;
+            pubkey[j] = ecxctx->peerkey->pubkey;
+        }
+        if (keylen == X25519_KEYLEN)
+            ok = ossl_x25519_batch(n, secret + i, privkey, pubkey);
+        else
+            ok = ossl_x448_batch(n, secret + i, privkey, pubkey);
+        if (!ok) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_DURING_DERIVATION);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < num; i++)
+        secretlen[i] = keylen;
+    return 1;
+}
+
 static void ecx_freectx(void *vecxctx)
 {
     PROV_ECX_CTX *ecxctx = (PROV_ECX_CTX *)vecxctx;
@@ -226,6 +303,7 @@ const OSSL_DISPATCH ossl_x25519_keyexch_functions[] = {
     { OSSL_FUNC_KEYEXCH_NEWCTX, (void (*)(void))x25519_newctx },
     { OSSL_FUNC_KEYEXCH_INIT, (void (*)(void))ecx_init },
     { OSSL_FUNC_KEYEXCH_DERIVE, (void (*)(void))ecx_derive },
+    { OSSL_FUNC_KEYEXCH_DERIVE_BATCH, (void (*)(void))ecx_derive_batch },
     { OSSL_FUNC_KEYEXCH_SET_PEER, (void (*)(void))ecx_set_peer },
     { OSSL_FUNC_KEYEXCH_FREECTX, (void (*)(void))ecx_freectx },
     { OSSL_FUNC_KEYEXCH_DUPCTX, (void (*)(void))ecx_dupctx },
@@ -236,6 +314,7 @@ const OSSL_DISPATCH ossl_x448_keyexch_functions[] = {
     { OSSL_FUNC_KEYEXCH_NEWCTX, (void (*)(void))x448_newctx },
     { OSSL_FUNC_KEYEXCH_INIT, (void (*)(void))ecx_init },
     { OSSL_FUNC_KEYEXCH_DERIVE, (void (*)(void))ecx_derive },
+    { OSSL_FUNC_KEYEXCH_DERIVE_BATCH, (void (*)(void))ecx_derive_batch },
     { OSSL_FUNC_KEYEXCH_SET_PEER, (void (*)(void))ecx_set_peer },
     { OSSL_FUNC_KEYEXCH_FREECTX, (void (*)(void))ecx_freectx },
     { OSSL_FUNC_KEYEXCH_DUPCTX, (void (*)(void))ecx_dupctx },
@@ -39,6 +39,10 @@ static OSSL_FUNC_keymgmt_gen_fn x25519_gen;
 static OSSL_FUNC_keymgmt_gen_fn x448_gen;
 static OSSL_FUNC_keymgmt_gen_fn ed25519_gen;
 static OSSL_FUNC_keymgmt_gen_fn ed448_gen;
+static OSSL_FUNC_keymgmt_gen_batch_fn x25519_gen_batch;
+static OSSL_FUNC_keymgmt_gen_batch_fn x448_gen_batch;
+static OSSL_FUNC_keymgmt_gen_batch_fn ed25519_gen_batch;
+static OSSL_FUNC_keymgmt_gen_batch_fn ed448_gen_batch;
 static OSSL_FUNC_keymgmt_gen_cleanup_fn ecx_gen_cleanup;
 static OSSL_FUNC_keymgmt_gen_set_params_fn ecx_gen_set_params;
 static OSSL_FUNC_keymgmt_gen_settable_params_fn ecx_gen_settable_params;
@@ -654,6 +658,115 @@ static void *x448_gen(void *genctx, OSSL_CALLBACK *osslcb, void *cbarg)
     return ecx_gen(gctx);
 }
 
+/* Generate |num| keys one at a time with |gen| */
+static int ecx_gen_each(void *genctx, size_t num, void *keydata[],
+                        OSSL_FUNC_keymgmt_gen_fn *gen,
+                        OSSL_CALLBACK *osslcb, void *cbarg)
+{
+    size_t i;
+
+    for (i = 0; i < num; i++) {
+        if ((keydata[i] = gen(genctx, osslcb, cbarg)) == NULL) {
+            while (i-- > 0) {
+                ossl_ecx_key_free(keydata[i]);
+                keydata[i] = NULL;
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Generate |num| X25519 or X448 key pairs, deriving the public keys
+ * together so that up to ECX_BATCH_MAX of them share one field inversion.
+ */
+static int ecx_gen_batch(struct ecx_gen_ctx *gctx, size_t num,
+                         void *keydata[])
+{
+    ECX_KEY *key;
+    unsigned char *priv, *pubkey[ECX_BATCH_MAX];
+    const unsigned char *privkey[ECX_BATCH_MAX];
+    size_t i, j, n;
+
+    for (i = 0; i < num; i++)
+        keydata[i] = NULL;
+
+    for (i = 0; i < num; i += n) {
+        n = num - i < ECX_BATCH_MAX ? num - i : ECX_BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            if ((key = ossl_ecx_key_new(gctx->libctx, gctx->type, 0,
+                                        gctx->propq)) == NULL) {
+                ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+                goto err;
+            }
+            keydata[i + j] = key;
+            if ((priv = ossl_ecx_key_allocate_privkey(key)) == NULL) {
+                ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+                goto err;
+            }
+            if (RAND_priv_bytes_ex(gctx->libctx, priv, key->keylen, 0) <= 0)
+                goto err;
+            if (gctx->type == ECX_KEY_TYPE_X25519) {
+                priv[0] &= 248;
+                priv[X25519_KEYLEN - 1] &= 127;
+                priv[X25519_KEYLEN - 1] |= 64;
+            } else {
+                priv[0] &= 252;
+                priv[X448_KEYLEN - 1] |= 128;
+            }
+            privkey[j] = priv;
+            pubkey[j] = key->pubkey;
+            key->haspubkey = 1;
+        }
+        if (gctx->type == ECX_KEY_TYPE_X25519)
+            ossl_x25519_public_from_private_batch(n, pubkey, privkey);
+        else
+            ossl_x448_public_from_private_batch(n, pubkey, privkey);
+    }
+    return 1;
+ err:
+    for (i = 0; i < num; i++) {
+        ossl_ecx_key_free(keydata[i]);
+        keydata[i] = NULL;
+    }
+    return 0;
+}
+
+static int x25519_gen_batch(void *genctx, size_t num, void *keydata[],
+                            OSSL_CALLBACK *osslcb, void *cbarg)
+{
+    struct ecx_gen_ctx *gctx = genctx;
+
+    if (!ossl_prov_is_running() || gctx == NULL)
+        return 0;
+
+#ifdef S390X_EC_ASM
+    if (OPENSSL_s390xcap_P.pcc[1] & S390X_CAPBIT(S390X_SCALAR_MULTIPLY_X25519))
+        return ecx_gen_each(genctx, num, keydata, x25519_gen, osslcb, cbarg);
+#endif
+    if ((gctx->selection & OSSL_KEYMGMT_SELECT_KEYPAIR) == 0)
+        return ecx_gen_each(genctx, num, keydata, x25519_gen, osslcb, cbarg);
+    return ecx_gen_batch(gctx, num, keydata);
+}
+
+static int x448_gen_batch(void *genctx, size_t num, void *keydata[],
+                          OSSL_CALLBACK *osslcb, void *cbarg)
+{
+    struct ecx_gen_ctx *gctx = genctx;
+
+    if (!ossl_prov_is_running() || gctx == NULL)
+        return 0;
+
+#ifdef S390X_EC_ASM
+    if (OPENSSL_s390xcap_P.pcc[1] & S390X_CAPBIT(S390X_SCALAR_MULTIPLY_X448))
+        return ecx_gen_each(genctx, num, keydata, x448_gen, osslcb, cbarg);
+#endif
+    if ((gctx->selection & OSSL_KEYMGMT_SELECT_KEYPAIR) == 0)
+        return ecx_gen_each(genctx, num, keydata, x448_gen, osslcb, cbarg);
+    return ecx_gen_batch(gctx, num, keydata);
+}
+
 static void *ed25519_gen(void *genctx, OSSL_CALLBACK *osslcb, void *cbarg)
 {
     struct ecx_gen_ctx *gctx = genctx;
@@ -687,6 +800,19 @@ static void *ed448_gen(void *genctx, OSSL_CALLBACK *osslcb, void *cbarg)
     return ecx_gen(gctx);
 }
 
+/* There is nothing for Ed25519 and Ed448 keys to share */
+static int ed25519_gen_batch(void *genctx, size_t num, void *keydata[],
+                             OSSL_CALLBACK *osslcb, void *cbarg)
+{
+    return ecx_gen_each(genctx, num, keydata, ed25519_gen, osslcb, cbarg);
+}
+
+static int ed448_gen_batch(void *genctx, size_t num, void *keydata[],
+                           OSSL_CALLBACK *osslcb, void *cbarg)
+{
+    return ecx_gen_each(genctx, num, keydata, ed448_gen, osslcb, cbarg);
+}
+
 static void ecx_gen_cleanup(void *genctx)
 {
     struct ecx_gen_ctx *gctx = genctx;
@@ -812,6 +938,7 @@ static int ed448_validate(const void *keydata, int selection, int checktype)
           (void (*)(void))ecx_gen_settable_params }, \
         { OSSL_FUNC_KEYMGMT_GEN, (void (*)(void))alg##_gen }, \
         { OSSL_FUNC_KEYMGMT_GEN_CLEANUP, (void (*)(void))ecx_gen_cleanup }, \
+        { OSSL_FUNC_KEYMGMT_GEN_BATCH, (void (*)(void))alg##_gen_batch }, \
         { OSSL_FUNC_KEYMGMT_LOAD, (void (*)(void))ecx_load }, \
         { OSSL_FUNC_KEYMGMT_DUP, (void (*)(void))ecx_dup }, \
         { 0, NULL } \
@@ -37,6 +37,7 @@ static OSSL_FUNC_signature_sign_init_fn ecdsa_sign_init;
 static OSSL_FUNC_signature_verify_init_fn ecdsa_verify_init;
 static OSSL_FUNC_signature_sign_fn ecdsa_sign;
 static OSSL_FUNC_signature_verify_fn ecdsa_verify;
+static OSSL_FUNC_signature_verify_batch_fn ecdsa_verify_batch;
 static OSSL_FUNC_signature_digest_sign_init_fn ecdsa_digest_sign_init;
 static OSSL_FUNC_signature_digest_sign_update_fn ecdsa_digest_signverify_update;
 static OSSL_FUNC_signature_digest_sign_final_fn ecdsa_digest_sign_final;
@@ -212,6 +213,51 @@ static int ecdsa_verify(void *vctx, const unsigned char *sig, size_t siglen,
     return ECDSA_verify(0, tbs, tbslen, sig, siglen, ctx->ec);
 }
 
+static int ecdsa_verify_batch(void *const vctx[], size_t num,
+                              const unsigned char *const sig[],
+                              const size_t siglen[],
+                              const unsigned char *const tbs[],
+                              const size_t tbslen[], int results[])
+{
+    PROV_ECDSA_CTX *ctx;
+    const unsigned char *bsig[ECDSA_BATCH_MAX], *btbs[ECDSA_BATCH_MAX];
+    size_t bsiglen[ECDSA_BATCH_MAX], btbslen[ECDSA_BATCH_MAX];
+    size_t bidx[ECDSA_BATCH_MAX];
+    int bresults[ECDSA_BATCH_MAX];
+    EC_KEY *bkey[ECDSA_BATCH_MAX];
+    size_t i, j, n;
+    int ret = 1;
+
+    if (!ossl_prov_is_running())
+        return 0;
+
+    for (i = 0; i < num;) {
+        /* Collect up to ECDSA_BATCH_MAX inputs that are worth verifying */
+        for (n = 0; i < num && n < ECDSA_BATCH_MAX; i++) {
+            ctx = (PROV_ECDSA_CTX *)vctx[i];
+            if (ctx->mdsize != 0 && tbslen[i] != ctx->mdsize) {
+                results[i] = 0;
+                ret = 0;
+                continue;
+            }
+            bsig[n] = sig[i];
+            bsiglen[n] = siglen[i];
+            btbs[n] = tbs[i];
+            btbslen[n] = tbslen[i];
+            bkey[n] = ctx->ec;
+            bidx[n++] = i;
+        }
+        if (n == 0)
+            continue;
+        if (!ossl_ecdsa_verify_batch(n, btbs, btbslen, bsig, bsiglen, bkey,
+                                     bresults))
+            ret = 0;
+        for (j = 0; j < n; j++)
+            results[bidx[j]] = bresults[j];
+    }
+    return ret;
+}
+
 static int ecdsa_setup_md(PROV_ECDSA_CTX *ctx, const char *mdname,
                           const char *mdprops)
 {
@@ -587,6 +633,7 @@ const OSSL_DISPATCH ossl_ecdsa_signature_functions[] = {
     { OSSL_FUNC_SIGNATURE_SIGN, (void (*)(void))ecdsa_sign },
     { OSSL_FUNC_SIGNATURE_VERIFY_INIT, (void (*)(void))ecdsa_verify_init },
     { OSSL_FUNC_SIGNATURE_VERIFY, (void (*)(void))ecdsa_verify },
+    { OSSL_FUNC_SIGNATURE_VERIFY_BATCH, (void (*)(void))ecdsa_verify_batch },
     { OSSL_FUNC_SIGNATURE_DIGEST_SIGN_INIT,
       (void (*)(void))ecdsa_digest_sign_init },
     { OSSL_FUNC_SIGNATURE_DIGEST_SIGN_UPDATE,
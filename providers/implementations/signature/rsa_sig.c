@@ -39,6 +39,7 @@ static OSSL_FUNC_signature_sign_init_fn rsa_sign_init;
 static OSSL_FUNC_signature_verify_init_fn rsa_verify_init;
 static OSSL_FUNC_signature_verify_recover_init_fn rsa_verify_recover_init;
 static OSSL_FUNC_signature_sign_fn rsa_sign;
+static OSSL_FUNC_signature_sign_batch_fn rsa_sign_batch;
 static OSSL_FUNC_signature_verify_fn rsa_verify;
 static OSSL_FUNC_signature_verify_recover_fn rsa_verify_recover;
 static OSSL_FUNC_signature_digest_sign_init_fn rsa_digest_sign_init;
@@ -511,6 +512,37 @@ static int rsa_sign_init(void *vprsactx, void *vrsa, const OSSL_PARAM params[])
     return rsa_signverify_init(vprsactx, vrsa, params, EVP_PKEY_OP_SIGN);
 }
 
+/* Checks the salt length against the PSS restrictions of the key, if any */
+static int rsa_pss_check_saltlen(PROV_RSA_CTX *prsactx)
+{
+    if (!rsa_pss_restricted(prsactx))
+        return 1;
+
+    switch (prsactx->saltlen) {
+    case RSA_PSS_SALTLEN_DIGEST:
+        if (prsactx->min_saltlen > EVP_MD_get_size(prsactx->md)) {
+            ERR_raise_data(ERR_LIB_PROV, PROV_R_PSS_SALTLEN_TOO_SMALL,
+                           "minimum salt length set to %d, "
+                           "but the digest only gives %d",
+                           prsactx->min_saltlen,
+                           EVP_MD_get_size(prsactx->md));
+            return 0;
+        }
+        /* FALLTHRU */
+    default:
+        if (prsactx->saltlen >= 0
+            && prsactx->saltlen < prsactx->min_saltlen) {
+            ERR_raise_data(ERR_LIB_PROV, PROV_R_PSS_SALTLEN_TOO_SMALL,
+                           "minimum salt length set to %d, but the"
+                           "actual salt length is only set to %d",
+                           prsactx->min_saltlen, prsactx->saltlen);
+            return 0;
+        }
+        break;
+    }
+    return 1;
+}
+
 static int rsa_sign(void *vprsactx, unsigned char *sig, size_t *siglen,
                     size_t sigsize, const unsigned char *tbs, size_t tbslen)
 {
@@ -593,34 +625,8 @@ static int rsa_sign(void *vprsactx, unsigned char *sig, size_t *siglen,
             break;
 
         case RSA_PKCS1_PSS_PADDING:
-            /* Check PSS restrictions */
-            if (rsa_pss_restricted(prsactx)) {
-                switch (prsactx->saltlen) {
-                case RSA_PSS_SALTLEN_DIGEST:
-                    if (prsactx->min_saltlen > EVP_MD_get_size(prsactx->md)) {
-                        ERR_raise_data(ERR_LIB_PROV,
-                                       PROV_R_PSS_SALTLEN_TOO_SMALL,
-                                       "minimum salt length set to %d, "
-                                       "but the digest only gives %d",
-                                       prsactx->min_saltlen,
-                                       EVP_MD_get_size(prsactx->md));
-                        return 0;
-                    }
-                    /* FALLTHRU */
-                default:
-                    if (prsactx->saltlen >= 0
-                        && prsactx->saltlen < prsactx->min_saltlen) {
-                        ERR_raise_data(ERR_LIB_PROV,
-                                       PROV_R_PSS_SALTLEN_TOO_SMALL,
-                                       "minimum salt length set to %d, but the"
-                                       "actual salt length is only set to %d",
-                                       prsactx->min_saltlen,
-                                       prsactx->saltlen);
-                        return 0;
-                    }
-                    break;
-                }
-            }
+            if (!rsa_pss_check_saltlen(prsactx))
+                return 0;
             if (!setup_tbuf(prsactx))
                 return 0;
             if (!RSA_padding_add_PKCS1_PSS_mgf1(prsactx->rsa,
@@ -657,6 +663,127 @@ static int rsa_sign(void *vprsactx, unsigned char *sig, size_t *siglen,
     return 1;
 }
 
+/*
+ * Signs |num| inputs with the same key and settings. Each input is encoded
+ * on its own, and all of the private key operations are then done together
+ * with ossl_rsa_private_encrypt_batch(). The few combinations that need
+ * something else, X9.31 padding with a digest, MDC2, MD5-SHA1 or a key with
+ * its own RSA_METHOD, go through rsa_sign() one input at a time instead.
+ */
+static int rsa_sign_batch(void *vprsactx, size_t num,
+                          unsigned char *const sig[], size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[])
+{
+    PROV_RSA_CTX *prsactx = (PROV_RSA_CTX *)vprsactx;
+    size_t rsasize = RSA_size(prsactx->rsa);
+    size_t mdsize = rsa_get_md_size(prsactx);
+    const unsigned char *di = NULL;
+    const unsigned char **in = NULL;
+    unsigned char *em = NULL;
+    size_t *inlen = NULL;
+    size_t i, dilen = 0, emlen = 0;
+    int padding = prsactx->pad_mode, ret = 0;
+
+    if (!ossl_prov_is_running())
+        return 0;
+
+    for (i = 0; i < num; i++) {
+        if (sig[i] == NULL) {
+            ERR_raise(ERR_LIB_PROV, ERR_R_PASSED_NULL_PARAMETER);
+            return 0;
+        }
+        if (siglen[i] < rsasize) {
+            ERR_raise_data(ERR_LIB_PROV, PROV_R_INVALID_SIGNATURE_SIZE,
+                           "is %zu, should be at least %zu", siglen[i],
+                           rsasize);
+            return 0;
+        }
+        if (mdsize != 0 && tbslen[i] != mdsize) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_DIGEST_LENGTH);
+            return 0;
+        }
+    }
+
+#ifndef FIPS_MODULE
+    if (RSA_get_method(prsactx->rsa) != RSA_PKCS1_OpenSSL())
+        goto one_by_one;
+#endif
+
+    if (mdsize == 0) {
+        if (!ossl_rsa_private_encrypt_batch(prsactx->rsa, num, tbs, tbslen,
+                                            sig, padding)) {
+            ERR_raise(ERR_LIB_PROV, ERR_R_RSA_LIB);
+            return 0;
+        }
+        goto end;
+    }
+
+    switch (padding) {
+    case RSA_PKCS1_PADDING:
+        /* MDC2 and MD5-SHA1 have no DigestInfo here */
+        di = ossl_rsa_digestinfo_encoding(prsactx->mdnid, &dilen);
+        if (di == NULL)
+            goto one_by_one;
+        emlen = dilen + mdsize;
+        break;
+    case RSA_PKCS1_PSS_PADDING:
+        if (!rsa_pss_check_saltlen(prsactx))
+            return 0;
+        emlen = rsasize;
+        padding = RSA_NO_PADDING;
+        break;
+    default:
+        goto one_by_one;
+    }
+
+    in = OPENSSL_malloc(num * sizeof(*in));
+    inlen = OPENSSL_malloc(num * sizeof(*inlen));
+    em = OPENSSL_malloc(num * emlen);
+    if (in == NULL || inlen == NULL || em == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (i = 0; i < num; i++) {
+        unsigned char *p = em + i * emlen;
+
+        if (di != NULL) {
+            memcpy(p, di, dilen);
+            memcpy(p + dilen, tbs[i], mdsize);
+        } else if (!RSA_padding_add_PKCS1_PSS_mgf1(prsactx->rsa, p, tbs[i],
+                                                   prsactx->md,
+                                                   prsactx->mgf1_md,
+                                                   prsactx->saltlen)) {
+            ERR_raise(ERR_LIB_PROV, ERR_R_RSA_LIB);
+            goto err;
+        }
+        in[i] = p;
+        inlen[i] = emlen;
+    }
+    if (!ossl_rsa_private_encrypt_batch(prsactx->rsa, num, in, inlen, sig,
+                                        padding)) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_RSA_LIB);
+        goto err;
+    }
+
+ end:
+    for (i = 0; i < num; i++)
+        siglen[i] = rsasize;
+    ret = 1;
+ err:
+    OPENSSL_free(in);
+    OPENSSL_free(inlen);
+    OPENSSL_clear_free(em, num * emlen);
+    return ret;
+
+ one_by_one:
+    for (i = 0; i < num; i++)
+        if (!rsa_sign(prsactx, sig[i], &siglen[i], siglen[i], tbs[i],
+                      tbslen[i]))
+            return 0;
+    return 1;
+}
+
 static int rsa_verify_recover_init(void *vprsactx, void *vrsa,
                                    const OSSL_PARAM params[])
 {
@@ -1436,6 +1563,7 @@ const OSSL_DISPATCH ossl_rsa_signature_functions[] = {
     { OSSL_FUNC_SIGNATURE_NEWCTX, (void (*)(void))rsa_newctx },
     { OSSL_FUNC_SIGNATURE_SIGN_INIT, (void (*)(void))rsa_sign_init },
     { OSSL_FUNC_SIGNATURE_SIGN, (void (*)(void))rsa_sign },
+    { OSSL_FUNC_SIGNATURE_SIGN_BATCH, (void (*)(void))rsa_sign_batch },
     { OSSL_FUNC_SIGNATURE_VERIFY_INIT, (void (*)(void))rsa_verify_init },
     { OSSL_FUNC_SIGNATURE_VERIFY, (void (*)(void))rsa_verify },
     { OSSL_FUNC_SIGNATURE_VERIFY_RECOVER_INIT,
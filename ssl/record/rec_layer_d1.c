@@ -70,7 +70,7 @@ void DTLS_RECORD_LAYER_clear(RECORD_LAYER *rl)
 
     while ((item = pqueue_pop(d->unprocessed_rcds.q)) != NULL) {
         rdata = (DTLS1_RECORD_DATA *)item->data;
-        OPENSSL_free(rdata->rbuf.buf);
+        ssl_buffer_release(rl->s, rdata->rbuf.buf, rdata->rbuf.len);
         OPENSSL_free(item->data);
         pitem_free(item);
     }
@@ -79,7 +79,7 @@ void DTLS_RECORD_LAYER_clear(RECORD_LAYER *rl)
         rdata = (DTLS1_RECORD_DATA *)item->data;
         if (rl->s->options & SSL_OP_CLEANSE_PLAINTEXT)
             OPENSSL_cleanse(rdata->rbuf.buf, rdata->rbuf.len);
-        OPENSSL_free(rdata->rbuf.buf);
+        ssl_buffer_release(rl->s, rdata->rbuf.buf, rdata->rbuf.len);
         OPENSSL_free(item->data);
         pitem_free(item);
     }
@@ -88,7 +88,7 @@ void DTLS_RECORD_LAYER_clear(RECORD_LAYER *rl)
         rdata = (DTLS1_RECORD_DATA *)item->data;
         if (rl->s->options & SSL_OP_CLEANSE_PLAINTEXT)
             OPENSSL_cleanse(rdata->rbuf.buf, rdata->rbuf.len);
-        OPENSSL_free(rdata->rbuf.buf);
+        ssl_buffer_release(rl->s, rdata->rbuf.buf, rdata->rbuf.len);
         OPENSSL_free(item->data);
         pitem_free(item);
     }
@@ -130,7 +130,7 @@ static int dtls1_copy_record(SSL *s, pitem *item)
 
     rdata = (DTLS1_RECORD_DATA *)item->data;
 
-    SSL3_BUFFER_release(&s->rlayer.rbuf);
+    SSL3_BUFFER_release(s, &s->rlayer.rbuf);
 
     s->rlayer.packet = rdata->packet;
     s->rlayer.packet_length = rdata->packet_length;
@@ -185,7 +185,7 @@ int dtls1_buffer_record(SSL *s, record_pqueue *queue, unsigned char *priority)
 
     if (!ssl3_setup_buffers(s)) {
         /* SSLfatal() already called */
-        OPENSSL_free(rdata->rbuf.buf);
+        ssl_buffer_release(s, rdata->rbuf.buf, rdata->rbuf.len);
         OPENSSL_free(rdata);
         pitem_free(item);
         return -1;
@@ -193,7 +193,7 @@ int dtls1_buffer_record(SSL *s, record_pqueue *queue, unsigned char *priority)
 
     if (pqueue_insert(queue->q, item) == NULL) {
         /* Must be a duplicate so ignore it */
-        OPENSSL_free(rdata->rbuf.buf);
+        ssl_buffer_release(s, rdata->rbuf.buf, rdata->rbuf.len);
         OPENSSL_free(rdata);
         pitem_free(item);
     }
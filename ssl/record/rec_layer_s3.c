@@ -342,21 +342,150 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
     return 1;
 }
 
+/*
+ * Returns 1 if several records can be encrypted in one go into a single
+ * write buffer with the current write cipher, or 0 otherwise. This is only
+ * done for AES-GCM and ChaCha20-Poly1305, where a full record always grows
+ * by the same, known amount, so that the records can be laid out back to back
+ * before they are encrypted.
+ */
+static int ssl3_write_batch_ok(SSL *s)
+{
+    const EVP_CIPHER *cipher;
+
+    if (SSL_IS_DTLS(s)
+            || s->enc_write_ctx == NULL
+            || s->compress != NULL
+            || s->rlayer.numwpipes > 1
+            || s->statem.enc_write_state != ENC_WRITE_STATE_VALID
+            || BIO_get_ktls_send(s->wbio))
+        return 0;
+
+    cipher = EVP_CIPHER_CTX_get0_cipher(s->enc_write_ctx);
+    if ((EVP_CIPHER_get_flags(cipher) & EVP_CIPH_FLAG_PIPELINE) != 0)
+        return 0;
+
+    return EVP_CIPHER_get_mode(cipher) == EVP_CIPH_GCM_MODE
+           || EVP_CIPHER_is_a(cipher, "ChaCha20-Poly1305");
+}
+
+/*
+ * Copies |len| bytes at offset |off| of the data of the current SSL_writev()
+ * call to |out|.
+ */
+static void ssl3_write_gather(SSL *s, unsigned char *out, size_t off,
+                              size_t len)
+{
+    const SSL_IOVEC *iov = s->rlayer.wiov;
+    size_t n;
+
+    if (len == 0)
+        return;
+
+    while (off >= iov->len) {
+        off -= iov->len;
+        iov++;
+    }
+    while (len > 0) {
+        n = iov->len - off;
+        if (n > len)
+            n = len;
+        memcpy(out, (const unsigned char *)iov->data + off, n);
+        out += n;
+        len -= n;
+        off = 0;
+        iov++;
+    }
+}
+
+#ifndef OPENSSL_NO_KTLS
+/*
+ * Writes the data of the current SSL_writev() call from offset |tot| up to
+ * |len| when the kernel does the record layer, handing it all of the
+ * remaining buffers at once. Return values are as per ssl3_write_bytes().
+ */
+static int ssl3_write_ktls_iov(SSL *s, size_t tot, size_t len,
+                               size_t *written)
+{
+    struct iovec vec[16];
+    const SSL_IOVEC *iov = s->rlayer.wiov;
+    size_t i, off, cnt;
+    ossl_ssize_t ret;
+    int fd = SSL_get_wfd(s);
+
+    /* If we have an alert to send, lets send it */
+    if (s->s3.alert_dispatch) {
+        ret = s->method->ssl_dispatch_alert(s);
+        if (ret <= 0) {
+            /* SSLfatal() already called if appropriate */
+            s->rlayer.wnum = tot;
+            return (int)ret;
+        }
+    }
+
+    s->rwstate = SSL_WRITING;
+    if (BIO_flush(s->wbio) <= 0) {
+        s->rlayer.wnum = tot;
+        return -1;
+    }
+
+    while (tot < len) {
+        /* Skip over what has been sent already */
+        off = tot;
+        for (i = 0; off >= iov[i].len; i++)
+            off -= iov[i].len;
+        for (cnt = 0; cnt < OSSL_NELEM(vec) && i < s->rlayer.wiovcnt; i++) {
+            vec[cnt].iov_base = (unsigned char *)iov[i].data + off;
+            vec[cnt].iov_len = iov[i].len - off;
+            off = 0;
+            cnt++;
+        }
+
+        clear_sys_error();
+        ret = ktls_sendv(fd, vec, (int)cnt);
+        if (ret < 0) {
+            s->rlayer.wnum = tot;
+#if defined(EAGAIN) && defined(EINTR) && defined(EBUSY)
+            if (get_last_sys_error() == EAGAIN
+                    || get_last_sys_error() == EINTR
+                    || get_last_sys_error() == EBUSY) {
+                BIO_set_retry_write(s->wbio);
+                return -1;
+            }
+#endif
+            ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(),
+                           "calling sendmsg()");
+            return -1;
+        }
+        tot += ret;
+        if ((s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE) != 0)
+            break;
+    }
+
+    s->rwstate = SSL_NOTHING;
+    *written = tot;
+    return 1;
+}
+#endif
+
 /*
  * Call this to write data in records of type 'type' It will return <= 0 if
  * not all data has been sent or non-blocking IO.
+ *
+ * |buf_| is NULL during SSL_writev(), when the data is in s->rlayer.wiov
+ * instead.
  */
 int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
                      size_t *written)
 {
     const unsigned char *buf = buf_;
     size_t tot;
-    size_t n, max_send_fragment, split_send_fragment, maxpipes;
+    size_t n, max_send_fragment, split_send_fragment, maxpipes, maxbatch;
 #if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
     size_t nw;
 #endif
     SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
-    int i;
+    int i, gather = buf == NULL && s->rlayer.wiov != NULL;
     size_t tmpwrit;
 
     s->rwstate = SSL_NOTHING;
@@ -415,8 +544,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      */
     if (wb->left != 0) {
         /* SSLfatal() already called if appropriate */
-        i = ssl3_write_pending(s, type, &buf[tot], s->rlayer.wpend_tot,
-                               &tmpwrit);
+        i = ssl3_write_pending(s, type, gather ? NULL : &buf[tot],
+                               s->rlayer.wpend_tot, &tmpwrit);
         if (i <= 0) {
             /* XXX should we ssl3_release_write_buffer if i<0? */
             s->rlayer.wnum = tot;
@@ -424,6 +553,10 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         }
         tot += tmpwrit;               /* this might be last fragment */
     }
+#ifndef OPENSSL_NO_KTLS
+    if (gather && BIO_get_ktls_send(s->wbio))
+        return ssl3_write_ktls_iov(s, tot, len, written);
+#endif
 #if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
     /*
      * Depending on platform multi-block can deliver several *times*
@@ -432,6 +565,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * compromise is considered worthy.
      */
     if (type == SSL3_RT_APPLICATION_DATA
+            && !gather
             && len >= 4 * (max_send_fragment = ssl_get_max_send_fragment(s))
             && s->compress == NULL
             && s->msg_callback == NULL
@@ -602,6 +736,18 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         return -1;
     }
 
+    /*
+     * Without a pipelining cipher, large writes of application data are still
+     * sent as batches of full records, which are encrypted together into one
+     * buffer and written out with a single BIO_write().
+     */
+    if (maxpipes == 1
+            && type == SSL3_RT_APPLICATION_DATA
+            && ssl3_write_batch_ok(s))
+        maxbatch = SSL3_WRITE_BATCH_MAX;
+    else
+        maxbatch = 1;
+
     for (;;) {
         size_t pipelens[SSL_MAX_PIPELINES], tmppipelen, remain;
         size_t numpipes, j;
@@ -632,8 +778,18 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
             }
         }
 
-        i = do_ssl3_write(s, type, &(buf[tot]), pipelens, numpipes, 0,
-                          &tmpwrit);
+        if (maxbatch > 1 && n >= 2 * max_send_fragment) {
+            numpipes = n / max_send_fragment;
+            if (numpipes > maxbatch)
+                numpipes = maxbatch;
+            for (j = 0; j < numpipes; j++)
+                pipelens[j] = max_send_fragment;
+        }
+
+        if (gather)
+            s->rlayer.wiovoff = tot;
+        i = do_ssl3_write(s, type, gather ? NULL : &(buf[tot]), pipelens,
+                          numpipes, 0, &tmpwrit);
         if (i <= 0) {
             /* SSLfatal() already called if appropriate */
             /* XXX should we ssl3_release_write_buffer if i<0? */
@@ -673,17 +829,20 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     WPACKET *thispkt;
     SSL3_RECORD *thiswr;
     unsigned char *recordstart;
-    int i, mac_size, clear = 0;
+    int i, mac_size, clear = 0, batched, gather;
     size_t prefix_len = 0;
     int eivlen = 0;
     size_t align = 0;
     SSL3_BUFFER *wb;
     SSL_SESSION *sess;
     size_t totlen = 0, len, wpinited = 0;
+    size_t batchlen[SSL_MAX_PIPELINES];
     size_t j;
 
     for (j = 0; j < numpipes; j++)
         totlen += pipelens[j];
+    /* The data of an SSL_writev() call is gathered from its buffers */
+    gather = buf == NULL && s->rlayer.wiov != NULL;
     /*
      * first check if there is a SSL3_BUFFER still being written out.  This
      * will happen with non blocking IO
@@ -703,7 +862,25 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* if it went, fall through and send more stuff */
     }
 
-    if (s->rlayer.numwpipes < numpipes) {
+    /*
+     * Several records for a cipher that can't pipeline them are a batch from
+     * ssl3_write_bytes(), which all go into a single, larger write buffer
+     */
+    batched = numpipes > 1 && !create_empty_fragment && ssl3_write_batch_ok(s);
+    if (batched) {
+        len = SSL3_WRITE_BATCH_MAX
+              * (ssl_get_max_send_fragment(s) + SSL3_RT_HEADER_LENGTH
+                 + SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD);
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD != 0
+        len += SSL3_ALIGN_PAYLOAD - 1;
+#endif
+        if ((s->rlayer.numwpipes == 0
+                    || SSL3_BUFFER_get_len(&s->rlayer.wbuf[0]) < len)
+                && !ssl3_setup_write_buffer(s, 1, len)) {
+            /* SSLfatal() already called */
+            return -1;
+        }
+    } else if (s->rlayer.numwpipes < numpipes) {
         if (!ssl3_setup_write_buffer(s, numpipes, 0)) {
             /* SSLfatal() already called */
             return -1;
@@ -807,7 +984,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             goto err;
         }
         wpinited = 1;
-    } else {
+    } else if (!batched) {
         for (j = 0; j < numpipes; j++) {
             thispkt = &pkt[j];
 
@@ -842,6 +1019,39 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         }
     }
 
+    if (batched) {
+        size_t off;
+
+        wb = &s->rlayer.wbuf[0];
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD != 0
+        align = (size_t)SSL3_BUFFER_get_buf(wb) + SSL3_RT_HEADER_LENGTH;
+        align = SSL3_ALIGN_PAYLOAD - 1 - ((align - 1) % SSL3_ALIGN_PAYLOAD);
+#endif
+        SSL3_BUFFER_set_offset(wb, align);
+        SSL3_BUFFER_set_left(wb, 0);
+        off = align;
+        for (j = 0; j < numpipes; j++) {
+            /*
+             * Each record gets exactly the space it will take once encrypted:
+             * the explicit IV if any, the TLSv1.3 content type and the tag.
+             * The records then end up back to back.
+             */
+            batchlen[j] = SSL3_RT_HEADER_LENGTH + eivlen + pipelens[j]
+                          + EVP_GCM_TLS_TAG_LEN;
+            if (SSL_TREAT_AS_TLS13(s))
+                batchlen[j]++;
+            if (off + batchlen[j] > SSL3_BUFFER_get_len(wb)
+                    || !WPACKET_init_static_len(&pkt[j],
+                                                SSL3_BUFFER_get_buf(wb) + off,
+                                                batchlen[j], 0)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            wpinited++;
+            off += batchlen[j];
+        }
+    }
+
  wpacket_init_complete:
 
     totlen = 0;
@@ -851,7 +1061,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         unsigned int version = (s->version == TLS1_3_VERSION) ? TLS1_2_VERSION
                                                               : s->version;
         unsigned char *compressdata = NULL;
-        size_t maxcomplen;
+        size_t maxcomplen, inoff = totlen;
         unsigned int rectype;
 
         thispkt = &pkt[j];
@@ -905,7 +1115,8 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* lets setup the record stuff. */
         SSL3_RECORD_set_data(thiswr, compressdata);
         SSL3_RECORD_set_length(thiswr, pipelens[j]);
-        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
+        SSL3_RECORD_set_input(thiswr,
+                              gather ? NULL : (unsigned char *)&buf[totlen]);
         totlen += pipelens[j];
 
         /*
@@ -915,16 +1126,43 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 
         /* first we compress */
         if (s->compress != NULL) {
+            unsigned char *in = NULL;
+
+            if (gather && thiswr->length > 0) {
+                /* The compressor needs its input in one piece */
+                if ((in = OPENSSL_malloc(thiswr->length)) == NULL) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
+                    goto err;
+                }
+                ssl3_write_gather(s, in, s->rlayer.wiovoff + inoff,
+                                  thiswr->length);
+                SSL3_RECORD_set_input(thiswr, in);
+            }
             if (!ssl3_do_compress(s, thiswr)
                     || !WPACKET_allocate_bytes(thispkt, thiswr->length, NULL)) {
+                OPENSSL_free(in);
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_R_COMPRESSION_FAILURE);
                 goto err;
             }
+            OPENSSL_free(in);
         } else {
             if (BIO_get_ktls_send(s->wbio)) {
                 SSL3_RECORD_reset_data(&wr[j]);
             } else {
-                if (!WPACKET_memcpy(thispkt, thiswr->input, thiswr->length)) {
+                if (gather) {
+                    if (thiswr->length > 0) {
+                        if (!WPACKET_allocate_bytes(thispkt, thiswr->length,
+                                                    NULL)) {
+                            SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                                     ERR_R_INTERNAL_ERROR);
+                            goto err;
+                        }
+                        ssl3_write_gather(s, compressdata,
+                                          s->rlayer.wiovoff + inoff,
+                                          thiswr->length);
+                    }
+                } else if (!WPACKET_memcpy(thispkt, thiswr->input,
+                                           thiswr->length)) {
                     SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
                     goto err;
                 }
@@ -1130,8 +1368,16 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                                              * debugging */
 
         /* now let's set up wb */
-        SSL3_BUFFER_set_left(&s->rlayer.wbuf[j],
-                             prefix_len + SSL3_RECORD_get_length(thiswr));
+        if (batched) {
+            if (SSL3_RECORD_get_length(thiswr) != batchlen[j]) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            SSL3_BUFFER_add_left(&s->rlayer.wbuf[0], batchlen[j]);
+        } else {
+            SSL3_BUFFER_set_left(&s->rlayer.wbuf[j],
+                                 prefix_len + SSL3_RECORD_get_length(thiswr));
+        }
     }
 
     /*
@@ -1345,7 +1591,14 @@ int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
     do {
         /* get new records if necessary */
         if (num_recs == 0) {
+            if (type == SSL3_RT_APPLICATION_DATA && !peek
+                    && (s->mode & SSL_MODE_ZERO_COPY_READ) != 0) {
+                s->rlayer.rdirect = buf;
+                s->rlayer.rdirectlen = len;
+            }
             ret = ssl3_get_record(s);
+            s->rlayer.rdirect = NULL;
+            s->rlayer.rdirectlen = 0;
             if (ret <= 0) {
                 /* SSLfatal() already called if appropriate */
                 return ret;
@@ -1452,15 +1705,20 @@ int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
             else
                 n = len - totalbytes;
 
-            memcpy(buf, &(rr->data[rr->off]), n);
+            if (&(rr->data[rr->off]) == buf) {
+                /* Decrypted in place by ssl3_get_record() */
+                s->rlayer.zero_copy_bytes += n;
+            } else {
+                memcpy(buf, &(rr->data[rr->off]), n);
+                if (!peek && (s->options & SSL_OP_CLEANSE_PLAINTEXT))
+                    OPENSSL_cleanse(&(rr->data[rr->off]), n);
+            }
             buf += n;
             if (peek) {
                 /* Mark any zero length record as consumed CVE-2016-6305 */
                 if (SSL3_RECORD_get_length(rr) == 0)
                     SSL3_RECORD_set_read(rr);
             } else {
-                if (s->options & SSL_OP_CLEANSE_PLAINTEXT)
-                    OPENSSL_cleanse(&(rr->data[rr->off]), n);
                 SSL3_RECORD_sub_length(rr, n);
                 SSL3_RECORD_add_off(rr, n);
                 if (SSL3_RECORD_get_length(rr) == 0) {
@@ -29,6 +29,9 @@ typedef struct ssl3_buffer_st {
     int app_buffer;
 } SSL3_BUFFER;
 
+/* A pool of SSL3_BUFFER memory, see ssl3_buffer.c */
+typedef struct ssl_buffer_pool_st SSL_BUFFER_POOL;
+
 #define SEQ_NUM_SIZE                            8
 
 typedef struct ssl3_record_st {
@@ -162,6 +165,22 @@ typedef struct record_layer_st {
     /* number of bytes submitted */
     size_t wpend_ret;
     const unsigned char *wpend_buf;
+    /*
+     * The buffers of an SSL_writev() call in progress, and the offset of the
+     * data currently being written in them. The records are built straight
+     * from these, and there is no contiguous write buffer.
+     */
+    const SSL_IOVEC *wiov;
+    size_t wiovcnt;
+    size_t wiovoff;
+    /*
+     * The buffer of an SSL_read() call in progress that a TLSv1.3 application
+     * data record may be decrypted straight into (SSL_MODE_ZERO_COPY_READ),
+     * and the number of bytes delivered that way over the connection.
+     */
+    unsigned char *rdirect;
+    size_t rdirectlen;
+    uint64_t zero_copy_bytes;
     unsigned char read_sequence[SEQ_NUM_SIZE];
     unsigned char write_sequence[SEQ_NUM_SIZE];
     /* Set to true if this is the first record in a connection */
@@ -219,6 +238,12 @@ __owur int ssl3_read_bytes(SSL *s, int type, int *recvd_type,
                            unsigned char *buf, size_t len, int peek,
                            size_t *readbytes);
 __owur int ssl3_setup_buffers(SSL *s);
+SSL_BUFFER_POOL *ssl_buffer_pool_new(size_t max_idle);
+int ssl_buffer_pool_up_ref(SSL_BUFFER_POOL *pool);
+void ssl_buffer_pool_free(SSL_BUFFER_POOL *pool);
+void ssl_buffer_pool_set_max(SSL_BUFFER_POOL *pool, size_t max_idle);
+size_t ssl_buffer_pool_get_max(const SSL_BUFFER_POOL *pool);
+size_t ssl_buffer_pool_stat(SSL_BUFFER_POOL *pool, int cmd);
 __owur int ssl3_enc(SSL *s, SSL3_RECORD *inrecs, size_t n_recs, int send,
                     SSL_MAC_BUF *mac, size_t macsize);
 __owur int n_ssl3_mac(SSL *ssl, SSL3_RECORD *rec, unsigned char *md, int send);
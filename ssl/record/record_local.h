@@ -16,6 +16,12 @@
 
 #define MAX_WARN_ALERT_COUNT    5
 
+/*
+ * Maximum number of full AEAD records that ssl3_write_bytes() encrypts into a
+ * single write buffer and hands to the BIO in one write
+ */
+#define SSL3_WRITE_BATCH_MAX    4
+
 /* Functions/macros provided by the RECORD_LAYER component */
 
 #define RECORD_LAYER_get_rrec(rl)               ((rl)->rrec)
@@ -59,6 +65,7 @@ void dtls1_record_bitmap_update(SSL *s, DTLS1_BITMAP *bitmap);
 #define SSL3_BUFFER_set_len(b, l)           ((b)->len = (l))
 #define SSL3_BUFFER_get_left(b)             ((b)->left)
 #define SSL3_BUFFER_set_left(b, l)          ((b)->left = (l))
+#define SSL3_BUFFER_add_left(b, l)          ((b)->left += (l))
 #define SSL3_BUFFER_sub_left(b, l)          ((b)->left -= (l))
 #define SSL3_BUFFER_get_offset(b)           ((b)->offset)
 #define SSL3_BUFFER_set_offset(b, o)        ((b)->offset = (o))
@@ -70,7 +77,8 @@ void dtls1_record_bitmap_update(SSL *s, DTLS1_BITMAP *bitmap);
 
 void SSL3_BUFFER_clear(SSL3_BUFFER *b);
 void SSL3_BUFFER_set_data(SSL3_BUFFER *b, const unsigned char *d, size_t n);
-void SSL3_BUFFER_release(SSL3_BUFFER *b);
+void SSL3_BUFFER_release(SSL *s, SSL3_BUFFER *b);
+void ssl_buffer_release(SSL *s, unsigned char *buf, size_t len);
 __owur int ssl3_setup_read_buffer(SSL *s);
 __owur int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len);
 int ssl3_release_read_buffer(SSL *s);
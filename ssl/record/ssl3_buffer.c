@@ -10,6 +10,257 @@
 #include "../ssl_local.h"
 #include "record_local.h"
 
+/*
+ * Buffer pools
+ * ============
+ *
+ * An SSL_CTX can keep the record layer buffers that connections are done
+ * with, so that new connections, and connections that only hold buffers
+ * while records are in flight (SSL_MODE_RELEASE_BUFFERS), don't allocate
+ * and free them all the time.  Buffers are rounded up to a few size
+ * classes, from the smallest maximum fragment length up to the default
+ * maximum record size, and idle buffers are linked through their first
+ * bytes.
+ *
+ * The pool is split into stripes, each with its own lock.  A connection
+ * always uses the same stripe, so connections that are served by different
+ * threads rarely contend for a lock.
+ */
+
+#define SSL_BUFFER_POOL_CLASSES 6
+#define SSL_BUFFER_POOL_STRIPES 16
+/* Room for headers, alignment, encryption and compression overhead */
+#define SSL_BUFFER_POOL_SLACK   2048
+
+#define SSL_BUFFER_POOL_CLASS_LEN(i) \
+    (((size_t)512 << (i)) + SSL_BUFFER_POOL_SLACK)
+
+typedef struct ssl_buffer_pool_stripe_st {
+    CRYPTO_RWLOCK *lock;
+    void *idle_list[SSL_BUFFER_POOL_CLASSES];
+    size_t max_idle;
+    size_t idle;
+    size_t in_use;
+    size_t hits;
+    size_t misses;
+} SSL_BUFFER_POOL_STRIPE;
+
+struct ssl_buffer_pool_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    size_t max_idle;
+    SSL_BUFFER_POOL_STRIPE stripes[SSL_BUFFER_POOL_STRIPES];
+};
+
+SSL_BUFFER_POOL *ssl_buffer_pool_new(size_t max_idle)
+{
+    SSL_BUFFER_POOL *pool = OPENSSL_zalloc(sizeof(*pool));
+    size_t i;
+
+    if (pool == NULL)
+        goto err;
+    pool->references = 1;
+    if ((pool->lock = CRYPTO_THREAD_lock_new()) == NULL)
+        goto err;
+    for (i = 0; i < SSL_BUFFER_POOL_STRIPES; i++)
+        if ((pool->stripes[i].lock = CRYPTO_THREAD_lock_new()) == NULL)
+            goto err;
+    ssl_buffer_pool_set_max(pool, max_idle);
+    return pool;
+ err:
+    ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+    ssl_buffer_pool_free(pool);
+    return NULL;
+}
+
+int ssl_buffer_pool_up_ref(SSL_BUFFER_POOL *pool)
+{
+    int i;
+
+    if (CRYPTO_UP_REF(&pool->references, &i, pool->lock) <= 0)
+        return 0;
+
+    REF_PRINT_COUNT("SSL_BUFFER_POOL", pool);
+    REF_ASSERT_ISNT(i < 2);
+    return i > 1;
+}
+
+void ssl_buffer_pool_free(SSL_BUFFER_POOL *pool)
+{
+    SSL_BUFFER_POOL_STRIPE *st;
+    void *p;
+    size_t i, c;
+    int r;
+
+    if (pool == NULL)
+        return;
+    CRYPTO_DOWN_REF(&pool->references, &r, pool->lock);
+    REF_PRINT_COUNT("SSL_BUFFER_POOL", pool);
+    if (r > 0)
+        return;
+    REF_ASSERT_ISNT(r < 0);
+
+    for (i = 0; i < SSL_BUFFER_POOL_STRIPES; i++) {
+        st = &pool->stripes[i];
+        for (c = 0; c < SSL_BUFFER_POOL_CLASSES; c++) {
+            while ((p = st->idle_list[c]) != NULL) {
+                st->idle_list[c] = *(void **)p;
+                OPENSSL_free(p);
+            }
+        }
+        CRYPTO_THREAD_lock_free(st->lock);
+    }
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+/* Excess idle buffers are freed as buffers are returned */
+void ssl_buffer_pool_set_max(SSL_BUFFER_POOL *pool, size_t max_idle)
+{
+    size_t i;
+
+    pool->max_idle = max_idle;
+    for (i = 0; i < SSL_BUFFER_POOL_STRIPES; i++) {
+        if (!CRYPTO_THREAD_write_lock(pool->stripes[i].lock))
+            continue;
+        pool->stripes[i].max_idle = (max_idle + SSL_BUFFER_POOL_STRIPES - 1)
+                                    / SSL_BUFFER_POOL_STRIPES;
+        CRYPTO_THREAD_unlock(pool->stripes[i].lock);
+    }
+}
+
+size_t ssl_buffer_pool_get_max(const SSL_BUFFER_POOL *pool)
+{
+    return pool->max_idle;
+}
+
+/* |cmd| is one of the SSL_CTRL_BUFFER_POOL_* statistics */
+size_t ssl_buffer_pool_stat(SSL_BUFFER_POOL *pool, int cmd)
+{
+    SSL_BUFFER_POOL_STRIPE *st;
+    size_t i, ret = 0;
+
+    for (i = 0; i < SSL_BUFFER_POOL_STRIPES; i++) {
+        st = &pool->stripes[i];
+        if (!CRYPTO_THREAD_read_lock(st->lock))
+            continue;
+        switch (cmd) {
+        case SSL_CTRL_BUFFER_POOL_IDLE:
+            ret += st->idle;
+            break;
+        case SSL_CTRL_BUFFER_POOL_IN_USE:
+            ret += st->in_use;
+            break;
+        case SSL_CTRL_BUFFER_POOL_HITS:
+            ret += st->hits;
+            break;
+        case SSL_CTRL_BUFFER_POOL_MISSES:
+            ret += st->misses;
+            break;
+        }
+        CRYPTO_THREAD_unlock(st->lock);
+    }
+    return ret;
+}
+
+static ossl_inline SSL_BUFFER_POOL_STRIPE *ssl_buffer_stripe(const SSL *s)
+{
+    uint32_t h = (uint32_t)((size_t)s >> 4);
+
+    return &s->buffer_pool->stripes[((h * 0x9E3779B1U) >> 16)
+                                    % SSL_BUFFER_POOL_STRIPES];
+}
+
+static ossl_inline int ssl_buffer_class(size_t len)
+{
+    int c;
+
+    for (c = 0; c < SSL_BUFFER_POOL_CLASSES; c++)
+        if (len <= SSL_BUFFER_POOL_CLASS_LEN(c))
+            return c;
+    return -1;
+}
+
+/* The length of the buffer that ssl_buffer_alloc() returns for |len| */
+static size_t ssl_buffer_len(const SSL *s, size_t len)
+{
+    int c;
+
+    if (s->buffer_pool == NULL || (c = ssl_buffer_class(len)) < 0)
+        return len;
+    return SSL_BUFFER_POOL_CLASS_LEN(c);
+}
+
+/*
+ * Allocates a record layer buffer of at least |*len| bytes, and sets |*len|
+ * to its actual length.  It must be freed with ssl_buffer_release().
+ */
+static unsigned char *ssl_buffer_alloc(SSL *s, size_t *len)
+{
+    SSL_BUFFER_POOL_STRIPE *st;
+    unsigned char *p = NULL;
+    int c;
+
+    if (s->buffer_pool == NULL)
+        return OPENSSL_malloc(*len);
+
+    st = ssl_buffer_stripe(s);
+    if ((c = ssl_buffer_class(*len)) >= 0)
+        *len = SSL_BUFFER_POOL_CLASS_LEN(c);
+    /* A miss is counted up front, so that the lock is only taken once */
+    if (!CRYPTO_THREAD_write_lock(st->lock))
+        return NULL;
+    if (c >= 0 && (p = st->idle_list[c]) != NULL) {
+        st->idle_list[c] = *(void **)p;
+        st->idle--;
+        st->hits++;
+    } else {
+        st->misses++;
+    }
+    st->in_use++;
+    CRYPTO_THREAD_unlock(st->lock);
+    if (p != NULL)
+        return p;
+
+    if ((p = OPENSSL_malloc(*len)) == NULL
+            && CRYPTO_THREAD_write_lock(st->lock)) {
+        st->in_use--;
+        CRYPTO_THREAD_unlock(st->lock);
+    }
+    return p;
+}
+
+void ssl_buffer_release(SSL *s, unsigned char *buf, size_t len)
+{
+    SSL_BUFFER_POOL_STRIPE *st;
+    int c;
+
+    if (buf == NULL)
+        return;
+    if (s->buffer_pool == NULL) {
+        OPENSSL_free(buf);
+        return;
+    }
+
+    st = ssl_buffer_stripe(s);
+    c = ssl_buffer_class(len);
+    if (!CRYPTO_THREAD_write_lock(st->lock)) {
+        OPENSSL_free(buf);
+        return;
+    }
+    st->in_use--;
+    /* Only buffers of exactly the length of a class were allocated by it */
+    if (c >= 0 && len == SSL_BUFFER_POOL_CLASS_LEN(c)
+            && st->idle < st->max_idle) {
+        *(void **)buf = st->idle_list[c];
+        st->idle_list[c] = buf;
+        st->idle++;
+        buf = NULL;
+    }
+    CRYPTO_THREAD_unlock(st->lock);
+    OPENSSL_free(buf);
+}
+
 void SSL3_BUFFER_set_data(SSL3_BUFFER *b, const unsigned char *d, size_t n)
 {
     if (d != NULL)
@@ -28,9 +279,9 @@ void SSL3_BUFFER_clear(SSL3_BUFFER *b)
     b->left = 0;
 }
 
-void SSL3_BUFFER_release(SSL3_BUFFER *b)
+void SSL3_BUFFER_release(SSL *s, SSL3_BUFFER *b)
 {
-    OPENSSL_free(b->buf);
+    ssl_buffer_release(s, b->buf, b->len);
     b->buf = NULL;
 }
 
@@ -60,7 +311,7 @@ int ssl3_setup_read_buffer(SSL *s)
 #endif
         if (b->default_len > len)
             len = b->default_len;
-        if ((p = OPENSSL_malloc(len)) == NULL) {
+        if ((p = ssl_buffer_alloc(s, &len)) == NULL) {
             /*
              * We've got a malloc failure, and we're still initialising buffers.
              * We assume we're so doomed that we won't even be able to send an
@@ -105,18 +356,19 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
             len += headerlen + align + SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD;
     }
 
+    len = ssl_buffer_len(s, len);
     wb = RECORD_LAYER_get_wbuf(&s->rlayer);
     for (currpipe = 0; currpipe < numwpipes; currpipe++) {
         SSL3_BUFFER *thiswb = &wb[currpipe];
 
         if (thiswb->len != len) {
-            OPENSSL_free(thiswb->buf);
+            ssl_buffer_release(s, thiswb->buf, thiswb->len);
             thiswb->buf = NULL;         /* force reallocation */
         }
 
         if (thiswb->buf == NULL) {
             if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio)) {
-                p = OPENSSL_malloc(len);
+                p = ssl_buffer_alloc(s, &len);
                 if (p == NULL) {
                     s->rlayer.numwpipes = currpipe;
                     /*
@@ -164,7 +416,7 @@ int ssl3_release_write_buffer(SSL *s)
         if (SSL3_BUFFER_is_app_buffer(wb))
             SSL3_BUFFER_set_app_buffer(wb, 0);
         else
-            OPENSSL_free(wb->buf);
+            ssl_buffer_release(s, wb->buf, wb->len);
         wb->buf = NULL;
         pipes--;
     }
@@ -179,7 +431,7 @@ int ssl3_release_read_buffer(SSL *s)
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
     if (s->options & SSL_OP_CLEANSE_PLAINTEXT)
         OPENSSL_cleanse(b->buf, b->len);
-    OPENSSL_free(b->buf);
+    ssl_buffer_release(s, b->buf, b->len);
     b->buf = NULL;
     return 1;
 }
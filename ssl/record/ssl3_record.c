@@ -187,7 +187,7 @@ int ssl3_get_record(SSL *s)
     PACKET pkt, sslv2pkt;
     int is_ktls_left;
     SSL_MAC_BUF *macbufs = NULL;
-    int ret = -1;
+    int ret = -1, direct = 0;
 
     rr = RECORD_LAYER_get_rrec(&s->rlayer);
     rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
@@ -362,7 +362,9 @@ int ssl3_get_record(SSL *s)
                 }
 
                 if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL) {
-                    if (thisrr->type != SSL3_RT_APPLICATION_DATA
+                    /* KTLS passes up the inner content type */
+                    if (!(BIO_get_ktls_recv(s->rbio) && !is_ktls_left)
+                            && thisrr->type != SSL3_RT_APPLICATION_DATA
                             && (thisrr->type != SSL3_RT_CHANGE_CIPHER_SPEC
                                 || !SSL_IS_FIRST_HANDSHAKE(s))
                             && (thisrr->type != SSL3_RT_ALERT
@@ -391,7 +393,9 @@ int ssl3_get_record(SSL *s)
         }
 
         if (SSL_IS_TLS13(s)) {
-            if (thisrr->length > SSL3_RT_MAX_TLS13_ENCRYPTED_LENGTH) {
+            /* KTLS may use all of the buffer, as below */
+            if (thisrr->length > SSL3_RT_MAX_TLS13_ENCRYPTED_LENGTH
+                    && (!BIO_get_ktls_recv(s->rbio) || is_ktls_left)) {
                 SSLfatal(s, SSL_AD_RECORD_OVERFLOW,
                          SSL_R_ENCRYPTED_LENGTH_TOO_LONG);
                 return -1;
@@ -576,6 +580,22 @@ int ssl3_get_record(SSL *s)
         }
     }
 
+    /*
+     * In SSL_MODE_ZERO_COPY_READ a TLSv1.3 application data record is
+     * decrypted straight into the caller's buffer if that can hold all of it.
+     * The plaintext is never longer than the ciphertext less the shortest tag.
+     */
+    if (s->rlayer.rdirect != NULL
+            && num_recs == 1
+            && SSL_IS_TLS13(s)
+            && s->enc_read_ctx != NULL
+            && rr[0].type == SSL3_RT_APPLICATION_DATA
+            && rr[0].length > EVP_CCM8_TLS_TAG_LEN
+            && rr[0].length - EVP_CCM8_TLS_TAG_LEN <= s->rlayer.rdirectlen) {
+        rr[0].data = s->rlayer.rdirect;
+        direct = 1;
+    }
+
     enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0, macbufs, mac_size);
 
     /*-
@@ -585,6 +605,11 @@ int ssl3_get_record(SSL *s)
      *    1: Success or MTE decryption failed (MAC will be randomised)
      */
     if (enc_err == 0) {
+        if (direct) {
+            /* Don't leave unauthenticated plaintext in the caller's buffer */
+            OPENSSL_cleanse(rr[0].data, rr[0].orig_len - EVP_CCM8_TLS_TAG_LEN);
+            rr[0].data = rr[0].input;
+        }
         if (ossl_statem_in_error(s)) {
             /* SSLfatal() already got called */
             goto end;
@@ -674,8 +699,10 @@ int ssl3_get_record(SSL *s)
             }
         }
 
+        /* KTLS has already removed the padding and inner content type */
         if (SSL_IS_TLS13(s)
                 && s->enc_read_ctx != NULL
+                && (!BIO_get_ktls_recv(s->rbio) || is_ktls_left)
                 && thisrr->type != SSL3_RT_ALERT) {
             size_t end;
 
@@ -701,6 +728,13 @@ int ssl3_get_record(SSL *s)
             if (s->msg_callback)
                 s->msg_callback(0, s->version, SSL3_RT_INNER_CONTENT_TYPE,
                                 &thisrr->data[end], 1, s, s->msg_callback_arg);
+
+            /* Only application data is left in the caller's buffer */
+            if (direct && thisrr->type != SSL3_RT_APPLICATION_DATA) {
+                memcpy(thisrr->input, thisrr->data, thisrr->length);
+                OPENSSL_cleanse(thisrr->data, end + 1);
+                thisrr->data = thisrr->input;
+            }
         }
 
         /*
@@ -1040,6 +1074,20 @@ int tls1_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
         bs = EVP_CIPHER_get_block_size(EVP_CIPHER_CTX_get0_cipher(ds));
 
         if (n_recs > 1) {
+            if (sending
+                    && (EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(ds))
+                        & (EVP_CIPH_FLAG_PIPELINE | EVP_CIPH_FLAG_AEAD_CIPHER))
+                       == EVP_CIPH_FLAG_AEAD_CIPHER) {
+                /*
+                 * A batch of records from ssl3_write_bytes(). Each AEAD
+                 * record is self-contained, so encrypt them in turn.
+                 */
+                for (ctr = 0; ctr < n_recs; ctr++) {
+                    if (tls1_enc(s, &recs[ctr], 1, sending, NULL, 0) < 1)
+                        return 0;
+                }
+                return 1;
+            }
             if ((EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(ds))
                   & EVP_CIPH_FLAG_PIPELINE) == 0) {
                 /*
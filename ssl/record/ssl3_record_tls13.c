@@ -14,7 +14,9 @@
 /*-
  * tls13_enc encrypts/decrypts |n_recs| in |recs|. Calls SSLfatal on internal
  * error, but not otherwise. It is the responsibility of the caller to report
- * a bad_record_mac.
+ * a bad_record_mac. More than one record is only ever passed when sending, in
+ * which case the records are encrypted in turn with consecutive sequence
+ * numbers.
  *
  * Returns:
  *    0: On failure
@@ -25,7 +27,7 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
 {
     EVP_CIPHER_CTX *ctx;
     unsigned char iv[EVP_MAX_IV_LENGTH], recheader[SSL3_RT_HEADER_LENGTH];
-    size_t ivlen, taglen, offset, loop, hdrlen;
+    size_t ivlen, taglen, offset, loop, hdrlen, ctr;
     unsigned char *staticiv;
     unsigned char *seq;
     int lenu, lenf;
@@ -33,7 +35,7 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
     uint32_t alg_enc;
     WPACKET wpkt;
 
-    if (n_recs != 1) {
+    if (n_recs == 0 || (!sending && n_recs != 1)) {
         /* Should not happen */
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
         return 0;
@@ -56,8 +58,10 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
      * far then we have already validated that a plaintext alert is ok here.
      */
     if (ctx == NULL || rec->type == SSL3_RT_ALERT) {
-        memmove(rec->data, rec->input, rec->length);
-        rec->input = rec->data;
+        for (ctr = 0; ctr < n_recs; ctr++) {
+            memmove(recs[ctr].data, recs[ctr].input, recs[ctr].length);
+            recs[ctr].input = recs[ctr].data;
+        }
         return 1;
     }
 
@@ -106,17 +110,6 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
         return 0;
     }
 
-    if (!sending) {
-        /*
-         * Take off tag. There must be at least one byte of content type as
-         * well as the tag
-         */
-        if (rec->length < taglen + 1)
-            return 0;
-        rec->length -= taglen;
-    }
-
-    /* Set up IV */
     if (ivlen < SEQ_NUM_SIZE) {
         /* Should not happen */
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
@@ -124,64 +117,80 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending,
     }
     offset = ivlen - SEQ_NUM_SIZE;
     memcpy(iv, staticiv, offset);
-    for (loop = 0; loop < SEQ_NUM_SIZE; loop++)
-        iv[offset + loop] = staticiv[offset + loop] ^ seq[loop];
-
-    /* Increment the sequence counter */
-    for (loop = SEQ_NUM_SIZE; loop > 0; loop--) {
-        ++seq[loop - 1];
-        if (seq[loop - 1] != 0)
-            break;
-    }
-    if (loop == 0) {
-        /* Sequence has wrapped */
-        return 0;
-    }
 
-    if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, sending) <= 0
-            || (!sending && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
-                                             taglen,
-                                             rec->data + rec->length) <= 0)) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        return 0;
-    }
+    for (ctr = 0; ctr < n_recs; ctr++) {
+        rec = &recs[ctr];
 
-    /* Set up the AAD */
-    if (!WPACKET_init_static_len(&wpkt, recheader, sizeof(recheader), 0)
-            || !WPACKET_put_bytes_u8(&wpkt, rec->type)
-            || !WPACKET_put_bytes_u16(&wpkt, rec->rec_version)
-            || !WPACKET_put_bytes_u16(&wpkt, rec->length + taglen)
-            || !WPACKET_get_total_written(&wpkt, &hdrlen)
-            || hdrlen != SSL3_RT_HEADER_LENGTH
-            || !WPACKET_finish(&wpkt)) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        WPACKET_cleanup(&wpkt);
-        return 0;
-    }
+        if (!sending) {
+            /*
+             * Take off tag. There must be at least one byte of content type as
+             * well as the tag
+             */
+            if (rec->length < taglen + 1)
+                return 0;
+            rec->length -= taglen;
+        }
 
-    /*
-     * For CCM we must explicitly set the total plaintext length before we add
-     * any AAD.
-     */
-    if (((alg_enc & SSL_AESCCM) != 0
-                 && EVP_CipherUpdate(ctx, NULL, &lenu, NULL,
-                                     (unsigned int)rec->length) <= 0)
-            || EVP_CipherUpdate(ctx, NULL, &lenu, recheader,
-                                sizeof(recheader)) <= 0
-            || EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
-                                (unsigned int)rec->length) <= 0
-            || EVP_CipherFinal_ex(ctx, rec->data + lenu, &lenf) <= 0
-            || (size_t)(lenu + lenf) != rec->length) {
-        return 0;
-    }
-    if (sending) {
-        /* Add the tag */
-        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, taglen,
-                                rec->data + rec->length) <= 0) {
+        /* Set up IV */
+        for (loop = 0; loop < SEQ_NUM_SIZE; loop++)
+            iv[offset + loop] = staticiv[offset + loop] ^ seq[loop];
+
+        /* Increment the sequence counter */
+        for (loop = SEQ_NUM_SIZE; loop > 0; loop--) {
+            ++seq[loop - 1];
+            if (seq[loop - 1] != 0)
+                break;
+        }
+        if (loop == 0) {
+            /* Sequence has wrapped */
+            return 0;
+        }
+
+        if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, sending) <= 0
+                || (!sending
+                    && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, taglen,
+                                           rec->input + rec->length) <= 0)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+
+        /* Set up the AAD */
+        if (!WPACKET_init_static_len(&wpkt, recheader, sizeof(recheader), 0)
+                || !WPACKET_put_bytes_u8(&wpkt, rec->type)
+                || !WPACKET_put_bytes_u16(&wpkt, rec->rec_version)
+                || !WPACKET_put_bytes_u16(&wpkt, rec->length + taglen)
+                || !WPACKET_get_total_written(&wpkt, &hdrlen)
+                || hdrlen != SSL3_RT_HEADER_LENGTH
+                || !WPACKET_finish(&wpkt)) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+            WPACKET_cleanup(&wpkt);
+            return 0;
+        }
+
+        /*
+         * For CCM we must explicitly set the total plaintext length before we
+         * add any AAD.
+         */
+        if (((alg_enc & SSL_AESCCM) != 0
+                     && EVP_CipherUpdate(ctx, NULL, &lenu, NULL,
+                                         (unsigned int)rec->length) <= 0)
+                || EVP_CipherUpdate(ctx, NULL, &lenu, recheader,
+                                    sizeof(recheader)) <= 0
+                || EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
+                                    (unsigned int)rec->length) <= 0
+                || EVP_CipherFinal_ex(ctx, rec->data + lenu, &lenf) <= 0
+                || (size_t)(lenu + lenf) != rec->length) {
             return 0;
         }
-        rec->length += taglen;
+        if (sending) {
+            /* Add the tag */
+            if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, taglen,
+                                    rec->data + rec->length) <= 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            rec->length += taglen;
+        }
     }
 
     return 1;
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * The key share pool
+ * ==================
+ *
+ * An SSL_CTX can hold ephemeral key pairs that were generated ahead of
+ * time, up to a configured depth for each group in its group list.  The
+ * handshake takes a key from the pool instead of generating one, if there
+ * is one for the negotiated group, and falls back to generating it
+ * otherwise.  Keys are removed from the pool when they are taken, so every
+ * key is used for one handshake only.
+ *
+ * The pool is only ever refilled by SSL_CTX_fill_key_share_pool(), which
+ * the application calls from a thread of its own or when it is idle, so
+ * that key generation stays off the handshake path.  Keys are generated
+ * without the lock held.
+ *
+ * A process that is forked after the pool was filled would share the keys
+ * with its parent, so the keys are thrown away when the pool is used in
+ * another process than the one that filled it.  Where libssl can't be
+ * unloaded, a fork handler counts the forks, so that taking a key doesn't
+ * cost a getpid() call.
+ */
+
+#include "ssl_local.h"
+#include "internal/thread_once.h"
+
+#ifdef OPENSSL_SYS_UNIX
+# include <unistd.h>
+# if defined(OPENSSL_THREADS) && defined(OPENSSL_USE_NODELETE)
+#  include <pthread.h>
+#  define KEY_SHARE_POOL_ATFORK
+# endif
+#endif
+
+/* Keys generated at a time by SSL_CTX_fill_key_share_pool() */
+#define KEY_SHARE_POOL_BATCH    16
+
+typedef struct ssl_key_share_slot_st {
+    uint16_t group_id;
+    EVP_PKEY **keys;
+    size_t num;
+} SSL_KEY_SHARE_SLOT;
+
+struct ssl_key_share_pool_st {
+    CRYPTO_RWLOCK *lock;
+    size_t depth;
+    SSL_KEY_SHARE_SLOT *slots;
+    size_t numslots;
+    size_t hits;
+    size_t misses;
+#ifdef OPENSSL_SYS_UNIX
+    unsigned long fork_id;
+#endif
+};
+
+#ifdef KEY_SHARE_POOL_ATFORK
+static unsigned long key_share_pool_forks = 0;
+static CRYPTO_ONCE key_share_pool_fork_once = CRYPTO_ONCE_STATIC_INIT;
+
+/* Only the forking thread runs in the child, so no lock is needed */
+static void key_share_pool_fork_child(void)
+{
+    key_share_pool_forks++;
+}
+
+DEFINE_RUN_ONCE_STATIC(key_share_pool_fork_init)
+{
+    return pthread_atfork(NULL, NULL, key_share_pool_fork_child) == 0;
+}
+#endif
+
+#ifdef OPENSSL_SYS_UNIX
+/* Changes whenever the process was forked */
+static unsigned long key_share_pool_fork_id(void)
+{
+# ifdef KEY_SHARE_POOL_ATFORK
+    return key_share_pool_forks;
+# else
+    return (unsigned long)getpid();
+# endif
+}
+#endif
+
+SSL_KEY_SHARE_POOL *ssl_key_share_pool_new(size_t depth)
+{
+    SSL_KEY_SHARE_POOL *pool;
+
+#ifdef KEY_SHARE_POOL_ATFORK
+    if (!RUN_ONCE(&key_share_pool_fork_once, key_share_pool_fork_init)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR);
+        return NULL;
+    }
+#endif
+    if ((pool = OPENSSL_zalloc(sizeof(*pool))) == NULL
+            || (pool->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(pool);
+        return NULL;
+    }
+    pool->depth = depth;
+#ifdef OPENSSL_SYS_UNIX
+    pool->fork_id = key_share_pool_fork_id();
+#endif
+    return pool;
+}
+
+/* Called with the lock held */
+static void key_share_pool_trim(SSL_KEY_SHARE_POOL *pool, size_t depth)
+{
+    SSL_KEY_SHARE_SLOT *slot;
+    size_t i;
+
+    for (i = 0; i < pool->numslots; i++) {
+        slot = &pool->slots[i];
+        while (slot->num > depth)
+            EVP_PKEY_free(slot->keys[--slot->num]);
+    }
+}
+
+/* Called with the lock held */
+static void key_share_pool_check_fork(SSL_KEY_SHARE_POOL *pool)
+{
+#ifdef OPENSSL_SYS_UNIX
+    unsigned long fork_id = key_share_pool_fork_id();
+
+    if (pool->fork_id != fork_id) {
+        key_share_pool_trim(pool, 0);
+        pool->fork_id = fork_id;
+    }
+#endif
+}
+
+void ssl_key_share_pool_free(SSL_KEY_SHARE_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL)
+        return;
+    key_share_pool_trim(pool, 0);
+    for (i = 0; i < pool->numslots; i++)
+        OPENSSL_free(pool->slots[i].keys);
+    OPENSSL_free(pool->slots);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+/* Excess keys are freed right away */
+void ssl_key_share_pool_set_depth(SSL_KEY_SHARE_POOL *pool, size_t depth)
+{
+    if (!CRYPTO_THREAD_write_lock(pool->lock))
+        return;
+    pool->depth = depth;
+    key_share_pool_trim(pool, depth);
+    CRYPTO_THREAD_unlock(pool->lock);
+}
+
+size_t ssl_key_share_pool_get_depth(SSL_KEY_SHARE_POOL *pool)
+{
+    size_t depth;
+
+    if (!CRYPTO_THREAD_read_lock(pool->lock))
+        return 0;
+    depth = pool->depth;
+    CRYPTO_THREAD_unlock(pool->lock);
+    return depth;
+}
+
+/* |cmd| is one of the SSL_CTRL_KEY_SHARE_POOL_* statistics */
+size_t ssl_key_share_pool_stat(SSL_KEY_SHARE_POOL *pool, int cmd)
+{
+    size_t i, ret = 0;
+
+    if (!CRYPTO_THREAD_read_lock(pool->lock))
+        return 0;
+    switch (cmd) {
+    case SSL_CTRL_KEY_SHARE_POOL_IDLE:
+        for (i = 0; i < pool->numslots; i++)
+            ret += pool->slots[i].num;
+        break;
+    case SSL_CTRL_KEY_SHARE_POOL_HITS:
+        ret = pool->hits;
+        break;
+    case SSL_CTRL_KEY_SHARE_POOL_MISSES:
+        ret = pool->misses;
+        break;
+    }
+    CRYPTO_THREAD_unlock(pool->lock);
+    return ret;
+}
+
+/* Called with the lock held */
+static SSL_KEY_SHARE_SLOT *key_share_pool_slot(SSL_KEY_SHARE_POOL *pool,
+                                               uint16_t group_id)
+{
+    size_t i;
+
+    for (i = 0; i < pool->numslots; i++)
+        if (pool->slots[i].group_id == group_id)
+            return &pool->slots[i];
+    return NULL;
+}
+
+/*
+ * Take a key for |group_id| out of the pool of the SSL_CTX of |s|.  Returns
+ * NULL if there is none, the caller then generates the key itself.
+ */
+EVP_PKEY *ssl_key_share_pool_get(SSL *s, uint16_t group_id)
+{
+    SSL_KEY_SHARE_POOL *pool = s->ctx->key_share_pool;
+    SSL_KEY_SHARE_SLOT *slot;
+    EVP_PKEY *pkey = NULL;
+
+    if (pool == NULL || !CRYPTO_THREAD_write_lock(pool->lock))
+        return NULL;
+    key_share_pool_check_fork(pool);
+    slot = key_share_pool_slot(pool, group_id);
+    if (slot != NULL && slot->num > 0) {
+        pkey = slot->keys[--slot->num];
+        slot->keys[slot->num] = NULL;
+        pool->hits++;
+    } else if (pool->depth > 0) {
+        pool->misses++;
+    }
+    CRYPTO_THREAD_unlock(pool->lock);
+    return pkey;
+}
+
+/* How many keys for |group_id| are missing, 0 on error */
+static size_t key_share_pool_missing(SSL_KEY_SHARE_POOL *pool,
+                                     uint16_t group_id)
+{
+    SSL_KEY_SHARE_SLOT *slot, *slots;
+    size_t ret = 0;
+
+    if (!CRYPTO_THREAD_write_lock(pool->lock))
+        return 0;
+    key_share_pool_check_fork(pool);
+    if ((slot = key_share_pool_slot(pool, group_id)) == NULL) {
+        slots = OPENSSL_realloc(pool->slots,
+                                (pool->numslots + 1) * sizeof(*slots));
+        if (slots == NULL) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            goto end;
+        }
+        pool->slots = slots;
+        slot = &slots[pool->numslots++];
+        memset(slot, 0, sizeof(*slot));
+        slot->group_id = group_id;
+    }
+    if (slot->num < pool->depth)
+        ret = pool->depth - slot->num;
+ end:
+    CRYPTO_THREAD_unlock(pool->lock);
+    return ret;
+}
+
+/*
+ * Add the |num| keys in |keys| to the pool, as long as there is room for
+ * them, and free the rest
+ */
+static int key_share_pool_add(SSL_KEY_SHARE_POOL *pool, uint16_t group_id,
+                              EVP_PKEY *keys[], size_t num)
+{
+    SSL_KEY_SHARE_SLOT *slot;
+    EVP_PKEY **tmp;
+    size_t i = 0;
+    int ret = 0;
+
+    if (!CRYPTO_THREAD_write_lock(pool->lock))
+        goto end;
+    key_share_pool_check_fork(pool);
+    if ((slot = key_share_pool_slot(pool, group_id)) == NULL)
+        goto unlock;
+    if (slot->num < pool->depth) {
+        tmp = OPENSSL_realloc(slot->keys, pool->depth * sizeof(*tmp));
+        if (tmp == NULL) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            goto unlock;
+        }
+        slot->keys = tmp;
+        for (; i < num && slot->num < pool->depth; i++)
+            slot->keys[slot->num++] = keys[i];
+    }
+    ret = 1;
+ unlock:
+    CRYPTO_THREAD_unlock(pool->lock);
+ end:
+    for (; i < num; i++)
+        EVP_PKEY_free(keys[i]);
+    return ret;
+}
+
+static int key_share_pool_fill_group(SSL_CTX *ctx, SSL_KEY_SHARE_POOL *pool,
+                                     const TLS_GROUP_INFO *ginf)
+{
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *keys[KEY_SHARE_POOL_BATCH];
+    size_t missing, n;
+    int ret = 0;
+
+    while ((missing = key_share_pool_missing(pool, ginf->group_id)) > 0) {
+        if (pctx == NULL) {
+            pctx = EVP_PKEY_CTX_new_from_name(ctx->libctx, ginf->algorithm,
+                                              ctx->propq);
+            if (pctx == NULL
+                    || EVP_PKEY_keygen_init(pctx) <= 0
+                    || !EVP_PKEY_CTX_set_group_name(pctx, ginf->realname)) {
+                ERR_raise(ERR_LIB_SSL, ERR_R_EVP_LIB);
+                goto err;
+            }
+        }
+        n = missing < OSSL_NELEM(keys) ? missing : OSSL_NELEM(keys);
+        if (EVP_PKEY_generate_batch(pctx, n, keys) <= 0) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_EVP_LIB);
+            goto err;
+        }
+        if (!key_share_pool_add(pool, ginf->group_id, keys, n))
+            goto err;
+    }
+    ret = 1;
+ err:
+    EVP_PKEY_CTX_free(pctx);
+    return ret;
+}
+
+int SSL_CTX_fill_key_share_pool(SSL_CTX *ctx)
+{
+    SSL_KEY_SHARE_POOL *pool = ctx->key_share_pool;
+    const TLS_GROUP_INFO *ginf;
+    const uint16_t *groups;
+    size_t i, numgroups;
+
+    if (pool == NULL)
+        return 1;
+
+    if (ctx->ext.supportedgroups != NULL) {
+        groups = ctx->ext.supportedgroups;
+        numgroups = ctx->ext.supportedgroups_len;
+    } else {
+        groups = ctx->ext.supported_groups_default;
+        numgroups = ctx->ext.supported_groups_default_len;
+    }
+    for (i = 0; i < numgroups; i++) {
+        ginf = tls1_group_id_lookup(ctx, groups[i]);
+        /* A server encapsulates to the key of the client for KEM groups */
+        if (ginf == NULL || ginf->is_kem)
+            continue;
+        if (!key_share_pool_fill_group(ctx, pool, ginf))
+            return 0;
+    }
+    return 1;
+}
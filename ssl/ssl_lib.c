@@ -24,6 +24,9 @@
 #include "internal/cryptlib.h"
 #include "internal/refcount.h"
 #include "internal/ktls.h"
+#ifndef OPENSSL_NO_KTLS
+# include <sys/stat.h>
+#endif
 
 static int ssl_undefined_function_1(SSL *ssl, SSL3_RECORD *r, size_t s, int t,
                                     SSL_MAC_BUF *mac, size_t macsize)
@@ -566,6 +569,18 @@ static void clear_ciphers(SSL *s)
     ssl_clear_hash_ctx(&s->write_hash);
 }
 
+#ifndef OPENSSL_NO_KTLS
+static void ssl_splice_pipe_free(SSL *s)
+{
+    if (s->splice_pipe[0] != -1) {
+        close(s->splice_pipe[0]);
+        close(s->splice_pipe[1]);
+        s->splice_pipe[0] = s->splice_pipe[1] = -1;
+    }
+    s->splice_pipe_len = 0;
+}
+#endif
+
 int SSL_clear(SSL *s)
 {
     if (s->method == NULL) {
@@ -640,6 +655,9 @@ int SSL_clear(SSL *s)
     }
 
     RECORD_LAYER_clear(&s->rlayer);
+#ifndef OPENSSL_NO_KTLS
+    ssl_splice_pipe_free(s);
+#endif
 
     return 1;
 }
@@ -695,6 +713,9 @@ SSL *SSL_new(SSL_CTX *ctx)
     }
 
     RECORD_LAYER_init(&s->rlayer, s);
+#ifndef OPENSSL_NO_KTLS
+    s->splice_pipe[0] = s->splice_pipe[1] = -1;
+#endif
 
     s->options = ctx->options;
     s->dane.flags = ctx->dane.flags;
@@ -754,6 +775,8 @@ SSL *SSL_new(SSL_CTX *ctx)
         RECORD_LAYER_set_read_ahead(&s->rlayer, 1);
     if (ctx->default_read_buf_len > 0)
         SSL_set_default_read_buffer_len(s, ctx->default_read_buf_len);
+    if (ctx->buffer_pool != NULL && ssl_buffer_pool_up_ref(ctx->buffer_pool))
+        s->buffer_pool = ctx->buffer_pool;
 
     SSL_CTX_up_ref(ctx);
     s->ctx = ctx;
@@ -926,6 +949,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
      * by this SSL.
      */
     SSL_SESSION r, *p;
+    SSL_SESSION_CACHE_SHARD *sh;
 
     if (id_len > sizeof(r.session_id))
         return 0;
@@ -934,10 +958,11 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
-    if (!CRYPTO_THREAD_read_lock(ssl->session_ctx->lock))
+    sh = ssl_session_cache_shard(ssl->session_ctx, &r);
+    if (!CRYPTO_THREAD_read_lock(sh->lock))
         return 0;
-    p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
-    CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
+    p = lh_SSL_SESSION_retrieve(sh->sessions, &r);
+    CRYPTO_THREAD_unlock(sh->lock);
     return (p != NULL);
 }
 
@@ -1248,10 +1273,17 @@ void SSL_free(SSL *s)
     if (s->method != NULL)
         s->method->ssl_free(s);
 
+    /* All record layer buffers have been released by now */
+    ssl_buffer_pool_free(s->buffer_pool);
+
     SSL_CTX_free(s->ctx);
 
     ASYNC_WAIT_CTX_free(s->waitctx);
 
+#ifndef OPENSSL_NO_KTLS
+    ssl_splice_pipe_free(s);
+#endif
+
 #if !defined(OPENSSL_NO_NEXTPROTONEG)
     OPENSSL_free(s->ext.npn);
 #endif
@@ -1889,6 +1921,37 @@ int SSL_read_ex(SSL *s, void *buf, size_t num, size_t *readbytes)
     return ret;
 }
 
+int SSL_readv(SSL *s, const SSL_IOVEC *iov, size_t iovcnt, size_t *readbytes)
+{
+    size_t i, n, total = 0;
+    int ret = 0, tried = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0)
+            continue;
+        /*
+         * Only move on to the next buffer if that doesn't mean waiting for
+         * more data
+         */
+        if (tried && SSL_pending(s) == 0)
+            break;
+        tried = 1;
+        ret = ssl_read_internal(s, iov[i].data, iov[i].len, &n);
+        if (ret <= 0)
+            break;
+        total += n;
+        if (n < iov[i].len)
+            break;
+    }
+    if (!tried)
+        return SSL_read_ex(s, NULL, 0, readbytes);
+
+    *readbytes = total;
+    if (total > 0)
+        return 1;
+    return ret < 0 ? 0 : ret;
+}
+
 int SSL_read_early_data(SSL *s, void *buf, size_t num, size_t *readbytes)
 {
     int ret;
@@ -2008,6 +2071,11 @@ int SSL_peek_ex(SSL *s, void *buf, size_t num, size_t *readbytes)
     return ret;
 }
 
+uint64_t SSL_get_zero_copy_read_bytes(const SSL *s)
+{
+    return s->rlayer.zero_copy_bytes;
+}
+
 int ssl_write_internal(SSL *s, const void *buf, size_t num, size_t *written)
 {
     if (s->handshake_func == NULL) {
@@ -2112,6 +2180,121 @@ ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size, int flags)
 #endif
 }
 
+ossl_ssize_t SSL_splice(SSL *s, int fd, size_t size, int flags)
+{
+#ifdef OPENSSL_NO_KTLS
+    ERR_raise_data(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR,
+                   "can't call ktls_splice(), ktls disabled");
+    return -1;
+#else
+    unsigned char buf[4096];
+    struct stat st;
+    size_t readbytes;
+    ossl_ssize_t ret;
+    int to_pipe;
+
+    if (s->handshake_func == NULL) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_UNINITIALIZED);
+        return -1;
+    }
+
+    if (!BIO_get_ktls_recv(s->rbio)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_UNINITIALIZED);
+        return -1;
+    }
+
+    if (s->shutdown & SSL_RECEIVED_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        return 0;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "calling fstat()");
+        return -1;
+    }
+    to_pipe = S_ISFIFO(st.st_mode);
+    if (size > OSSL_SSIZE_MAX)
+        size = OSSL_SSIZE_MAX;
+
+    s->rwstate = SSL_NOTHING;
+    for (;;) {
+        /* Data already taken off the socket goes out first, in order */
+        if (s->splice_pipe_len > 0) {
+            ret = ktls_splice(s->splice_pipe[0], fd,
+                              size < s->splice_pipe_len ? size
+                                                        : s->splice_pipe_len,
+                              flags);
+            if (ret <= 0)
+                goto write_err;
+            s->splice_pipe_len -= ret;
+            return ret;
+        }
+        if (SSL_has_pending(s)) {
+            if (!SSL_peek_ex(s, buf, size < sizeof(buf) ? size : sizeof(buf),
+                             &readbytes))
+                return SSL_get_error(s, 0) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+            ret = write(fd, buf, readbytes);
+            if (ret <= 0)
+                goto write_err;
+            /* Only consume what could be written */
+            if (!SSL_read_ex(s, buf, (size_t)ret, &readbytes))
+                return -1;
+            return ret;
+        }
+
+        if (to_pipe) {
+            ret = ktls_splice(SSL_get_rfd(s), fd, size, flags);
+        } else {
+            if (s->splice_pipe[0] == -1 && pipe(s->splice_pipe) != 0) {
+                s->splice_pipe[0] = s->splice_pipe[1] = -1;
+                ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(),
+                               "calling pipe()");
+                return -1;
+            }
+            ret = ktls_splice(SSL_get_rfd(s), s->splice_pipe[1], size, flags);
+            if (ret > 0) {
+                s->splice_pipe_len = ret;
+                continue;
+            }
+        }
+        if (ret >= 0)
+            return ret;
+
+        if (get_last_sys_error() != EINVAL)
+            break;
+
+        /*
+         * The next record is not application data. Let the record layer
+         * process it, which deals with alerts and post-handshake messages,
+         * until application data is available again.
+         */
+        if (!SSL_peek_ex(s, buf, 1, &readbytes))
+            return SSL_get_error(s, 0) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+
+# if defined(EAGAIN) && defined(EINTR)
+    if (get_last_sys_error() == EAGAIN || get_last_sys_error() == EINTR) {
+        s->rwstate = SSL_READING;
+        BIO_set_retry_read(s->rbio);
+        return -1;
+    }
+# endif
+    ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "calling splice()");
+    return -1;
+
+ write_err:
+# if defined(EAGAIN) && defined(EINTR)
+    if (get_last_sys_error() == EAGAIN || get_last_sys_error() == EINTR) {
+        s->rwstate = SSL_WRITING;
+        BIO_set_retry_write(s->wbio);
+        return -1;
+    }
+# endif
+    ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "writing to fd");
+    return -1;
+#endif
+}
+
 int SSL_write(SSL *s, const void *buf, int num)
 {
     int ret;
@@ -2143,6 +2326,40 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+int SSL_writev(SSL *s, const SSL_IOVEC *iov, size_t iovcnt, size_t *written)
+{
+    size_t i, num = 0;
+    int ret;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len > SIZE_MAX - num) {
+            ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+            return 0;
+        }
+        num += iov[i].len;
+    }
+
+    /* A DTLS record is a single datagram, written out from one buffer */
+    if (SSL_IS_DTLS(s)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    /*
+     * The record layer builds the records straight from |iov|, it is told to
+     * do so by the NULL buffer
+     */
+    s->rlayer.wiov = iov;
+    s->rlayer.wiovcnt = iovcnt;
+    ret = ssl_write_internal(s, NULL, num, written);
+    s->rlayer.wiov = NULL;
+    s->rlayer.wiovcnt = 0;
+
+    if (ret < 0)
+        ret = 0;
+    return ret;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -2451,7 +2668,10 @@ long SSL_callback_ctrl(SSL *s, int cmd, void (*fp) (void))
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
 {
-    return ctx->sessions;
+    /* There is no single hash table to return for a sharded cache */
+    if (ctx->session_cache_shard_count != 1)
+        return NULL;
+    return ctx->session_cache_shards[0].sessions;
 }
 
 static int ssl_tsan_load(SSL_CTX *ctx, TSAN_QUALIFIER int *stat)
@@ -2518,7 +2738,55 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return ctx->session_cache_mode;
 
     case SSL_CTRL_SESS_NUMBER:
-        return lh_SSL_SESSION_num_items(ctx->sessions);
+        return (long)ssl_session_cache_num(ctx);
+    case SSL_CTRL_SET_SESS_CACHE_SHARDS:
+        if (larg <= 0 || larg > SSL_SESSION_CACHE_MAX_SHARDS)
+            return 0;
+        return ssl_session_cache_new(ctx, (size_t)larg);
+    case SSL_CTRL_GET_SESS_CACHE_SHARDS:
+        return (long)ctx->session_cache_shard_count;
+    case SSL_CTRL_SET_BUFFER_POOL_SIZE:
+        if (larg < 0)
+            return 0;
+        if (larg == 0) {
+            /* Connections that use the pool keep it until they are freed */
+            ssl_buffer_pool_free(ctx->buffer_pool);
+            ctx->buffer_pool = NULL;
+        } else if (ctx->buffer_pool != NULL) {
+            ssl_buffer_pool_set_max(ctx->buffer_pool, (size_t)larg);
+        } else {
+            if ((ctx->buffer_pool = ssl_buffer_pool_new((size_t)larg)) == NULL)
+                return 0;
+        }
+        return 1;
+    case SSL_CTRL_GET_BUFFER_POOL_SIZE:
+        return ctx->buffer_pool != NULL
+               ? (long)ssl_buffer_pool_get_max(ctx->buffer_pool) : 0;
+    case SSL_CTRL_BUFFER_POOL_IDLE:
+    case SSL_CTRL_BUFFER_POOL_IN_USE:
+    case SSL_CTRL_BUFFER_POOL_HITS:
+    case SSL_CTRL_BUFFER_POOL_MISSES:
+        return ctx->buffer_pool != NULL
+               ? (long)ssl_buffer_pool_stat(ctx->buffer_pool, cmd) : 0;
+    case SSL_CTRL_SET_KEY_SHARE_POOL_DEPTH:
+        if (larg < 0)
+            return 0;
+        /* Only the first call, which creates the pool, isn't thread safe */
+        if (ctx->key_share_pool != NULL)
+            ssl_key_share_pool_set_depth(ctx->key_share_pool, (size_t)larg);
+        else if (larg > 0
+                 && (ctx->key_share_pool
+                     = ssl_key_share_pool_new((size_t)larg)) == NULL)
+            return 0;
+        return 1;
+    case SSL_CTRL_GET_KEY_SHARE_POOL_DEPTH:
+        return ctx->key_share_pool != NULL
+               ? (long)ssl_key_share_pool_get_depth(ctx->key_share_pool) : 0;
+    case SSL_CTRL_KEY_SHARE_POOL_IDLE:
+    case SSL_CTRL_KEY_SHARE_POOL_HITS:
+    case SSL_CTRL_KEY_SHARE_POOL_MISSES:
+        return ctx->key_share_pool != NULL
+               ? (long)ssl_key_share_pool_stat(ctx->key_share_pool, cmd) : 0;
     case SSL_CTRL_SESS_CONNECT:
         return ssl_tsan_load(ctx, &ctx->stats.sess_connect);
     case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -3176,6 +3444,89 @@ static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
     return memcmp(a->session_id, b->session_id, a->session_id_length);
 }
 
+static void ssl_session_cache_shards_free(SSL_SESSION_CACHE_SHARD *shards,
+                                         size_t n)
+{
+    size_t i;
+
+    if (shards == NULL)
+        return;
+    for (i = 0; i < n; i++) {
+        lh_SSL_SESSION_free(shards[i].sessions);
+        CRYPTO_THREAD_lock_free(shards[i].lock);
+    }
+    OPENSSL_free(shards);
+}
+
+/*
+ * (Re)creates the session cache of |ctx| with |n| shards.  This is only
+ * possible while the cache is empty.
+ */
+int ssl_session_cache_new(SSL_CTX *ctx, size_t n)
+{
+    SSL_SESSION_CACHE_SHARD *shards;
+    size_t i;
+
+    if (ssl_session_cache_num(ctx) != 0) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_SESSION_CACHE_NOT_EMPTY);
+        return 0;
+    }
+
+    if ((shards = OPENSSL_zalloc(n * sizeof(*shards))) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        shards[i].lock = CRYPTO_THREAD_lock_new();
+        shards[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                                ssl_session_cmp);
+        if (shards[i].lock == NULL || shards[i].sessions == NULL) {
+            ssl_session_cache_shards_free(shards, i + 1);
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+    }
+    ssl_session_cache_shards_free(ctx->session_cache_shards,
+                                  ctx->session_cache_shard_count);
+    ctx->session_cache_shards = shards;
+    ctx->session_cache_shard_count = n;
+    return 1;
+}
+
+void ssl_session_cache_free(SSL_CTX *ctx)
+{
+    ssl_session_cache_shards_free(ctx->session_cache_shards,
+                                  ctx->session_cache_shard_count);
+    ctx->session_cache_shards = NULL;
+    ctx->session_cache_shard_count = 0;
+}
+
+/*
+ * The shard is picked from the top bits of the hash after mixing, so that
+ * the sessions of one shard still spread over all buckets of its hash table.
+ */
+SSL_SESSION_CACHE_SHARD *ssl_session_cache_shard(const SSL_CTX *ctx,
+                                                 const SSL_SESSION *a)
+{
+    uint32_t h;
+
+    if (ctx->session_cache_shard_count == 1)
+        return &ctx->session_cache_shards[0];
+    h = (uint32_t)ssl_session_hash(a) * 0x9E3779B1U;
+    return &ctx->session_cache_shards[(h >> 16)
+                                      % ctx->session_cache_shard_count];
+}
+
+/* Unlocked, like the statistics, so this is only a snapshot */
+size_t ssl_session_cache_num(const SSL_CTX *ctx)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < ctx->session_cache_shard_count; i++)
+        n += lh_SSL_SESSION_num_items(ctx->session_cache_shards[i].sessions);
+    return n;
+}
+
 /*
  * These wrapper functions should remain rather than redeclaring
  * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
@@ -3241,8 +3592,7 @@ SSL_CTX *SSL_CTX_new_ex(OSSL_LIB_CTX *libctx, const char *propq,
     if ((ret->cert = ssl_cert_new()) == NULL)
         goto err;
 
-    ret->sessions = lh_SSL_SESSION_new(ssl_session_hash, ssl_session_cmp);
-    if (ret->sessions == NULL)
+    if (!ssl_session_cache_new(ret, 1))
         goto err;
     ret->cert_store = X509_STORE_new();
     if (ret->cert_store == NULL)
@@ -3296,7 +3646,7 @@ SSL_CTX *SSL_CTX_new_ex(OSSL_LIB_CTX *libctx, const char *propq,
     if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_SSL_CTX, ret, &ret->ex_data))
         goto err;
 
-    if ((ret->ext.secure = OPENSSL_secure_zalloc(sizeof(*ret->ext.secure))) == NULL)
+    if ((ret->ext.ticket_keys = ssl_ticket_keys_new()) == NULL)
         goto err;
 
     /* No compression for DTLS */
@@ -3307,12 +3657,7 @@ SSL_CTX *SSL_CTX_new_ex(OSSL_LIB_CTX *libctx, const char *propq,
     ret->split_send_fragment = SSL3_RT_MAX_PLAIN_LENGTH;
 
     /* Setup RFC5077 ticket keys */
-    if ((RAND_bytes_ex(libctx, ret->ext.tick_key_name,
-                       sizeof(ret->ext.tick_key_name), 0) <= 0)
-        || (RAND_priv_bytes_ex(libctx, ret->ext.secure->tick_hmac_key,
-                               sizeof(ret->ext.secure->tick_hmac_key), 0) <= 0)
-        || (RAND_priv_bytes_ex(libctx, ret->ext.secure->tick_aes_key,
-                               sizeof(ret->ext.secure->tick_aes_key), 0) <= 0))
+    if (!ssl_ticket_keys_generate(ret))
         ret->options |= SSL_OP_NO_TICKET;
 
     if (RAND_priv_bytes_ex(libctx, ret->ext.cookie_hmac_key,
@@ -3437,11 +3782,13 @@ void SSL_CTX_free(SSL_CTX *a)
      * free ex_data, then finally free the cache.
      * (See ticket [openssl.org #212].)
      */
-    if (a->sessions != NULL)
-        SSL_CTX_flush_sessions(a, 0);
+    SSL_CTX_flush_sessions(a, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
-    lh_SSL_SESSION_free(a->sessions);
+    ssl_session_cache_free(a);
+    SSL_SHARED_SESSION_CACHE_free(a->shared_session_cache);
+    ssl_buffer_pool_free(a->buffer_pool);
+    ssl_key_share_pool_free(a->key_share_pool);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -3468,7 +3815,7 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->ext.supportedgroups);
     OPENSSL_free(a->ext.supported_groups_default);
     OPENSSL_free(a->ext.alpn);
-    OPENSSL_secure_free(a->ext.secure);
+    ssl_ticket_keys_free(a->ext.ticket_keys);
 
     ssl_evp_md_free(a->md5);
     ssl_evp_md_free(a->sha1);
@@ -3755,8 +4102,15 @@ void ssl_update_cache(SSL *s, int mode)
         }
     }
 
-    /* auto flush every 255 connections */
-    if ((!(i & SSL_SESS_CACHE_NO_AUTO_CLEAR)) && ((i & mode) == mode)) {
+    /*
+     * auto flush every 255 connections, a sharded cache is only ever
+     * expired lazily to avoid taking the lock of every shard in turn.
+     * At most one new session is cached per connection, so removing up
+     * to SSL_SESSION_CACHE_FLUSH_MAX sessions keeps up with the expiry
+     * while bounding the time the cache is locked for.
+     */
+    if ((!(i & SSL_SESS_CACHE_NO_AUTO_CLEAR)) && ((i & mode) == mode)
+        && s->session_ctx->session_cache_shard_count == 1) {
         TSAN_QUALIFIER int *stat;
 
         if (mode & SSL_SESS_CACHE_CLIENT)
@@ -3764,7 +4118,8 @@ void ssl_update_cache(SSL *s, int mode)
         else
             stat = &s->session_ctx->stats.sess_accept_good;
         if ((ssl_tsan_load(s->session_ctx, stat) & 0xff) == 0xff)
-            SSL_CTX_flush_sessions(s->session_ctx, (unsigned long)time(NULL));
+            SSL_CTX_expire_sessions(s->session_ctx, (long)time(NULL),
+                                    SSL_SESSION_CACHE_FLUSH_MAX);
     }
 }
 
@@ -779,10 +779,45 @@ DEFINE_LHASH_OF(X509_NAME);
 # define TLSEXT_KEYNAME_LENGTH  16
 # define TLSEXT_TICK_KEY_LENGTH 32
 
-typedef struct ssl_ctx_ext_secure_st {
-    unsigned char tick_hmac_key[TLSEXT_TICK_KEY_LENGTH];
-    unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
-} SSL_CTX_EXT_SECURE;
+/*
+ * A session ticket key.  These are allocated from the secure heap, and are
+ * only ever accessed with the lock of the key ring held.
+ */
+typedef struct ssl_ticket_key_st {
+    unsigned char name[TLSEXT_KEYNAME_LENGTH];
+    unsigned char hmac_key[TLSEXT_TICK_KEY_LENGTH];
+    unsigned char aes_key[TLSEXT_TICK_KEY_LENGTH];
+    /* SSL_TICKET_KEY_DECRYPT_ONLY */
+    int flags;
+    time_t created;
+    /* When a rotated out key stops being accepted, 0 for never */
+    time_t expires;
+    /*
+     * Keyed contexts, created on first use, that are copied for each ticket
+     * so that the keys aren't set up and the algorithms fetched every time
+     */
+    EVP_CIPHER_CTX *enc_ctx;
+    EVP_CIPHER_CTX *dec_ctx;
+    EVP_MAC_CTX *mac_ctx;
+} SSL_TICKET_KEY;
+
+DEFINE_LHASH_OF(SSL_TICKET_KEY);
+
+# define SSL_TICKET_KEYS_MAX 16
+
+typedef struct ssl_ticket_keys_st {
+    CRYPTO_RWLOCK *lock;
+    /* Newest first */
+    SSL_TICKET_KEY *keys[SSL_TICKET_KEYS_MAX];
+    size_t num;
+    LHASH_OF(SSL_TICKET_KEY) *by_name;
+    /* Automatic rotation, disabled if the interval is 0 */
+    time_t rotate_interval;
+    time_t rotate_lifetime;
+} SSL_TICKET_KEYS;
+
+/* Pre-generated ephemeral keys, see ssl_key_share.c */
+typedef struct ssl_key_share_pool_st SSL_KEY_SHARE_POOL;
 
 /*
  * Helper function for HMAC
@@ -799,6 +834,7 @@ typedef struct ssl_hmac_st {
 } SSL_HMAC;
 
 SSL_HMAC *ssl_hmac_new(const SSL_CTX *ctx);
+SSL_HMAC *ssl_hmac_new_copy(const EVP_MAC_CTX *src);
 void ssl_hmac_free(SSL_HMAC *ctx);
 # ifndef OPENSSL_NO_DEPRECATED_3_0
 HMAC_CTX *ssl_hmac_get0_HMAC_CTX(SSL_HMAC *ctx);
@@ -815,6 +851,23 @@ __owur int tls13_set_encoded_pub_key(EVP_PKEY *pkey,
                                      const unsigned char *enckey,
                                      size_t enckeylen);
 
+/*
+ * One shard of the session cache.  Each session ID maps to exactly one shard,
+ * and all the data of a shard is protected by its own lock.
+ */
+typedef struct ssl_session_cache_shard_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    /* Sorted by timeout, the head expires last */
+    struct ssl_session_st *session_cache_head;
+    struct ssl_session_st *session_cache_tail;
+} SSL_SESSION_CACHE_SHARD;
+
+/* Upper limit for SSL_CTX_set_session_cache_shards() */
+# define SSL_SESSION_CACHE_MAX_SHARDS    256
+/* Most sessions removed by the automatic flush every 255 connections */
+# define SSL_SESSION_CACHE_FLUSH_MAX     512
+
 typedef struct tls_group_info_st {
     char *tlsname;           /* Curve Name as in TLS specs */
     char *realname;          /* Curve Name according to provider */
@@ -848,14 +901,16 @@ struct ssl_ctx_st {
     /* TLSv1.3 specific ciphersuites */
     STACK_OF(SSL_CIPHER) *tls13_ciphersuites;
     struct x509_store_st /* X509_STORE */ *cert_store;
-    LHASH_OF(SSL_SESSION) *sessions;
+    /* Set with SSL_CTX_set1_shared_session_cache() */
+    SSL_SHARED_SESSION_CACHE *shared_session_cache;
+    /* The session cache, 1 shard unless configured otherwise */
+    SSL_SESSION_CACHE_SHARD *session_cache_shards;
+    size_t session_cache_shard_count;
     /*
      * Most session-ids that will be cached, default is
      * SSL_SESSION_CACHE_MAX_SIZE_DEFAULT. 0 is unlimited.
      */
     size_t session_cache_size;
-    struct ssl_session_st *session_cache_head;
-    struct ssl_session_st *session_cache_tail;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -1021,6 +1076,12 @@ struct ssl_ctx_st {
     /* The default read buffer length to use (0 means not set) */
     size_t default_read_buf_len;
 
+    /* Pool of record layer buffers, or NULL */
+    SSL_BUFFER_POOL *buffer_pool;
+
+    /* Pool of pre-generated ephemeral keys, or NULL */
+    SSL_KEY_SHARE_POOL *key_share_pool;
+
 # ifndef OPENSSL_NO_ENGINE
     /*
      * Engine to pass requests for client certs to
@@ -1038,8 +1099,7 @@ struct ssl_ctx_st {
         int (*servername_cb) (SSL *, int *, void *);
         void *servername_arg;
         /* RFC 4507 session ticket keys */
-        unsigned char tick_key_name[TLSEXT_KEYNAME_LENGTH];
-        SSL_CTX_EXT_SECURE *secure;
+        SSL_TICKET_KEYS *ticket_keys;
 # ifndef OPENSSL_NO_DEPRECATED_3_0
         /* Callback to support customisation of ticket key setting */
         int (*ticket_key_cb) (SSL *ssl,
@@ -1744,6 +1804,8 @@ struct ssl_st {
      */
     int (*not_resumable_session_cb) (SSL *ssl, int is_forward_secure);
     RECORD_LAYER rlayer;
+    /* The pool of the SSL_CTX the SSL was created with, if any */
+    SSL_BUFFER_POOL *buffer_pool;
     /* Default password callback. */
     pem_password_cb *default_passwd_callback;
     /* Default password callback user data. */
@@ -1753,6 +1815,15 @@ struct ssl_st {
     ASYNC_WAIT_CTX *waitctx;
     size_t asyncrw;
 
+#ifndef OPENSSL_NO_KTLS
+    /*
+     * The pipe that SSL_splice() passes data through when its destination is
+     * not a pipe, and the number of bytes still in it.
+     */
+    int splice_pipe[2];
+    size_t splice_pipe_len;
+#endif
+
     /*
      * The maximum number of bytes advertised in session tickets that can be
      * sent as early data.
@@ -2379,6 +2450,26 @@ __owur int ssl_read_internal(SSL *s, void *buf, size_t num, size_t *readbytes);
 __owur int ssl_write_internal(SSL *s, const void *buf, size_t num, size_t *written);
 void ssl_clear_cipher_ctx(SSL *s);
 int ssl_clear_bad_session(SSL *s);
+__owur int ssl_session_cache_new(SSL_CTX *ctx, size_t n);
+void ssl_session_cache_free(SSL_CTX *ctx);
+SSL_SESSION_CACHE_SHARD *ssl_session_cache_shard(const SSL_CTX *ctx,
+                                                 const SSL_SESSION *a);
+size_t ssl_session_cache_num(const SSL_CTX *ctx);
+SSL_SESSION *ssl_session_decode_any(const unsigned char *in, size_t inlen);
+__owur SSL_TICKET_KEYS *ssl_ticket_keys_new(void);
+void ssl_ticket_keys_free(SSL_TICKET_KEYS *keys);
+__owur int ssl_ticket_keys_generate(SSL_CTX *ctx);
+__owur int ssl_ticket_keys_set(SSL_CTX *ctx, const unsigned char *keys);
+__owur int ssl_ticket_keys_get(SSL_CTX *ctx, unsigned char *keys);
+__owur SSL_KEY_SHARE_POOL *ssl_key_share_pool_new(size_t depth);
+void ssl_key_share_pool_free(SSL_KEY_SHARE_POOL *pool);
+void ssl_key_share_pool_set_depth(SSL_KEY_SHARE_POOL *pool, size_t depth);
+size_t ssl_key_share_pool_get_depth(SSL_KEY_SHARE_POOL *pool);
+size_t ssl_key_share_pool_stat(SSL_KEY_SHARE_POOL *pool, int cmd);
+__owur EVP_PKEY *ssl_key_share_pool_get(SSL *s, uint16_t group_id);
+__owur int ssl_ticket_key_init(SSL_CTX *ctx, unsigned char *name,
+                               unsigned char *iv, EVP_CIPHER_CTX *cctx,
+                               SSL_HMAC **hctx, int enc);
 __owur CERT *ssl_cert_new(void);
 __owur CERT *ssl_cert_dup(CERT *cert);
 void ssl_cert_clear_certs(CERT *c);
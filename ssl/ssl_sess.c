@@ -20,10 +20,18 @@
 #include "ssl_local.h"
 #include "statem/statem_local.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+static void SSL_SESSION_list_remove(SSL_SESSION_CACHE_SHARD *sh,
+                                    SSL_SESSION *s);
+static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION_CACHE_SHARD *sh,
+                                 SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
 
+/*
+ * Most expired sessions that are removed from a shard of the session cache
+ * whenever a session is added to it
+ */
+#define SSL_SESSION_CACHE_EXPIRE_BATCH  4
+
 DEFINE_STACK_OF(SSL_SESSION)
 
 __owur static int sess_timedout(time_t t, SSL_SESSION *ss)
@@ -485,6 +493,7 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
     if ((s->session_ctx->session_cache_mode
          & SSL_SESS_CACHE_NO_INTERNAL_LOOKUP) == 0) {
         SSL_SESSION data;
+        SSL_SESSION_CACHE_SHARD *sh;
 
         data.ssl_version = s->version;
         if (!ossl_assert(sess_id_len <= SSL_MAX_SSL_SESSION_ID_LENGTH))
@@ -493,14 +502,15 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
         memcpy(data.session_id, sess_id, sess_id_len);
         data.session_id_length = sess_id_len;
 
-        if (!CRYPTO_THREAD_read_lock(s->session_ctx->lock))
+        sh = ssl_session_cache_shard(s->session_ctx, &data);
+        if (!CRYPTO_THREAD_read_lock(sh->lock))
             return NULL;
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
+        ret = lh_SSL_SESSION_retrieve(sh->sessions, &data);
         if (ret != NULL) {
             /* don't allow other threads to steal it: */
             SSL_SESSION_up_ref(ret);
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
+        CRYPTO_THREAD_unlock(sh->lock);
         if (ret == NULL)
             ssl_tsan_counter(s->session_ctx, &s->session_ctx->stats.sess_miss);
     }
@@ -699,6 +709,9 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SSL_SESSION_CACHE_SHARD *sh = ssl_session_cache_shard(ctx, c);
+    size_t limit, n;
+    time_t now;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -710,20 +723,20 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    if (!CRYPTO_THREAD_write_lock(ctx->lock)) {
+    if (!CRYPTO_THREAD_write_lock(sh->lock)) {
         SSL_SESSION_free(c);
         return 0;
     }
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    s = lh_SSL_SESSION_insert(sh->sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
      * case, s == c should hold (then we did not really modify
-     * ctx->sessions), or we're in trouble.
+     * sh->sessions), or we're in trouble.
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -733,7 +746,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(sh->sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -748,7 +761,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         c->time = time(NULL);
         ssl_session_calculate_timeout(c);
     }
-    SSL_SESSION_list_add(ctx, c);
+    SSL_SESSION_list_add(ctx, sh, c);
 
     if (s != NULL) {
         /*
@@ -760,21 +773,40 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         ret = 0;
     } else {
         /*
-         * new cache entry -- remove old ones if cache has become too large
+         * new cache entry -- remove old ones if cache has become too large,
+         * each shard holds its share of the cache size
          */
 
         ret = 1;
 
         if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+            limit = (SSL_CTX_sess_get_cache_size(ctx)
+                     + ctx->session_cache_shard_count - 1)
+                    / ctx->session_cache_shard_count;
+            while (lh_SSL_SESSION_num_items(sh->sessions) > limit) {
+                if (!remove_session_lock(ctx, sh->session_cache_tail, 0))
                     break;
                 else
                     ssl_tsan_counter(ctx, &ctx->stats.sess_cache_full);
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+
+    /*
+     * A sharded cache isn't flushed automatically, some of the oldest
+     * sessions of this shard are expired lazily instead
+     */
+    if (ctx->session_cache_shard_count > 1
+            && (ctx->session_cache_mode & SSL_SESS_CACHE_NO_AUTO_CLEAR) == 0) {
+        now = time(NULL);
+        for (n = 0; n < SSL_SESSION_CACHE_EXPIRE_BATCH; n++) {
+            s = sh->session_cache_tail;
+            if (s == NULL || s == c || !sess_timedout(now, s)
+                    || !remove_session_lock(ctx, s, 0))
+                break;
+        }
+    }
+    CRYPTO_THREAD_unlock(sh->lock);
     return ret;
 }
 
@@ -786,22 +818,24 @@ int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
     SSL_SESSION *r;
+    SSL_SESSION_CACHE_SHARD *sh;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        sh = ssl_session_cache_shard(ctx, c);
         if (lck) {
-            if (!CRYPTO_THREAD_write_lock(ctx->lock))
+            if (!CRYPTO_THREAD_write_lock(sh->lock))
                 return 0;
         }
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) != NULL) {
+        if ((r = lh_SSL_SESSION_retrieve(sh->sessions, c)) != NULL) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, r);
-            SSL_SESSION_list_remove(ctx, r);
+            r = lh_SSL_SESSION_delete(sh->sessions, r);
+            SSL_SESSION_list_remove(sh, r);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(sh->lock);
 
         if (ctx->remove_session_cb != NULL)
             ctx->remove_session_cb(ctx, c);
@@ -895,12 +929,15 @@ long SSL_SESSION_set_timeout(SSL_SESSION *s, long t)
     if (s == NULL || t < 0)
         return 0;
     if (s->owner != NULL) {
-        if (!CRYPTO_THREAD_write_lock(s->owner->lock))
+        SSL_CTX *owner = s->owner;
+        SSL_SESSION_CACHE_SHARD *sh = ssl_session_cache_shard(owner, s);
+
+        if (!CRYPTO_THREAD_write_lock(sh->lock))
             return 0;
         s->timeout = new_timeout;
         ssl_session_calculate_timeout(s);
-        SSL_SESSION_list_add(s->owner, s);
-        CRYPTO_THREAD_unlock(s->owner->lock);
+        SSL_SESSION_list_add(owner, sh, s);
+        CRYPTO_THREAD_unlock(sh->lock);
     } else {
         s->timeout = new_timeout;
         ssl_session_calculate_timeout(s);
@@ -929,12 +966,15 @@ long SSL_SESSION_set_time(SSL_SESSION *s, long t)
     if (s == NULL)
         return 0;
     if (s->owner != NULL) {
-        if (!CRYPTO_THREAD_write_lock(s->owner->lock))
+        SSL_CTX *owner = s->owner;
+        SSL_SESSION_CACHE_SHARD *sh = ssl_session_cache_shard(owner, s);
+
+        if (!CRYPTO_THREAD_write_lock(sh->lock))
             return 0;
         s->time = new_time;
         ssl_session_calculate_timeout(s);
-        SSL_SESSION_list_add(s->owner, s);
-        CRYPTO_THREAD_unlock(s->owner->lock);
+        SSL_SESSION_list_add(owner, sh, s);
+        CRYPTO_THREAD_unlock(sh->lock);
     } else {
         s->time = new_time;
         ssl_session_calculate_timeout(s);
@@ -1132,31 +1172,34 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
     return 0;
 }
 
-void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+/* Removes at most |max| sessions expired at time |t| from the shard |sh| */
+static size_t flush_shard(SSL_CTX *s, SSL_SESSION_CACHE_SHARD *sh, long t,
+                          size_t max)
 {
     STACK_OF(SSL_SESSION) *sk;
     SSL_SESSION *current;
     unsigned long i;
+    size_t n = 0;
 
-    if (!CRYPTO_THREAD_write_lock(s->lock))
-        return;
+    if (!CRYPTO_THREAD_write_lock(sh->lock))
+        return 0;
 
     sk = sk_SSL_SESSION_new_null();
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
+    i = lh_SSL_SESSION_get_down_load(sh->sessions);
+    lh_SSL_SESSION_set_down_load(sh->sessions, 0);
 
     /*
      * Iterate over the list from the back (oldest), and stop
      * when a session can no longer be removed.
      * Add the session to a temporary list to be freed outside
-     * the SSL_CTX lock.
+     * the shard lock.
      * But still do the remove_session_cb() within the lock.
      */
-    while (s->session_cache_tail != NULL) {
-        current = s->session_cache_tail;
+    while (sh->session_cache_tail != NULL && n < max) {
+        current = sh->session_cache_tail;
         if (t == 0 || sess_timedout((time_t)t, current)) {
-            lh_SSL_SESSION_delete(s->sessions, current);
-            SSL_SESSION_list_remove(s, current);
+            lh_SSL_SESSION_delete(sh->sessions, current);
+            SSL_SESSION_list_remove(sh, current);
             current->not_resumable = 1;
             if (s->remove_session_cb != NULL)
                 s->remove_session_cb(s, current);
@@ -1169,15 +1212,45 @@ void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
              */
             if (sk == NULL || !sk_SSL_SESSION_push(sk, current))
                 SSL_SESSION_free(current);
+            n++;
         } else {
             break;
         }
     }
 
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    lh_SSL_SESSION_set_down_load(sh->sessions, i);
+    CRYPTO_THREAD_unlock(sh->lock);
 
     sk_SSL_SESSION_pop_free(sk, SSL_SESSION_free);
+    return n;
+}
+
+void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+{
+    size_t i;
+
+    /* Only one shard is locked at a time */
+    for (i = 0; i < s->session_cache_shard_count; i++)
+        flush_shard(s, &s->session_cache_shards[i], t, SIZE_MAX);
+}
+
+/*
+ * The sessions are sorted by timeout, so the sessions to remove are always
+ * found at the tail and each call only takes time proportional to |max|.
+ * The budget is shared evenly between the shards.
+ */
+size_t SSL_CTX_expire_sessions(SSL_CTX *s, long t, size_t max)
+{
+    size_t i, n = 0, per_shard;
+
+    if (s->session_cache_shard_count == 0)
+        return 0;
+    per_shard = max / s->session_cache_shard_count
+                + (max % s->session_cache_shard_count != 0);
+    for (i = 0; i < s->session_cache_shard_count && n < max; i++)
+        n += flush_shard(s, &s->session_cache_shards[i], t,
+                         per_shard < max - n ? per_shard : max - n);
+    return n;
 }
 
 int ssl_clear_bad_session(SSL *s)
@@ -1191,27 +1264,28 @@ int ssl_clear_bad_session(SSL *s)
         return 0;
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the shard in the calling function */
+static void SSL_SESSION_list_remove(SSL_SESSION_CACHE_SHARD *sh,
+                                    SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)&(sh->session_cache_tail)) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            sh->session_cache_head = NULL;
+            sh->session_cache_tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            sh->session_cache_tail = s->prev;
+            s->prev->next = (SSL_SESSION *)&(sh->session_cache_tail);
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            sh->session_cache_head = s->next;
+            s->next->prev = (SSL_SESSION *)&(sh->session_cache_head);
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1222,41 +1296,42 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->owner = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION_CACHE_SHARD *sh,
+                                 SSL_SESSION *s)
 {
     SSL_SESSION *next;
 
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (sh->session_cache_head == NULL) {
+        sh->session_cache_head = s;
+        sh->session_cache_tail = s;
+        s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+        s->next = (SSL_SESSION *)&(sh->session_cache_tail);
     } else {
-        if (timeoutcmp(s, ctx->session_cache_head) >= 0) {
+        if (timeoutcmp(s, sh->session_cache_head) >= 0) {
             /*
              * if we timeout after (or the same time as) the first
              * session, put us first - usual case
              */
-            s->next = ctx->session_cache_head;
+            s->next = sh->session_cache_head;
             s->next->prev = s;
-            s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-            ctx->session_cache_head = s;
-        } else if (timeoutcmp(s, ctx->session_cache_tail) < 0) {
+            s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+            sh->session_cache_head = s;
+        } else if (timeoutcmp(s, sh->session_cache_tail) < 0) {
             /* if we timeout before the last session, put us last */
-            s->prev = ctx->session_cache_tail;
+            s->prev = sh->session_cache_tail;
             s->prev->next = s;
-            s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
-            ctx->session_cache_tail = s;
+            s->next = (SSL_SESSION *)&(sh->session_cache_tail);
+            sh->session_cache_tail = s;
         } else {
             /*
              * we timeout somewhere in-between - if there is only
              * one session in the cache it will be caught above
              */
-            next = ctx->session_cache_head->next;
-            while (next != (SSL_SESSION*)&(ctx->session_cache_tail)) {
+            next = sh->session_cache_head->next;
+            while (next != (SSL_SESSION*)&(sh->session_cache_tail)) {
                 if (timeoutcmp(s, next) >= 0) {
                     s->next = next;
                     s->prev = next->prev;
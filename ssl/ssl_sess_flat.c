@@ -0,0 +1,362 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A flat binary encoding of SSL_SESSION
+ * =====================================
+ *
+ * This is a faster alternative to the DER encoding of i2d_SSL_SESSION(),
+ * for sessions that are only ever read back by the same application, such
+ * as those in session tickets and in external session caches.
+ *
+ * All integers are in network byte order, variable length fields are
+ * prefixed with their length.  An empty field is the same as an absent one.
+ * The encoding starts with its format version, the first byte of which is
+ * never 0x30, the first byte of a DER encoded session.
+ *
+ *   uint16 format version (SSL_SESSION_FLAT_VERSION)
+ *   uint16 protocol version
+ *   uint16 cipher suite
+ *   uint8  compression method
+ *   uint16 key exchange group
+ *   uint32 time (high and low 32 bits follow each other)
+ *   uint32 timeout (same)
+ *   uint32 verify result
+ *   uint32 flags
+ *   uint32 ticket lifetime hint
+ *   uint32 ticket age add
+ *   uint32 max early data
+ *   uint8  max fragment length mode
+ *   opaque session_id<0..2^8-1>
+ *   opaque master_key<0..2^16-1>
+ *   opaque sid_ctx<0..2^8-1>
+ *   opaque peer<0..2^24-1>              DER encoded certificate
+ *   opaque hostname<0..2^16-1>
+ *   opaque tick<0..2^24-1>
+ *   opaque alpn_selected<0..2^16-1>
+ *   opaque ticket_appdata<0..2^16-1>
+ *   opaque psk_identity_hint<0..2^16-1>
+ *   opaque psk_identity<0..2^16-1>
+ *   opaque srp_username<0..2^16-1>
+ */
+
+#include <limits.h>
+#include <openssl/x509.h>
+#include "internal/packet.h"
+#include "ssl_local.h"
+
+#define SSL_SESSION_FLAT_VERSION    0x0001
+
+static int put_uint64(WPACKET *pkt, uint64_t v)
+{
+    return WPACKET_put_bytes_u32(pkt, (uint32_t)(v >> 32))
+           && WPACKET_put_bytes_u32(pkt, (uint32_t)v);
+}
+
+static int get_uint64(PACKET *pkt, uint64_t *v)
+{
+    unsigned long hi, lo;
+
+    if (!PACKET_get_net_4(pkt, &hi) || !PACKET_get_net_4(pkt, &lo))
+        return 0;
+    *v = ((uint64_t)hi << 32) | lo;
+    return 1;
+}
+
+static int put_string(WPACKET *pkt, const char *s)
+{
+    return WPACKET_sub_memcpy_u16(pkt, s, s == NULL ? 0 : strlen(s));
+}
+
+static int encode_session(WPACKET *pkt, const SSL_SESSION *in)
+{
+    unsigned char *p;
+    unsigned long cipher_id;
+    int comp = 0, len;
+
+    cipher_id = in->cipher != NULL ? in->cipher->id : in->cipher_id;
+#ifndef OPENSSL_NO_COMP
+    comp = in->compress_meth;
+#endif
+
+    if (!WPACKET_put_bytes_u16(pkt, SSL_SESSION_FLAT_VERSION)
+            || !WPACKET_put_bytes_u16(pkt, in->ssl_version)
+            || !WPACKET_put_bytes_u16(pkt, cipher_id & 0xffff)
+            || !WPACKET_put_bytes_u8(pkt, comp)
+            || !WPACKET_put_bytes_u16(pkt, in->kex_group)
+            || !put_uint64(pkt, (uint64_t)in->time)
+            || !put_uint64(pkt, (uint64_t)in->timeout)
+            || !WPACKET_put_bytes_u32(pkt, (uint32_t)in->verify_result)
+            || !WPACKET_put_bytes_u32(pkt, in->flags)
+            || !WPACKET_put_bytes_u32(pkt, in->ext.tick_lifetime_hint)
+            || !WPACKET_put_bytes_u32(pkt, in->ext.tick_age_add)
+            || !WPACKET_put_bytes_u32(pkt, in->ext.max_early_data)
+            || !WPACKET_put_bytes_u8(pkt, in->ext.max_fragment_len_mode)
+            || !WPACKET_sub_memcpy_u8(pkt, in->session_id,
+                                      in->session_id_length)
+            || !WPACKET_sub_memcpy_u16(pkt, in->master_key,
+                                       in->master_key_length)
+            || !WPACKET_sub_memcpy_u8(pkt, in->sid_ctx, in->sid_ctx_length))
+        return 0;
+
+    if (in->peer == NULL) {
+        if (!WPACKET_put_bytes_u24(pkt, 0))
+            return 0;
+    } else {
+        /* |p| is NULL when only the length is calculated */
+        if ((len = i2d_X509(in->peer, NULL)) <= 0
+                || !WPACKET_sub_allocate_bytes_u24(pkt, len, &p)
+                || (p != NULL && i2d_X509(in->peer, &p) != len))
+            return 0;
+    }
+
+    if (!put_string(pkt, in->ext.hostname)
+            || !WPACKET_sub_memcpy_u24(pkt, in->ext.tick, in->ext.ticklen)
+            || !WPACKET_sub_memcpy_u16(pkt, in->ext.alpn_selected,
+                                       in->ext.alpn_selected_len)
+            || !WPACKET_sub_memcpy_u16(pkt, in->ticket_appdata,
+                                       in->ticket_appdata_len))
+        return 0;
+#ifndef OPENSSL_NO_PSK
+    if (!put_string(pkt, in->psk_identity_hint)
+            || !put_string(pkt, in->psk_identity))
+        return 0;
+#else
+    if (!put_string(pkt, NULL) || !put_string(pkt, NULL))
+        return 0;
+#endif
+#ifndef OPENSSL_NO_SRP
+    if (!put_string(pkt, in->srp_username))
+        return 0;
+#else
+    if (!put_string(pkt, NULL))
+        return 0;
+#endif
+    return 1;
+}
+
+int SSL_SESSION_encode(const SSL_SESSION *in, unsigned char *out,
+                       size_t outlen, size_t *written)
+{
+    WPACKET pkt;
+    int ret;
+
+    if (in == NULL || written == NULL
+            || (in->cipher == NULL && in->cipher_id == 0)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    if (out == NULL)
+        ret = WPACKET_init_null(&pkt, 0);
+    else
+        ret = WPACKET_init_static_len(&pkt, out, outlen, 0);
+    if (!ret) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    if (!encode_session(&pkt, in)
+            || !WPACKET_get_total_written(&pkt, written)
+            || !WPACKET_finish(&pkt)) {
+        WPACKET_cleanup(&pkt);
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+        return 0;
+    }
+    return 1;
+}
+
+/* Copies |pkt| into |dst| of at most |maxlen| bytes */
+static int get_bytes(PACKET *pkt, unsigned char *dst, size_t *dstlen,
+                     size_t maxlen)
+{
+    if (PACKET_remaining(pkt) > maxlen)
+        return 0;
+    *dstlen = PACKET_remaining(pkt);
+    return PACKET_copy_bytes(pkt, dst, *dstlen);
+}
+
+/* An empty |pkt| is a NULL string, which must not contain a zero byte */
+static int get_string(PACKET *pkt, char **dst)
+{
+    OPENSSL_free(*dst);
+    *dst = NULL;
+    if (PACKET_remaining(pkt) == 0)
+        return 1;
+    return !PACKET_contains_zero_byte(pkt) && PACKET_strndup(pkt, dst);
+}
+
+static int get_memdup(PACKET *pkt, unsigned char **dst, size_t *dstlen)
+{
+    OPENSSL_free(*dst);
+    *dst = NULL;
+    *dstlen = 0;
+    if (PACKET_remaining(pkt) == 0)
+        return 1;
+    return PACKET_memdup(pkt, dst, dstlen);
+}
+
+static int decode_session(PACKET *pkt, SSL_SESSION *ret)
+{
+    unsigned int version, ssl_version, cipher, comp, kex_group, mfl;
+    unsigned long verify_result, flags, lifetime_hint, age_add, early_data;
+    uint64_t t, timeout;
+    PACKET session_id, master_key, sid_ctx, peer, hostname, tick, alpn;
+    PACKET appdata, psk_identity_hint, psk_identity, srp_username;
+    const unsigned char *p;
+
+    if (!PACKET_get_net_2(pkt, &version)
+            || version != SSL_SESSION_FLAT_VERSION) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_UNKNOWN_SSL_VERSION);
+        return 0;
+    }
+    if (!PACKET_get_net_2(pkt, &ssl_version)
+            || !PACKET_get_net_2(pkt, &cipher)
+            || !PACKET_get_1(pkt, &comp)
+            || !PACKET_get_net_2(pkt, &kex_group)
+            || !get_uint64(pkt, &t)
+            || !get_uint64(pkt, &timeout)
+            || !PACKET_get_net_4(pkt, &verify_result)
+            || !PACKET_get_net_4(pkt, &flags)
+            || !PACKET_get_net_4(pkt, &lifetime_hint)
+            || !PACKET_get_net_4(pkt, &age_add)
+            || !PACKET_get_net_4(pkt, &early_data)
+            || !PACKET_get_1(pkt, &mfl)
+            || !PACKET_get_length_prefixed_1(pkt, &session_id)
+            || !PACKET_get_length_prefixed_2(pkt, &master_key)
+            || !PACKET_get_length_prefixed_1(pkt, &sid_ctx)
+            || !PACKET_get_length_prefixed_3(pkt, &peer)
+            || !PACKET_get_length_prefixed_2(pkt, &hostname)
+            || !PACKET_get_length_prefixed_3(pkt, &tick)
+            || !PACKET_get_length_prefixed_2(pkt, &alpn)
+            || !PACKET_get_length_prefixed_2(pkt, &appdata)
+            || !PACKET_get_length_prefixed_2(pkt, &psk_identity_hint)
+            || !PACKET_get_length_prefixed_2(pkt, &psk_identity)
+            || !PACKET_get_length_prefixed_2(pkt, &srp_username)
+            || PACKET_remaining(pkt) != 0) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+        return 0;
+    }
+
+    if ((ssl_version >> 8) != SSL3_VERSION_MAJOR
+        && (ssl_version >> 8) != DTLS1_VERSION_MAJOR
+        && ssl_version != DTLS1_BAD_VER) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_UNSUPPORTED_SSL_VERSION);
+        return 0;
+    }
+    ret->ssl_version = (int)ssl_version;
+    ret->kex_group = (int)kex_group;
+
+    ret->cipher_id = 0x03000000L | cipher;
+    if ((ret->cipher = ssl3_get_cipher_by_id(ret->cipher_id)) == NULL) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_DATA);
+        return 0;
+    }
+#ifndef OPENSSL_NO_COMP
+    ret->compress_meth = (int)comp;
+#endif
+
+    /* The same defaults as for the DER encoding */
+    ret->time = t != 0 ? (time_t)t : time(NULL);
+    ret->timeout = timeout != 0 ? (time_t)timeout : 3;
+    ssl_session_calculate_timeout(ret);
+
+    ret->verify_result = (int32_t)verify_result;
+    ret->flags = (uint32_t)flags;
+    ret->ext.tick_lifetime_hint = lifetime_hint;
+    ret->ext.tick_age_add = (uint32_t)age_add;
+    ret->ext.max_early_data = (uint32_t)early_data;
+    ret->ext.max_fragment_len_mode = (uint8_t)mfl;
+
+    if (!get_bytes(&session_id, ret->session_id, &ret->session_id_length,
+                   SSL3_MAX_SSL_SESSION_ID_LENGTH)
+            || !get_bytes(&master_key, ret->master_key,
+                          &ret->master_key_length,
+                          TLS13_MAX_RESUMPTION_PSK_LENGTH)
+            || !get_bytes(&sid_ctx, ret->sid_ctx, &ret->sid_ctx_length,
+                          SSL_MAX_SID_CTX_LENGTH)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+        return 0;
+    }
+
+    X509_free(ret->peer);
+    ret->peer = NULL;
+    if (PACKET_remaining(&peer) != 0) {
+        p = PACKET_data(&peer);
+        ret->peer = d2i_X509(NULL, &p, (long)PACKET_remaining(&peer));
+        if (ret->peer == NULL
+                || p != PACKET_data(&peer) + PACKET_remaining(&peer)) {
+            ERR_raise(ERR_LIB_SSL, SSL_R_BAD_DATA);
+            return 0;
+        }
+    }
+
+    if (!get_string(&hostname, &ret->ext.hostname)
+            || !get_memdup(&tick, &ret->ext.tick, &ret->ext.ticklen)
+            || !get_memdup(&alpn, &ret->ext.alpn_selected,
+                           &ret->ext.alpn_selected_len)
+            || !get_memdup(&appdata, &ret->ticket_appdata,
+                           &ret->ticket_appdata_len)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_DATA);
+        return 0;
+    }
+#ifndef OPENSSL_NO_PSK
+    if (!get_string(&psk_identity_hint, &ret->psk_identity_hint)
+            || !get_string(&psk_identity, &ret->psk_identity)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_DATA);
+        return 0;
+    }
+#endif
+#ifndef OPENSSL_NO_SRP
+    if (!get_string(&srp_username, &ret->srp_username)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_DATA);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+SSL_SESSION *SSL_SESSION_decode(const unsigned char *in, size_t inlen)
+{
+    PACKET pkt;
+    SSL_SESSION *ret;
+
+    if (in == NULL || !PACKET_buf_init(&pkt, in, inlen)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+    if ((ret = SSL_SESSION_new()) == NULL)
+        return NULL;
+    if (!decode_session(&pkt, ret)) {
+        SSL_SESSION_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+/*
+ * Decodes a session in either of its encodings, all of |in| must be used.
+ * This allows to read the DER encoded sessions written by older versions.
+ */
+SSL_SESSION *ssl_session_decode_any(const unsigned char *in, size_t inlen)
+{
+    SSL_SESSION *ret;
+    const unsigned char *p = in;
+
+    if (inlen > 0 && in[0] != 0x30)
+        return SSL_SESSION_decode(in, inlen);
+
+    if (inlen > LONG_MAX
+            || (ret = d2i_SSL_SESSION(NULL, &p, (long)inlen)) == NULL)
+        return NULL;
+    if (p != in + inlen) {
+        SSL_SESSION_free(ret);
+        return NULL;
+    }
+    return ret;
+}
@@ -0,0 +1,402 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A session cache in shared memory
+ * ================================
+ *
+ * The cache is a single anonymous shared mapping, so that it is inherited by
+ * all processes forked after it was created.  It is used through the usual
+ * external session cache callbacks, sessions are stored in the flat
+ * encoding of SSL_SESSION_encode().
+ *
+ * The mapping starts with a header and an array of process-shared mutexes,
+ * followed by the slots.  The slots are grouped in sets of SHM_CACHE_WAYS,
+ * and a session ID can only be stored in the set that its hash selects.
+ * Each mutex protects every SHM_CACHE_STRIPES-th set.  When a set is full,
+ * the session that expires first is replaced.
+ */
+
+#include "ssl_local.h"
+
+#if defined(OPENSSL_SYS_UNIX) && defined(OPENSSL_THREADS)
+# define SHM_CACHE_IMPLEMENTED
+# include <pthread.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#  define MAP_ANON MAP_ANONYMOUS
+# endif
+#endif
+
+struct ssl_shared_session_cache_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    void *map;
+    size_t map_size;
+};
+
+#ifdef SHM_CACHE_IMPLEMENTED
+
+# define SHM_CACHE_WAYS       4
+# define SHM_CACHE_STRIPES    64
+
+typedef struct {
+    size_t num_sets;
+    size_t num_stripes;
+    size_t slot_size;
+    pthread_mutex_t locks[1];
+} SHM_CACHE_HEADER;
+
+typedef struct {
+    /* 0 for an empty slot */
+    time_t expires;
+    size_t len;
+    unsigned int id_len;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+} SHM_CACHE_SLOT;
+
+# define SHM_CACHE_ALIGN(n)   (((n) + 15) & ~(size_t)15)
+
+static SHM_CACHE_HEADER *shm_header(const SSL_SHARED_SESSION_CACHE *cache)
+{
+    return cache->map;
+}
+
+static size_t shm_header_size(size_t num_stripes)
+{
+    return SHM_CACHE_ALIGN(sizeof(SHM_CACHE_HEADER)
+                           + (num_stripes - 1) * sizeof(pthread_mutex_t));
+}
+
+static SHM_CACHE_SLOT *shm_slot(const SSL_SHARED_SESSION_CACHE *cache,
+                                size_t set, size_t way)
+{
+    SHM_CACHE_HEADER *hdr = shm_header(cache);
+
+    return (SHM_CACHE_SLOT *)((unsigned char *)cache->map
+                              + shm_header_size(hdr->num_stripes)
+                              + (set * SHM_CACHE_WAYS + way) * hdr->slot_size);
+}
+
+/* FNV-1a, all of the session ID is significant here */
+static size_t shm_set(const SSL_SHARED_SESSION_CACHE *cache,
+                      const unsigned char *id, size_t id_len)
+{
+    uint32_t h = 0x811c9dc5U;
+    size_t i;
+
+    for (i = 0; i < id_len; i++)
+        h = (h ^ id[i]) * 0x01000193U;
+    return h % shm_header(cache)->num_sets;
+}
+
+static void shm_unlock(SSL_SHARED_SESSION_CACHE *cache, size_t set)
+{
+    SHM_CACHE_HEADER *hdr = shm_header(cache);
+
+    pthread_mutex_unlock(&hdr->locks[set % hdr->num_stripes]);
+}
+
+static int shm_lock(SSL_SHARED_SESSION_CACHE *cache, size_t set)
+{
+    SHM_CACHE_HEADER *hdr = shm_header(cache);
+    size_t stripe = set % hdr->num_stripes;
+    int rv = pthread_mutex_lock(&hdr->locks[stripe]);
+
+# if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L
+    /*
+     * A process died while holding the lock, the slots that it protects
+     * may be half written so they are all emptied
+     */
+    if (rv == EOWNERDEAD) {
+        size_t s, w;
+
+        for (s = stripe; s < hdr->num_sets; s += hdr->num_stripes)
+            for (w = 0; w < SHM_CACHE_WAYS; w++)
+                shm_slot(cache, s, w)->expires = 0;
+        rv = pthread_mutex_consistent(&hdr->locks[stripe]);
+    }
+# endif
+    return rv == 0;
+}
+
+/* Returns the slot holding |id| in |set| or NULL, with |set| locked */
+static SHM_CACHE_SLOT *shm_find(SSL_SHARED_SESSION_CACHE *cache, size_t set,
+                                const unsigned char *id, size_t id_len)
+{
+    SHM_CACHE_SLOT *slot;
+    size_t w;
+
+    for (w = 0; w < SHM_CACHE_WAYS; w++) {
+        slot = shm_slot(cache, set, w);
+        if (slot->expires != 0 && slot->id_len == id_len
+                && memcmp(slot->id, id, id_len) == 0)
+            return slot;
+    }
+    return NULL;
+}
+
+static int shm_new_session_cb(SSL *s, SSL_SESSION *sess)
+{
+    SSL_SHARED_SESSION_CACHE *cache = s->session_ctx->shared_session_cache;
+    SHM_CACHE_SLOT *slot, *victim;
+    unsigned char *enc = NULL;
+    unsigned int id_len;
+    const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+    time_t expires;
+    size_t set, w, len;
+
+    if (cache == NULL || id_len == 0)
+        return 0;
+
+    /* Encode outside of the lock, sessions too large for a slot are skipped */
+    if (!SSL_SESSION_encode(sess, NULL, 0, &len)
+            || len > shm_header(cache)->slot_size - sizeof(*slot)
+            || (enc = OPENSSL_malloc(len)) == NULL)
+        return 0;
+    if (!SSL_SESSION_encode(sess, enc, len, &len))
+        goto end;
+
+    /* Sessions that never expire are left to the internal cache */
+    if (sess->timeout_ovf || (expires = sess->calc_timeout) <= 0)
+        goto end;
+
+    set = shm_set(cache, id, id_len);
+    if (!shm_lock(cache, set))
+        goto end;
+    if ((victim = shm_find(cache, set, id, id_len)) == NULL) {
+        /* Use an empty slot, or replace the one that expires first */
+        for (w = 0; w < SHM_CACHE_WAYS; w++) {
+            slot = shm_slot(cache, set, w);
+            if (victim == NULL || slot->expires < victim->expires)
+                victim = slot;
+        }
+    }
+    victim->expires = expires;
+    victim->len = len;
+    victim->id_len = id_len;
+    memcpy(victim->id, id, id_len);
+    memcpy(victim + 1, enc, len);
+    shm_unlock(cache, set);
+
+ end:
+    OPENSSL_free(enc);
+    /* No reference to |sess| is kept */
+    return 0;
+}
+
+static SSL_SESSION *shm_get_session_cb(SSL *s, const unsigned char *id,
+                                       int id_len, int *copy)
+{
+    SSL_SHARED_SESSION_CACHE *cache = s->session_ctx->shared_session_cache;
+    SHM_CACHE_SLOT *slot;
+    SSL_SESSION *ret = NULL;
+    unsigned char *enc = NULL;
+    size_t set, len = 0;
+
+    *copy = 0;
+    if (cache == NULL || id_len <= 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return NULL;
+
+    set = shm_set(cache, id, id_len);
+    if (!shm_lock(cache, set))
+        return NULL;
+    if ((slot = shm_find(cache, set, id, id_len)) != NULL) {
+        if (time(NULL) > slot->expires) {
+            slot->expires = 0;
+        } else if ((enc = OPENSSL_malloc(slot->len)) != NULL) {
+            len = slot->len;
+            memcpy(enc, slot + 1, len);
+        }
+    }
+    shm_unlock(cache, set);
+
+    /* Decode outside of the lock */
+    if (enc != NULL) {
+        ret = ssl_session_decode_any(enc, len);
+        OPENSSL_free(enc);
+    }
+    return ret;
+}
+
+static void shm_remove_session_cb(SSL_CTX *ctx, SSL_SESSION *sess)
+{
+    SSL_SHARED_SESSION_CACHE *cache = ctx->shared_session_cache;
+    SHM_CACHE_SLOT *slot;
+    unsigned int id_len;
+    const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+    size_t set;
+
+    if (cache == NULL || id_len == 0)
+        return;
+
+    set = shm_set(cache, id, id_len);
+    if (!shm_lock(cache, set))
+        return;
+    if ((slot = shm_find(cache, set, id, id_len)) != NULL)
+        slot->expires = 0;
+    shm_unlock(cache, set);
+}
+
+static int shm_init(SSL_SHARED_SESSION_CACHE *cache, size_t num_sets,
+                    size_t num_stripes, size_t slot_size)
+{
+    SHM_CACHE_HEADER *hdr = shm_header(cache);
+    pthread_mutexattr_t attr;
+    size_t i;
+    int ok = 1;
+
+    hdr->num_sets = num_sets;
+    hdr->num_stripes = num_stripes;
+    hdr->slot_size = slot_size;
+
+    if (pthread_mutexattr_init(&attr) != 0)
+        return 0;
+    if (pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0)
+        ok = 0;
+# if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L
+    if (ok && pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) != 0)
+        ok = 0;
+# endif
+    for (i = 0; ok && i < num_stripes; i++)
+        if (pthread_mutex_init(&hdr->locks[i], &attr) != 0)
+            ok = 0;
+    pthread_mutexattr_destroy(&attr);
+    return ok;
+}
+
+#endif /* SHM_CACHE_IMPLEMENTED */
+
+SSL_SHARED_SESSION_CACHE *SSL_SHARED_SESSION_CACHE_new(size_t num_slots,
+                                                       size_t slot_size)
+{
+#ifdef SHM_CACHE_IMPLEMENTED
+    SSL_SHARED_SESSION_CACHE *cache;
+    size_t num_sets, num_stripes, size;
+
+    num_sets = (num_slots + SHM_CACHE_WAYS - 1) / SHM_CACHE_WAYS;
+    slot_size = SHM_CACHE_ALIGN(slot_size);
+    if (num_sets == 0 || slot_size <= sizeof(SHM_CACHE_SLOT)
+            || num_sets > SIZE_MAX / SHM_CACHE_WAYS / slot_size) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+    num_stripes = num_sets < SHM_CACHE_STRIPES ? num_sets : SHM_CACHE_STRIPES;
+    size = shm_header_size(num_stripes);
+    if (num_sets * SHM_CACHE_WAYS * slot_size > SIZE_MAX - size) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+    size += num_sets * SHM_CACHE_WAYS * slot_size;
+
+    if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    cache->references = 1;
+    if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(cache);
+        return NULL;
+    }
+
+    /* Anonymous mappings are zero filled, so all slots start out empty */
+    cache->map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANON, -1, 0);
+    if (cache->map == MAP_FAILED) {
+        ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "calling mmap()");
+        cache->map = NULL;
+        SSL_SHARED_SESSION_CACHE_free(cache);
+        return NULL;
+    }
+    cache->map_size = size;
+    if (!shm_init(cache, num_sets, num_stripes, slot_size)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_UNSUPPORTED);
+        SSL_SHARED_SESSION_CACHE_free(cache);
+        return NULL;
+    }
+    return cache;
+#else
+    ERR_raise(ERR_LIB_SSL, ERR_R_UNSUPPORTED);
+    return NULL;
+#endif
+}
+
+void SSL_SHARED_SESSION_CACHE_free(SSL_SHARED_SESSION_CACHE *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+    CRYPTO_DOWN_REF(&cache->references, &i, cache->lock);
+    REF_PRINT_COUNT("SSL_SHARED_SESSION_CACHE", cache);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+#ifdef SHM_CACHE_IMPLEMENTED
+    /* The locks are left alone, other processes may still be using them */
+    if (cache->map != NULL)
+        munmap(cache->map, cache->map_size);
+#endif
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+int SSL_CTX_set1_shared_session_cache(SSL_CTX *ctx,
+                                      SSL_SHARED_SESSION_CACHE *cache)
+{
+#ifdef SHM_CACHE_IMPLEMENTED
+    int i;
+
+    /* Don't silently replace the callbacks of an external session cache */
+    if (cache != NULL
+            && ((ctx->new_session_cb != NULL
+                 && ctx->new_session_cb != shm_new_session_cb)
+                || (ctx->get_session_cb != NULL
+                    && ctx->get_session_cb != shm_get_session_cb)
+                || (ctx->remove_session_cb != NULL
+                    && ctx->remove_session_cb != shm_remove_session_cb))) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_SESSION_CALLBACKS_ALREADY_SET);
+        return 0;
+    }
+    if (cache != NULL && CRYPTO_UP_REF(&cache->references, &i,
+                                       cache->lock) <= 0)
+        return 0;
+    SSL_SHARED_SESSION_CACHE_free(ctx->shared_session_cache);
+    ctx->shared_session_cache = cache;
+
+    if (cache == NULL) {
+        if (ctx->new_session_cb == shm_new_session_cb)
+            ctx->new_session_cb = NULL;
+        if (ctx->get_session_cb == shm_get_session_cb)
+            ctx->get_session_cb = NULL;
+        if (ctx->remove_session_cb == shm_remove_session_cb)
+            ctx->remove_session_cb = NULL;
+        return 1;
+    }
+
+    /*
+     * The internal cache would call the remove callback for every session
+     * that it drops, which would also drop them for all other processes
+     */
+    ctx->session_cache_mode |= SSL_SESS_CACHE_SERVER
+                               | SSL_SESS_CACHE_NO_INTERNAL;
+    ctx->new_session_cb = shm_new_session_cb;
+    ctx->get_session_cb = shm_get_session_cb;
+    ctx->remove_session_cb = shm_remove_session_cb;
+    return 1;
+#else
+    if (cache == NULL)
+        return 1;
+    ERR_raise(ERR_LIB_SSL, ERR_R_UNSUPPORTED);
+    return 0;
+#endif
+}
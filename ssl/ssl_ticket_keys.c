@@ -0,0 +1,444 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * The session ticket key ring
+ * ===========================
+ *
+ * Tickets are encrypted with the newest key that isn't decrypt-only, and
+ * decrypted with whichever key their key name refers to.  Tickets that were
+ * encrypted with a decrypt-only key are renewed.
+ *
+ * When rotation is enabled, a new key is generated once the current one is
+ * older than the rotation interval.  The keys that were in use become
+ * decrypt-only, and are dropped once their lifetime is over.
+ */
+
+#include <string.h>
+#include <openssl/rand.h>
+#include <openssl/core_names.h>
+#include "ssl_local.h"
+
+/* The layout of the keys in SSL_CTX_set_tlsext_ticket_keys() */
+#define TICKET_KEY_BYTES \
+    (TLSEXT_KEYNAME_LENGTH + 2 * TLSEXT_TICK_KEY_LENGTH)
+
+/* Key names are random, so the first bytes make for a good hash */
+static unsigned long ticket_key_hash(const SSL_TICKET_KEY *a)
+{
+    return (unsigned long)a->name[0]
+           | ((unsigned long)a->name[1] << 8L)
+           | ((unsigned long)a->name[2] << 16L)
+           | ((unsigned long)a->name[3] << 24L);
+}
+
+static int ticket_key_cmp(const SSL_TICKET_KEY *a, const SSL_TICKET_KEY *b)
+{
+    return memcmp(a->name, b->name, sizeof(a->name));
+}
+
+static void ticket_key_free(SSL_TICKET_KEY *key)
+{
+    if (key == NULL)
+        return;
+    EVP_CIPHER_CTX_free(key->enc_ctx);
+    EVP_CIPHER_CTX_free(key->dec_ctx);
+    EVP_MAC_CTX_free(key->mac_ctx);
+    OPENSSL_secure_clear_free(key, sizeof(*key));
+}
+
+/* |keys| is NULL for a random key */
+static SSL_TICKET_KEY *ticket_key_new(SSL_CTX *ctx, const unsigned char *keys,
+                                      int flags)
+{
+    SSL_TICKET_KEY *key = OPENSSL_secure_zalloc(sizeof(*key));
+
+    if (key == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if (keys != NULL) {
+        memcpy(key->name, keys, sizeof(key->name));
+        memcpy(key->hmac_key, keys + sizeof(key->name),
+               sizeof(key->hmac_key));
+        memcpy(key->aes_key, keys + sizeof(key->name) + sizeof(key->hmac_key),
+               sizeof(key->aes_key));
+    } else if (RAND_bytes_ex(ctx->libctx, key->name, sizeof(key->name),
+                             0) <= 0
+               || RAND_priv_bytes_ex(ctx->libctx, key->hmac_key,
+                                     sizeof(key->hmac_key), 0) <= 0
+               || RAND_priv_bytes_ex(ctx->libctx, key->aes_key,
+                                     sizeof(key->aes_key), 0) <= 0) {
+        ticket_key_free(key);
+        return NULL;
+    }
+    key->flags = flags;
+    key->created = time(NULL);
+    return key;
+}
+
+static int ticket_key_init_ctxs(SSL_CTX *ctx, SSL_TICKET_KEY *key)
+{
+    EVP_CIPHER *cipher = EVP_CIPHER_fetch(ctx->libctx, "AES-256-CBC",
+                                          ctx->propq);
+    EVP_MAC *mac = EVP_MAC_fetch(ctx->libctx, "HMAC", ctx->propq);
+    OSSL_PARAM params[2];
+    int ok = 0;
+
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 "SHA256", 0);
+    params[1] = OSSL_PARAM_construct_end();
+    if (cipher == NULL || mac == NULL
+            || (key->enc_ctx = EVP_CIPHER_CTX_new()) == NULL
+            || (key->dec_ctx = EVP_CIPHER_CTX_new()) == NULL
+            || (key->mac_ctx = EVP_MAC_CTX_new(mac)) == NULL
+            || !EVP_EncryptInit_ex(key->enc_ctx, cipher, NULL, key->aes_key,
+                                   NULL)
+            || !EVP_DecryptInit_ex(key->dec_ctx, cipher, NULL, key->aes_key,
+                                   NULL)
+            || !EVP_MAC_init(key->mac_ctx, key->hmac_key,
+                             sizeof(key->hmac_key), params)) {
+        EVP_CIPHER_CTX_free(key->enc_ctx);
+        EVP_CIPHER_CTX_free(key->dec_ctx);
+        EVP_MAC_CTX_free(key->mac_ctx);
+        key->enc_ctx = key->dec_ctx = NULL;
+        key->mac_ctx = NULL;
+        goto end;
+    }
+    ok = 1;
+ end:
+    EVP_CIPHER_free(cipher);
+    EVP_MAC_free(mac);
+    return ok;
+}
+
+SSL_TICKET_KEYS *ssl_ticket_keys_new(void)
+{
+    SSL_TICKET_KEYS *ret = OPENSSL_zalloc(sizeof(*ret));
+
+    if (ret == NULL
+            || (ret->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || (ret->by_name = lh_SSL_TICKET_KEY_new(ticket_key_hash,
+                                                     ticket_key_cmp)) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        ssl_ticket_keys_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+void ssl_ticket_keys_free(SSL_TICKET_KEYS *keys)
+{
+    size_t i;
+
+    if (keys == NULL)
+        return;
+    for (i = 0; i < keys->num; i++)
+        ticket_key_free(keys->keys[i]);
+    lh_SSL_TICKET_KEY_free(keys->by_name);
+    CRYPTO_THREAD_lock_free(keys->lock);
+    OPENSSL_free(keys);
+}
+
+/* Must be called with the write lock held */
+static void ticket_keys_delete(SSL_TICKET_KEYS *keys, size_t i, int unhash)
+{
+    SSL_TICKET_KEY *key = keys->keys[i];
+
+    if (unhash)
+        (void)lh_SSL_TICKET_KEY_delete(keys->by_name, key);
+    ticket_key_free(key);
+    keys->num--;
+    memmove(&keys->keys[i], &keys->keys[i + 1],
+            (keys->num - i) * sizeof(keys->keys[0]));
+}
+
+/*
+ * Must be called with the write lock held.  A key with the same name is
+ * replaced, if the ring is full the oldest key is dropped.
+ */
+static int ticket_keys_insert(SSL_TICKET_KEYS *keys, SSL_TICKET_KEY *key)
+{
+    SSL_TICKET_KEY *old;
+    size_t i;
+
+    old = lh_SSL_TICKET_KEY_insert(keys->by_name, key);
+    if (old == NULL && lh_SSL_TICKET_KEY_error(keys->by_name)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    if (old != NULL) {
+        for (i = 0; keys->keys[i] != old; i++)
+            continue;
+        ticket_keys_delete(keys, i, 0);
+    } else if (keys->num == SSL_TICKET_KEYS_MAX) {
+        ticket_keys_delete(keys, keys->num - 1, 1);
+    }
+    memmove(&keys->keys[1], &keys->keys[0],
+            keys->num * sizeof(keys->keys[0]));
+    keys->keys[0] = key;
+    keys->num++;
+    return 1;
+}
+
+static ossl_inline int ticket_key_expired(const SSL_TICKET_KEY *key,
+                                          time_t now)
+{
+    return key->expires != 0 && now >= key->expires;
+}
+
+/* The key that tickets are encrypted with, if any */
+static SSL_TICKET_KEY *ticket_keys_current(const SSL_TICKET_KEYS *keys)
+{
+    size_t i;
+
+    for (i = 0; i < keys->num; i++)
+        if ((keys->keys[i]->flags & SSL_TICKET_KEY_DECRYPT_ONLY) == 0)
+            return keys->keys[i];
+    return NULL;
+}
+
+static SSL_TICKET_KEY *ticket_keys_find(SSL_TICKET_KEYS *keys,
+                                        const unsigned char *name, time_t now)
+{
+    SSL_TICKET_KEY tmp, *ret;
+
+    memcpy(tmp.name, name, sizeof(tmp.name));
+    ret = lh_SSL_TICKET_KEY_retrieve(keys->by_name, &tmp);
+    if (ret == NULL || ticket_key_expired(ret, now))
+        return NULL;
+    return ret;
+}
+
+/* Must be called with the write lock held */
+static SSL_TICKET_KEY *ticket_keys_rotate(SSL_CTX *ctx, SSL_TICKET_KEYS *keys,
+                                          time_t now)
+{
+    SSL_TICKET_KEY *key;
+    size_t i;
+
+    if ((key = ticket_key_new(ctx, NULL, 0)) == NULL)
+        return NULL;
+    for (i = 0; i < keys->num; i++) {
+        if ((keys->keys[i]->flags & SSL_TICKET_KEY_DECRYPT_ONLY) == 0) {
+            keys->keys[i]->flags |= SSL_TICKET_KEY_DECRYPT_ONLY;
+            keys->keys[i]->expires = now + keys->rotate_lifetime;
+        }
+    }
+    for (i = keys->num; i-- > 0; )
+        if (ticket_key_expired(keys->keys[i], now))
+            ticket_keys_delete(keys, i, 1);
+    if (!ticket_keys_insert(keys, key)) {
+        ticket_key_free(key);
+        return NULL;
+    }
+    return key;
+}
+
+int ssl_ticket_keys_generate(SSL_CTX *ctx)
+{
+    SSL_TICKET_KEYS *keys = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY *key = ticket_key_new(ctx, NULL, 0);
+    int ret;
+
+    if (key == NULL)
+        return 0;
+    if (!CRYPTO_THREAD_write_lock(keys->lock)) {
+        ticket_key_free(key);
+        return 0;
+    }
+    ret = ticket_keys_insert(keys, key);
+    CRYPTO_THREAD_unlock(keys->lock);
+    if (!ret)
+        ticket_key_free(key);
+    return ret;
+}
+
+/* Replaces all keys with |keys| */
+int ssl_ticket_keys_set(SSL_CTX *ctx, const unsigned char *keys)
+{
+    SSL_TICKET_KEYS *ring = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY *key = ticket_key_new(ctx, keys, 0);
+    int ret;
+
+    if (key == NULL)
+        return 0;
+    if (!CRYPTO_THREAD_write_lock(ring->lock)) {
+        ticket_key_free(key);
+        return 0;
+    }
+    while (ring->num > 0)
+        ticket_keys_delete(ring, ring->num - 1, 1);
+    ret = ticket_keys_insert(ring, key);
+    CRYPTO_THREAD_unlock(ring->lock);
+    if (!ret)
+        ticket_key_free(key);
+    return ret;
+}
+
+/* Gets the current key, or the newest one if all are decrypt-only */
+int ssl_ticket_keys_get(SSL_CTX *ctx, unsigned char *keys)
+{
+    SSL_TICKET_KEYS *ring = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY *key;
+
+    if (!CRYPTO_THREAD_read_lock(ring->lock))
+        return 0;
+    if ((key = ticket_keys_current(ring)) == NULL && ring->num > 0)
+        key = ring->keys[0];
+    if (key != NULL) {
+        memcpy(keys, key->name, sizeof(key->name));
+        memcpy(keys + sizeof(key->name), key->hmac_key,
+               sizeof(key->hmac_key));
+        memcpy(keys + sizeof(key->name) + sizeof(key->hmac_key),
+               key->aes_key, sizeof(key->aes_key));
+    }
+    CRYPTO_THREAD_unlock(ring->lock);
+    return key != NULL;
+}
+
+/*
+ * Sets up |cctx| and |*hctx| for a ticket, the same way that the
+ * ticket_key_evp_cb callback does.  When encrypting the current key's name
+ * is written to |name| and a random IV to |iv|.  Returns 1 on success, 2 if
+ * the ticket should be renewed, 0 if there is no key and -1 on error.
+ *
+ * The lock is only taken for writing when a key is rotated or its contexts
+ * are set up, which happens once per key.
+ */
+int ssl_ticket_key_init(SSL_CTX *ctx, unsigned char *name, unsigned char *iv,
+                        EVP_CIPHER_CTX *cctx, SSL_HMAC **hctx, int enc)
+{
+    SSL_TICKET_KEYS *keys = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY *key;
+    time_t now = time(NULL);
+    int write = 0, iv_len, ret = -1;
+
+    *hctx = NULL;
+ again:
+    if (!(write ? CRYPTO_THREAD_write_lock(keys->lock)
+                : CRYPTO_THREAD_read_lock(keys->lock)))
+        return -1;
+
+    if (enc) {
+        key = ticket_keys_current(keys);
+        if (keys->rotate_interval > 0
+                && (key == NULL
+                    || now - key->created >= keys->rotate_interval)) {
+            if (!write)
+                goto relock;
+            if ((key = ticket_keys_rotate(ctx, keys, now)) == NULL)
+                goto end;
+        }
+    } else {
+        key = ticket_keys_find(keys, name, now);
+    }
+    if (key == NULL) {
+        ret = 0;
+        goto end;
+    }
+
+    if (key->mac_ctx == NULL) {
+        if (!write)
+            goto relock;
+        if (!ticket_key_init_ctxs(ctx, key))
+            goto end;
+    }
+
+    if (enc) {
+        iv_len = EVP_CIPHER_CTX_get_iv_length(key->enc_ctx);
+        if (iv_len < 0
+                || RAND_bytes_ex(ctx->libctx, iv, iv_len, 0) <= 0
+                || !EVP_CIPHER_CTX_copy(cctx, key->enc_ctx)
+                || !EVP_EncryptInit_ex(cctx, NULL, NULL, NULL, iv))
+            goto end;
+        memcpy(name, key->name, sizeof(key->name));
+    } else if (!EVP_CIPHER_CTX_copy(cctx, key->dec_ctx)
+               || !EVP_DecryptInit_ex(cctx, NULL, NULL, NULL, iv)) {
+        goto end;
+    }
+    if ((*hctx = ssl_hmac_new_copy(key->mac_ctx)) == NULL)
+        goto end;
+
+    ret = (key->flags & SSL_TICKET_KEY_DECRYPT_ONLY) != 0 ? 2 : 1;
+ end:
+    CRYPTO_THREAD_unlock(keys->lock);
+    return ret;
+
+ relock:
+    CRYPTO_THREAD_unlock(keys->lock);
+    write = 1;
+    goto again;
+}
+
+int SSL_CTX_add_ticket_key(SSL_CTX *ctx, const unsigned char *keys,
+                           size_t keylen, int flags)
+{
+    SSL_TICKET_KEYS *ring = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY *key;
+    int ret;
+
+    if (keys == NULL || keylen != TICKET_KEY_BYTES) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_INVALID_TICKET_KEYS_LENGTH);
+        return 0;
+    }
+    if ((flags & ~SSL_TICKET_KEY_DECRYPT_ONLY) != 0) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    if ((key = ticket_key_new(ctx, keys, flags)) == NULL)
+        return 0;
+    if (!CRYPTO_THREAD_write_lock(ring->lock)) {
+        ticket_key_free(key);
+        return 0;
+    }
+    ret = ticket_keys_insert(ring, key);
+    CRYPTO_THREAD_unlock(ring->lock);
+    if (!ret)
+        ticket_key_free(key);
+    return ret;
+}
+
+int SSL_CTX_remove_ticket_key(SSL_CTX *ctx, const unsigned char *name,
+                              size_t namelen)
+{
+    SSL_TICKET_KEYS *ring = ctx->ext.ticket_keys;
+    SSL_TICKET_KEY tmp, *key;
+    size_t i;
+
+    if (name == NULL || namelen != TLSEXT_KEYNAME_LENGTH)
+        return 0;
+    memcpy(tmp.name, name, sizeof(tmp.name));
+    if (!CRYPTO_THREAD_write_lock(ring->lock))
+        return 0;
+    if ((key = lh_SSL_TICKET_KEY_retrieve(ring->by_name, &tmp)) != NULL) {
+        for (i = 0; ring->keys[i] != key; i++)
+            continue;
+        ticket_keys_delete(ring, i, 1);
+    }
+    CRYPTO_THREAD_unlock(ring->lock);
+    return key != NULL;
+}
+
+int SSL_CTX_set_ticket_key_rotation(SSL_CTX *ctx, long interval,
+                                    long lifetime)
+{
+    SSL_TICKET_KEYS *ring = ctx->ext.ticket_keys;
+
+    if (interval < 0 || lifetime < 0) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    if (!CRYPTO_THREAD_write_lock(ring->lock))
+        return 0;
+    ring->rotate_interval = (time_t)interval;
+    ring->rotate_lifetime = (time_t)lifetime;
+    CRYPTO_THREAD_unlock(ring->lock);
+    return 1;
+}
@@ -1630,7 +1630,9 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
 
     if (!ginf->is_kem) {
         /* Regular KEX */
-        skey = ssl_generate_pkey(s, ckey);
+        skey = ssl_key_share_pool_get(s, s->s3.group_id);
+        if (skey == NULL)
+            skey = ssl_generate_pkey(s, ckey);
         if (skey == NULL) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
             return EXT_RETURN_FAIL;
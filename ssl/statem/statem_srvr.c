@@ -3658,69 +3658,53 @@ static int construct_stateless_ticket(SSL *s, WPACKET *pkt, uint32_t age_add,
     EVP_CIPHER_CTX *ctx = NULL;
     SSL_HMAC *hctx = NULL;
     unsigned char *p, *encdata1, *encdata2, *macdata1, *macdata2;
-    const unsigned char *const_p;
-    int len, slen_full, slen, lenfinal;
-    SSL_SESSION *sess;
-    size_t hlen;
+    int len, lenfinal;
+    size_t slen, hlen;
     SSL_CTX *tctx = s->session_ctx;
     unsigned char iv[EVP_MAX_IV_LENGTH];
     unsigned char key_name[TLSEXT_KEYNAME_LENGTH];
-    int iv_len, ok = 0;
+    int iv_len, ret = 0, ok = 0;
     size_t macoffset, macendoffset;
+    /*
+     * Servers running older versions can't decrypt tickets in the flat
+     * encoding, so it has to be asked for
+     */
+    int flat = (s->options & SSL_OP_FLAT_SESSION_TICKETS) != 0;
 
     /* get session encoding length */
-    slen_full = i2d_SSL_SESSION(s->session, NULL);
+    if (flat) {
+        if (!SSL_SESSION_encode(s->session, NULL, 0, &slen))
+            slen = 0;
+    } else {
+        len = i2d_SSL_SESSION(s->session, NULL);
+        slen = len > 0 ? (size_t)len : 0;
+    }
     /*
      * Some length values are 16 bits, so forget it if session is too
      * long
      */
-    if (slen_full == 0 || slen_full > 0xFF00) {
+    if (slen == 0 || slen > 0xFF00) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
         goto err;
     }
-    senc = OPENSSL_malloc(slen_full);
+    senc = OPENSSL_malloc(slen);
     if (senc == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
         goto err;
     }
 
     ctx = EVP_CIPHER_CTX_new();
-    hctx = ssl_hmac_new(tctx);
-    if (ctx == NULL || hctx == NULL) {
+    if (ctx == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
         goto err;
     }
 
     p = senc;
-    if (!i2d_SSL_SESSION(s->session, &p)) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        goto err;
-    }
-
-    /*
-     * create a fresh copy (not shared with other threads) to clean up
-     */
-    const_p = senc;
-    sess = d2i_SSL_SESSION(NULL, &const_p, slen_full);
-    if (sess == NULL) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        goto err;
-    }
-
-    slen = i2d_SSL_SESSION(sess, NULL);
-    if (slen == 0 || slen > slen_full) {
-        /* shouldn't ever happen */
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        SSL_SESSION_free(sess);
-        goto err;
-    }
-    p = senc;
-    if (!i2d_SSL_SESSION(sess, &p)) {
+    if (flat ? !SSL_SESSION_encode(s->session, senc, slen, &slen)
+             : i2d_SSL_SESSION(s->session, &p) != (int)slen) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-        SSL_SESSION_free(sess);
         goto err;
     }
-    SSL_SESSION_free(sess);
 
     /*
      * Initialize HMAC and cipher contexts. If callback present it does
@@ -3732,8 +3716,11 @@ static int construct_stateless_ticket(SSL *s, WPACKET *pkt, uint32_t age_add,
     if (tctx->ext.ticket_key_evp_cb != NULL)
 #endif
     {
-        int ret = 0;
-
+        hctx = ssl_hmac_new(tctx);
+        if (hctx == NULL) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
         if (tctx->ext.ticket_key_evp_cb != NULL)
             ret = tctx->ext.ticket_key_evp_cb(s, key_name, iv, ctx,
                                               ssl_hmac_get0_EVP_MAC_CTX(hctx),
@@ -3744,51 +3731,32 @@ static int construct_stateless_ticket(SSL *s, WPACKET *pkt, uint32_t age_add,
             ret = tctx->ext.ticket_key_cb(s, key_name, iv, ctx,
                                           ssl_hmac_get0_HMAC_CTX(hctx), 1);
 #endif
-
-        if (ret == 0) {
-
-            /* Put timeout and length */
-            if (!WPACKET_put_bytes_u32(pkt, 0)
-                    || !WPACKET_put_bytes_u16(pkt, 0)) {
-                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-                goto err;
-            }
-            OPENSSL_free(senc);
-            EVP_CIPHER_CTX_free(ctx);
-            ssl_hmac_free(hctx);
-            return 1;
-        }
         if (ret < 0) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_R_CALLBACK_FAILED);
             goto err;
         }
-        iv_len = EVP_CIPHER_CTX_get_iv_length(ctx);
     } else {
-        EVP_CIPHER *cipher = EVP_CIPHER_fetch(s->ctx->libctx, "AES-256-CBC",
-                                              s->ctx->propq);
-
-        if (cipher == NULL) {
-            /* Error is already recorded */
-            SSLfatal_alert(s, SSL_AD_INTERNAL_ERROR);
+        /* Uses the current key of the key ring, 0 if there is none */
+        ret = ssl_ticket_key_init(tctx, key_name, iv, ctx, &hctx, 1);
+        if (ret < 0) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
         }
+    }
 
-        iv_len = EVP_CIPHER_get_iv_length(cipher);
-        if (iv_len < 0
-                || RAND_bytes_ex(s->ctx->libctx, iv, iv_len, 0) <= 0
-                || !EVP_EncryptInit_ex(ctx, cipher, NULL,
-                                       tctx->ext.secure->tick_aes_key, iv)
-                || !ssl_hmac_init(hctx, tctx->ext.secure->tick_hmac_key,
-                                  sizeof(tctx->ext.secure->tick_hmac_key),
-                                  "SHA256")) {
-            EVP_CIPHER_free(cipher);
+    if (ret == 0) {
+        /* Put timeout and length */
+        if (!WPACKET_put_bytes_u32(pkt, 0)
+                || !WPACKET_put_bytes_u16(pkt, 0)) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
         }
-        EVP_CIPHER_free(cipher);
-        memcpy(key_name, tctx->ext.tick_key_name,
-               sizeof(tctx->ext.tick_key_name));
+        OPENSSL_free(senc);
+        EVP_CIPHER_CTX_free(ctx);
+        ssl_hmac_free(hctx);
+        return 1;
     }
+    iv_len = EVP_CIPHER_CTX_get_iv_length(ctx);
 
     if (!create_ticket_prequel(s, pkt, age_add, tick_nonce)) {
         /* SSLfatal() already called */
@@ -3803,13 +3771,13 @@ static int construct_stateless_ticket(SSL *s, WPACKET *pkt, uint32_t age_add,
             || !WPACKET_reserve_bytes(pkt, slen + EVP_MAX_BLOCK_LENGTH,
                                       &encdata1)
                /* Encrypt session data */
-            || !EVP_EncryptUpdate(ctx, encdata1, &len, senc, slen)
+            || !EVP_EncryptUpdate(ctx, encdata1, &len, senc, (int)slen)
             || !WPACKET_allocate_bytes(pkt, len, &encdata2)
             || encdata1 != encdata2
             || !EVP_EncryptFinal(ctx, encdata1 + len, &lenfinal)
             || !WPACKET_allocate_bytes(pkt, lenfinal, &encdata2)
             || encdata1 + len != encdata2
-            || len + lenfinal > slen + EVP_MAX_BLOCK_LENGTH
+            || (size_t)(len + lenfinal) > slen + EVP_MAX_BLOCK_LENGTH
             || !WPACKET_get_total_written(pkt, &macendoffset)
             || !ssl_hmac_update(hctx,
                                 (unsigned char *)s->init_buf->data + macoffset,
@@ -1814,11 +1814,6 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
     }
 
     /* Initialize session ticket encryption and HMAC contexts */
-    hctx = ssl_hmac_new(tctx);
-    if (hctx == NULL) {
-        ret = SSL_TICKET_FATAL_ERR_MALLOC;
-        goto end;
-    }
     ctx = EVP_CIPHER_CTX_new();
     if (ctx == NULL) {
         ret = SSL_TICKET_FATAL_ERR_MALLOC;
@@ -1833,6 +1828,11 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         unsigned char *nctick = (unsigned char *)etick;
         int rv = 0;
 
+        hctx = ssl_hmac_new(tctx);
+        if (hctx == NULL) {
+            ret = SSL_TICKET_FATAL_ERR_MALLOC;
+            goto end;
+        }
         if (tctx->ext.ticket_key_evp_cb != NULL)
             rv = tctx->ext.ticket_key_evp_cb(s, nctick,
                                              nctick + TLSEXT_KEYNAME_LENGTH,
@@ -1857,30 +1857,21 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         if (rv == 2)
             renew_ticket = 1;
     } else {
-        EVP_CIPHER *aes256cbc = NULL;
+        /* Look the key up by its name */
+        int rv = ssl_ticket_key_init(tctx, (unsigned char *)etick,
+                                     (unsigned char *)etick
+                                     + TLSEXT_KEYNAME_LENGTH,
+                                     ctx, &hctx, 0);
 
-        /* Check key name matches */
-        if (memcmp(etick, tctx->ext.tick_key_name,
-                   TLSEXT_KEYNAME_LENGTH) != 0) {
-            ret = SSL_TICKET_NO_DECRYPT;
+        if (rv < 0) {
+            ret = SSL_TICKET_FATAL_ERR_OTHER;
             goto end;
         }
-
-        aes256cbc = EVP_CIPHER_fetch(s->ctx->libctx, "AES-256-CBC",
-                                     s->ctx->propq);
-        if (aes256cbc == NULL
-            || ssl_hmac_init(hctx, tctx->ext.secure->tick_hmac_key,
-                             sizeof(tctx->ext.secure->tick_hmac_key),
-                             "SHA256") <= 0
-            || EVP_DecryptInit_ex(ctx, aes256cbc, NULL,
-                                  tctx->ext.secure->tick_aes_key,
-                                  etick + TLSEXT_KEYNAME_LENGTH) <= 0) {
-            EVP_CIPHER_free(aes256cbc);
-            ret = SSL_TICKET_FATAL_ERR_OTHER;
+        if (rv == 0) {
+            ret = SSL_TICKET_NO_DECRYPT;
             goto end;
         }
-        EVP_CIPHER_free(aes256cbc);
-        if (SSL_IS_TLS13(s))
+        if (rv == 2 || SSL_IS_TLS13(s))
             renew_ticket = 1;
     }
     /*
@@ -1928,19 +1919,11 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         goto end;
     }
     slen += declen;
-    p = sdec;
 
-    sess = d2i_SSL_SESSION(NULL, &p, slen);
-    slen -= p - sdec;
+    /* Trailing bytes make this fail as well */
+    sess = ssl_session_decode_any(sdec, slen);
     OPENSSL_free(sdec);
     if (sess) {
-        /* Some additional consistency checks */
-        if (slen != 0) {
-            SSL_SESSION_free(sess);
-            sess = NULL;
-            ret = SSL_TICKET_NO_DECRYPT;
-            goto end;
-        }
         /*
          * The session ID, if non-empty, is used by some clients to detect
          * that the ticket has been accepted. So we copy it to the session
@@ -3401,6 +3384,20 @@ SSL_HMAC *ssl_hmac_new(const SSL_CTX *ctx)
     return NULL;
 }
 
+/* Creates an SSL_HMAC from a copy of the already keyed |src| */
+SSL_HMAC *ssl_hmac_new_copy(const EVP_MAC_CTX *src)
+{
+    SSL_HMAC *ret = OPENSSL_zalloc(sizeof(*ret));
+
+    if (ret == NULL)
+        return NULL;
+    if ((ret->ctx = EVP_MAC_CTX_dup(src)) == NULL) {
+        OPENSSL_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
 void ssl_hmac_free(SSL_HMAC *ctx)
 {
     if (ctx != NULL) {
@@ -396,6 +396,43 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
     return 1;
 }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+/*
+ * Hand the traffic key for one direction over to the kernel. Returns 1 if the
+ * kernel protects the records in that direction from now on, 0 otherwise.
+ */
+static int tls13_set_ktls(SSL *s, const EVP_CIPHER *cipher,
+                          EVP_CIPHER_CTX *ciph_ctx, unsigned char *iv,
+                          unsigned char *key, int sending)
+{
+    ktls_crypto_info_t crypto_info;
+    unsigned char *seq;
+    int ret;
+
+    if (sending) {
+        seq = RECORD_LAYER_get_write_sequence(&s->rlayer);
+    } else {
+# ifndef OPENSSL_KTLS_TLS13_RX
+        return 0;
+# else
+        /* Opt-in only, not every kernel can take a new key from a KeyUpdate */
+        if ((s->options & SSL_OP_ENABLE_KTLS_TLS13_RX) == 0)
+            return 0;
+        seq = RECORD_LAYER_get_read_sequence(&s->rlayer);
+# endif
+    }
+
+    /* configure kernel crypto structure */
+    if (!ktls_configure_crypto(s, cipher, ciph_ctx, seq, &crypto_info, NULL,
+                               iv, key, NULL, 0))
+        return 0;
+
+    ret = BIO_set_ktls(sending ? s->wbio : s->rbio, &crypto_info, sending);
+    OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+    return ret > 0;
+}
+#endif
+
 int tls13_change_cipher_state(SSL *s, int which)
 {
 #ifdef CHARSET_EBCDIC
@@ -433,7 +470,6 @@ int tls13_change_cipher_state(SSL *s, int which)
     const EVP_MD *md = NULL;
     const EVP_CIPHER *cipher = NULL;
 #if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
-    ktls_crypto_info_t crypto_info;
     BIO *bio;
 #endif
 
@@ -688,8 +724,7 @@ int tls13_change_cipher_state(SSL *s, int which)
         s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
 #ifndef OPENSSL_NO_KTLS
 # if defined(OPENSSL_KTLS_TLS13)
-    if (!(which & SSL3_CC_WRITE)
-            || !(which & SSL3_CC_APPLICATION)
+    if (!(which & SSL3_CC_APPLICATION)
             || (s->options & SSL_OP_ENABLE_KTLS) == 0)
         goto skip_ktls;
 
@@ -698,32 +733,42 @@ int tls13_change_cipher_state(SSL *s, int which)
         goto skip_ktls;
 
     /* ktls does not support record padding */
-    if (s->record_padding_cb != NULL)
+    if ((which & SSL3_CC_WRITE) && s->record_padding_cb != NULL)
         goto skip_ktls;
 
     /* check that cipher is supported */
     if (!ktls_check_supported_cipher(s, cipher, ciph_ctx))
         goto skip_ktls;
 
-    bio = s->wbio;
+    if (which & SSL3_CC_WRITE)
+        bio = s->wbio;
+    else
+        bio = s->rbio;
 
     if (!ossl_assert(bio != NULL)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
         goto err;
     }
 
-    /* All future data will get encrypted by ktls. Flush the BIO or skip ktls */
-    if (BIO_flush(bio) <= 0)
-        goto skip_ktls;
-
-    /* configure kernel crypto structure */
-    if (!ktls_configure_crypto(s, cipher, ciph_ctx,
-                               RECORD_LAYER_get_write_sequence(&s->rlayer),
-                               &crypto_info, NULL, iv, key, NULL, 0))
-        goto skip_ktls;
+    if (which & SSL3_CC_WRITE) {
+        /*
+         * All future data will get encrypted by ktls. Flush the BIO or skip
+         * ktls
+         */
+        if (BIO_flush(bio) <= 0)
+            goto skip_ktls;
+    } else {
+        /*
+         * The kernel takes over from the next byte on the socket, so records
+         * already in the read buffer would be decrypted with the wrong key
+         */
+        if (SSL3_BUFFER_get_left(RECORD_LAYER_get_rbuf(&s->rlayer)) != 0)
+            goto skip_ktls;
+    }
 
     /* ktls works with user provided buffers directly */
-    if (BIO_set_ktls(bio, &crypto_info, which & SSL3_CC_WRITE))
+    if (tls13_set_ktls(s, cipher, ciph_ctx, iv, key, which & SSL3_CC_WRITE)
+            && (which & SSL3_CC_WRITE))
         ssl3_release_write_buffer(s);
 skip_ktls:
 # endif
@@ -779,6 +824,20 @@ int tls13_update_key(SSL *s, int sending)
         goto err;
     }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    /*
+     * If the kernel protects this direction it needs the new key too. There
+     * is no way back to protecting records in user space.
+     */
+    if ((sending ? BIO_get_ktls_send(s->wbio) : BIO_get_ktls_recv(s->rbio))
+            && !tls13_set_ktls(s, s->s3.tmp.new_sym_enc, ciph_ctx, iv, key,
+                               sending)) {
+        SSLfatal_data(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR,
+                      "kernel refused the updated traffic key");
+        goto err;
+    }
+#endif
+
     memcpy(insecret, secret, hashlen);
 
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
@@ -334,6 +334,62 @@ static int test_clear_error(void)
     return res;
 }
 
+/*
+ * Error data and debug information that don't fit in the space that each
+ * error has for them are kept all the same
+ */
+static int test_long_error_data(void)
+{
+    char file[300], func[200], txt[2 * ERR_MAX_DATA_SIZE];
+    const char *f = NULL, *fn = NULL, *data = NULL;
+    int line = 0, flags = -1, res = 0;
+
+    memset(file, 'f', sizeof(file) - 1);
+    file[sizeof(file) - 1] = '\0';
+    memset(func, 'g', sizeof(func) - 1);
+    func[sizeof(func) - 1] = '\0';
+    memset(txt, 'x', sizeof(txt) - 1);
+    txt[sizeof(txt) - 1] = '\0';
+
+    /* Data that is appended to grows beyond the space that an error has */
+    ERR_new();
+    ERR_set_debug(file, 42, func);
+    ERR_set_error(ERR_LIB_NONE, 0, "%s", "short");
+    ERR_add_error_data(2, "-", txt + sizeof(txt) - 300);
+    ERR_peek_last_error_all(&f, &line, &fn, &data, &flags);
+    if (!TEST_str_eq(f, file)
+            || !TEST_int_eq(line, 42)
+            || !TEST_str_eq(fn, func)
+            || !TEST_size_t_eq(strlen(data), 5 + 1 + 299)
+            || !TEST_strn_eq(data, "short-xxx", 9)
+            || !TEST_int_eq(flags, ERR_TXT_STRING | ERR_TXT_MALLOCED))
+        goto err;
+
+    /* Formatted data is limited to ERR_MAX_DATA_SIZE, as it always was */
+    ERR_raise_data(ERR_LIB_NONE, 0, "%.*s", ERR_MAX_DATA_SIZE - 1, txt);
+    ERR_peek_last_error_data(&data, &flags);
+    if (!TEST_size_t_eq(strlen(data), ERR_MAX_DATA_SIZE - 1)
+            || !TEST_int_eq(flags, ERR_TXT_STRING | ERR_TXT_MALLOCED))
+        goto err;
+
+    /* Short data after long data, wrapping around the error queue */
+    ERR_clear_error();
+    for (line = 0; line < 32; line++) {
+        if (line % 3 == 0)
+            ERR_raise_data(ERR_LIB_NONE, 0, "%s", txt + 600);
+        else
+            ERR_raise_data(ERR_LIB_NONE, 0, "%d", line);
+    }
+    ERR_peek_last_error_data(&data, &flags);
+    if (!TEST_str_eq(data, "31"))
+        goto err;
+
+    res = 1;
+ err:
+    ERR_clear_error();
+    return res;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(preserves_system_error);
@@ -344,5 +400,6 @@ int setup_tests(void)
 #endif
     ADD_TEST(test_marks);
     ADD_TEST(test_clear_error);
+    ADD_TEST(test_long_error_data);
     return 1;
 }
@@ -1132,6 +1132,347 @@ static int test_EVP_PKEY_sign(int tst)
     return ret;
 }
 
+#define BATCH_SIZE  5
+
+/*
+ * Sign a batch of digests and check each signature.
+ * Test 0: RSA with PKCS#1 v1.5 padding, against EVP_PKEY_sign()
+ * Test 1: RSA with PSS padding
+ * Test 2: RSA with PKCS#1 v1.5 padding and no digest
+ * Test 3: EC, which has no batch support in the provider
+ */
+static int test_EVP_PKEY_sign_batch(int tst)
+{
+    int ret = 0;
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    unsigned char tbsbuf[BATCH_SIZE][32];
+    unsigned char *sig[BATCH_SIZE] = { NULL };
+    const unsigned char *tbs[BATCH_SIZE];
+    size_t siglen[BATCH_SIZE], tbslen[BATCH_SIZE];
+    unsigned char *onesig = NULL;
+    size_t onesiglen, i;
+
+    if (tst < 3) {
+        if (!TEST_ptr(pkey = load_example_rsa_key()))
+            goto out;
+    } else {
+#ifndef OPENSSL_NO_EC
+        if (!TEST_ptr(pkey = load_example_ec_key()))
+            goto out;
+#else
+        return TEST_skip("EC is disabled");
+#endif
+    }
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        memset(tbsbuf[i], (int)i, sizeof(tbsbuf[i]));
+        tbs[i] = tbsbuf[i];
+        tbslen[i] = sizeof(tbsbuf[i]);
+        siglen[i] = EVP_PKEY_get_size(pkey);
+        if (!TEST_ptr(sig[i] = OPENSSL_malloc(siglen[i])))
+            goto out;
+    }
+
+    if (!TEST_ptr(ctx = EVP_PKEY_CTX_new_from_pkey(testctx, pkey, testpropq))
+            || !TEST_int_gt(EVP_PKEY_sign_init(ctx), 0))
+        goto out;
+    if (tst == 0 || tst == 1) {
+        if (!TEST_int_gt(EVP_PKEY_CTX_set_rsa_padding(ctx,
+                                                      tst == 0
+                                                      ? RSA_PKCS1_PADDING
+                                                      : RSA_PKCS1_PSS_PADDING),
+                         0)
+                || !TEST_int_gt(EVP_PKEY_CTX_set_signature_md(ctx,
+                                                              EVP_sha256()),
+                                0))
+            goto out;
+    }
+    if (!TEST_int_eq(EVP_PKEY_sign_batch(ctx, BATCH_SIZE, sig, siglen, tbs,
+                                         tbslen), 1))
+        goto out;
+
+    if (!TEST_ptr(onesig = OPENSSL_malloc(EVP_PKEY_get_size(pkey))))
+        goto out;
+    /* PKCS#1 v1.5 signatures are deterministic */
+    for (i = 0; tst == 0 && i < BATCH_SIZE; i++) {
+        onesiglen = EVP_PKEY_get_size(pkey);
+        if (!TEST_int_gt(EVP_PKEY_sign(ctx, onesig, &onesiglen, tbs[i],
+                                       tbslen[i]), 0)
+                || !TEST_mem_eq(sig[i], siglen[i], onesig, onesiglen))
+            goto out;
+    }
+
+    if (!TEST_int_gt(EVP_PKEY_verify_init(ctx), 0))
+        goto out;
+    if (tst == 0 || tst == 1) {
+        if (!TEST_int_gt(EVP_PKEY_CTX_set_rsa_padding(ctx,
+                                                      tst == 0
+                                                      ? RSA_PKCS1_PADDING
+                                                      : RSA_PKCS1_PSS_PADDING),
+                         0)
+                || !TEST_int_gt(EVP_PKEY_CTX_set_signature_md(ctx,
+                                                              EVP_sha256()),
+                                0))
+            goto out;
+    }
+    for (i = 0; i < BATCH_SIZE; i++)
+        if (!TEST_int_gt(EVP_PKEY_verify(ctx, sig[i], siglen[i], tbs[i],
+                                         tbslen[i]), 0))
+            goto out;
+
+    /* A signature buffer that is too short fails the whole batch */
+    if (!TEST_int_gt(EVP_PKEY_sign_init(ctx), 0))
+        goto out;
+    siglen[BATCH_SIZE - 1] = 1;
+    if (!TEST_int_le(EVP_PKEY_sign_batch(ctx, BATCH_SIZE, sig, siglen, tbs,
+                                         tbslen), 0))
+        goto out;
+
+    ret = 1;
+ out:
+    for (i = 0; i < BATCH_SIZE; i++)
+        OPENSSL_free(sig[i]);
+    OPENSSL_free(onesig);
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+
+/*
+ * Decrypt a batch of RSA ciphertexts.
+ * Test 0: PKCS#1 v1.5 padding
+ * Test 1: OAEP padding
+ */
+static int test_EVP_PKEY_decrypt_batch(int tst)
+{
+    int ret = 0;
+    int padding = tst == 0 ? RSA_PKCS1_PADDING : RSA_PKCS1_OAEP_PADDING;
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    unsigned char msg[BATCH_SIZE][16];
+    unsigned char *ct[BATCH_SIZE] = { NULL }, *pt[BATCH_SIZE] = { NULL };
+    const unsigned char *in[BATCH_SIZE];
+    size_t ctlen[BATCH_SIZE], ptlen[BATCH_SIZE], i;
+
+    if (!TEST_ptr(pkey = load_example_rsa_key())
+            || !TEST_ptr(ctx = EVP_PKEY_CTX_new_from_pkey(testctx, pkey,
+                                                          testpropq))
+            || !TEST_int_gt(EVP_PKEY_encrypt_init(ctx), 0)
+            || !TEST_int_gt(EVP_PKEY_CTX_set_rsa_padding(ctx, padding), 0))
+        goto out;
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        memset(msg[i], 'a' + (int)i, sizeof(msg[i]));
+        ctlen[i] = ptlen[i] = EVP_PKEY_get_size(pkey);
+        if (!TEST_ptr(ct[i] = OPENSSL_malloc(ctlen[i]))
+                || !TEST_ptr(pt[i] = OPENSSL_malloc(ptlen[i]))
+                || !TEST_int_gt(EVP_PKEY_encrypt(ctx, ct[i], &ctlen[i], msg[i],
+                                                 sizeof(msg[i])), 0))
+            goto out;
+        in[i] = ct[i];
+    }
+
+    if (!TEST_int_gt(EVP_PKEY_decrypt_init(ctx), 0)
+            || !TEST_int_gt(EVP_PKEY_CTX_set_rsa_padding(ctx, padding), 0)
+            || !TEST_int_eq(EVP_PKEY_decrypt_batch(ctx, BATCH_SIZE, pt, ptlen,
+                                                   in, ctlen), 1))
+        goto out;
+    for (i = 0; i < BATCH_SIZE; i++)
+        if (!TEST_mem_eq(pt[i], ptlen[i], msg[i], sizeof(msg[i])))
+            goto out;
+
+    ret = 1;
+ out:
+    for (i = 0; i < BATCH_SIZE; i++) {
+        OPENSSL_free(ct[i]);
+        OPENSSL_free(pt[i]);
+    }
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+
+#ifndef OPENSSL_NO_EC
+/* More than one chunk of derivations sharing a field inversion */
+# define DERIVE_BATCH_SIZE  20
+
+/*
+ * Generate and derive with batches of keys, and check the secrets against
+ * the ones the peers derive one at a time.
+ * Test 0: X25519
+ * Test 1: X448
+ */
+static int test_EVP_PKEY_derive_batch(int tst)
+{
+    static const unsigned char zeros[56] = { 0 };
+    const char *alg = tst == 0 ? "X25519" : "X448";
+    size_t keylen = tst == 0 ? 32 : 56;
+    int ret = 0;
+    EVP_PKEY_CTX *genctx = NULL;
+    EVP_PKEY *ours[DERIVE_BATCH_SIZE] = { NULL };
+    EVP_PKEY *peers[DERIVE_BATCH_SIZE] = { NULL };
+    EVP_PKEY_CTX *ctx[DERIVE_BATCH_SIZE] = { NULL };
+    EVP_PKEY_CTX *peerctx = NULL;
+    unsigned char secrets[DERIVE_BATCH_SIZE][56];
+    unsigned char *secret[DERIVE_BATCH_SIZE];
+    size_t secretlen[DERIVE_BATCH_SIZE];
+    unsigned char expected[56];
+    size_t expectedlen, i;
+
+    if (!TEST_ptr(genctx = EVP_PKEY_CTX_new_from_name(testctx, alg,
+                                                      testpropq))
+            || !TEST_int_gt(EVP_PKEY_keygen_init(genctx), 0)
+            || !TEST_int_eq(EVP_PKEY_generate_batch(genctx, DERIVE_BATCH_SIZE,
+                                                    ours), 1))
+        goto out;
+
+    for (i = 0; i < DERIVE_BATCH_SIZE; i++) {
+        if (!TEST_ptr(ours[i])
+                || !TEST_int_gt(EVP_PKEY_generate(genctx, &peers[i]), 0)
+                || !TEST_ptr(ctx[i] = EVP_PKEY_CTX_new_from_pkey(testctx,
+                                                                 ours[i],
+                                                                 testpropq))
+                || !TEST_int_gt(EVP_PKEY_derive_init(ctx[i]), 0)
+                || !TEST_int_gt(EVP_PKEY_derive_set_peer(ctx[i], peers[i]),
+                                0))
+            goto out;
+        secret[i] = secrets[i];
+        secretlen[i] = sizeof(secrets[i]);
+    }
+
+    if (!TEST_int_eq(EVP_PKEY_derive_batch(ctx, DERIVE_BATCH_SIZE, secret,
+                                           secretlen), 1))
+        goto out;
+
+    for (i = 0; i < DERIVE_BATCH_SIZE; i++) {
+        expectedlen = sizeof(expected);
+        if (!TEST_ptr(peerctx = EVP_PKEY_CTX_new_from_pkey(testctx, peers[i],
+                                                           testpropq))
+                || !TEST_int_gt(EVP_PKEY_derive_init(peerctx), 0)
+                || !TEST_int_gt(EVP_PKEY_derive_set_peer(peerctx, ours[i]), 0)
+                || !TEST_int_gt(EVP_PKEY_derive(peerctx, expected,
+                                                &expectedlen), 0)
+                || !TEST_mem_eq(secret[i], secretlen[i], expected,
+                                expectedlen))
+            goto out;
+        EVP_PKEY_CTX_free(peerctx);
+        peerctx = NULL;
+    }
+
+    /* A peer key of small order fails the whole batch */
+    EVP_PKEY_free(peers[DERIVE_BATCH_SIZE / 2]);
+    if (!TEST_ptr(peers[DERIVE_BATCH_SIZE / 2]
+                      = EVP_PKEY_new_raw_public_key_ex(testctx, alg, testpropq,
+                                                       zeros, keylen))
+            || !TEST_int_gt(EVP_PKEY_derive_set_peer(ctx[DERIVE_BATCH_SIZE / 2],
+                                                     peers[DERIVE_BATCH_SIZE / 2]),
+                            0))
+        goto out;
+    for (i = 0; i < DERIVE_BATCH_SIZE; i++)
+        secretlen[i] = sizeof(secrets[i]);
+    if (!TEST_int_le(EVP_PKEY_derive_batch(ctx, DERIVE_BATCH_SIZE, secret,
+                                           secretlen), 0))
+        goto out;
+
+    ret = 1;
+ out:
+    for (i = 0; i < DERIVE_BATCH_SIZE; i++) {
+        EVP_PKEY_CTX_free(ctx[i]);
+        EVP_PKEY_free(ours[i]);
+        EVP_PKEY_free(peers[i]);
+    }
+    EVP_PKEY_CTX_free(peerctx);
+    EVP_PKEY_CTX_free(genctx);
+    return ret;
+}
+
+/* More than one group of signatures that are verified together */
+# define VERIFY_BATCH_SIZE  40
+
+/*
+ * Verify a batch of ECDSA signatures made with three keys, one of which is
+ * on another curve, and check the results against single verifications.
+ * Test 0: P-256
+ * Test 1: P-384
+ */
+static int test_EVP_PKEY_verify_batch(int tst)
+{
+    const char *curves[3] = { "P-256", "P-256", "P-384" };
+    int ret = 0;
+    EVP_PKEY *keys[3] = { NULL, NULL, NULL };
+    EVP_PKEY_CTX *ctx[VERIFY_BATCH_SIZE] = { NULL };
+    EVP_PKEY_CTX *signctx = NULL;
+    unsigned char sigs[VERIFY_BATCH_SIZE][128];
+    unsigned char tbss[VERIFY_BATCH_SIZE][32];
+    const unsigned char *sig[VERIFY_BATCH_SIZE], *tbs[VERIFY_BATCH_SIZE];
+    size_t siglen[VERIFY_BATCH_SIZE], tbslen[VERIFY_BATCH_SIZE];
+    int results[VERIFY_BATCH_SIZE];
+    size_t i;
+
+    if (tst == 1) {
+        curves[0] = curves[1] = "P-384";
+        curves[2] = "P-256";
+    }
+    for (i = 0; i < OSSL_NELEM(keys); i++)
+        if (!TEST_ptr(keys[i] = EVP_PKEY_Q_keygen(testctx, testpropq, "EC",
+                                                  curves[i])))
+            goto out;
+
+    for (i = 0; i < VERIFY_BATCH_SIZE; i++) {
+        memset(tbss[i], (int)i, sizeof(tbss[i]));
+        tbs[i] = tbss[i];
+        tbslen[i] = sizeof(tbss[i]);
+        sig[i] = sigs[i];
+        siglen[i] = sizeof(sigs[i]);
+        if (!TEST_ptr(signctx = EVP_PKEY_CTX_new_from_pkey(testctx,
+                                                           keys[i % 3],
+                                                           testpropq))
+                || !TEST_int_gt(EVP_PKEY_sign_init(signctx), 0)
+                || !TEST_int_gt(EVP_PKEY_sign(signctx, sigs[i], &siglen[i],
+                                              tbs[i], tbslen[i]), 0)
+                || !TEST_ptr(ctx[i] = EVP_PKEY_CTX_new_from_pkey(testctx,
+                                                                 keys[i % 3],
+                                                                 testpropq))
+                || !TEST_int_gt(EVP_PKEY_verify_init(ctx[i]), 0))
+            goto out;
+        EVP_PKEY_CTX_free(signctx);
+        signctx = NULL;
+    }
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(ctx, VERIFY_BATCH_SIZE, sig,
+                                           siglen, tbs, tbslen, results), 1))
+        goto out;
+    for (i = 0; i < VERIFY_BATCH_SIZE; i++)
+        if (!TEST_int_eq(results[i], 1))
+            goto out;
+
+    /* A wrong digest, a wrong signature and a truncated signature */
+    tbss[3][0] ^= 1;
+    sigs[17][siglen[17] - 1] ^= 1;
+    siglen[35]--;
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(ctx, VERIFY_BATCH_SIZE, sig,
+                                           siglen, tbs, tbslen, results), 0))
+        goto out;
+    for (i = 0; i < VERIFY_BATCH_SIZE; i++)
+        if (!TEST_int_eq(results[i], i == 35 ? -1 : i == 3 || i == 17 ? 0 : 1))
+            goto out;
+    for (i = 0; i < VERIFY_BATCH_SIZE; i++)
+        if (!TEST_int_eq(results[i], EVP_PKEY_verify(ctx[i], sig[i], siglen[i],
+                                                     tbs[i], tbslen[i])))
+            goto out;
+
+    ret = 1;
+ out:
+    for (i = 0; i < VERIFY_BATCH_SIZE; i++)
+        EVP_PKEY_CTX_free(ctx[i]);
+    for (i = 0; i < OSSL_NELEM(keys); i++)
+        EVP_PKEY_free(keys[i]);
+    EVP_PKEY_CTX_free(signctx);
+    return ret;
+}
+#endif
+
 /*
  * n = 0 => test using legacy cipher
  * n = 1 => test using fetched cipher
@@ -4722,6 +5063,12 @@ int setup_tests(void)
     ADD_TEST(test_EVP_Digest);
     ADD_TEST(test_EVP_md_null);
     ADD_ALL_TESTS(test_EVP_PKEY_sign, 3);
+    ADD_ALL_TESTS(test_EVP_PKEY_sign_batch, 4);
+    ADD_ALL_TESTS(test_EVP_PKEY_decrypt_batch, 2);
+#ifndef OPENSSL_NO_EC
+    ADD_ALL_TESTS(test_EVP_PKEY_derive_batch, 2);
+    ADD_ALL_TESTS(test_EVP_PKEY_verify_batch, 2);
+#endif
     ADD_ALL_TESTS(test_EVP_Enveloped, 2);
     ADD_ALL_TESTS(test_d2i_AutoPrivateKey, OSSL_NELEM(keydata));
     ADD_TEST(test_privatekey_to_pkcs8);
@@ -18,6 +18,7 @@
  */
 
 #include <openssl/evp.h>
+#include <openssl/kdf.h>
 #include <openssl/pem.h>
 #include <openssl/provider.h>
 #include <openssl/rsa.h>
@@ -1013,6 +1014,316 @@ static int test_evp_md_ctx_copy(void)
     return ret;
 }
 
+static int test_thread_fetch_cache(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *deflt = NULL;
+    EVP_MD *md1 = NULL, *md2 = NULL, *md3 = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+            || !TEST_ptr(deflt = OSSL_PROVIDER_load(ctx, "default"))
+            || !TEST_false(EVP_thread_fetch_cache_is_enabled(ctx))
+            || !TEST_true(EVP_thread_fetch_cache_enable(ctx, 1))
+            || !TEST_true(EVP_thread_fetch_cache_is_enabled(ctx)))
+        goto err;
+
+    /* Repeated fetches return the same method */
+    if (!TEST_ptr(md1 = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_ptr_eq(md1, md2))
+        goto err;
+    EVP_MD_free(md2);
+    md2 = NULL;
+
+    /* Changing the default properties must invalidate the cached entry */
+    if (!TEST_true(EVP_set_default_properties(ctx, "provider=nonexistent")))
+        goto err;
+    ERR_set_mark();
+    md2 = EVP_MD_fetch(ctx, "SHA2-256", NULL);
+    ERR_pop_to_mark();
+    if (!TEST_ptr_null(md2)
+            || !TEST_true(EVP_set_default_properties(ctx, NULL))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_ptr(md3 = EVP_MD_fetch(ctx, "SHA2-256",
+                                            "provider=default"))
+            || !TEST_str_eq(EVP_MD_get0_name(md3), "SHA2-256"))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_MD_free(md1);
+    EVP_MD_free(md2);
+    EVP_MD_free(md3);
+    /* Release the references this thread's cache holds */
+    OPENSSL_thread_stop_ex(ctx);
+    OSSL_PROVIDER_unload(deflt);
+    OSSL_LIB_CTX_free(ctx);
+    return ret;
+}
+
+static int test_property_query_intern(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *deflt = NULL;
+    const OSSL_PROPERTY_QUERY *q1, *q2, *q3;
+    EVP_MD *md = NULL;
+    EVP_CIPHER *cipher = NULL;
+    EVP_MAC *mac = NULL;
+    EVP_KDF *kdf = NULL;
+    char propq[640];
+    int i, ret = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+            || !TEST_ptr(deflt = OSSL_PROVIDER_load(ctx, "default"))
+            || !TEST_ptr(q1 = OSSL_PROPERTY_QUERY_intern(ctx,
+                                                         "provider=default"))
+            || !TEST_str_eq(OSSL_PROPERTY_QUERY_get0_string(q1),
+                            "provider=default")
+            /* Interned, so the same string gives the same query */
+            || !TEST_ptr_eq(OSSL_PROPERTY_QUERY_intern(ctx, "provider=default"),
+                            q1)
+            || !TEST_ptr(q2 = OSSL_PROPERTY_QUERY_intern(ctx,
+                                                         "provider=nonexistent"))
+            || !TEST_ptr_ne(q1, q2))
+        goto err;
+
+    ERR_set_mark();
+    q3 = OSSL_PROPERTY_QUERY_intern(ctx, "provider default");
+    ERR_pop_to_mark();
+    if (!TEST_ptr_null(q3))
+        goto err;
+
+    if (!TEST_ptr(md = EVP_MD_fetch_with_query(ctx, "SHA2-256", q1))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch_with_query(ctx,
+                                                              "AES-128-GCM",
+                                                              q1))
+            || !TEST_ptr(mac = EVP_MAC_fetch_with_query(ctx, "HMAC", q1))
+            || !TEST_ptr(kdf = EVP_KDF_fetch_with_query(ctx, "HKDF", q1)))
+        goto err;
+    EVP_MD_free(md);
+
+    ERR_set_mark();
+    md = EVP_MD_fetch_with_query(ctx, "SHA2-256", q2);
+    ERR_pop_to_mark();
+    if (!TEST_ptr_null(md)
+            || !TEST_ptr(md = EVP_MD_fetch_with_query(ctx, "SHA2-256", NULL)))
+        goto err;
+
+    /*
+     * Distinct query strings, more than fetches intern, still give the same
+     * results after the cache is full
+     */
+    for (i = 0; i < 600; i++) {
+        BIO_snprintf(propq, sizeof(propq), "%*sprovider=default", i, "");
+        EVP_MD_free(md);
+        if (!TEST_ptr(md = EVP_MD_fetch(ctx, "SHA2-256", propq)))
+            goto err;
+    }
+
+    ret = 1;
+ err:
+    EVP_MD_free(md);
+    EVP_CIPHER_free(cipher);
+    EVP_MAC_free(mac);
+    EVP_KDF_free(kdf);
+    OSSL_PROVIDER_unload(deflt);
+    OSSL_LIB_CTX_free(ctx);
+    return ret;
+}
+
+static int test_lib_ctx_prefetch(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *deflt = NULL;
+    EVP_MD *md = NULL;
+    EVP_CIPHER *cipher = NULL;
+    uint64_t hits, misses, evictions, hits2, misses2;
+    int ret = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+            || !TEST_ptr(deflt = OSSL_PROVIDER_load(ctx, "default"))
+            || !TEST_true(OSSL_LIB_CTX_prefetch(ctx,
+                                                "digest, cipher:AES-128-GCM,"
+                                                "decoder", NULL))
+            || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits,
+                                                              &misses,
+                                                              &evictions)))
+        goto err;
+
+    /* Prefetched algorithms come straight from the query cache */
+    if (!TEST_ptr(md = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(ctx, "AES-128-GCM", NULL))
+            || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits2,
+                                                              &misses2,
+                                                              &evictions))
+            || !TEST_uint_eq((unsigned int)(hits2 - hits), 2)
+            || !TEST_uint_eq((unsigned int)(misses2 - misses), 0))
+        goto err;
+
+    ERR_set_mark();
+    if (!TEST_false(OSSL_LIB_CTX_prefetch(ctx, "digests", NULL))
+            || !TEST_false(OSSL_LIB_CTX_prefetch(ctx, "cipher:NOPE", NULL))
+            || !TEST_false(OSSL_LIB_CTX_prefetch(ctx, "encoder:DER", NULL))
+            || !TEST_false(OSSL_LIB_CTX_prefetch(ctx, "digest:", NULL))) {
+        ERR_pop_to_mark();
+        goto err;
+    }
+    ERR_pop_to_mark();
+    if (!TEST_true(OSSL_LIB_CTX_prefetch(ctx, "", NULL)))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_MD_free(md);
+    EVP_CIPHER_free(cipher);
+    OSSL_PROVIDER_unload(deflt);
+    OSSL_LIB_CTX_free(ctx);
+    return ret;
+}
+
+static int test_lib_ctx_freeze(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *deflt = NULL, *legacy = NULL;
+    EVP_MD *md = NULL, *md2 = NULL;
+    EVP_CIPHER *cipher = NULL;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len;
+    uint64_t hits, misses, evictions, hits2, misses2;
+    int ret = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+            || !TEST_ptr(deflt = OSSL_PROVIDER_load(ctx, "default"))
+            || !TEST_false(OSSL_LIB_CTX_is_frozen(ctx))
+            || !TEST_true(OSSL_LIB_CTX_freeze(ctx, NULL))
+            || !TEST_true(OSSL_LIB_CTX_is_frozen(ctx))
+            || !TEST_true(OSSL_LIB_CTX_freeze(ctx, NULL))
+            || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits,
+                                                              &misses,
+                                                              &evictions)))
+        goto err;
+
+    /* Fetching still works, queries never seen before included */
+    if (!TEST_ptr(md = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_true(EVP_Digest("abc", 3, digest, &digest_len, md, NULL))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256",
+                                            "provider=default,fips=no"))
+            || !TEST_ptr_eq(md, md2)
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(ctx, "AES-128-GCM", NULL))
+            || !TEST_ulong_eq(ERR_peek_error(), 0))
+        goto err;
+
+    /* The query cache is read without touching its statistics */
+    if (!TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits2, &misses2,
+                                                       &evictions))
+            || !TEST_uint_eq((unsigned int)(hits2 - hits), 0)
+            || !TEST_uint_eq((unsigned int)(misses2 - misses), 0))
+        goto err;
+
+    /* Nothing can be changed any more */
+    ERR_set_mark();
+    if (!TEST_ptr_null(legacy = OSSL_PROVIDER_load(ctx, "legacy"))
+            || !TEST_int_eq(ERR_GET_REASON(ERR_peek_last_error()),
+                            CRYPTO_R_LIBRARY_CONTEXT_FROZEN)
+            || !TEST_false(EVP_set_default_properties(ctx, "fips=no"))
+            || !TEST_false(OSSL_LIB_CTX_set_method_cache_size(ctx, 10))
+            || !TEST_ptr_null(OSSL_PROPERTY_QUERY_intern(ctx, "?fips=no"))) {
+        ERR_pop_to_mark();
+        goto err;
+    }
+    ERR_pop_to_mark();
+
+    /* Unloading is deferred until the library context is freed */
+    if (!TEST_true(OSSL_PROVIDER_unload(deflt))
+            || !TEST_ulong_eq(ERR_peek_error(), 0)) {
+        deflt = NULL;
+        goto err;
+    }
+    deflt = NULL;
+
+    /* The provider is still there */
+    if (!TEST_true(OSSL_PROVIDER_available(ctx, "default"))
+            || !TEST_true(EVP_Digest("abc", 3, digest, &digest_len, md2,
+                                     NULL)))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_MD_free(md);
+    EVP_MD_free(md2);
+    EVP_CIPHER_free(cipher);
+    OSSL_PROVIDER_unload(legacy);
+    OSSL_PROVIDER_unload(deflt);
+    OSSL_LIB_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * The digests and ciphers of a frozen library context are still reference
+ * counted, so the contexts that use them can outlive the library context.
+ */
+static int test_lib_ctx_freeze_free_order(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *deflt = NULL;
+    EVP_MD *md = NULL;
+    EVP_CIPHER *cipher = NULL;
+    EVP_MD_CTX *mdctx = NULL, *mdctx2 = NULL;
+    EVP_CIPHER_CTX *cctx = NULL, *cctx2 = NULL;
+    static const unsigned char key[16] = { 0 };
+    unsigned char out[EVP_MAX_MD_SIZE], out2[EVP_MAX_MD_SIZE];
+    unsigned int outl, outl2;
+    int l, l2, ret = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+            || !TEST_ptr(deflt = OSSL_PROVIDER_load(ctx, "default"))
+            || !TEST_ptr(md = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+            || !TEST_ptr(mdctx = EVP_MD_CTX_new())
+            || !TEST_ptr(mdctx2 = EVP_MD_CTX_new())
+            || !TEST_ptr(cctx = EVP_CIPHER_CTX_new())
+            || !TEST_ptr(cctx2 = EVP_CIPHER_CTX_new())
+            || !TEST_true(EVP_DigestInit_ex(mdctx, md, NULL))
+            || !TEST_true(OSSL_LIB_CTX_freeze(ctx, NULL))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(ctx, "AES-128-CBC", NULL))
+            || !TEST_true(EVP_EncryptInit_ex2(cctx, cipher, key, key, NULL)))
+        goto err;
+
+    /* Only the contexts keep the methods alive from here on */
+    EVP_MD_free(md);
+    md = NULL;
+    EVP_CIPHER_free(cipher);
+    cipher = NULL;
+    OSSL_PROVIDER_unload(deflt);
+    deflt = NULL;
+    OSSL_LIB_CTX_free(ctx);
+    ctx = NULL;
+
+    if (!TEST_true(EVP_DigestUpdate(mdctx, "abc", 3))
+            || !TEST_true(EVP_MD_CTX_copy_ex(mdctx2, mdctx))
+            || !TEST_true(EVP_DigestFinal_ex(mdctx, out, &outl))
+            || !TEST_true(EVP_DigestFinal_ex(mdctx2, out2, &outl2))
+            || !TEST_mem_eq(out, outl, out2, outl2)
+            || !TEST_true(EVP_CIPHER_CTX_copy(cctx2, cctx))
+            || !TEST_true(EVP_EncryptUpdate(cctx, out, &l, key, sizeof(key)))
+            || !TEST_true(EVP_EncryptUpdate(cctx2, out2, &l2, key,
+                                            sizeof(key)))
+            || !TEST_mem_eq(out, l, out2, l2))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_MD_CTX_free(mdctx);
+    EVP_MD_CTX_free(mdctx2);
+    EVP_CIPHER_CTX_free(cctx);
+    EVP_CIPHER_CTX_free(cctx2);
+    EVP_MD_free(md);
+    EVP_CIPHER_free(cipher);
+    OSSL_PROVIDER_unload(deflt);
+    OSSL_LIB_CTX_free(ctx);
+    return ret;
+}
+
 int setup_tests(void)
 {
     if (!test_get_libctx(&mainctx, &nullprov, NULL, NULL, NULL)) {
@@ -1048,6 +1359,11 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_PEM_read_bio_negative, OSSL_NELEM(keydata));
     ADD_TEST(test_rsa_pss_sign);
     ADD_TEST(test_evp_md_ctx_copy);
+    ADD_TEST(test_thread_fetch_cache);
+    ADD_TEST(test_property_query_intern);
+    ADD_TEST(test_lib_ctx_prefetch);
+    ADD_TEST(test_lib_ctx_freeze);
+    ADD_TEST(test_lib_ctx_freeze_free_order);
     return 1;
 }
 
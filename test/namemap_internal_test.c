@@ -53,6 +53,37 @@ static int test_namemap(OSSL_NAMEMAP *nm)
         && TEST_int_eq(false1, 0);
 }
 
+/*
+ * Add enough names to make the lookup index grow a few times, and check
+ * that all of them can still be found afterwards.
+ */
+static int test_namemap_many(void)
+{
+    OSSL_NAMEMAP *nm = ossl_namemap_new();
+    char name[32];
+    int i, ok = 0;
+
+    if (!TEST_ptr(nm))
+        goto end;
+    for (i = 0; i < 1000; i++) {
+        BIO_snprintf(name, sizeof(name), "name-%d", i);
+        if (!TEST_int_eq(ossl_namemap_add_name(nm, 0, name), i + 1))
+            goto end;
+    }
+    for (i = 0; i < 1000; i++) {
+        BIO_snprintf(name, sizeof(name), "NAME-%d", i);
+        if (!TEST_int_eq(ossl_namemap_name2num(nm, name), i + 1)
+            || !TEST_int_eq(ossl_namemap_name2num_n(nm, name, 4), 0))
+            goto end;
+    }
+    if (!TEST_int_eq(ossl_namemap_name2num(nm, "name-1000"), 0))
+        goto end;
+    ok = 1;
+ end:
+    ossl_namemap_free(nm);
+    return ok;
+}
+
 static int test_namemap_independent(void)
 {
     OSSL_NAMEMAP *nm = ossl_namemap_new();
@@ -174,6 +205,7 @@ int setup_tests(void)
 {
     ADD_TEST(test_namemap_empty);
     ADD_TEST(test_namemap_independent);
+    ADD_TEST(test_namemap_many);
     ADD_TEST(test_namemap_stored);
     ADD_TEST(test_digestbyname);
     ADD_TEST(test_cipherbyname);
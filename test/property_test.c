@@ -499,47 +499,75 @@ err:
     return ret;
 }
 
-static int test_query_cache_stochastic(void)
+/*
+ * Check the CLOCK replacement of the query cache: old entries get evicted
+ * once the cache is full, recently used ones survive and the statistics
+ * account for all of it.
+ */
+static int test_query_cache_clock(void)
 {
-    const int max = 10000, tail = 10;
-    OSSL_METHOD_STORE *store;
+    const int max = 10000, size = 400;
+    OSSL_METHOD_STORE *store = NULL;
     int i, res = 0;
     char buf[50];
     void *result;
-    int errors = 0;
+    int hits = 0;
     int v[10001];
+    uint64_t h0, m0, e0, h1, m1, e1;
+    size_t old_size = OSSL_LIB_CTX_get_method_cache_size(NULL);
     OSSL_PROVIDER prov = { 1 };
 
-    if (!TEST_ptr(store = ossl_method_store_new(NULL))
-        || !add_property_names("n", NULL))
+    if (!TEST_true(OSSL_LIB_CTX_set_method_cache_size(NULL, size))
+        || !TEST_size_t_eq(OSSL_LIB_CTX_get_method_cache_size(NULL), size)
+        || !TEST_ptr(store = ossl_method_store_new(NULL))
+        || !add_property_names("n", NULL)
+        || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(NULL, &h0, &m0,
+                                                          &e0)))
         goto err;
 
     for (i = 1; i <= max; i++) {
         v[i] = 2 * i;
-        BIO_snprintf(buf, sizeof(buf), "n=%d\n", i);
+        BIO_snprintf(buf, sizeof(buf), "n=%d", i);
         if (!TEST_true(ossl_method_store_add(store, &prov, i, buf, "abc",
                                              &up_ref, &down_ref))
                 || !TEST_true(ossl_method_store_cache_set(store, &prov, i,
                                                           buf, v + i,
-                                                          &up_ref, &down_ref))
-                || !TEST_true(ossl_method_store_cache_set(store, &prov, i,
-                                                          "n=1234", "miss",
                                                           &up_ref, &down_ref))) {
             TEST_note("iteration %d", i);
             goto err;
         }
+        /* Keep the very first entry in use, it must never be evicted */
+        if (!TEST_true(ossl_method_store_cache_get(store, NULL, 1, "n=1",
+                                                   &result))
+                || !TEST_ptr_eq(result, v + 1)) {
+            TEST_note("iteration %d", i);
+            goto err;
+        }
     }
     for (i = 1; i <= max; i++) {
-        BIO_snprintf(buf, sizeof(buf), "n=%d\n", i);
-        if (!ossl_method_store_cache_get(store, NULL, i, buf, &result)
-            || result != v + i)
-            errors++;
+        BIO_snprintf(buf, sizeof(buf), "n=%d", i);
+        if (ossl_method_store_cache_get(store, NULL, i, buf, &result)
+            && TEST_ptr_eq(result, v + i))
+            hits++;
     }
-    /* There is a tiny probability that this will fail when it shouldn't */
-    res = TEST_int_gt(errors, tail) && TEST_int_lt(errors, max - tail);
+    BIO_snprintf(buf, sizeof(buf), "n=%d", max);
+    res = TEST_int_gt(hits, 1)
+          && TEST_int_le(hits, size)
+          && TEST_true(ossl_method_store_cache_get(store, NULL, max, buf,
+                                                   &result))
+          && TEST_true(ossl_method_store_cache_get(store, NULL, 1, "n=1",
+                                                   &result))
+          && TEST_false(ossl_method_store_cache_get(store, NULL, 2, "n=2",
+                                                    &result))
+          && TEST_true(OSSL_LIB_CTX_get_method_cache_stats(NULL, &h1, &m1,
+                                                           &e1))
+          && TEST_size_t_ge((size_t)(h1 - h0), max + hits)
+          && TEST_size_t_ge((size_t)(m1 - m0), max - hits)
+          && TEST_size_t_ge((size_t)(e1 - e0), max - size);
 
 err:
     ossl_method_store_free(store);
+    OSSL_LIB_CTX_set_method_cache_size(NULL, old_size);
     return res;
 }
 
@@ -635,7 +663,7 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_definition_compares, OSSL_NELEM(definition_tests));
     ADD_TEST(test_register_deregister);
     ADD_TEST(test_property);
-    ADD_TEST(test_query_cache_stochastic);
+    ADD_TEST(test_query_cache_clock);
     ADD_TEST(test_fips_mode);
     ADD_ALL_TESTS(test_property_list_to_string, OSSL_NELEM(to_string_tests));
     return 1;
@@ -11,6 +11,7 @@
 #include "testutil.h"
 
 static char *configfile = NULL;
+static char *prefetchfile = NULL;
 
 /*
  * Test to make sure there are no leaks or failures from loading the config
@@ -44,7 +45,41 @@ static int test_double_config(void)
     return testresult;
 }
 
-OPT_TEST_DECLARE_USAGE("configfile\n")
+/*
+ * Test that algorithms listed with the provider "prefetch" directive are
+ * served from the query cache on their first fetch.
+ */
+static int test_prefetch_config(void)
+{
+    OSSL_LIB_CTX *ctx = OSSL_LIB_CTX_new();
+    int testresult = 0;
+    EVP_MD *sha256 = NULL;
+    EVP_CIPHER *aes = NULL;
+    uint64_t hits, misses, hits2, misses2;
+
+    if (!TEST_ptr(ctx))
+        return 0;
+
+    if (!TEST_true(OSSL_LIB_CTX_load_config(ctx, prefetchfile))
+        || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits, &misses,
+                                                          NULL))
+        || !TEST_ptr(sha256 = EVP_MD_fetch(ctx, "SHA2-256", NULL))
+        || !TEST_ptr(aes = EVP_CIPHER_fetch(ctx, "AES-128-GCM", NULL))
+        || !TEST_true(OSSL_LIB_CTX_get_method_cache_stats(ctx, &hits2,
+                                                          &misses2, NULL))
+        || !TEST_uint_eq((unsigned int)(hits2 - hits), 2)
+        || !TEST_uint_eq((unsigned int)(misses2 - misses), 0))
+        goto err;
+
+    testresult = 1;
+ err:
+    EVP_MD_free(sha256);
+    EVP_CIPHER_free(aes);
+    OSSL_LIB_CTX_free(ctx);
+    return testresult;
+}
+
+OPT_TEST_DECLARE_USAGE("configfile [prefetchconfigfile]\n")
 
 int setup_tests(void)
 {
@@ -57,5 +92,7 @@ int setup_tests(void)
         return 0;
 
     ADD_TEST(test_double_config);
+    if ((prefetchfile = test_get_argument(1)) != NULL)
+        ADD_TEST(test_prefetch_config);
     return 1;
 }
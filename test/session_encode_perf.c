@@ -0,0 +1,239 @@
+/*
+ * Copyright 2022 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Compares the time it takes to encode and decode an SSL_SESSION with
+ * i2d_SSL_SESSION()/d2i_SSL_SESSION() and with the flat encoding of
+ * SSL_SESSION_encode()/SSL_SESSION_decode().
+ *
+ * Without arguments, the session is built with the SSL_SESSION setters and
+ * has no peer certificate.  Given a certificate and a key file, the session
+ * is the one a client gets from a TLSv1.3 handshake with a server using
+ * them, which includes the server certificate.
+ *
+ * This is not run as part of the tests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#define DEFAULT_COUNT   100000
+
+static const unsigned char tls13_aes128gcmsha256_id[] = { 0x13, 0x01 };
+
+static SSL_SESSION *make_session(void)
+{
+    static const unsigned char alpn[] = "h2";
+    unsigned char key[32];
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    unsigned char appdata[64];
+    SSL_CTX *ctx = NULL;
+    SSL *ssl = NULL;
+    SSL_SESSION *sess = NULL;
+    const SSL_CIPHER *cipher;
+
+    memset(key, 0x5a, sizeof(key));
+    memset(id, 0xa5, sizeof(id));
+    memset(appdata, 0x3c, sizeof(appdata));
+    if ((ctx = SSL_CTX_new(TLS_method())) == NULL
+        || (ssl = SSL_new(ctx)) == NULL
+        || (cipher = SSL_CIPHER_find(ssl, tls13_aes128gcmsha256_id)) == NULL
+        || (sess = SSL_SESSION_new()) == NULL
+        || !SSL_SESSION_set_protocol_version(sess, TLS1_3_VERSION)
+        || !SSL_SESSION_set_cipher(sess, cipher)
+        || !SSL_SESSION_set1_master_key(sess, key, sizeof(key))
+        || !SSL_SESSION_set1_id(sess, id, sizeof(id))
+        || !SSL_SESSION_set1_id_context(sess, id, 16)
+        || !SSL_SESSION_set1_hostname(sess, "server.example.com")
+        || !SSL_SESSION_set1_alpn_selected(sess, alpn, sizeof(alpn) - 1)
+        || !SSL_SESSION_set1_ticket_appdata(sess, appdata, sizeof(appdata))
+        || !SSL_SESSION_set_max_early_data(sess, 16384)) {
+        SSL_SESSION_free(sess);
+        sess = NULL;
+    }
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    return sess;
+}
+
+/* Runs a TLSv1.3 handshake over a BIO pair and returns the client session */
+static SSL_SESSION *handshake_session(const char *certfile,
+                                      const char *keyfile)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *server = NULL, *client = NULL;
+    BIO *sbio = NULL, *cbio = NULL;
+    SSL_SESSION *sess = NULL;
+    unsigned char buf[1];
+    int i, sret = 0, cret = 0;
+
+    if ((sctx = SSL_CTX_new(TLS_server_method())) == NULL
+        || (cctx = SSL_CTX_new(TLS_client_method())) == NULL
+        || !SSL_CTX_set_min_proto_version(sctx, TLS1_3_VERSION)
+        || SSL_CTX_use_certificate_chain_file(sctx, certfile) <= 0
+        || SSL_CTX_use_PrivateKey_file(sctx, keyfile, SSL_FILETYPE_PEM) <= 0
+        || (server = SSL_new(sctx)) == NULL
+        || (client = SSL_new(cctx)) == NULL
+        || !BIO_new_bio_pair(&sbio, 0, &cbio, 0))
+        goto end;
+    SSL_set_bio(server, sbio, sbio);
+    SSL_set_bio(client, cbio, cbio);
+    SSL_set_accept_state(server);
+    SSL_set_connect_state(client);
+
+    for (i = 0; i < 100 && (sret <= 0 || cret <= 0); i++) {
+        if (cret <= 0)
+            cret = SSL_do_handshake(client);
+        if (sret <= 0)
+            sret = SSL_do_handshake(server);
+    }
+    if (sret <= 0 || cret <= 0)
+        goto end;
+
+    /* Let the client process the NewSessionTicket messages */
+    if (SSL_read(client, buf, sizeof(buf)) > 0)
+        goto end;
+    sess = SSL_get1_session(client);
+    if (sess != NULL && !SSL_SESSION_is_resumable(sess)) {
+        SSL_SESSION_free(sess);
+        sess = NULL;
+    }
+
+ end:
+    SSL_free(server);
+    SSL_free(client);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return sess;
+}
+
+static double usec_per_op(clock_t start, long count)
+{
+    return (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / count;
+}
+
+static int time_der(SSL_SESSION *sess, long count)
+{
+    unsigned char *buf, *p;
+    const unsigned char *q;
+    SSL_SESSION *copy;
+    int len = i2d_SSL_SESSION(sess, NULL);
+    clock_t start;
+    long i;
+
+    if (len <= 0 || (buf = OPENSSL_malloc(len)) == NULL)
+        return 0;
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        p = buf;
+        if (i2d_SSL_SESSION(sess, &p) != len)
+            goto err;
+    }
+    printf("i2d_SSL_SESSION     %5d bytes  %8.3f us\n", len,
+           usec_per_op(start, count));
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        q = buf;
+        if ((copy = d2i_SSL_SESSION(NULL, &q, len)) == NULL)
+            goto err;
+        SSL_SESSION_free(copy);
+    }
+    printf("d2i_SSL_SESSION     %5d bytes  %8.3f us\n", len,
+           usec_per_op(start, count));
+
+    OPENSSL_free(buf);
+    return 1;
+ err:
+    OPENSSL_free(buf);
+    return 0;
+}
+
+static int time_flat(SSL_SESSION *sess, long count)
+{
+    unsigned char *buf;
+    SSL_SESSION *copy;
+    size_t len, written;
+    clock_t start;
+    long i;
+
+    if (!SSL_SESSION_encode(sess, NULL, 0, &len)
+        || (buf = OPENSSL_malloc(len)) == NULL)
+        return 0;
+
+    start = clock();
+    for (i = 0; i < count; i++)
+        if (!SSL_SESSION_encode(sess, buf, len, &written))
+            goto err;
+    printf("SSL_SESSION_encode  %5zu bytes  %8.3f us\n", len,
+           usec_per_op(start, count));
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        if ((copy = SSL_SESSION_decode(buf, len)) == NULL)
+            goto err;
+        SSL_SESSION_free(copy);
+    }
+    printf("SSL_SESSION_decode  %5zu bytes  %8.3f us\n", len,
+           usec_per_op(start, count));
+
+    OPENSSL_free(buf);
+    return 1;
+ err:
+    OPENSSL_free(buf);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n count] [certfile keyfile]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    SSL_SESSION *sess;
+    long count = DEFAULT_COUNT;
+    int argi = 1, ret = EXIT_FAILURE;
+
+    if (argc > argi + 1 && strcmp(argv[argi], "-n") == 0) {
+        count = atol(argv[argi + 1]);
+        argi += 2;
+    }
+    if (count <= 0 || (argc - argi != 0 && argc - argi != 2)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc - argi == 2)
+        sess = handshake_session(argv[argi], argv[argi + 1]);
+    else
+        sess = make_session();
+    if (sess == NULL) {
+        fprintf(stderr, "Failed to create a session\n");
+        goto end;
+    }
+
+    printf("%ld iterations, %s peer certificate, time per operation:\n",
+           count, SSL_SESSION_get0_peer(sess) != NULL ? "with" : "without");
+    if (time_der(sess, count) && time_flat(sess, count))
+        ret = EXIT_SUCCESS;
+    else
+        fprintf(stderr, "Encoding or decoding failed\n");
+
+ end:
+    ERR_print_errors_fp(stderr);
+    SSL_SESSION_free(sess);
+    return ret;
+}
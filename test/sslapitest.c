@@ -42,6 +42,12 @@
 #include "../ssl/ssl_local.h"
 #include "filterprov.h"
 
+#ifdef OPENSSL_SYS_UNIX
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
 #undef OSSL_NO_USABLE_TLS1_3
 #if defined(OPENSSL_NO_TLS1_3) \
     || (defined(OPENSSL_NO_EC) && defined(OPENSSL_NO_DH))
@@ -1425,6 +1431,127 @@ end:
     return testresult;
 }
 
+#define SPLICE_SZ                       (16 * 4096)
+#define SPLICE_CHUNK                    (4 * 4096)
+
+/*
+ * Forward data from a KTLS connection into a pipe (tosock == 0) or a socket
+ * (tosock == 1), across a NewSessionTicket in TLSv1.3 and up to the
+ * close_notify alert.
+ */
+static int execute_test_ktls_splice(int tls_version, const char *cipher,
+                                    int tosock)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *buf, *buf_dst;
+    int cfd = -1, sfd = -1, outfd[2] = { -1, -1 };
+    size_t written, total = 0;
+    ossl_ssize_t ret, got;
+    int testresult = 0;
+
+    buf = OPENSSL_zalloc(SPLICE_SZ);
+    buf_dst = OPENSSL_zalloc(SPLICE_SZ);
+    if (!TEST_ptr(buf) || !TEST_ptr(buf_dst)
+        || !TEST_true(create_test_sockets(&cfd, &sfd)))
+        goto end;
+
+    /* Skip this test if the platform does not support ktls */
+    if (!ktls_chk_platform(cfd)) {
+        testresult = TEST_skip("Kernel does not support KTLS");
+        goto end;
+    }
+
+    if (is_fips && strstr(cipher, "CHACHA") != NULL) {
+        testresult = TEST_skip("CHACHA is not supported in FIPS");
+        goto end;
+    }
+
+    if (tosock) {
+        if (!TEST_true(create_test_sockets(&outfd[1], &outfd[0])))
+            goto end;
+    } else if (!TEST_int_eq(pipe(outfd), 0)) {
+        goto end;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(),
+                                       tls_version, tls_version,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    if (tls_version == TLS1_3_VERSION) {
+        if (!TEST_true(SSL_CTX_set_ciphersuites(cctx, cipher))
+            || !TEST_true(SSL_CTX_set_ciphersuites(sctx, cipher)))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, cipher))
+            || !TEST_true(SSL_CTX_set_cipher_list(sctx, cipher)))
+            goto end;
+    }
+
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                       &clientssl, sfd, cfd))
+            || !TEST_true(SSL_set_options(clientssl, SSL_OP_ENABLE_KTLS
+                                                     | SSL_OP_ENABLE_KTLS_TLS13_RX))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    if (!BIO_get_ktls_recv(clientssl->rbio)) {
+        testresult = TEST_skip("Failed to enable KTLS receive for %s cipher %s",
+                               tls_version == TLS1_3_VERSION ? "TLS 1.3" :
+                               "TLS 1.2", cipher);
+        goto end;
+    }
+
+    if (!TEST_int_gt(RAND_bytes_ex(libctx, buf, SPLICE_SZ, 0), 0)
+            || !TEST_true(SSL_write_ex(serverssl, buf, SPLICE_SZ / 2,
+                                       &written))
+            || (tls_version == TLS1_3_VERSION
+                && !TEST_true(SSL_new_session_ticket(serverssl)))
+            || !TEST_true(SSL_write_ex(serverssl, buf + written,
+                                       SPLICE_SZ - written, &written))
+            || !TEST_int_eq(SSL_shutdown(serverssl), 0))
+        goto end;
+
+    while (total < SPLICE_SZ) {
+        ret = SSL_splice(clientssl, outfd[1], SPLICE_CHUNK, 0);
+        if (!TEST_int_gt((int)ret, 0)
+                || !TEST_size_t_le(total + (size_t)ret, SPLICE_SZ))
+            goto end;
+        for (; ret > 0; ret -= got, total += got) {
+            got = read(outfd[0], buf_dst + total, ret);
+            if (!TEST_int_gt((int)got, 0))
+                goto end;
+        }
+    }
+
+    /* The close_notify ends the stream */
+    if (!TEST_int_eq((int)SSL_splice(clientssl, outfd[1], SPLICE_CHUNK, 0), 0)
+            || !TEST_int_eq(SSL_get_error(clientssl, 0), SSL_ERROR_ZERO_RETURN)
+            || !TEST_mem_eq(buf_dst, SPLICE_SZ, buf, SPLICE_SZ))
+        goto end;
+
+    testresult = 1;
+end:
+    SSL_free(clientssl);
+    SSL_free(serverssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    if (cfd != -1)
+        close(cfd);
+    if (sfd != -1)
+        close(sfd);
+    if (outfd[0] != -1)
+        close(outfd[0]);
+    if (outfd[1] != -1)
+        close(outfd[1]);
+    OPENSSL_free(buf);
+    OPENSSL_free(buf_dst);
+    return testresult;
+}
+
 static struct ktls_test_cipher {
     int tls_version;
     const char *cipher;
@@ -1486,6 +1613,17 @@ static int test_ktls_sendfile(int tst)
 
     return execute_test_ktls_sendfile(cipher->tls_version, cipher->cipher);
 }
+
+static int test_ktls_splice(int tst)
+{
+    struct ktls_test_cipher *cipher;
+
+    OPENSSL_assert(tst / 2 < (int)NUM_KTLS_TEST_CIPHERS);
+    cipher = &ktls_test_ciphers[tst / 2];
+
+    return execute_test_ktls_splice(cipher->tls_version, cipher->cipher,
+                                    tst & 1);
+}
 #endif
 
 static int test_large_message_tls(void)
@@ -2056,142 +2194,917 @@ static int execute_test_session(int maxprot, int use_int_cache,
     SSL_SESSION_free(sess2);
     sess2 = NULL;
 
-    SSL_CTX_set_max_proto_version(sctx, maxprot);
-    if (maxprot == TLS1_2_VERSION)
-        SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
-    new_called = remove_called = get_called = 0;
-    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl1, &clientssl1,
+    SSL_CTX_set_max_proto_version(sctx, maxprot);
+    if (maxprot == TLS1_2_VERSION)
+        SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    new_called = remove_called = get_called = 0;
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl1, &clientssl1,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl1, clientssl1,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(sess1 = SSL_get1_session(clientssl1))
+            || !TEST_ptr(sess2 = SSL_get1_session(serverssl1)))
+        goto end;
+
+    if (use_int_cache) {
+        if (maxprot == TLS1_3_VERSION && !use_ext_cache) {
+            /*
+             * In TLSv1.3 it should not have been added to the internal cache,
+             * except in the case where we also have an external cache (in that
+             * case it gets added to the cache in order to generate remove
+             * events after timeout).
+             */
+            if (!TEST_false(SSL_CTX_remove_session(sctx, sess2)))
+                goto end;
+        } else {
+            /* Should fail because it should already be in the cache */
+            if (!TEST_false(SSL_CTX_add_session(sctx, sess2)))
+                goto end;
+        }
+    }
+
+    if (use_ext_cache) {
+        SSL_SESSION *tmp = sess2;
+
+        if (!TEST_int_eq(new_called, numnewsesstick)
+                || !TEST_int_eq(remove_called, 0)
+                || !TEST_int_eq(get_called, 0))
+            goto end;
+        /*
+         * Delete the session from the internal cache to force a lookup from
+         * the external cache. We take a copy first because
+         * SSL_CTX_remove_session() also marks the session as non-resumable.
+         */
+        if (use_int_cache && maxprot != TLS1_3_VERSION) {
+            if (!TEST_ptr(tmp = SSL_SESSION_dup(sess2))
+                    || !TEST_true(SSL_CTX_remove_session(sctx, sess2)))
+                goto end;
+            SSL_SESSION_free(sess2);
+        }
+        sess2 = tmp;
+    }
+
+    new_called = remove_called = get_called = 0;
+    get_sess_val = sess2;
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl2,
+                                      &clientssl2, NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl2, sess1))
+            || !TEST_true(create_ssl_connection(serverssl2, clientssl2,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_session_reused(clientssl2)))
+        goto end;
+
+    if (use_ext_cache) {
+        if (!TEST_int_eq(remove_called, 0))
+            goto end;
+
+        if (maxprot == TLS1_3_VERSION) {
+            if (!TEST_int_eq(new_called, 1)
+                    || !TEST_int_eq(get_called, 0))
+                goto end;
+        } else {
+            if (!TEST_int_eq(new_called, 0)
+                    || !TEST_int_eq(get_called, 1))
+                goto end;
+        }
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl1);
+    SSL_free(clientssl1);
+    SSL_free(serverssl2);
+    SSL_free(clientssl2);
+# ifndef OPENSSL_NO_TLS1_1
+    SSL_free(serverssl3);
+    SSL_free(clientssl3);
+# endif
+    SSL_SESSION_free(sess1);
+    SSL_SESSION_free(sess2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif /* !defined(OSSL_NO_USABLE_TLS1_3) || !defined(OPENSSL_NO_TLS1_2) */
+
+static int test_session_with_only_int_cache(void)
+{
+#ifndef OSSL_NO_USABLE_TLS1_3
+    if (!execute_test_session(TLS1_3_VERSION, 1, 0, 0))
+        return 0;
+#endif
+
+#ifndef OPENSSL_NO_TLS1_2
+    return execute_test_session(TLS1_2_VERSION, 1, 0, 0);
+#else
+    return 1;
+#endif
+}
+
+static int test_session_with_only_ext_cache(void)
+{
+#ifndef OSSL_NO_USABLE_TLS1_3
+    if (!execute_test_session(TLS1_3_VERSION, 0, 1, 0))
+        return 0;
+#endif
+
+#ifndef OPENSSL_NO_TLS1_2
+    return execute_test_session(TLS1_2_VERSION, 0, 1, 0);
+#else
+    return 1;
+#endif
+}
+
+static int test_session_with_both_cache(void)
+{
+#ifndef OSSL_NO_USABLE_TLS1_3
+    if (!execute_test_session(TLS1_3_VERSION, 1, 1, 0))
+        return 0;
+#endif
+
+#ifndef OPENSSL_NO_TLS1_2
+    return execute_test_session(TLS1_2_VERSION, 1, 1, 0);
+#else
+    return 1;
+#endif
+}
+
+#if !defined(OPENSSL_NO_TLS1_2) && defined(OPENSSL_SYS_UNIX) \
+    && defined(OPENSSL_THREADS)
+/*
+ * Two server SSL_CTXs stand in for two worker processes, the cache holds no
+ * state outside of the shared mapping.
+ */
+static int test_shared_session_cache(void)
+{
+    SSL_SHARED_SESSION_CACHE *cache = NULL;
+    SSL_CTX *sctx = NULL, *sctx2 = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *sess = NULL, *copy = NULL;
+    int testresult = 0;
+
+    if (!TEST_ptr_null(SSL_SHARED_SESSION_CACHE_new(0, 4096))
+        || !TEST_ptr_null(SSL_SHARED_SESSION_CACHE_new(64, 16))
+        || !TEST_ptr(cache = SSL_SHARED_SESSION_CACHE_new(64, 4096))
+        || !TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                          TLS_client_method(), TLS1_VERSION,
+                                          TLS1_2_VERSION, &sctx, &cctx,
+                                          cert, privkey))
+        || !TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(), NULL,
+                                          TLS1_VERSION, TLS1_2_VERSION,
+                                          &sctx2, NULL, cert, privkey))
+        || !TEST_true(SSL_CTX_set1_shared_session_cache(sctx, cache)))
+        goto end;
+
+    /* Session callbacks of the application are not replaced */
+    SSL_CTX_sess_set_remove_cb(sctx2, remove_session_cb);
+    if (!TEST_false(SSL_CTX_set1_shared_session_cache(sctx2, cache)))
+        goto end;
+    SSL_CTX_sess_set_remove_cb(sctx2, NULL);
+    if (!TEST_true(SSL_CTX_set1_shared_session_cache(sctx2, cache)))
+        goto end;
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    cache = NULL;
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_options(sctx2, SSL_OP_NO_TICKET);
+
+    /* Establish a session with one server and resume it with the other */
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_ptr(sess = SSL_get1_session(clientssl))
+        || !TEST_long_eq(SSL_CTX_sess_number(sctx), 0))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    if (!TEST_true(create_ssl_objects(sctx2, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || !TEST_true(SSL_set_session(clientssl, sess))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    /*
+     * A session removed by one server is gone for the other.  Removing it
+     * makes the session object non-resumable, so a copy is removed.
+     */
+    if (!TEST_ptr(copy = SSL_SESSION_dup(sess))
+        || !TEST_int_eq(SSL_CTX_remove_session(sctx2, copy), 0)
+        || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                         NULL, NULL))
+        || !TEST_true(SSL_set_session(clientssl, sess))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_false(SSL_session_reused(clientssl)))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(copy);
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(sctx2);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+/*
+ * The flat encoding must carry everything the DER one does, so a decoded
+ * session has to have the same DER encoding as the original.
+ */
+static int test_session_encode(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *sess = NULL, *sess2 = NULL;
+    unsigned char *enc = NULL, *der = NULL, *der2 = NULL, *p;
+    size_t enclen, len;
+    int derlen, der2len, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+        || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                         NULL, NULL))
+        || !TEST_true(SSL_set_tlsext_host_name(clientssl, "localhost"))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_ptr(sess = SSL_get1_session(clientssl))
+        || !TEST_ptr(SSL_SESSION_get0_peer(sess)))
+        goto end;
+
+    if (!TEST_true(SSL_SESSION_encode(sess, NULL, 0, &enclen))
+        || !TEST_ptr(enc = OPENSSL_malloc(enclen))
+        || !TEST_false(SSL_SESSION_encode(sess, enc, enclen - 1, &len))
+        || !TEST_true(SSL_SESSION_encode(sess, enc, enclen, &len))
+        || !TEST_size_t_eq(len, enclen)
+        || !TEST_ptr(sess2 = SSL_SESSION_decode(enc, enclen))
+        || !TEST_int_gt(derlen = i2d_SSL_SESSION(sess, NULL), 0)
+        || !TEST_int_gt(der2len = i2d_SSL_SESSION(sess2, NULL), 0)
+        || !TEST_ptr(der = OPENSSL_malloc(derlen))
+        || !TEST_ptr(der2 = OPENSSL_malloc(der2len)))
+        goto end;
+    p = der;
+    if (!TEST_int_eq(i2d_SSL_SESSION(sess, &p), derlen))
+        goto end;
+    p = der2;
+    if (!TEST_int_eq(i2d_SSL_SESSION(sess2, &p), der2len)
+        || !TEST_mem_eq(der, derlen, der2, der2len))
+        goto end;
+    SSL_SESSION_free(sess2);
+    sess2 = NULL;
+
+    /* Truncated, padded and DER encoded input is rejected */
+    if (!TEST_ptr_null(SSL_SESSION_decode(enc, enclen - 1))
+        || !TEST_ptr_null(SSL_SESSION_decode(der, derlen))
+        || !TEST_ptr(p = OPENSSL_realloc(enc, enclen + 1)))
+        goto end;
+    enc = p;
+    enc[enclen] = 0;
+    if (!TEST_ptr_null(SSL_SESSION_decode(enc, enclen + 1)))
+        goto end;
+    ERR_clear_error();
+
+    testresult = 1;
+ end:
+    OPENSSL_free(enc);
+    OPENSSL_free(der);
+    OPENSSL_free(der2);
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(sess2);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Tickets are issued with DER or flat encoded sessions depending on
+ * SSL_OP_FLAT_SESSION_TICKETS, but accepted in either encoding.
+ * Test 0: A DER ticket is resumed with the option set
+ * Test 1: A flat ticket is resumed with the option cleared
+ */
+static int test_flat_session_tickets(int idx)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *sess = NULL;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+    if (idx == 1)
+        SSL_CTX_set_options(sctx, SSL_OP_FLAT_SESSION_TICKETS);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_ptr(sess = SSL_get1_session(clientssl))
+        || !TEST_true(SSL_SESSION_has_ticket(sess)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    if (idx == 1)
+        SSL_CTX_clear_options(sctx, SSL_OP_FLAT_SESSION_TICKETS);
+    else
+        SSL_CTX_set_options(sctx, SSL_OP_FLAT_SESSION_TICKETS);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || !TEST_true(SSL_set_session(clientssl, sess))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_SESSION_free(sess);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Connects with |sess|, if any, and checks whether it was resumed and
+ * the name of the key of the new ticket, if there is one.
+ */
+static int ticket_key_connect(SSL_CTX *sctx, SSL_CTX *cctx, SSL_SESSION *sess,
+                              int reused, const unsigned char *name,
+                              SSL_SESSION **newsess)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *ret = NULL;
+    const unsigned char *tick;
+    size_t ticklen;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || (sess != NULL && !TEST_true(SSL_set_session(clientssl, sess)))
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+        || !TEST_int_eq(SSL_session_reused(clientssl), reused)
+        || !TEST_ptr(ret = SSL_get1_session(clientssl)))
+        goto end;
+    SSL_SESSION_get0_ticket(ret, &tick, &ticklen);
+    if (!TEST_size_t_gt(ticklen, TLSEXT_KEYNAME_LENGTH)
+        || (name != NULL
+            && !TEST_mem_eq(tick, TLSEXT_KEYNAME_LENGTH,
+                            name, TLSEXT_KEYNAME_LENGTH)))
+        goto end;
+    if (newsess != NULL) {
+        *newsess = ret;
+        ret = NULL;
+    }
+    testresult = 1;
+ end:
+    SSL_SESSION_free(ret);
+    SSL_shutdown(clientssl);
+    SSL_shutdown(serverssl);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return testresult;
+}
+
+static int test_ticket_key_ring(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL_SESSION *sess = NULL, *sess2 = NULL;
+    unsigned char keya[80], keyb[80], keys[80];
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_2_VERSION,
+                                       TLS1_2_VERSION, &sctx, &cctx, cert,
+                                       privkey))
+        || !TEST_int_gt(RAND_bytes_ex(libctx, keya, sizeof(keya), 0), 0)
+        || !TEST_int_gt(RAND_bytes_ex(libctx, keyb, sizeof(keyb), 0), 0))
+        goto end;
+    /* Only tickets can be resumed */
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_OFF);
+
+    if (!TEST_false(SSL_CTX_add_ticket_key(sctx, keya, sizeof(keya) - 1, 0))
+        || !TEST_false(SSL_CTX_add_ticket_key(sctx, keya, sizeof(keya), 2))
+        || !TEST_long_eq(SSL_CTX_set_tlsext_ticket_keys(sctx, keya,
+                                                        sizeof(keya)), 1)
+        || !TEST_true(ticket_key_connect(sctx, cctx, NULL, 0, keya, &sess)))
+        goto end;
+
+    /* Tickets of any key that isn't decrypt-only are kept */
+    if (!TEST_true(SSL_CTX_add_ticket_key(sctx, keyb, sizeof(keyb), 0))
+        || !TEST_long_eq(SSL_CTX_get_tlsext_ticket_keys(sctx, keys,
+                                                        sizeof(keys)), 1)
+        || !TEST_mem_eq(keys, sizeof(keys), keyb, sizeof(keyb))
+        || !TEST_true(ticket_key_connect(sctx, cctx, sess, 1, keya, NULL))
+        || !TEST_true(ticket_key_connect(sctx, cctx, NULL, 0, keyb, NULL)))
+        goto end;
+
+    /* Tickets of a decrypt-only key are renewed */
+    if (!TEST_true(SSL_CTX_add_ticket_key(sctx, keya, sizeof(keya),
+                                          SSL_TICKET_KEY_DECRYPT_ONLY))
+        || !TEST_true(ticket_key_connect(sctx, cctx, sess, 1, keyb, NULL)))
+        goto end;
+
+    /* Tickets of a removed key are not */
+    if (!TEST_true(SSL_CTX_remove_ticket_key(sctx, keya, 16))
+        || !TEST_false(SSL_CTX_remove_ticket_key(sctx, keya, 16))
+        || !TEST_true(ticket_key_connect(sctx, cctx, sess, 0, keyb, &sess2)))
+        goto end;
+
+    /* Once due, a new key is used and the old one dropped */
+    if (!TEST_true(SSL_CTX_set_ticket_key_rotation(sctx, 3600, 0))
+        || !TEST_true(ticket_key_connect(sctx, cctx, sess2, 1, keyb, NULL)))
+        goto end;
+    sctx->ext.ticket_keys->keys[0]->created -= 3600;
+    if (!TEST_true(ticket_key_connect(sctx, cctx, NULL, 0, NULL, NULL))
+        || !TEST_long_eq(SSL_CTX_get_tlsext_ticket_keys(sctx, keys,
+                                                        sizeof(keys)), 1)
+        || !TEST_mem_ne(keys, sizeof(keys), keyb, sizeof(keyb))
+        || !TEST_true(ticket_key_connect(sctx, cctx, sess2, 0, keys, NULL)))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(sess2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+/*
+ * With a buffer pool and SSL_MODE_RELEASE_BUFFERS connections only hold
+ * buffers while they read or write records, and the buffers of one
+ * connection are reused by the next.
+ */
+static int test_buffer_pool(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    char buf[64];
+    size_t written, readbytes;
+    int i, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+        || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 0)
+        || !TEST_long_eq(SSL_CTX_buffer_pool_misses(sctx), 0)
+        || !TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, -1), 0)
+        || !TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, 4), 1)
+        || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 4)
+        || !TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, 64), 1)
+        || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 64)
+        || !TEST_long_eq(SSL_CTX_get_mode(sctx) & SSL_MODE_RELEASE_BUFFERS,
+                         0))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_RELEASE_BUFFERS);
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_write_ex(clientssl, "hello", 5, &written))
+            || !TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf),
+                                      &readbytes))
+            || !TEST_mem_eq(buf, readbytes, "hello", 5)
+            || !TEST_true(SSL_write_ex(serverssl, "world", 5, &written))
+            || !TEST_true(SSL_read_ex(clientssl, buf, sizeof(buf),
+                                      &readbytes))
+            || !TEST_mem_eq(buf, readbytes, "world", 5)
+            /* An idle connection holds no buffers */
+            || !TEST_long_eq(SSL_CTX_buffer_pool_in_use(sctx), 0)
+            || !TEST_long_gt(SSL_CTX_buffer_pool_idle(sctx), 0))
+            goto end;
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+    /* The second connection didn't need to allocate any buffers */
+    if (!TEST_long_gt(SSL_CTX_buffer_pool_hits(sctx),
+                      SSL_CTX_buffer_pool_misses(sctx)))
+        goto end;
+
+    /* Connections can outlive the pool */
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+        || !TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, 0), 1)
+        || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 0)
+        || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE)))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+#if !defined(OPENSSL_NO_EC) && !defined(OSSL_NO_USABLE_TLS1_3)
+# ifdef OPENSSL_SYS_UNIX
+/* Run a handshake in a child process that was forked after the pool filled */
+static int key_share_pool_child(SSL_CTX *sctx, SSL_CTX *cctx)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    int ok;
+
+    ok = TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+         && TEST_true(create_ssl_connection(serverssl, clientssl,
+                                            SSL_ERROR_NONE))
+         /* The keys of the parent were thrown away */
+         && TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 0)
+         && TEST_long_eq(SSL_CTX_key_share_pool_misses(sctx), 1);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return ok;
+}
+# endif
+
+static int test_key_share_pool(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    EVP_PKEY *keys[2] = { NULL, NULL };
+    int i, testresult = 0;
+# ifdef OPENSSL_SYS_UNIX
+    pid_t pid;
+    int status;
+# endif
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+        || !TEST_true(SSL_CTX_set1_groups_list(sctx, "P-256:P-384"))
+        || !TEST_true(SSL_CTX_set1_groups_list(cctx, "P-256"))
+        || !TEST_long_eq(SSL_CTX_get_key_share_pool_depth(sctx), 0)
+        || !TEST_true(SSL_CTX_fill_key_share_pool(sctx))
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 0)
+        || !TEST_long_eq(SSL_CTX_set_key_share_pool_depth(sctx, -1), 0)
+        || !TEST_long_eq(SSL_CTX_set_key_share_pool_depth(sctx, 2), 1)
+        || !TEST_long_eq(SSL_CTX_get_key_share_pool_depth(sctx), 2)
+        || !TEST_long_eq(SSL_CTX_set_key_share_pool_depth(cctx, 1), 1)
+        || !TEST_true(SSL_CTX_fill_key_share_pool(sctx))
+        || !TEST_true(SSL_CTX_fill_key_share_pool(cctx))
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 4)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(cctx), 1))
+        goto end;
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_get_peer_tmp_key(clientssl, &keys[i])))
+            goto end;
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+    /* Both server keys came from the pool, and each was only used once */
+    if (!TEST_long_eq(SSL_CTX_key_share_pool_hits(sctx), 2)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_misses(sctx), 0)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 2)
+        || !TEST_int_ne(EVP_PKEY_eq(keys[0], keys[1]), 1)
+        /* The client ran out of keys */
+        || !TEST_long_eq(SSL_CTX_key_share_pool_hits(cctx), 1)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_misses(cctx), 1)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(cctx), 0))
+        goto end;
+
+# ifdef OPENSSL_SYS_UNIX
+    if (!TEST_int_ge(pid = fork(), 0))
+        goto end;
+    if (pid == 0)
+        _exit(key_share_pool_child(sctx, cctx) ? 0 : 1);
+    if (!TEST_int_eq(waitpid(pid, &status, 0), pid)
+        || !TEST_int_eq(status, 0)
+        /* The parent keeps its keys */
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 2))
+        goto end;
+# endif
+
+    if (!TEST_true(SSL_CTX_fill_key_share_pool(sctx))
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 4)
+        || !TEST_long_eq(SSL_CTX_set_key_share_pool_depth(sctx, 1), 1)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 2)
+        || !TEST_long_eq(SSL_CTX_set_key_share_pool_depth(sctx, 0), 1)
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 0)
+        || !TEST_true(SSL_CTX_fill_key_share_pool(sctx))
+        || !TEST_long_eq(SSL_CTX_key_share_pool_idle(sctx), 0))
+        goto end;
+
+    testresult = 1;
+ end:
+    EVP_PKEY_free(keys[0]);
+    EVP_PKEY_free(keys[1]);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+static struct write_batch_cipher {
+    int tls_version;
+    const char *cipher;
+} write_batch_ciphers[] = {
+#ifndef OPENSSL_NO_TLS1_2
+    { TLS1_2_VERSION, "AES128-GCM-SHA256" },
+# if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    { TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305" },
+# endif
+#endif
+#ifndef OSSL_NO_USABLE_TLS1_3
+    { TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256" },
+# if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    { TLS1_3_VERSION, "TLS_CHACHA20_POLY1305_SHA256" },
+# endif
+#endif
+};
+
+#define NUM_WRITE_BATCH_CIPHERS \
+    (sizeof(write_batch_ciphers) / sizeof(write_batch_ciphers[0]))
+
+static int write_batch_writes;
+
+static long write_batch_cb(BIO *b, int oper, const char *argp, size_t len,
+                           int argi, long argl, int ret, size_t *processed)
+{
+    if (oper == BIO_CB_WRITE)
+        write_batch_writes++;
+    return ret;
+}
+
+/*
+ * Test that a large write is sent as batches of full AEAD records, each
+ * batch with a single write to the BIO, and that the peer can read it
+ */
+static int test_write_batch(int idx)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    struct write_batch_cipher *cipher = &write_batch_ciphers[idx];
+    static unsigned char msg[5 * SSL3_RT_MAX_PLAIN_LENGTH + 100];
+    static unsigned char buf[sizeof(msg)];
+    size_t i, written, readbytes, total;
+    int testresult = 0;
+
+    if (is_fips && strstr(cipher->cipher, "CHACHA") != NULL)
+        return TEST_skip("CHACHA is not supported in FIPS");
+
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = (unsigned char)(i * 7);
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(),
+                                       cipher->tls_version,
+                                       cipher->tls_version,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    if (cipher->tls_version == TLS1_3_VERSION) {
+        if (!TEST_true(SSL_CTX_set_ciphersuites(cctx, cipher->cipher))
+                || !TEST_true(SSL_CTX_set_ciphersuites(sctx, cipher->cipher)))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, cipher->cipher))
+                || !TEST_true(SSL_CTX_set_cipher_list(sctx, cipher->cipher)))
+            goto end;
+    }
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
                                       NULL, NULL))
-            || !TEST_true(create_ssl_connection(serverssl1, clientssl1,
-                                                SSL_ERROR_NONE))
-            || !TEST_ptr(sess1 = SSL_get1_session(clientssl1))
-            || !TEST_ptr(sess2 = SSL_get1_session(serverssl1)))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
         goto end;
 
-    if (use_int_cache) {
-        if (maxprot == TLS1_3_VERSION && !use_ext_cache) {
+    write_batch_writes = 0;
+    BIO_set_callback_ex(SSL_get_wbio(clientssl), write_batch_cb);
+    if (!TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg), &written))
+            || !TEST_size_t_eq(written, sizeof(msg))
             /*
-             * In TLSv1.3 it should not have been added to the internal cache,
-             * except in the case where we also have an external cache (in that
-             * case it gets added to the cache in order to generate remove
-             * events after timeout).
+             * Six records: a batch of four, then one full record and the
+             * remaining 100 bytes, each on its own
              */
-            if (!TEST_false(SSL_CTX_remove_session(sctx, sess2)))
-                goto end;
-        } else {
-            /* Should fail because it should already be in the cache */
-            if (!TEST_false(SSL_CTX_add_session(sctx, sess2)))
-                goto end;
-        }
+            || !TEST_int_eq(write_batch_writes, 3))
+        goto end;
+    BIO_set_callback_ex(SSL_get_wbio(clientssl), NULL);
+
+    for (total = 0; total < sizeof(buf); total += readbytes) {
+        if (!TEST_true(SSL_read_ex(serverssl, buf + total,
+                                   sizeof(buf) - total, &readbytes)))
+            goto end;
     }
+    if (!TEST_mem_eq(buf, total, msg, sizeof(msg)))
+        goto end;
 
-    if (use_ext_cache) {
-        SSL_SESSION *tmp = sess2;
+    /* Small writes are unaffected */
+    if (!TEST_true(SSL_write_ex(clientssl, "hello", 5, &written))
+            || !TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf),
+                                      &readbytes))
+            || !TEST_mem_eq(buf, readbytes, "hello", 5))
+        goto end;
 
-        if (!TEST_int_eq(new_called, numnewsesstick)
-                || !TEST_int_eq(remove_called, 0)
-                || !TEST_int_eq(get_called, 0))
-            goto end;
-        /*
-         * Delete the session from the internal cache to force a lookup from
-         * the external cache. We take a copy first because
-         * SSL_CTX_remove_session() also marks the session as non-resumable.
-         */
-        if (use_int_cache && maxprot != TLS1_3_VERSION) {
-            if (!TEST_ptr(tmp = SSL_SESSION_dup(sess2))
-                    || !TEST_true(SSL_CTX_remove_session(sctx, sess2)))
-                goto end;
-            SSL_SESSION_free(sess2);
-        }
-        sess2 = tmp;
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Test SSL_writev() and SSL_readv()
+ * Test 0: TLSv1.3, the records are encrypted in batches
+ * Test 1: TLSv1.2 with a CBC cipher
+ */
+static int test_writev_readv(int idx)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    static unsigned char body[3 * SSL3_RT_MAX_PLAIN_LENGTH + 17];
+    static unsigned char msg[sizeof(body) + 100];
+    static unsigned char buf[sizeof(msg)];
+    static const char head[] = "HTTP/1.1 200 OK\r\n\r\n";
+    static const char trailer[] = "0\r\n\r\n";
+    SSL_IOVEC wiov[4], riov[3];
+    size_t i, written, readbytes, total, msglen;
+    int testresult = 0;
+
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (idx == 0)
+        return TEST_skip("No TLSv1.3 support");
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (idx == 1)
+        return TEST_skip("No TLSv1.2 support");
+#endif
+
+    for (i = 0; i < sizeof(body); i++)
+        body[i] = (unsigned char)(i * 13);
+
+    wiov[0].data = (void *)head;
+    wiov[0].len = strlen(head);
+    wiov[1].data = body;
+    wiov[1].len = sizeof(body);
+    wiov[2].data = NULL;
+    wiov[2].len = 0;
+    wiov[3].data = (void *)trailer;
+    wiov[3].len = strlen(trailer);
+    msglen = 0;
+    for (i = 0; i < OSSL_NELEM(wiov); i++) {
+        if (wiov[i].len > 0)
+            memcpy(msg + msglen, wiov[i].data, wiov[i].len);
+        msglen += wiov[i].len;
     }
 
-    new_called = remove_called = get_called = 0;
-    get_sess_val = sess2;
-    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl2,
-                                      &clientssl2, NULL, NULL))
-            || !TEST_true(SSL_set_session(clientssl2, sess1))
-            || !TEST_true(create_ssl_connection(serverssl2, clientssl2,
-                                                SSL_ERROR_NONE))
-            || !TEST_true(SSL_session_reused(clientssl2)))
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(),
+                                       idx == 0 ? TLS1_3_VERSION
+                                                : TLS1_2_VERSION,
+                                       idx == 0 ? TLS1_3_VERSION
+                                                : TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || (idx == 1
+                && !TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA")))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
         goto end;
 
-    if (use_ext_cache) {
-        if (!TEST_int_eq(remove_called, 0))
-            goto end;
+    if (!TEST_true(SSL_writev(clientssl, wiov, OSSL_NELEM(wiov), &written))
+            || !TEST_size_t_eq(written, msglen))
+        goto end;
 
-        if (maxprot == TLS1_3_VERSION) {
-            if (!TEST_int_eq(new_called, 1)
-                    || !TEST_int_eq(get_called, 0))
-                goto end;
-        } else {
-            if (!TEST_int_eq(new_called, 0)
-                    || !TEST_int_eq(get_called, 1))
-                goto end;
-        }
+    /* Read it back in three uneven pieces */
+    for (total = 0; total < msglen; total += readbytes) {
+        riov[0].data = buf + total;
+        riov[0].len = 10;
+        riov[1].data = buf + total + 10;
+        riov[1].len = 0;
+        riov[2].data = buf + total + 10;
+        riov[2].len = sizeof(buf) - total - 10;
+        if (!TEST_true(SSL_readv(serverssl, riov, OSSL_NELEM(riov),
+                                 &readbytes))
+                || !TEST_size_t_gt(readbytes, 0))
+            goto end;
     }
+    if (!TEST_mem_eq(buf, total, msg, msglen))
+        goto end;
 
-    testresult = 1;
+    /* A vectored write with nothing in it is like an empty SSL_write_ex() */
+    if (!TEST_true(SSL_writev(clientssl, wiov, 0, &written))
+            || !TEST_size_t_eq(written, 0))
+        goto end;
 
+    testresult = 1;
  end:
-    SSL_free(serverssl1);
-    SSL_free(clientssl1);
-    SSL_free(serverssl2);
-    SSL_free(clientssl2);
-# ifndef OPENSSL_NO_TLS1_1
-    SSL_free(serverssl3);
-    SSL_free(clientssl3);
-# endif
-    SSL_SESSION_free(sess1);
-    SSL_SESSION_free(sess2);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
     SSL_CTX_free(sctx);
     SSL_CTX_free(cctx);
-
     return testresult;
 }
-#endif /* !defined(OSSL_NO_USABLE_TLS1_3) || !defined(OPENSSL_NO_TLS1_2) */
 
-static int test_session_with_only_int_cache(void)
-{
 #ifndef OSSL_NO_USABLE_TLS1_3
-    if (!execute_test_session(TLS1_3_VERSION, 1, 0, 0))
-        return 0;
-#endif
+static int test_zero_copy_read(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    static unsigned char msg[3 * SSL3_RT_MAX_PLAIN_LENGTH + 17];
+    static unsigned char buf[sizeof(msg)];
+    unsigned char rbuf[SSL3_RT_MAX_ENCRYPTED_LENGTH];
+    size_t i, written, readbytes, total;
+    int testresult = 0;
 
-#ifndef OPENSSL_NO_TLS1_2
-    return execute_test_session(TLS1_2_VERSION, 1, 0, 0);
-#else
-    return 1;
-#endif
-}
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = (unsigned char)(i * 7);
 
-static int test_session_with_only_ext_cache(void)
-{
-#ifndef OSSL_NO_USABLE_TLS1_3
-    if (!execute_test_session(TLS1_3_VERSION, 0, 1, 0))
-        return 0;
-#endif
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION,
+                                       TLS1_3_VERSION, &sctx, &cctx, cert,
+                                       privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
 
-#ifndef OPENSSL_NO_TLS1_2
-    return execute_test_session(TLS1_2_VERSION, 0, 1, 0);
-#else
-    return 1;
-#endif
-}
+    SSL_set_mode(clientssl, SSL_MODE_ZERO_COPY_READ);
 
-static int test_session_with_both_cache(void)
-{
-#ifndef OSSL_NO_USABLE_TLS1_3
-    if (!execute_test_session(TLS1_3_VERSION, 1, 1, 0))
-        return 0;
-#endif
+    /*
+     * A ticket follows the first record. It is decrypted into the caller's
+     * buffer too but must be moved out again.
+     */
+    if (!TEST_true(SSL_write_ex(serverssl, msg, SSL3_RT_MAX_PLAIN_LENGTH,
+                                &written))
+            || !TEST_true(SSL_new_session_ticket(serverssl))
+            || !TEST_true(SSL_write_ex(serverssl, msg + written,
+                                       sizeof(msg) - written, &written))
+            || !TEST_size_t_eq(written, sizeof(msg) - SSL3_RT_MAX_PLAIN_LENGTH))
+        goto end;
 
-#ifndef OPENSSL_NO_TLS1_2
-    return execute_test_session(TLS1_2_VERSION, 1, 1, 0);
-#else
-    return 1;
-#endif
+    /* Too small for a whole record, so this is copied as usual */
+    if (!TEST_true(SSL_read_ex(clientssl, buf, 100, &readbytes))
+            || !TEST_size_t_eq(readbytes, 100)
+            || !TEST_size_t_eq((size_t)SSL_get_zero_copy_read_bytes(clientssl),
+                               0))
+        goto end;
+    total = readbytes;
+    if (!TEST_true(SSL_read_ex(clientssl, rbuf, sizeof(rbuf), &readbytes))
+            || !TEST_size_t_eq(readbytes, SSL3_RT_MAX_PLAIN_LENGTH - 100)
+            || !TEST_size_t_eq((size_t)SSL_get_zero_copy_read_bytes(clientssl),
+                               0))
+        goto end;
+    memcpy(buf + total, rbuf, readbytes);
+    total += readbytes;
+
+    /* The remaining records go straight into the buffer */
+    while (total < sizeof(msg)) {
+        if (!TEST_true(SSL_read_ex(clientssl, rbuf, sizeof(rbuf), &readbytes)))
+            goto end;
+        memcpy(buf + total, rbuf, readbytes);
+        total += readbytes;
+    }
+    if (!TEST_mem_eq(buf, total, msg, sizeof(msg))
+            || !TEST_size_t_eq((size_t)SSL_get_zero_copy_read_bytes(clientssl),
+                               sizeof(msg) - SSL3_RT_MAX_PLAIN_LENGTH))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
 }
+#endif
 
 static int test_session_wo_ca_names(void)
 {
@@ -8465,6 +9378,138 @@ end:
 }
 #endif /* OPENSSL_NO_TLS1_2 */
 
+static int test_session_cache_shards(void)
+{
+    SSL_SESSION *sess[64] = { NULL }, *old = NULL, *new = NULL;
+    SSL_CTX *ctx;
+    SSL *ssl = NULL;
+    size_t i;
+    long now = (long)time(NULL);
+    int testresult = 0;
+
+    if (!TEST_ptr(ctx = SSL_CTX_new_ex(libctx, NULL, TLS_server_method()))
+        || !TEST_long_eq(SSL_CTX_get_session_cache_shards(ctx), 1)
+        || !TEST_ptr(SSL_CTX_sessions(ctx))
+        || !TEST_false(SSL_CTX_set_session_cache_shards(ctx, 0))
+        || !TEST_true(SSL_CTX_set_session_cache_shards(ctx, 8))
+        || !TEST_long_eq(SSL_CTX_get_session_cache_shards(ctx), 8)
+        || !TEST_ptr_null(SSL_CTX_sessions(ctx))
+        || !TEST_ptr(ssl = SSL_new(ctx)))
+        goto end;
+
+    /* Each of the shards holds its share of the cache size */
+    (void)SSL_CTX_sess_set_cache_size(ctx, 16);
+    for (i = 0; i < OSSL_NELEM(sess); i++) {
+        if (!TEST_ptr(sess[i] = SSL_SESSION_new()))
+            goto end;
+        sess[i]->ssl_version = SSL_version(ssl);
+        sess[i]->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+        memset(sess[i]->session_id, (int)i, SSL3_SSL_SESSION_ID_LENGTH);
+        if (!TEST_int_eq(SSL_CTX_add_session(ctx, sess[i]), 1))
+            goto end;
+    }
+    if (!TEST_long_gt(SSL_CTX_sess_number(ctx), 2)
+        || !TEST_long_le(SSL_CTX_sess_number(ctx), 16)
+        || !TEST_true(SSL_has_matching_session_id(ssl, sess[63]->session_id,
+                                                  SSL3_SSL_SESSION_ID_LENGTH))
+        || !TEST_int_eq(SSL_CTX_remove_session(ctx, sess[63]), 1)
+        || !TEST_false(SSL_has_matching_session_id(ssl, sess[63]->session_id,
+                                                   SSL3_SSL_SESSION_ID_LENGTH)))
+        goto end;
+
+    /* The shards can only be changed while the cache is empty */
+    if (!TEST_false(SSL_CTX_set_session_cache_shards(ctx, 2)))
+        goto end;
+    SSL_CTX_flush_sessions(ctx, 0);
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), 0)
+        || !TEST_true(SSL_CTX_set_session_cache_shards(ctx, 2)))
+        goto end;
+
+    /*
+     * Expired sessions are removed when a session is added to their shard.
+     * Sessions IDs that only differ after the 4th byte share their shard.
+     */
+    if (!TEST_ptr(old = SSL_SESSION_new())
+        || !TEST_ptr(new = SSL_SESSION_new()))
+        goto end;
+    old->session_id_length = new->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+    memset(old->session_id, 7, SSL3_SSL_SESSION_ID_LENGTH);
+    memset(new->session_id, 7, SSL3_SSL_SESSION_ID_LENGTH);
+    new->session_id[4] = 8;
+    if (!TEST_int_eq(SSL_CTX_add_session(ctx, old), 1)
+        || !TEST_int_ne(SSL_SESSION_set_time(old, now - 1000), 0)
+        || !TEST_long_eq(SSL_CTX_sess_number(ctx), 1)
+        || !TEST_int_eq(SSL_CTX_add_session(ctx, new), 1)
+        || !TEST_long_eq(SSL_CTX_sess_number(ctx), 1)
+        || !TEST_int_eq(SSL_CTX_remove_session(ctx, old), 0))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    for (i = 0; i < OSSL_NELEM(sess); i++)
+        SSL_SESSION_free(sess[i]);
+    SSL_SESSION_free(old);
+    SSL_SESSION_free(new);
+    return testresult;
+}
+
+static int test_session_expire(int idx)
+{
+    SSL_SESSION *sess[10] = { NULL };
+    SSL_CTX *ctx;
+    size_t i;
+    long now = (long)time(NULL);
+    int testresult = 0;
+
+    if (!TEST_ptr(ctx = SSL_CTX_new_ex(libctx, NULL, TLS_server_method()))
+        || (idx == 1
+            && !TEST_true(SSL_CTX_set_session_cache_shards(ctx, 4))))
+        goto end;
+    /* Keep a sharded cache from expiring sessions while they are added */
+    (void)SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_NO_AUTO_CLEAR
+                                         | SSL_CTX_get_session_cache_mode(ctx));
+
+    /* The first 6 sessions have expired */
+    for (i = 0; i < OSSL_NELEM(sess); i++) {
+        if (!TEST_ptr(sess[i] = SSL_SESSION_new()))
+            goto end;
+        sess[i]->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+        memset(sess[i]->session_id, (int)i + 1, SSL3_SSL_SESSION_ID_LENGTH);
+        if (!TEST_int_ne(SSL_SESSION_set_time(sess[i],
+                                              i < 6 ? now - 1000 : now), 0)
+            || !TEST_int_eq(SSL_CTX_add_session(ctx, sess[i]), 1))
+            goto end;
+    }
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), (long)OSSL_NELEM(sess))
+        || !TEST_size_t_eq(SSL_CTX_expire_sessions(ctx, now, 0), 0))
+        goto end;
+    /* The budget is shared between the shards */
+    if (idx == 0) {
+        if (!TEST_size_t_eq(SSL_CTX_expire_sessions(ctx, now, 4), 4))
+            goto end;
+    } else if (!TEST_size_t_le(SSL_CTX_expire_sessions(ctx, now, 4), 4)) {
+        goto end;
+    }
+
+    /* Nothing but the expired sessions is ever removed */
+    while (SSL_CTX_expire_sessions(ctx, now, 4) != 0)
+        continue;
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), 4))
+        goto end;
+    for (i = 0; i < OSSL_NELEM(sess); i++)
+        if (!TEST_int_eq(SSL_CTX_remove_session(ctx, sess[i]), i >= 6))
+            goto end;
+
+    testresult = 1;
+ end:
+    SSL_CTX_free(ctx);
+    for (i = 0; i < OSSL_NELEM(sess); i++)
+        SSL_SESSION_free(sess[i]);
+    return testresult;
+}
+
 static int test_session_timeout(int test)
 {
     /*
@@ -9623,6 +10668,7 @@ int setup_tests(void)
 # if !defined(OPENSSL_NO_TLS1_2) || !defined(OSSL_NO_USABLE_TLS1_3)
     ADD_ALL_TESTS(test_ktls, NUM_KTLS_TEST_CIPHERS * 4);
     ADD_ALL_TESTS(test_ktls_sendfile, NUM_KTLS_TEST_CIPHERS);
+    ADD_ALL_TESTS(test_ktls_splice, NUM_KTLS_TEST_CIPHERS * 2);
 # endif
 #endif
     ADD_TEST(test_large_message_tls);
@@ -9637,6 +10683,24 @@ int setup_tests(void)
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
     ADD_TEST(test_session_with_both_cache);
+#if !defined(OPENSSL_NO_TLS1_2) && defined(OPENSSL_SYS_UNIX) \
+    && defined(OPENSSL_THREADS)
+    ADD_TEST(test_shared_session_cache);
+#endif
+    ADD_TEST(test_session_encode);
+    ADD_ALL_TESTS(test_flat_session_tickets, 2);
+    ADD_TEST(test_buffer_pool);
+#if !defined(OPENSSL_NO_EC) && !defined(OSSL_NO_USABLE_TLS1_3)
+    ADD_TEST(test_key_share_pool);
+#endif
+    ADD_ALL_TESTS(test_write_batch, NUM_WRITE_BATCH_CIPHERS);
+    ADD_ALL_TESTS(test_writev_readv, 2);
+#ifndef OSSL_NO_USABLE_TLS1_3
+    ADD_TEST(test_zero_copy_read);
+#endif
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_TEST(test_ticket_key_ring);
+#endif
     ADD_TEST(test_session_wo_ca_names);
 #ifndef OSSL_NO_USABLE_TLS1_3
     ADD_ALL_TESTS(test_stateful_tickets, 3);
@@ -9758,6 +10822,8 @@ int setup_tests(void)
     ADD_TEST(test_inherit_verify_param);
     ADD_TEST(test_set_alpn);
     ADD_ALL_TESTS(test_session_timeout, 1);
+    ADD_TEST(test_session_cache_shards);
+    ADD_ALL_TESTS(test_session_expire, 2);
     return 1;
 
  err:
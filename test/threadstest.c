@@ -19,6 +19,10 @@
 #include <openssl/rsa.h>
 #include <openssl/aes.h>
 #include <openssl/rsa.h>
+#include <openssl/pem.h>
+#include <openssl/decoder.h>
+#include <openssl/err.h>
+#include "crypto/evp.h"          /* For the method reference counts */
 #include "testutil.h"
 #include "threadstest.h"
 
@@ -555,6 +559,356 @@ static int test_multi_load(void)
     return res && multi_success;
 }
 
+/*
+ * Fetch the same algorithms from several threads at once, and check that
+ * every thread gets the same method and that all references taken by the
+ * fetches are released again.
+ * Test 0: Fetches going to the method store
+ * Test 1: Fetches served by the per-thread fetch cache
+ */
+#define MULTI_FETCH_THREADS         4
+#define MULTI_FETCH_LOOPS           500
+
+static EVP_MD *multi_fetch_md = NULL;
+static EVP_CIPHER *multi_fetch_cipher = NULL;
+
+static void thread_multi_fetch_worker(void)
+{
+    EVP_MD *md;
+    EVP_CIPHER *ciph;
+    int i;
+
+    for (i = 0; i < MULTI_FETCH_LOOPS; i++) {
+        md = EVP_MD_fetch(multi_libctx, "SHA2-256", NULL);
+        ciph = EVP_CIPHER_fetch(multi_libctx, "AES-128-GCM", NULL);
+        if (md != multi_fetch_md || ciph != multi_fetch_cipher)
+            multi_success = 0;
+        EVP_MD_free(md);
+        EVP_CIPHER_free(ciph);
+    }
+    /* Releases the references held by the per-thread fetch cache */
+    OPENSSL_thread_stop_ex(multi_libctx);
+}
+
+static int test_multi_fetch(int idx)
+{
+    thread_t threads[MULTI_FETCH_THREADS];
+    OSSL_PROVIDER *prov = NULL;
+    int md_refs, cipher_refs, i, testresult = 0;
+
+    multi_success = 1;
+    if (!TEST_true(test_get_libctx(&multi_libctx, NULL, config_file,
+                                   NULL, NULL))
+            || !TEST_ptr(prov = OSSL_PROVIDER_load(multi_libctx, "default"))
+            || !TEST_true(EVP_thread_fetch_cache_enable(multi_libctx,
+                                                        idx == 1))
+            || !TEST_ptr(multi_fetch_md = EVP_MD_fetch(multi_libctx,
+                                                       "SHA2-256", NULL))
+            || !TEST_ptr(multi_fetch_cipher
+                         = EVP_CIPHER_fetch(multi_libctx, "AES-128-GCM",
+                                            NULL)))
+        goto err;
+    md_refs = multi_fetch_md->refcnt;
+    cipher_refs = multi_fetch_cipher->refcnt;
+
+    for (i = 0; i < MULTI_FETCH_THREADS; i++)
+        if (!TEST_true(run_thread(&threads[i], thread_multi_fetch_worker)))
+            goto err;
+    for (i = 0; i < MULTI_FETCH_THREADS; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            goto err;
+
+    if (!TEST_true(multi_success)
+            || !TEST_int_eq(multi_fetch_md->refcnt, md_refs)
+            || !TEST_int_eq(multi_fetch_cipher->refcnt, cipher_refs))
+        goto err;
+    testresult = 1;
+ err:
+    EVP_MD_free(multi_fetch_md);
+    multi_fetch_md = NULL;
+    EVP_CIPHER_free(multi_fetch_cipher);
+    multi_fetch_cipher = NULL;
+    OPENSSL_thread_stop_ex(multi_libctx);
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(multi_libctx);
+    multi_libctx = NULL;
+    return testresult;
+}
+
+/*
+ * Freeze a library context while other threads fetch from it and use what
+ * they fetch.  The threads keep going for a while after they see it frozen,
+ * so that they search the method stores both with and without locks.
+ */
+#define MULTI_FREEZE_THREADS        4
+#define MULTI_FREEZE_LOOPS          200
+
+static void thread_multi_freeze_worker(void)
+{
+    static const unsigned char expected[] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+        0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+        0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int outl;
+    EVP_MD *md;
+    EVP_CIPHER *ciph;
+    int i = 0;
+
+    while (i < MULTI_FREEZE_LOOPS) {
+        if (OSSL_LIB_CTX_is_frozen(multi_libctx))
+            i++;
+        md = EVP_MD_fetch(multi_libctx, "SHA2-256", NULL);
+        ciph = EVP_CIPHER_fetch(multi_libctx, "AES-128-GCM", NULL);
+        if (md != multi_fetch_md || ciph != multi_fetch_cipher
+                || !EVP_Digest("abc", 3, out, &outl, md, NULL)
+                || outl != sizeof(expected)
+                || memcmp(out, expected, outl) != 0)
+            multi_success = 0;
+        EVP_MD_free(md);
+        EVP_CIPHER_free(ciph);
+        if (!multi_success)
+            break;
+    }
+}
+
+static int test_multi_freeze(void)
+{
+    thread_t threads[MULTI_FREEZE_THREADS];
+    OSSL_PROVIDER *prov = NULL;
+    int i, started = 0, testresult = 0;
+
+    multi_success = 1;
+    if (!TEST_true(test_get_libctx(&multi_libctx, NULL, config_file,
+                                   NULL, NULL))
+            || !TEST_ptr(prov = OSSL_PROVIDER_load(multi_libctx, "default"))
+            || !TEST_ptr(multi_fetch_md = EVP_MD_fetch(multi_libctx,
+                                                       "SHA2-256", NULL))
+            || !TEST_ptr(multi_fetch_cipher
+                         = EVP_CIPHER_fetch(multi_libctx, "AES-128-GCM",
+                                            NULL)))
+        goto err;
+
+    for (; started < MULTI_FREEZE_THREADS; started++)
+        if (!TEST_true(run_thread(&threads[started],
+                                  thread_multi_freeze_worker)))
+            break;
+    if (started == MULTI_FREEZE_THREADS
+            && TEST_true(OSSL_LIB_CTX_freeze(multi_libctx, NULL)))
+        testresult = 1;
+    /* The workers only stop once the library context is frozen */
+    if (!testresult)
+        multi_success = 0;
+    for (i = 0; i < started; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            testresult = 0;
+    if (!TEST_true(multi_success))
+        testresult = 0;
+ err:
+    EVP_MD_free(multi_fetch_md);
+    multi_fetch_md = NULL;
+    EVP_CIPHER_free(multi_fetch_cipher);
+    multi_fetch_cipher = NULL;
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(multi_libctx);
+    multi_libctx = NULL;
+    return testresult;
+}
+
+/*
+ * Decode a PEM encoded private key from several threads at once.  Setting up
+ * a decoder context is dominated by algorithm name lookups, so this checks
+ * that concurrent readers of the namemap get correct results: every thread
+ * must decode the same key, and find it under all names of its algorithm.
+ * The threads also fail to decode DER that isn't any key, which every decoder
+ * tries, raising and discarding errors, as happens when probing formats.
+ */
+#define MULTI_DECODE_THREADS        4
+#define MULTI_DECODE_LOOPS          20
+
+static EVP_PKEY *multi_decode_pkey = NULL;
+static const char *multi_decode_pem = NULL;
+static size_t multi_decode_pemlen = 0;
+
+static int multi_decode(const char *input_type, const unsigned char *data,
+                        size_t datalen, EVP_PKEY **pkey)
+{
+    OSSL_DECODER_CTX *dctx;
+    int ret;
+
+    *pkey = NULL;
+    dctx = OSSL_DECODER_CTX_new_for_pkey(pkey, input_type, NULL, NULL,
+                                         OSSL_KEYMGMT_SELECT_KEYPAIR,
+                                         multi_libctx, NULL);
+    ret = dctx != NULL && OSSL_DECODER_from_data(dctx, &data, &datalen);
+    OSSL_DECODER_CTX_free(dctx);
+    return ret;
+}
+
+static void thread_multi_decode_worker(void)
+{
+    /* SEQUENCE { INTEGER 0, INTEGER 0 } */
+    static const unsigned char not_a_key[] = {
+        0x30, 0x06, 0x02, 0x01, 0x00, 0x02, 0x01, 0x00
+    };
+    EVP_PKEY *pkey;
+    int i;
+
+    for (i = 0; i < MULTI_DECODE_LOOPS; i++) {
+        if (!multi_decode("PEM", (const unsigned char *)multi_decode_pem,
+                          multi_decode_pemlen, &pkey)
+                || EVP_PKEY_eq(pkey, multi_decode_pkey) != 1
+                || !EVP_PKEY_is_a(pkey, "RSA")
+                || !EVP_PKEY_is_a(pkey, "rsaEncryption")
+                || !EVP_PKEY_is_a(pkey, "1.2.840.113549.1.1.1")
+                || EVP_PKEY_is_a(pkey, "RSA-PSS"))
+            multi_success = 0;
+        EVP_PKEY_free(pkey);
+
+        if (multi_decode(NULL, not_a_key, sizeof(not_a_key), &pkey)
+                || pkey != NULL)
+            multi_success = 0;
+        EVP_PKEY_free(pkey);
+        ERR_clear_error();
+    }
+}
+
+static int test_multi_decode(void)
+{
+    thread_t threads[MULTI_DECODE_THREADS];
+    OSSL_PROVIDER *prov = NULL;
+    BIO *bio = NULL;
+    char *pem;
+    long pemlen;
+    int i, testresult = 0;
+
+    multi_success = 1;
+    if (!TEST_true(test_get_libctx(&multi_libctx, NULL, config_file,
+                                   NULL, NULL))
+            || !TEST_ptr(prov = OSSL_PROVIDER_load(multi_libctx, "default"))
+            || !TEST_ptr(multi_decode_pkey = load_pkey_pem(privkey,
+                                                           multi_libctx))
+            || !TEST_ptr(bio = BIO_new(BIO_s_mem()))
+            || !TEST_true(PEM_write_bio_PrivateKey(bio, multi_decode_pkey,
+                                                   NULL, NULL, 0, NULL, NULL))
+            || !TEST_long_gt(pemlen = BIO_get_mem_data(bio, &pem), 0))
+        goto err;
+    multi_decode_pem = pem;
+    multi_decode_pemlen = (size_t)pemlen;
+
+    for (i = 0; i < MULTI_DECODE_THREADS; i++)
+        if (!TEST_true(run_thread(&threads[i], thread_multi_decode_worker)))
+            goto err;
+    for (i = 0; i < MULTI_DECODE_THREADS; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            goto err;
+
+    testresult = TEST_true(multi_success);
+ err:
+    multi_decode_pem = NULL;
+    BIO_free(bio);
+    EVP_PKEY_free(multi_decode_pkey);
+    multi_decode_pkey = NULL;
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(multi_libctx);
+    multi_libctx = NULL;
+    return testresult;
+}
+
+/*
+ * Sign with one shared RSA key from several threads at once.  Every thread
+ * but the first to use the key takes its blinding from the key's pool, so
+ * this checks that concurrent blinding gives correct signatures: each one
+ * must match the signature made up front and must verify.
+ */
+#define MULTI_RSA_THREADS           4
+#define MULTI_RSA_LOOPS             20
+
+static EVP_PKEY *multi_rsa_pkey = NULL;
+static unsigned char multi_rsa_sig[512];
+static size_t multi_rsa_siglen = 0;
+
+static int multi_rsa_ctx_init(EVP_PKEY_CTX *ctx, int sign)
+{
+    return (sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) > 0
+           && EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) > 0;
+}
+
+static void thread_multi_rsa_worker(void)
+{
+    static const unsigned char tbs[32] = { 0 };
+    unsigned char sig[512];
+    size_t siglen;
+    EVP_PKEY_CTX *sctx, *vctx;
+    int i;
+
+    sctx = EVP_PKEY_CTX_new_from_pkey(multi_libctx, multi_rsa_pkey, NULL);
+    vctx = EVP_PKEY_CTX_new_from_pkey(multi_libctx, multi_rsa_pkey, NULL);
+    if (sctx == NULL || vctx == NULL
+            || !multi_rsa_ctx_init(sctx, 1)
+            || !multi_rsa_ctx_init(vctx, 0)) {
+        multi_success = 0;
+        goto err;
+    }
+    for (i = 0; i < MULTI_RSA_LOOPS; i++) {
+        siglen = sizeof(sig);
+        if (EVP_PKEY_sign(sctx, sig, &siglen, tbs, sizeof(tbs)) <= 0
+                || siglen != multi_rsa_siglen
+                || memcmp(sig, multi_rsa_sig, siglen) != 0
+                || EVP_PKEY_verify(vctx, sig, siglen, tbs, sizeof(tbs)) <= 0) {
+            multi_success = 0;
+            break;
+        }
+    }
+ err:
+    EVP_PKEY_CTX_free(sctx);
+    EVP_PKEY_CTX_free(vctx);
+}
+
+static int test_multi_rsa(void)
+{
+    static const unsigned char tbs[32] = { 0 };
+    thread_t threads[MULTI_RSA_THREADS];
+    OSSL_PROVIDER *prov = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    int i, testresult = 0;
+
+    multi_success = 1;
+    multi_rsa_siglen = sizeof(multi_rsa_sig);
+    if (!TEST_true(test_get_libctx(&multi_libctx, NULL, config_file,
+                                   NULL, NULL))
+            || !TEST_ptr(prov = OSSL_PROVIDER_load(multi_libctx, "default"))
+            || !TEST_ptr(multi_rsa_pkey = load_pkey_pem(privkey,
+                                                        multi_libctx))
+            || !TEST_ptr(ctx = EVP_PKEY_CTX_new_from_pkey(multi_libctx,
+                                                          multi_rsa_pkey,
+                                                          NULL))
+            || !TEST_true(multi_rsa_ctx_init(ctx, 1))
+            || !TEST_int_gt(EVP_PKEY_sign(ctx, multi_rsa_sig,
+                                          &multi_rsa_siglen, tbs,
+                                          sizeof(tbs)), 0))
+        goto err;
+
+    for (i = 0; i < MULTI_RSA_THREADS; i++)
+        if (!TEST_true(run_thread(&threads[i], thread_multi_rsa_worker)))
+            goto err;
+    for (i = 0; i < MULTI_RSA_THREADS; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            goto err;
+
+    testresult = TEST_true(multi_success);
+ err:
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(multi_rsa_pkey);
+    multi_rsa_pkey = NULL;
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(multi_libctx);
+    multi_libctx = NULL;
+    return testresult;
+}
+
 typedef enum OPTION_choice {
     OPT_ERR = -1,
     OPT_EOF = 0,
@@ -609,6 +963,10 @@ int setup_tests(void)
     ADD_TEST(test_thread_local);
     ADD_TEST(test_atomic);
     ADD_TEST(test_multi_load);
+    ADD_ALL_TESTS(test_multi_fetch, 2);
+    ADD_TEST(test_multi_freeze);
+    ADD_TEST(test_multi_decode);
+    ADD_TEST(test_multi_rsa);
     ADD_ALL_TESTS(test_multi, 6);
     return 1;
 }